@@ -21,6 +21,7 @@
 #define IDD_SETTINGS            132
 #define IDD_DOWNLOAD_MANAGER    133
 #define IDD_PLAYLIST            131
+#define IDD_MIRRORS             134
 #define IDC_PROGRESS_BAR        1006
 #define IDC_PROGRESS_TEXT       1031
 #define IDC_COMBO_RESOLUTION    1001
@@ -51,11 +52,23 @@
 #define IDM_NAV_FORWARD         32786
 #define IDM_NAV_RELOAD          32787
 #define IDM_NAV_HOME            32788
+#define IDM_PLAYLIST_MIRRORS    32789
 #define IDC_PROGRESS            1030
 #define IDC_PROGRESS_PERCENT    1032
 #define IDC_TIME_REMAINING      1033
 #define IDC_DOWNLOAD_SPEED      1034
 #define IDC_HIDE_BUTTON         1035
+#define IDC_EDIT_FILTER         1036
+#define IDC_BUTTON_SELECT_MATCHING 1037
+#define IDC_BUTTON_DESELECT_MATCHING 1038
+#define IDC_BUTTON_PROBE        1039
+#define IDC_MIRROR_LIST         1040
+#define IDC_BUTTON_MIRROR_ADD   1041
+#define IDC_BUTTON_MIRROR_REMOVE 1042
+#define IDC_BUTTON_MIRROR_SYNC  1043
+#define IDC_CHECK_MIRROR_REPORT 1044
+#define IDC_EDIT_SECTIONS       1045
+#define IDC_STATIC_QUEUE_RESULT 1046
 #ifndef IDC_STATIC
 #define IDC_STATIC				-1
 #endif
@@ -65,9 +78,9 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 
 #define _APS_NO_MFC					1
-#define _APS_NEXT_RESOURCE_VALUE	134
-#define _APS_NEXT_COMMAND_VALUE		32789
-#define _APS_NEXT_CONTROL_VALUE		1036
+#define _APS_NEXT_RESOURCE_VALUE	135
+#define _APS_NEXT_COMMAND_VALUE		32790
+#define _APS_NEXT_CONTROL_VALUE		1047
 #define _APS_NEXT_SYMED_VALUE		110
 #endif
 #endif
@@ -12,19 +12,49 @@
 #include <CommCtrl.h>
 #include <thread>
 #include <vector>
+#include <algorithm>
 #include <regex>
 #include <ShlObj.h> // For SHBrowseForFolder
 #include <fstream>
 #include <mutex>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <unordered_map>
+#include <unordered_set>
 #include <sstream>
 #include "nlohmann/json.hpp"
+#include "core/ChunkedList.h"
+#include "core/Cookies.h"
+#include "core/InnerTube.h"
+#include "core/JsonFields.h"
+#include "core/PlaylistEntrySax.h"
+#include "core/PlayerResponse.h"
+#include "core/Process.h"
+#include "core/ProgressLines.h"
+#include "core/SegmentedTransfer.h"
+#include "core/Subtitles.h"
+#include "core/Xxh64.h"
+#include "core/YouTubeUrl.h"
 #include <Windows.h>
 #include <winreg.h> // For registry functions
 #include <shellapi.h> // For ShellExecute and SHELLEXECUTEINFO
+#include <winhttp.h> // For the native playlist enumerator
+#include <wincrypt.h> // For DPAPI encryption of the exported cookies
+#include <winsock2.h> // For the loopback control API
+#include <ws2tcpip.h>
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h> // For SSE2 title filtering
+#endif
 
 #pragma comment(lib, "Comctl32.lib")
 #pragma comment(lib, "WebView2LoaderStatic.lib")
 #pragma comment(lib, "Shell32.lib") // For ShellExecute functions
+#pragma comment(lib, "winhttp.lib")
+#pragma comment(lib, "Crypt32.lib")
+#pragma comment(lib, "ws2_32.lib")
 
 using namespace Microsoft::WRL;
 
@@ -33,6 +63,11 @@ INT_PTR CALLBACK DownloadOptionsProc(HWND hDlg, UINT message, WPARAM wParam, LPA
 INT_PTR CALLBACK DownloadProgressProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam);
 INT_PTR CALLBACK DownloadManagerProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam);
 DWORD WINAPI DownloadThread(LPVOID lpParam);
+void StartQueuedDownloads();
+void ShowDownloadManager();
+void StartLibraryIndex();
+bool IsVideoInLibrary(const std::wstring& videoId);
+int ResolutionToHeight(const std::wstring& resolution);
 void SetLightMode();
 void SetDarkMode();
 void UseSystemTheme();
@@ -45,31 +80,95 @@ HINSTANCE hInst;                                // current instance
 ICoreWebView2Controller* g_webViewController = nullptr;
 ICoreWebView2* g_webView = nullptr;
 bool g_isAudioOnly = false;
+HWND g_hMainWnd = NULL;
+HWND g_hDownloadManager = NULL;                 // Modeless download manager, if open
 
 enum DownloadStatus {
+    Queued,
     Downloading,
+    WaitingToProcess,   // Downloaded; waiting for a post-processing worker
+    Processing,
     Completed,
     Failed,
-    Cancelled
+    Cancelled,
+    Paused              // Stopped through the control API; the partial file is kept
 };
 
 // Struct to hold all info about a download
 struct DownloadItem {
+    int id = 0;                 // Stable handle for the control API
     std::wstring url;
     std::wstring resolution;
     std::wstring path;
     bool downloadSubtitles;
     DownloadStatus status;
     double progress;
-    HANDLE hProcess;
+    ChildProcess* process;  // The running yt-dlp or ffmpeg, set and cleared under g_queueMutex
     HANDLE hThread;  // Add handle to thread
     DWORD threadId;
     HWND progressDlg; // Handle to the progress dialog for this download
     DWORD startTime;  // Add start time for calculating progress
+    std::wstring outputTemplate = L"%(title)s.%(ext)s"; // yt-dlp -o template within path
+    std::wstring archivePath;   // yt-dlp --download-archive file, if any
+    std::wstring title;         // Known video title, shown instead of the URL
+    std::wstring plan;          // Post-processing pipeline chosen for this item
+    std::wstring targetExt;     // Container the post-processing stage produces
+    std::vector<std::wstring> stageFiles; // Streams the download stage left on disk
+    std::wstring sections;      // Time ranges or chapter names to download instead of the whole video
+    double estimatedSize = 0;   // Bytes, for the sections only when set; 0 if unknown
+    double cpuSeconds = 0;      // CPU time used by yt-dlp and its ffmpeg children
+    std::atomic<double> speed{ 0 }; // Bytes per second from yt-dlp's latest progress line; written without the lock
+    int throttleRestarts = 0;   // Times the item was restarted because its stream URL was throttled
+    std::wstring formatIds;     // Streams the format selector resolved to, e.g. "137,140"
+    bool resumed = false;       // Restored from queue.json; formatIds then pins the selection
+    bool running = false;       // A DownloadThread or the archive check still holds the item (guarded by g_queueMutex)
+    bool postProcessing = false; // Queued for or held by a post-processing worker (guarded by g_queueMutex)
+    bool resumeRequested = false; // Resumed while the stopping thread was still running
+    bool releaseOnExit = false; // Its progress dialog closed first; DownloadThread frees it (guarded by g_queueMutex)
+    bool archiveChecked = false; // Nothing in the download archive could stand in for this item
+    bool skipInfoJsonCache = false; // The cached info JSON failed or went stale; extract from the URL
 };
 
+// Every download started through the scheduler. Finished items stay until there are more than
+// kMaxFinishedDownloads of them; the oldest are then freed.
 std::vector<DownloadItem*> g_downloadQueue;
 std::mutex g_queueMutex;
+std::atomic<int> g_nextDownloadId(1);
+
+// Helper function to check whether a running item was asked to stop (cancelled or paused)
+bool IsDownloadStopped(const DownloadItem* item) {
+    return item->status == Cancelled || item->status == Paused;
+}
+
+// IsDownloadStopped for a download or transfer thread, which doesn't hold g_queueMutex
+bool PollDownloadStopped(const DownloadItem* item) {
+    std::lock_guard<std::mutex> lock(g_queueMutex);
+    return IsDownloadStopped(item);
+}
+
+// Helper function to check from a download thread whether its item was paused rather than cancelled
+bool PollDownloadPaused(const DownloadItem* item) {
+    std::lock_guard<std::mutex> lock(g_queueMutex);
+    return item->status == Paused;
+}
+
+// Finished (completed, failed or cancelled) items kept in the queue and the Download Manager
+const size_t kMaxFinishedDownloads = 200;
+// Subtitle-only jobs fetch a few KB each, so many more of them can run without competing for bandwidth
+const int kMaxConcurrentSubtitleJobs = 8;
+
+// Audio-only choices. m4a and opus match the audio streams YouTube serves, so they can be copied as-is.
+const wchar_t* kAudioOnlyM4a = L"Audio Only (m4a)";
+const wchar_t* kAudioOnlyOpus = L"Audio Only (opus)";
+const wchar_t* kAudioOnlyMp3 = L"Audio Only (mp3)";
+// Subtitle-only choices; no media is downloaded
+const wchar_t* kSubtitlesOnlySrt = L"Subtitles Only (srt)";
+const wchar_t* kSubtitlesOnlyText = L"Subtitles Only (txt)";
+
+// Helper function to check whether a resolution choice skips the media entirely
+bool IsSubtitleOnly(const std::wstring& resolution) {
+    return resolution == kSubtitlesOnlySrt || resolution == kSubtitlesOnlyText;
+}
 
 // Application settings
 struct AppSettings {
@@ -83,6 +182,22 @@ struct AppSettings {
         System
     };
     ThemeMode themeMode = ThemeMode::System;
+
+    // Where InnerTube requests go; can point at a local server that replays recorded responses
+    std::wstring innerTubeBaseUrl = L"https://www.youtube.com";
+
+    // Web client version sent with InnerTube requests, empty for the built-in one.
+    // Set it when YouTube stops serving playlists to the built-in version.
+    std::wstring innerTubeClientVersion = L"";
+
+    // Port of the loopback control API; 0 leaves it off
+    int controlApiPort = 0;
+
+    // Replace finished files that are identical to an earlier download with hard links
+    bool deduplicateDownloads = true;
+
+    // Queued video and audio downloads allowed to run at the same time
+    int maxConcurrentDownloads = 2;
 };
 AppSettings g_settings;
 
@@ -100,6 +215,52 @@ std::wstring GetSettingsPath() {
     return L"";
 }
 
+// Helper function to get the path of a file in the YoutubePlus AppData folder
+std::wstring GetAppDataFilePath(const wchar_t* fileName) {
+    std::wstring settingsPath = GetSettingsPath();
+    size_t pos = settingsPath.find_last_of(L"\\");
+    if (pos == std::wstring::npos) {
+        return L"";
+    }
+    return settingsPath.substr(0, pos + 1) + fileName;
+}
+
+// Helper function to convert UTF-8 text to a wide string
+std::wstring Utf8ToWide(const std::string& text) {
+    if (text.empty()) return L"";
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, text.c_str(), (int)text.size(), NULL, 0);
+    std::wstring result(size_needed, 0);
+    MultiByteToWideChar(CP_UTF8, 0, text.c_str(), (int)text.size(), &result[0], size_needed);
+    return result;
+}
+
+// Helper function to convert a wide string to UTF-8
+std::string WideToUtf8(const std::wstring& text) {
+    if (text.empty()) return "";
+    int size_needed = WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.size(), NULL, 0, NULL, NULL);
+    std::string result(size_needed, 0);
+    WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.size(), &result[0], size_needed, NULL, NULL);
+    return result;
+}
+
+// Helper function to quote one command line argument so it reaches the program unchanged
+std::wstring QuoteArgument(const std::wstring& argument) {
+    return Utf8ToWide(QuoteCommandArgument(WideToUtf8(argument)));
+}
+
+// Helper function to format a duration in seconds as h:mm:ss or m:ss
+std::wstring FormatDuration(double seconds) {
+    if (seconds <= 0) return L"";
+    int total = (int)(seconds + 0.5);
+    wchar_t text[32];
+    if (total >= 3600) {
+        swprintf_s(text, L"%d:%02d:%02d", total / 3600, (total / 60) % 60, total % 60);
+    } else {
+        swprintf_s(text, L"%d:%02d", total / 60, total % 60);
+    }
+    return text;
+}
+
 // Helper function to save settings
 void SaveSettings() {
     nlohmann::json j;
@@ -111,6 +272,11 @@ void SaveSettings() {
     std::string path_str(size_needed, 0);
     WideCharToMultiByte(CP_UTF8, 0, &g_settings.defaultDownloadPath[0], (int)g_settings.defaultDownloadPath.size(), &path_str[0], size_needed, NULL, NULL);
     j["defaultDownloadPath"] = path_str;
+    j["innerTubeBaseUrl"] = WideToUtf8(g_settings.innerTubeBaseUrl);
+    j["innerTubeClientVersion"] = WideToUtf8(g_settings.innerTubeClientVersion);
+    j["controlApiPort"] = g_settings.controlApiPort;
+    j["deduplicateDownloads"] = g_settings.deduplicateDownloads;
+    j["maxConcurrentDownloads"] = g_settings.maxConcurrentDownloads;
 
     std::wstring settingsPath = GetSettingsPath();
     if (!settingsPath.empty()) {
@@ -141,6 +307,22 @@ void LoadSettings() {
                 MultiByteToWideChar(CP_UTF8, 0, &path_str[0], (int)path_str.size(), &w_path_str[0], size_needed);
                 g_settings.defaultDownloadPath = w_path_str;
             }
+            if (j.contains("innerTubeBaseUrl") && j["innerTubeBaseUrl"].is_string()) {
+                g_settings.innerTubeBaseUrl = Utf8ToWide(j["innerTubeBaseUrl"].get<std::string>());
+            }
+            if (j.contains("innerTubeClientVersion") && j["innerTubeClientVersion"].is_string()) {
+                g_settings.innerTubeClientVersion = Utf8ToWide(j["innerTubeClientVersion"].get<std::string>());
+            }
+            if (j.contains("controlApiPort") && j["controlApiPort"].is_number_integer()) {
+                g_settings.controlApiPort = j["controlApiPort"].get<int>();
+            }
+            if (j.contains("deduplicateDownloads") && j["deduplicateDownloads"].is_boolean()) {
+                g_settings.deduplicateDownloads = j["deduplicateDownloads"].get<bool>();
+            }
+            if (j.contains("maxConcurrentDownloads") && j["maxConcurrentDownloads"].is_number_integer()) {
+                int limit = j["maxConcurrentDownloads"].get<int>();
+                g_settings.maxConcurrentDownloads = limit < 1 ? 1 : (limit > 16 ? 16 : limit);
+            }
         }
     }
 }
@@ -159,774 +341,4138 @@ struct DownloadOptions {
     std::wstring videoUrl;
     bool downloadSubtitles;
     HANDLE hProcess = NULL; // To hold the handle of the yt-dlp process
+    std::wstring sections;  // Comma-separated time ranges ("1:30-3:00") or chapter names; empty for the whole video
 };
 
-// Structure to hold playlist video info
-struct PlaylistVideo {
-    std::wstring title;
-    std::wstring url;
-    bool selected;
-};
-
-std::vector<PlaylistVideo> g_playlistVideos;
+// Message posted to a window when probed video metadata lands in the cache
+#define WM_APP_VIDEOINFO_READY (WM_APP + 1)
+// Messages posted to the mirrors dialog while a sync runs
+#define WM_APP_MIRROR_STATUS (WM_APP + 2)
+#define WM_APP_MIRROR_SYNC_DONE (WM_APP + 3)
+// Posted to the main window when a later launch handed over its URLs (wParam = number queued)
+#define WM_APP_INSTANCE_ACTIVATE (WM_APP + 4)
+// Posted to the Download Manager when a bulk paste has been queued (wParam = queued, lParam = skipped)
+#define WM_APP_BULK_QUEUED (WM_APP + 5)
 
-// Parse playlist page to extract videos
-DWORD WINAPI FetchPlaylistVideosThread(LPVOID lpParam) {
-    HWND hDlg = (HWND)lpParam;
-    
-    // Get the playlist URL safely
-    std::wstring playlistUrl;
-    
-    // Get the playlist URL with safer access
-    void* userData = (void*)GetWindowLongPtr(hDlg, GWLP_USERDATA);
-    if (!userData) {
-        MessageBox(hDlg, L"Failed to get playlist URL from dialog.", L"Error", MB_OK | MB_ICONERROR);
-        return 1;
-    }
-    
-    try {
-        playlistUrl = *(std::wstring*)userData;
-    }
-    catch (...) {
-        MessageBox(hDlg, L"Error accessing playlist URL data.", L"Error", MB_OK | MB_ICONERROR);
-        return 1;
-    }
-    
-    if (playlistUrl.empty()) {
-        MessageBox(hDlg, L"Playlist URL is empty.", L"Error", MB_OK | MB_ICONERROR);
-        return 1;
-    }
-    
-    // Support both playlist URLs and watch?v=XXX&list=XXX format
-    bool isPlaylistPage = playlistUrl.find(L"youtube.com/playlist") != std::wstring::npos;
-    bool isWatchListPage = playlistUrl.find(L"youtube.com/watch") != std::wstring::npos && 
-                          playlistUrl.find(L"list=") != std::wstring::npos;
-    
-    if (!isPlaylistPage && !isWatchListPage) {
-        MessageBox(hDlg, L"The URL does not appear to be a YouTube playlist.", L"Error", MB_OK | MB_ICONERROR);
-        return 1;
-    }
-    
-    // Get full path to yt-dlp.exe
+// Helper function to get the folder containing YoutubePlus.exe (and yt-dlp.exe)
+std::wstring GetAppDirectory() {
     wchar_t exePath[MAX_PATH];
     GetModuleFileNameW(NULL, exePath, MAX_PATH);
     std::wstring exeDir = exePath;
     size_t pos = exeDir.find_last_of(L"\\/");
-    std::wstring ytdlpPath = L"yt-dlp.exe";
-    std::wstring workingDir;
-    if (pos != std::wstring::npos) {
-        workingDir = exeDir.substr(0, pos);
-        ytdlpPath = L"\"" + workingDir + L"\\yt-dlp.exe\"";
+    if (pos == std::wstring::npos) {
+        return L"";
     }
+    return exeDir.substr(0, pos);
+}
 
-    // Run yt-dlp to get playlist info in JSON format
-    std::wstring command = ytdlpPath + L" --flat-playlist --dump-json \"" + playlistUrl + L"\"";
-    
-    HANDLE hChildStd_OUT_Rd = NULL;
-    HANDLE hChildStd_OUT_Wr = NULL;
-    HANDLE hChildStd_ERR_Rd = NULL;
-    HANDLE hChildStd_ERR_Wr = NULL;
-    
-    SECURITY_ATTRIBUTES sa;
-    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
-    sa.bInheritHandle = TRUE;
-    sa.lpSecurityDescriptor = NULL;
-
-    // Create pipes for stdout and stderr with proper error checking
-    if (!CreatePipe(&hChildStd_OUT_Rd, &hChildStd_OUT_Wr, &sa, 0) ||
-        !CreatePipe(&hChildStd_ERR_Rd, &hChildStd_ERR_Wr, &sa, 0)) {
-        MessageBox(hDlg, L"Failed to create pipes for process communication.", L"Error", MB_OK | MB_ICONERROR);
-        return 1;
-    }
-    
-    SetHandleInformation(hChildStd_OUT_Rd, HANDLE_FLAG_INHERIT, 0);
-    SetHandleInformation(hChildStd_ERR_Rd, HANDLE_FLAG_INHERIT, 0);
+// How long a captured yt-dlp run may take before it is killed. A stalled extractor or a
+// network that never answers would otherwise block the calling worker forever.
+const DWORD kYtDlpCaptureTimeoutMs = 2 * 60 * 1000;
 
-    PROCESS_INFORMATION pi = { 0 };
-    STARTUPINFOW si = { sizeof(si) };
-    si.hStdError = hChildStd_ERR_Wr;
-    si.hStdOutput = hChildStd_OUT_Wr;
-    si.dwFlags |= STARTF_USESTDHANDLES;
+// Helper function to run yt-dlp with the given arguments and capture its standard output.
+// Returns false if it could not be started or was killed after timeoutMs.
+bool RunYtDlpCapture(const std::wstring& arguments, std::string& output, DWORD& exitCode,
+                     DWORD timeoutMs = kYtDlpCaptureTimeoutMs) {
+    std::wstring workingDir = GetAppDirectory();
+    std::wstring command = workingDir.empty() ? L"yt-dlp.exe" : L"\"" + workingDir + L"\\yt-dlp.exe\"";
+    command += L" " + arguments;
 
-    g_playlistVideos.clear();
-    
-    bool processCreated = CreateProcessW(nullptr, &command[0], nullptr, nullptr, TRUE, CREATE_NO_WINDOW, nullptr, workingDir.c_str(), &si, &pi);
-    
-    // Always close write handles after process creation
-    CloseHandle(hChildStd_OUT_Wr);
-    CloseHandle(hChildStd_ERR_Wr);
-    
-    if (!processCreated) {
-        // Get the error message
-        DWORD errorCode = GetLastError();
-        wchar_t errorMsg[256];
-        swprintf_s(errorMsg, L"Failed to start yt-dlp.exe. Error code: %d", errorCode);
-        MessageBox(hDlg, errorMsg, L"Error", MB_OK | MB_ICONERROR);
-        CloseHandle(hChildStd_OUT_Rd);
-        CloseHandle(hChildStd_ERR_Rd);
-        return 1;
+    // Diagnostics aren't needed here; they are discarded so a full stderr pipe can't stall the child
+    ProcessOptions options;
+    options.workingDirectory = WideToUtf8(workingDir);
+    ChildProcess process;
+    if (!process.Start(WideToUtf8(command), options)) {
+        return false;
     }
-    
-    // Read the output
-    std::string jsonOutput;
-    std::string errorOutput;
+
+    // yt-dlp.exe unpacks itself and runs a second process, so a timeout kills the whole tree
+    ULONGLONG deadline = GetTickCount64() + timeoutMs;
+    bool timedOut = false;
     char buffer[4096];
-    DWORD bytesRead;
-    
-    // Read standard output
-    while (ReadFile(hChildStd_OUT_Rd, buffer, sizeof(buffer) - 1, &bytesRead, NULL) && bytesRead > 0) {
-        buffer[bytesRead] = '\0';
-        jsonOutput += buffer;
+    while (true) {
+        ULONGLONG now = GetTickCount64();
+        if (now >= deadline) {
+            timedOut = true;
+            break;
+        }
+        int bytesRead = process.ReadOutput(buffer, sizeof(buffer), (unsigned)(deadline - now));
+        if (bytesRead == kProcessReadClosed) {
+            break; // Every writer has exited
+        }
+        if (bytesRead > 0) {
+            output.append(buffer, bytesRead);
+        }
     }
-    
-    // Read error output
-    while (ReadFile(hChildStd_ERR_Rd, buffer, sizeof(buffer) - 1, &bytesRead, NULL) && bytesRead > 0) {
-        buffer[bytesRead] = '\0';
-        errorOutput += buffer;
+
+    if (timedOut) {
+        process.Kill();
     }
-    
-    // Wait for process to finish with timeout
-    WaitForSingleObject(pi.hProcess, 30000); // 30 second timeout
-    
-    DWORD exitCode = 0;
-    GetExitCodeProcess(pi.hProcess, &exitCode);
-    
-    // Clean up process handles
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
-    CloseHandle(hChildStd_OUT_Rd);
-    CloseHandle(hChildStd_ERR_Rd);
+    // Give a process that just closed its output a moment to exit even if the deadline is near
+    ULONGLONG now = GetTickCount64();
+    DWORD exitWaitMs = (!timedOut && deadline > now + 5000) ? (DWORD)(deadline - now) : 5000;
+    if (!process.Wait(exitWaitMs)) {
+        // Output ended but the process hung on exit
+        timedOut = true;
+        process.Kill();
+    }
+    int code = process.ExitCode();
+    exitCode = code < 0 ? 1 : (DWORD)code;
+    return !timedOut;
+}
 
-    if (exitCode != 0) {
-        // Process failed
-        wchar_t errorMsg[4096];
-        if (!errorOutput.empty()) {
-            // Convert error output to wstring for display
-            int size_needed = MultiByteToWideChar(CP_UTF8, 0, errorOutput.c_str(), (int)errorOutput.size(), NULL, 0);
-            std::wstring wErrorOutput(size_needed, 0);
-            MultiByteToWideChar(CP_UTF8, 0, errorOutput.c_str(), (int)errorOutput.size(), &wErrorOutput[0], size_needed);
-            
-            swprintf_s(errorMsg, L"Failed to extract playlist data. yt-dlp.exe returned error code %d.\n\nError: %s", 
-                       exitCode, wErrorOutput.c_str());
-        } else {
-            swprintf_s(errorMsg, L"Failed to extract playlist data. yt-dlp.exe returned error code %d.", exitCode);
+// Chapter of a video, times in seconds
+struct VideoChapter {
+    std::wstring title;
+    double start;
+    double end;
+};
+
+// Metadata gathered by probing a single video
+struct VideoInfo {
+    std::wstring id;
+    std::wstring title;
+    double duration = 0;                // Seconds
+    std::vector<VideoFormat> formats;
+    std::vector<VideoChapter> chapters; // Only known from a yt-dlp probe
+};
+typedef std::shared_ptr<const VideoInfo> VideoInfoPtr;
+
+// Probed metadata, keyed by video ID
+std::unordered_map<std::wstring, VideoInfoPtr> g_videoInfoCache;
+std::mutex g_videoInfoMutex;
+
+// Helper function to look up cached metadata for a video
+VideoInfoPtr GetCachedVideoInfo(const std::wstring& videoId) {
+    std::lock_guard<std::mutex> lock(g_videoInfoMutex);
+    auto it = g_videoInfoCache.find(videoId);
+    return it != g_videoInfoCache.end() ? it->second : VideoInfoPtr();
+}
+
+// Helper function to add metadata to the cache
+void StoreVideoInfo(const VideoInfoPtr& info) {
+    std::lock_guard<std::mutex> lock(g_videoInfoMutex);
+    g_videoInfoCache[info->id] = info;
+}
+
+// Parse the output of yt-dlp -J for a single video
+bool ParseVideoInfoJson(const std::string& text, VideoInfo& info) {
+    try {
+        auto json = nlohmann::json::parse(text);
+        if (!json.is_object() || JsonString(json, "id").empty()) {
+            return false;
         }
-        
-        MessageBox(hDlg, errorMsg, L"Error", MB_OK | MB_ICONERROR);
-        return 1;
-    }
 
-    if (jsonOutput.empty()) {
-        MessageBox(hDlg, L"No playlist data was returned from yt-dlp.", L"Warning", MB_OK | MB_ICONWARNING);
-        return 1;
-    }
+        info.id = Utf8ToWide(JsonString(json, "id"));
+        info.title = Utf8ToWide(JsonString(json, "title"));
+        info.duration = JsonNumber(json, "duration");
+        info.formats.clear();
 
-    // Parse each line as a separate JSON object
-    std::istringstream stream(jsonOutput);
-    std::string line;
-    int videosAdded = 0;
-    
-    while (std::getline(stream, line)) {
-        if (line.empty()) continue;
-        
-        try {
-            auto json = nlohmann::json::parse(line);
-            
-            // Use "id" instead of "url" for better compatibility
-            if (json.contains("title") && json.contains("id")) {
-                std::string title;
-                std::string id;
-                
-                try {
-                    title = json["title"].get<std::string>();
-                    id = json["id"].get<std::string>();
+        auto formats = json.find("formats");
+        if (formats != json.end() && formats->is_array()) {
+            for (const auto& f : *formats) {
+                VideoFormat format;
+                format.formatId = JsonString(f, "format_id");
+                format.ext = JsonString(f, "ext");
+                format.height = (int)JsonNumber(f, "height");
+                std::string vcodec = JsonString(f, "vcodec");
+                std::string acodec = JsonString(f, "acodec");
+                format.hasVideo = !vcodec.empty() && vcodec != "none";
+                format.hasAudio = !acodec.empty() && acodec != "none";
+                format.filesize = JsonNumber(f, "filesize");
+                if (format.filesize <= 0) {
+                    format.filesize = JsonNumber(f, "filesize_approx");
                 }
-                catch (...) {
-                    continue; // Skip entries with invalid title or id
+                format.tbr = JsonNumber(f, "tbr");
+
+                // Skip storyboards and other formats without media streams
+                if (!format.hasVideo && !format.hasAudio) {
+                    continue;
                 }
-                
-                // Convert to wstring
-                int titleSize = MultiByteToWideChar(CP_UTF8, 0, title.c_str(), -1, NULL, 0);
-                if (titleSize <= 0) continue;
-                
-                std::vector<wchar_t> wTitle(titleSize);
-                MultiByteToWideChar(CP_UTF8, 0, title.c_str(), -1, &wTitle[0], titleSize);
-                
-                // Construct the YouTube video URL directly from video ID
-                std::wstring videoUrl = L"https://www.youtube.com/watch?v=" + std::wstring(id.begin(), id.end());
-                
-                // Add to our playlist videos list
-                PlaylistVideo video = {&wTitle[0], videoUrl, true};
-                g_playlistVideos.push_back(video);
-                videosAdded++;
+                if (!format.hasVideo) {
+                    format.height = 0;
+                }
+                info.formats.push_back(format);
             }
         }
-        catch (...) {
-            // Skip any lines that don't parse correctly
-            continue;
+
+        info.chapters.clear();
+        auto chapters = json.find("chapters");
+        if (chapters != json.end() && chapters->is_array()) {
+            for (const auto& c : *chapters) {
+                VideoChapter chapter;
+                chapter.title = Utf8ToWide(JsonString(c, "title"));
+                chapter.start = JsonNumber(c, "start_time");
+                chapter.end = JsonNumber(c, "end_time");
+                info.chapters.push_back(chapter);
+            }
         }
+        return true;
     }
-    
-    if (videosAdded == 0) {
-        MessageBox(hDlg, L"No videos were found in the playlist.", L"Warning", MB_OK | MB_ICONWARNING);
-        return 1;
-    }
-    
-    // Update the UI with the fetched videos
-    if (IsWindow(hDlg)) {
-        // Use PostMessage instead of SendMessage to avoid deadlocks
-        PostMessage(hDlg, WM_COMMAND, MAKEWPARAM(IDC_PLAYLIST_LIST, LBN_SELCHANGE), 0);
+    catch (...) {
+        return false;
     }
-    
-    return 0;
 }
 
-// Dialog procedure for playlist selection
-INT_PTR CALLBACK PlaylistDialogProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
-    static std::wstring* pPlaylistUrl = nullptr;
-    
-    switch (message) {
-    case WM_INITDIALOG: {
-        pPlaylistUrl = (std::wstring*)lParam;
-        SetWindowLongPtr(hDlg, GWLP_USERDATA, (LONG_PTR)pPlaylistUrl);
-        
-        // Initialize the list view
-        HWND hList = GetDlgItem(hDlg, IDC_PLAYLIST_LIST);
-        
-        // Add columns to the list view
-        LVCOLUMNW lvc = { 0 };
-        lvc.mask = LVCF_TEXT | LVCF_WIDTH | LVCF_SUBITEM;
-        
-        lvc.iSubItem = 0;
-        lvc.pszText = (LPWSTR)L"Title";
-        lvc.cx = 320;
-        ListView_InsertColumn(hList, 0, &lvc);
-        
-        lvc.iSubItem = 1;
-        lvc.pszText = (LPWSTR)L"URL";
-        lvc.cx = 60;
-        ListView_InsertColumn(hList, 1, &lvc);
-        
-        // Set extended style to enable checkboxes
-        ListView_SetExtendedListViewStyle(hList, LVS_EX_CHECKBOXES | LVS_EX_FULLROWSELECT);
-        
-        // Start thread to fetch playlist data
-        CreateThread(NULL, 0, FetchPlaylistVideosThread, (LPVOID)hDlg, 0, NULL);
-        
-        return (INT_PTR)TRUE;
+// Parse the videoDetails and streamingData of a page's ytInitialPlayerResponse
+bool ParsePlayerResponse(const nlohmann::json& response, VideoInfo& info) {
+    PlayerResponseInfo parsed;
+    if (!ParsePlayerResponseJson(response, parsed)) {
+        return false;
     }
-    
-    case WM_COMMAND:
-        if (LOWORD(wParam) == IDOK) {
-            // Process selected videos
-            std::vector<std::wstring> selectedUrls;
-            
-            for (const auto& video : g_playlistVideos) {
-                if (video.selected) {
-                    selectedUrls.push_back(video.url);
-                }
-            }
-            
-            if (!selectedUrls.empty()) {
-                // Ask for download options first
-                DownloadOptions options = { nullptr, L"Best", g_settings.defaultDownloadPath, L"", false };
-                if (DialogBoxParam(hInst, MAKEINTRESOURCE(IDD_DOWNLOAD_OPTIONS), hDlg, DownloadOptionsProc, (LPARAM)&options) == IDOK) {
-                    // Pass the selected URLs and options to the Download Manager
-                    auto managerData = new std::pair<std::vector<std::wstring>, DownloadOptions>(selectedUrls, options);
-                    DialogBoxParam(hInst, MAKEINTRESOURCE(IDD_DOWNLOAD_MANAGER), NULL, DownloadManagerProc, (LPARAM)managerData);
-                }
-            }
-            
-            EndDialog(hDlg, IDOK);
-            return (INT_PTR)TRUE;
-        }
-        else if (LOWORD(wParam) == IDCANCEL) {
-            EndDialog(hDlg, IDCANCEL);
-            return (INT_PTR)TRUE;
-        }
-        else if (LOWORD(wParam) == IDC_BUTTON_SELECT_ALL) {
-            HWND hList = GetDlgItem(hDlg, IDC_PLAYLIST_LIST);
-            int count = ListView_GetItemCount(hList);
-            
-            for (int i = 0; i < count; i++) {
-                ListView_SetCheckState(hList, i, TRUE);
-                if (i < g_playlistVideos.size()) {
-                    g_playlistVideos[i].selected = true;
-                }
-            }
-            
-            return (INT_PTR)TRUE;
+    info.id = Utf8ToWide(parsed.videoId);
+    info.title = Utf8ToWide(parsed.title);
+    info.duration = parsed.duration;
+    info.formats.swap(parsed.formats);
+    return true;
+}
+
+// Size of a format in bytes, falling back to bitrate x duration when yt-dlp has no size
+double EstimateFormatSize(const VideoFormat& format, double duration) {
+    if (format.filesize > 0) return format.filesize;
+    return format.tbr * 1000.0 / 8.0 * duration;
+}
+
+// Estimate the download size for a resolution cap (0 = best available, -1 = audio only)
+double EstimateDownloadSize(const VideoInfo& info, int maxHeight) {
+    const VideoFormat* bestVideo = nullptr;
+    const VideoFormat* bestAudio = nullptr;
+    for (const auto& format : info.formats) {
+        if (format.hasAudio && !format.hasVideo) {
+            if (!bestAudio || format.tbr > bestAudio->tbr) bestAudio = &format;
         }
-        else if (LOWORD(wParam) == IDC_BUTTON_DESELECT_ALL) {
-            HWND hList = GetDlgItem(hDlg, IDC_PLAYLIST_LIST);
-            int count = ListView_GetItemCount(hList);
-            
-            for (int i = 0; i < count; i++) {
-                ListView_SetCheckState(hList, i, FALSE);
-                if (i < g_playlistVideos.size()) {
-                    g_playlistVideos[i].selected = false;
-                }
+        else if (format.hasVideo && maxHeight >= 0 && (maxHeight == 0 || format.height <= maxHeight)) {
+            if (!bestVideo || format.height > bestVideo->height ||
+                (format.height == bestVideo->height && format.tbr > bestVideo->tbr)) {
+                bestVideo = &format;
             }
-            
-            return (INT_PTR)TRUE;
         }
-        else if (LOWORD(wParam) == IDC_PLAYLIST_LIST && HIWORD(wParam) == LBN_SELCHANGE) {
-            // Update the list view with the fetched videos
-            HWND hList = GetDlgItem(hDlg, IDC_PLAYLIST_LIST);
-            ListView_DeleteAllItems(hList);
-            
-            for (size_t i = 0; i < g_playlistVideos.size(); i++) {
-                const auto& video = g_playlistVideos[i];
-                
-                LVITEMW lvi = { 0 };
-                lvi.mask = LVIF_TEXT;
-                lvi.iItem = i;
-                lvi.iSubItem = 0;
-                lvi.pszText = (LPWSTR)video.title.c_str();
-                int index = ListView_InsertItem(hList, &lvi);
-                
-                // Set URL as the second column
-                ListView_SetItemText(hList, index, 1, (LPWSTR)L"View");
-                
-                // Set checkbox state
-                ListView_SetCheckState(hList, index, video.selected);
-            }
-            
-            return (INT_PTR)TRUE;
+    }
+
+    double size = 0;
+    if (bestVideo) {
+        size += EstimateFormatSize(*bestVideo, info.duration);
+    }
+    if (bestAudio && (!bestVideo || !bestVideo->hasAudio)) {
+        size += EstimateFormatSize(*bestAudio, info.duration);
+    }
+    return size;
+}
+
+// Helper function to split a comma or semicolon separated section list into trimmed entries
+std::vector<std::wstring> SplitSections(const std::wstring& sections) {
+    std::vector<std::wstring> result;
+    size_t start = 0;
+    while (start <= sections.size()) {
+        size_t end = sections.find_first_of(L",;", start);
+        if (end == std::wstring::npos) end = sections.size();
+        std::wstring part = sections.substr(start, end - start);
+        size_t first = part.find_first_not_of(L" \t");
+        size_t last = part.find_last_not_of(L" \t");
+        if (first != std::wstring::npos) {
+            result.push_back(part.substr(first, last - first + 1));
         }
-        break;
-    
-    case WM_NOTIFY: {
-        NMHDR* pnmhdr = (NMHDR*)lParam;
-        if (pnmhdr->idFrom == IDC_PLAYLIST_LIST && pnmhdr->code == LVN_ITEMCHANGED) {
-            NMLISTVIEW* pnmlv = (NMLISTVIEW*)lParam;
-            if (pnmlv->uChanged & LVIF_STATE) {
-                int index = pnmlv->iItem;
-                if (index >= 0 && index < g_playlistVideos.size()) {
-                    g_playlistVideos[index].selected = (ListView_GetCheckState(pnmhdr->hwndFrom, index) != 0);
-                }
+        start = end + 1;
+    }
+    return result;
+}
+
+// Helper function to parse "ss", "mm:ss" or "hh:mm:ss" (fractions allowed); -1 if invalid
+double ParseTimestamp(const std::wstring& text) {
+    if (text == L"inf") return 1e12;
+    if (text.empty() || text.find_first_not_of(L"0123456789:.") != std::wstring::npos) return -1;
+    double seconds = 0;
+    size_t start = 0;
+    while (true) {
+        size_t colon = text.find(L':', start);
+        std::wstring field = text.substr(start, colon == std::wstring::npos ? std::wstring::npos : colon - start);
+        if (field.empty()) return -1;
+        seconds = seconds * 60 + _wtof(field.c_str());
+        if (colon == std::wstring::npos) break;
+        start = colon + 1;
+    }
+    return seconds;
+}
+
+// A section is a time range ("1:30-3:00") when both ends parse as timestamps; otherwise it names chapters
+bool ParseTimeRange(const std::wstring& section, double& start, double& end) {
+    size_t dash = section.find(L'-');
+    if (dash == std::wstring::npos) return false;
+    start = ParseTimestamp(section.substr(0, dash));
+    end = ParseTimestamp(section.substr(dash + 1));
+    return start >= 0 && end > start;
+}
+
+// Seconds of the video the sections cover, or -1 when it can't be worked out (chapters of an unprobed video)
+double EstimateSectionSeconds(const std::wstring& sections, const VideoInfo& info) {
+    std::vector<std::pair<double, double>> ranges;
+    for (const auto& section : SplitSections(sections)) {
+        double start, end;
+        if (ParseTimeRange(section, start, end)) {
+            ranges.push_back(std::make_pair(start, end));
+            continue;
+        }
+        // yt-dlp matches chapter names as a regex; a case-insensitive substring is close enough for an estimate
+        if (info.chapters.empty()) {
+            return -1;
+        }
+        std::wstring needle = section;
+        std::transform(needle.begin(), needle.end(), needle.begin(), towlower);
+        for (const auto& chapter : info.chapters) {
+            std::wstring title = chapter.title;
+            std::transform(title.begin(), title.end(), title.begin(), towlower);
+            if (title.find(needle) != std::wstring::npos) {
+                ranges.push_back(std::make_pair(chapter.start, chapter.end));
             }
         }
-        break;
     }
+
+    // Overlapping sections are only downloaded once per range, so merge them before adding up
+    std::sort(ranges.begin(), ranges.end());
+    double covered = 0;
+    double reached = 0;
+    for (const auto& range : ranges) {
+        double start = range.first > reached ? range.first : reached;
+        double end = (info.duration > 0 && range.second > info.duration) ? info.duration : range.second;
+        if (end > start) {
+            covered += end - start;
+            reached = end;
+        }
     }
-    
-    return (INT_PTR)FALSE;
+    return covered;
 }
 
-// Function to parse yt-dlp output and update progress bar
-void UpdateDownloadProgress(const std::string& output, HWND hDlg, int itemIndex) {
-    if (output.empty() || itemIndex < 0) {
-        return; // No output or invalid index
+// Estimate a download's size, scaled down to the requested sections when there are any
+double EstimateItemSize(const VideoInfo& info, int maxHeight, const std::wstring& sections) {
+    if (maxHeight < -3) {
+        return 0; // Subtitles only
     }
-    
-    try {
-        // More robust regex to match yt-dlp progress outputs
-        std::regex progressRegex(R"(\[download\]\s+([0-9\.]+)%\s+of\s+~?)");
-        std::smatch match;
-        std::string lastMatch;
-        
-        // Find all matches and use the last one (most recent progress)
-        std::string::const_iterator searchStart(output.cbegin());
-        while (std::regex_search(searchStart, output.cend(), match, progressRegex)) {
-            lastMatch = match[1].str();
-            searchStart = match.suffix().first;
-        }
-        
-        if (!lastMatch.empty()) {
-            try {
-                float progress = std::stof(lastMatch);
-                {
-                    std::lock_guard<std::mutex> lock(g_queueMutex);
-                    if (itemIndex < g_downloadQueue.size() && g_downloadQueue[itemIndex] != nullptr) {
-                        g_downloadQueue[itemIndex]->progress = progress;
-                    }
-                }
-            }
-            catch (const std::invalid_argument&) {
-                // Invalid number format in progress output
-            }
-            catch (const std::out_of_range&) {
-                // Progress number out of range
-            }
+    double size = EstimateDownloadSize(info, maxHeight);
+    if (sections.empty() || size <= 0) {
+        return size;
+    }
+    double seconds = EstimateSectionSeconds(sections, info);
+    if (seconds < 0 || info.duration <= 0) {
+        return 0;
+    }
+    return size * (seconds < info.duration ? seconds / info.duration : 1.0);
+}
+
+// Highest video resolution available, 0 if unknown or audio only
+int GetMaxVideoHeight(const VideoInfo& info) {
+    int maxHeight = 0;
+    for (const auto& format : info.formats) {
+        if (format.hasVideo && format.height > maxHeight) maxHeight = format.height;
+    }
+    return maxHeight;
+}
+
+// Helper function to format a byte count for display
+std::wstring FormatFileSize(double bytes) {
+    if (bytes <= 0) return L"";
+    wchar_t text[32];
+    if (bytes >= 1024.0 * 1024 * 1024) {
+        swprintf_s(text, L"%.2f GB", bytes / (1024.0 * 1024 * 1024));
+    } else if (bytes >= 1024.0 * 1024) {
+        swprintf_s(text, L"%.1f MB", bytes / (1024.0 * 1024));
+    } else {
+        swprintf_s(text, L"%.0f KB", bytes / 1024.0);
+    }
+    return text;
+}
+
+// Video ID of a YouTube video URL (watch, youtu.be, shorts, live, embed), empty for anything else
+std::wstring GetWatchVideoId(const std::wstring& url) {
+    return ClassifyYouTubeUrl(url).videoId;
+}
+
+// yt-dlp's info JSON is kept on disk for this long so downloads can skip extraction.
+// It holds signed format URLs, which YouTube expires after a few hours.
+const ULONGLONG kInfoJsonTtlSeconds = 60 * 60;
+
+// Helper function to get the cached info JSON path for a video, empty if the ID isn't usable as a file name
+std::wstring GetInfoJsonPath(const std::wstring& videoId) {
+    if (videoId.empty()) {
+        return L"";
+    }
+    for (wchar_t c : videoId) {
+        if (!iswalnum(c) && c != L'-' && c != L'_') {
+            return L"";
         }
     }
-    catch (const std::regex_error&) {
-        // Regex error - don't crash the application
+    std::wstring cacheDir = GetAppDataFilePath(L"InfoCache");
+    if (cacheDir.empty()) {
+        return L"";
     }
-    catch (...) {
-        // Unknown error - don't crash the application
+    CreateDirectoryW(cacheDir.c_str(), NULL);
+    return cacheDir + L"\\" + videoId + L".info.json";
+}
+
+// Helper function to check whether a cached file is younger than the info JSON TTL
+bool IsInfoJsonFresh(const std::wstring& path) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (path.empty() || !GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data)) {
+        return false;
     }
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    ULARGE_INTEGER written, current;
+    written.LowPart = data.ftLastWriteTime.dwLowDateTime;
+    written.HighPart = data.ftLastWriteTime.dwHighDateTime;
+    current.LowPart = now.dwLowDateTime;
+    current.HighPart = now.dwHighDateTime;
+    // FILETIME counts 100 ns intervals
+    return current.QuadPart >= written.QuadPart &&
+           current.QuadPart - written.QuadPart < kInfoJsonTtlSeconds * 10000000ULL;
 }
 
-// Thread function to run yt-dlp and capture its output
-DWORD WINAPI DownloadThread(LPVOID lpParam) {
-    if (!lpParam) {
-        // Invalid parameter
-        return 1;
+// Path of a video's cached info JSON if it is still fresh, empty otherwise
+std::wstring GetFreshInfoJsonPath(const std::wstring& videoId) {
+    std::wstring path = GetInfoJsonPath(videoId);
+    return IsInfoJsonFresh(path) ? path : L"";
+}
+
+// Helper function to save yt-dlp's info JSON for a video
+void StoreInfoJson(const std::wstring& videoId, const std::string& json) {
+    std::wstring path = GetInfoJsonPath(videoId);
+    if (path.empty()) {
+        return;
+    }
+    // Write beside the target and swap it in so a download never loads a half-written file
+    std::wstring tempPath = path + L".tmp";
+    {
+        std::ofstream o(tempPath, std::ios::binary);
+        o.write(json.data(), json.size());
+        if (!o.good()) {
+            return;
+        }
     }
+    if (!MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileW(tempPath.c_str());
+    }
+}
 
-    DownloadItem* item = (DownloadItem*)lpParam;
-    if (!item) {
-        return 1;
+// Delete cached info JSON files that have outlived the TTL
+void PruneInfoJsonCache() {
+    std::wstring cacheDir = GetAppDataFilePath(L"InfoCache");
+    if (cacheDir.empty()) {
+        return;
     }
-    
-    // Make sure URL is not empty
-    if (item->url.empty()) {
-        item->status = Failed;
-        return 1;
+    WIN32_FIND_DATAW findData;
+    HANDLE hFind = FindFirstFileExW((cacheDir + L"\\*.json").c_str(), FindExInfoBasic, &findData,
+                                    FindExSearchNameMatch, NULL, 0);
+    if (hFind == INVALID_HANDLE_VALUE) {
+        return;
     }
-    
-    // Construct the command with user-selected options
-    std::wstring command;
-    try {
-        // Get full path to yt-dlp.exe
-        wchar_t exePath[MAX_PATH];
-        GetModuleFileNameW(NULL, exePath, MAX_PATH);
-        std::wstring exeDir = exePath;
-        size_t pos = exeDir.find_last_of(L"\\/");
-        std::wstring ytdlpPath = L"yt-dlp.exe";
-        if (pos != std::wstring::npos) {
-            ytdlpPath = L"\"" + exeDir.substr(0, pos) + L"\\yt-dlp.exe\"";
+    do {
+        std::wstring path = cacheDir + L"\\" + findData.cFileName;
+        if (!IsInfoJsonFresh(path)) {
+            DeleteFileW(path.c_str());
         }
+    } while (FindNextFileW(hFind, &findData));
+    FindClose(hFind);
+}
 
-        if (item->resolution == L"Audio Only (mp3)") {
-            command = ytdlpPath + L" --progress --newline --no-playlist --no-check-certificates -x --audio-format mp3";
+// Parse one video's info, from the info JSON cache when fresh, otherwise by running yt-dlp -J
+bool ProbeVideoInfo(const std::wstring& videoId, const std::wstring& url, VideoInfo& info) {
+    std::wstring cachedPath = GetFreshInfoJsonPath(videoId);
+    if (!cachedPath.empty()) {
+        std::ifstream i(cachedPath, std::ios::binary);
+        std::string cached((std::istreambuf_iterator<char>(i)), std::istreambuf_iterator<char>());
+        if (ParseVideoInfoJson(cached, info)) {
+            return true;
         }
-        else {
-            command = ytdlpPath + L" --progress --newline --no-playlist --no-check-certificates --merge-output-format mp4";
-            if (item->resolution != L"Best") {
-                std::wstring res = item->resolution;
-                if (!res.empty() && res.back() == 'p') {
-                    res.pop_back();
-                }
-                command += L" -f \"bestvideo[height<=" + res + L"]+bestaudio/best\"";
+    }
+
+    std::string output;
+    DWORD exitCode = 1;
+    if (!RunYtDlpCapture(L"-J --no-playlist --no-warnings \"" + url + L"\"", output, exitCode) || exitCode != 0) {
+        return false;
+    }
+    if (!ParseVideoInfoJson(output, info)) {
+        return false;
+    }
+    StoreInfoJson(videoId, output);
+    return true;
+}
+
+// Pending metadata probe
+struct MetadataProbeJob {
+    std::wstring videoId;
+    std::wstring url;
+};
+
+// Probes run on a small pool of worker threads so a large selection
+// doesn't spawn one yt-dlp process per video at once.
+const int kMaxMetadataProbes = 4;
+std::deque<MetadataProbeJob> g_metadataQueue;
+// Queued or running video IDs, with the windows that get WM_APP_VIDEOINFO_READY when each finishes
+std::unordered_map<std::wstring, std::vector<HWND>> g_metadataPending;
+int g_metadataWorkers = 0;
+std::mutex g_metadataMutex;
+
+// Worker thread that drains the metadata probe queue
+DWORD WINAPI MetadataProbeThread(LPVOID lpParam) {
+    UNREFERENCED_PARAMETER(lpParam);
+    while (true) {
+        MetadataProbeJob job;
+        {
+            std::lock_guard<std::mutex> lock(g_metadataMutex);
+            if (g_metadataQueue.empty()) {
+                g_metadataWorkers--;
+                return 0;
             }
+            job = g_metadataQueue.front();
+            g_metadataQueue.pop_front();
         }
 
-        if (item->downloadSubtitles) {
-            command += L" --write-auto-sub";
+        if (!GetCachedVideoInfo(job.videoId)) {
+            auto info = std::make_shared<VideoInfo>();
+            if (ProbeVideoInfo(job.videoId, job.url, *info)) {
+                info->id = job.videoId; // Keep the key the caller asked for
+                StoreVideoInfo(info);
+            }
         }
 
-        std::wstring path = item->path;
-        if (path.empty()) {
-            // Default to Documents folder if path is empty
-            PWSTR documentsPath = nullptr;
-            if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_Documents, 0, nullptr, &documentsPath))) {
-                path = documentsPath;
-                CoTaskMemFree(documentsPath);
+        std::vector<HWND> waiters;
+        {
+            std::lock_guard<std::mutex> lock(g_metadataMutex);
+            auto it = g_metadataPending.find(job.videoId);
+            if (it != g_metadataPending.end()) {
+                waiters.swap(it->second);
+                g_metadataPending.erase(it);
             }
         }
-        
-        if (!path.empty() && path.back() != L'\\' && path.back() != L'/') {
-            path += L'\\';
+        for (HWND hNotify : waiters) {
+            if (IsWindow(hNotify)) {
+                PostMessage(hNotify, WM_APP_VIDEOINFO_READY, 0, 0);
+            }
         }
-        
-        // Create the output directory if it doesn't exist
-        CreateDirectoryW(path.c_str(), NULL);
-        
-        command += L" -o \"" + path + L"%(title)s.%(ext)s\"";
-        command += L" \"" + item->url + L"\"";
-        
-        // Log the command for debugging purposes
-        OutputDebugStringW((L"Running command: " + command).c_str());
     }
-    catch (...) {
-        // Error constructing command
-        item->status = Failed;
-        return 1;
+}
+
+// Queue a video for background probing unless it is cached or already queued
+void QueueMetadataProbe(const std::wstring& videoId, const std::wstring& url, HWND hNotify) {
+    if (videoId.empty() || GetCachedVideoInfo(videoId)) {
+        return;
     }
 
-    HANDLE hChildStd_OUT_Rd = NULL;
-    HANDLE hChildStd_OUT_Wr = NULL;
-    HANDLE hChildStd_ERR_Rd = NULL;
-    HANDLE hChildStd_ERR_Wr = NULL;
-    
-    SECURITY_ATTRIBUTES sa;
-    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
-    sa.bInheritHandle = TRUE;
-    sa.lpSecurityDescriptor = NULL;
+    std::lock_guard<std::mutex> lock(g_metadataMutex);
+    auto pending = g_metadataPending.find(videoId);
+    if (pending != g_metadataPending.end()) {
+        // Already queued or running; just ask to be told when it lands
+        if (hNotify && std::find(pending->second.begin(), pending->second.end(), hNotify) == pending->second.end()) {
+            pending->second.push_back(hNotify);
+        }
+        return;
+    }
+    g_metadataPending[videoId] = hNotify ? std::vector<HWND>(1, hNotify) : std::vector<HWND>();
+    g_metadataQueue.push_back({ videoId, url });
 
-    // Create pipes with proper error handling
-    bool pipesCreated = true;
-    if (!CreatePipe(&hChildStd_OUT_Rd, &hChildStd_OUT_Wr, &sa, 0)) {
-        pipesCreated = false;
+    if (g_metadataWorkers < kMaxMetadataProbes) {
+        HANDLE hThread = CreateThread(NULL, 0, MetadataProbeThread, NULL, 0, NULL);
+        if (hThread) {
+            g_metadataWorkers++;
+            CloseHandle(hThread);
+        }
     }
-    if (!CreatePipe(&hChildStd_ERR_Rd, &hChildStd_ERR_Wr, &sa, 0)) {
-        pipesCreated = false;
-        if (hChildStd_OUT_Rd) CloseHandle(hChildStd_OUT_Rd);
-        if (hChildStd_OUT_Wr) CloseHandle(hChildStd_OUT_Wr);
+}
+
+// A video's metadata arrived from elsewhere: tell its waiters and drop the probe if it hasn't started
+void CompleteMetadataProbe(const std::wstring& videoId) {
+    std::vector<HWND> waiters;
+    {
+        std::lock_guard<std::mutex> lock(g_metadataMutex);
+        auto pending = g_metadataPending.find(videoId);
+        if (pending == g_metadataPending.end()) {
+            return;
+        }
+        waiters = pending->second;
+        for (auto it = g_metadataQueue.begin(); it != g_metadataQueue.end(); ++it) {
+            if (it->videoId == videoId) {
+                g_metadataQueue.erase(it);
+                g_metadataPending.erase(pending);
+                break;
+            }
+        }
     }
-    
-    if (!pipesCreated) {
-        item->status = Failed;
-        return 1;
+    for (HWND hNotify : waiters) {
+        if (IsWindow(hNotify)) {
+            PostMessage(hNotify, WM_APP_VIDEOINFO_READY, 0, 0);
+        }
     }
+}
 
-    // Set the pipe handles as non-inheritable
-    SetHandleInformation(hChildStd_OUT_Rd, HANDLE_FLAG_INHERIT, 0);
-    SetHandleInformation(hChildStd_ERR_Rd, HANDLE_FLAG_INHERIT, 0);
+// The profile's cookies, exported for yt-dlp so downloads get the signed-in session's access.
+// They hold the session, so the export is encrypted for the current user with DPAPI, and a
+// plaintext copy exists only in the AppData folder and only while a yt-dlp run needs it.
+const wchar_t* kCookieFileName = L"cookies.dat";
+const wchar_t* kLegacyCookieFileName = L"cookies.txt";  // Plaintext export of earlier versions
+const wchar_t* kCookieRunFolder = L"CookieRuns";
+const DWORD kCookieExportIntervalMs = 10000;
+std::string g_exportedCookies;  // Contents last written, so an unchanged jar isn't rewritten
+DWORD g_lastCookieExport = 0;
+std::atomic<unsigned int> g_cookieRunCount(0);
+
+// Helper function to encrypt data so only the current Windows user can read it
+bool ProtectForUser(const std::string& plain, std::string& encrypted) {
+    DATA_BLOB input = { (DWORD)plain.size(), (BYTE*)plain.data() };
+    DATA_BLOB output = { 0 };
+    if (!CryptProtectData(&input, L"YoutubePlus cookies", NULL, NULL, NULL, CRYPTPROTECT_UI_FORBIDDEN, &output)) {
+        return false;
+    }
+    encrypted.assign((const char*)output.pbData, output.cbData);
+    LocalFree(output.pbData);
+    return true;
+}
 
-    PROCESS_INFORMATION pi = {0};
-    STARTUPINFOW si = {sizeof(si)};
-    si.hStdError = hChildStd_ERR_Wr;
-    si.hStdOutput = hChildStd_OUT_Wr;
-    si.dwFlags |= STARTF_USESTDHANDLES;
+// Helper function to decrypt data written by ProtectForUser
+bool UnprotectForUser(const std::string& encrypted, std::string& plain) {
+    DATA_BLOB input = { (DWORD)encrypted.size(), (BYTE*)encrypted.data() };
+    DATA_BLOB output = { 0 };
+    if (!CryptUnprotectData(&input, NULL, NULL, NULL, NULL, CRYPTPROTECT_UI_FORBIDDEN, &output)) {
+        return false;
+    }
+    plain.assign((const char*)output.pbData, output.cbData);
+    SecureZeroMemory(output.pbData, output.cbData);
+    LocalFree(output.pbData);
+    return true;
+}
 
-    bool success = false;
-    bool processStarted = false;
-    DWORD lastError = 0;
-    
-    try {
-        // Get the current executable directory for yt-dlp.exe
-        wchar_t exePath[MAX_PATH];
-        GetModuleFileNameW(NULL, exePath, MAX_PATH);
-        std::wstring exeDir = std::wstring(exePath);
-        size_t lastSlash = exeDir.find_last_of(L"\\/");
-        if (lastSlash != std::wstring::npos) {
-            exeDir = exeDir.substr(0, lastSlash);
-        }
-        
-        // Create the process with proper working directory
-        processStarted = CreateProcessW(nullptr, &command[0], nullptr, nullptr, TRUE, 
-                                      CREATE_NO_WINDOW, nullptr, exeDir.c_str(), &si, &pi);
-        
-        if (!processStarted) {
-            lastError = GetLastError();
-        }
+// Export the WebView2 cookie jar for youtube.com. Must run on the UI thread; the file is only
+// rewritten when the cookies changed since the last export.
+void ExportWebViewCookies() {
+    if (!g_webView) {
+        return;
     }
-    catch (...) {
-        processStarted = false;
-        lastError = GetLastError();
+    DWORD now = GetTickCount();
+    if (g_lastCookieExport && now - g_lastCookieExport < kCookieExportIntervalMs) {
+        return;
     }
-    
-    // Close write handles after process creation attempt
-    CloseHandle(hChildStd_OUT_Wr);
-    CloseHandle(hChildStd_ERR_Wr);
-    
-    if (processStarted) {
-        item->hProcess = pi.hProcess;
-        
-        char buffer[256];
-        DWORD dwRead;
-        std::string full_output;
-        std::string error_output;
-        
-        // Read process output with better error handling
-        try {
-            // Read output in a more robust way using PeekNamedPipe
-            while (true) {
-                // Check if download was cancelled
-                if (item->status == Cancelled) {
-                    break;
+    g_lastCookieExport = now;
+
+    ComPtr<ICoreWebView2_2> webView2;
+    ComPtr<ICoreWebView2CookieManager> cookieManager;
+    if (FAILED(g_webView->QueryInterface(IID_PPV_ARGS(&webView2))) || FAILED(webView2->get_CookieManager(&cookieManager))) {
+        return;
+    }
+    cookieManager->GetCookies(L"https://www.youtube.com",
+        Callback<ICoreWebView2GetCookiesCompletedHandler>(
+            [](HRESULT result, ICoreWebView2CookieList* list) -> HRESULT {
+                if (FAILED(result) || !list) {
+                    return S_OK;
                 }
-                
-                DWORD available = 0;
-                DWORD exitCode = STILL_ACTIVE;
-                
-                // First check if process is still running
-                if (!GetExitCodeProcess(pi.hProcess, &exitCode) || exitCode != STILL_ACTIVE) {
-                    break;
+                UINT count = 0;
+                list->get_Count(&count);
+                std::vector<NetscapeCookie> cookies;
+                cookies.reserve(count);
+                for (UINT i = 0; i < count; i++) {
+                    ComPtr<ICoreWebView2Cookie> cookie;
+                    if (FAILED(list->GetValueAtIndex(i, &cookie))) {
+                        continue;
+                    }
+                    NetscapeCookie entry;
+                    LPWSTR text = nullptr;
+                    if (SUCCEEDED(cookie->get_Domain(&text))) { entry.domain = WideToUtf8(text); CoTaskMemFree(text); }
+                    if (SUCCEEDED(cookie->get_Path(&text))) { entry.path = WideToUtf8(text); CoTaskMemFree(text); }
+                    if (SUCCEEDED(cookie->get_Name(&text))) { entry.name = WideToUtf8(text); CoTaskMemFree(text); }
+                    if (SUCCEEDED(cookie->get_Value(&text))) { entry.value = WideToUtf8(text); CoTaskMemFree(text); }
+                    double expires = -1;
+                    cookie->get_Expires(&expires); // -1 for session cookies
+                    entry.expires = expires > 0 ? (long long)expires : 0;
+                    BOOL flag = FALSE;
+                    cookie->get_IsSecure(&flag);
+                    entry.secure = flag != FALSE;
+                    flag = FALSE;
+                    cookie->get_IsHttpOnly(&flag);
+                    entry.httpOnly = flag != FALSE;
+                    cookies.push_back(entry);
                 }
-                
-                // Check if there's data to read
-                if (!PeekNamedPipe(hChildStd_OUT_Rd, NULL, 0, NULL, &available, NULL) || available == 0) {
-                    Sleep(100); // Wait a bit before trying again
-                    continue;
+
+                std::string contents = FormatNetscapeCookies(cookies);
+                if (contents == g_exportedCookies) {
+                    return S_OK;
                 }
-                
-                // Read available data
-                if (ReadFile(hChildStd_OUT_Rd, buffer, sizeof(buffer) - 1, &dwRead, NULL) && dwRead > 0) {
-                    buffer[dwRead] = '\0';
-                    full_output += buffer;
-                    
-                    // Parse progress information using more robust regex
-                    try {
-                        std::regex re(R"(\[download\]\s+([0-9\.]+)%)");
-                        std::smatch match;
-                        
-                        // Process just the newly received data
-                        std::string newOutput(buffer);
-                        std::string::const_iterator searchStart(newOutput.cbegin());
-                        while (std::regex_search(searchStart, newOutput.cend(), match, re)) {
-                            // Update progress with the latest percentage
-                            try {
-                                float progress = std::stof(match[1].str());
-                                item->progress = progress;
-                            }
-                            catch (...) {
-                                // Ignore parsing errors
-                            }
-                            searchStart = match.suffix().first;
-                        }
-                    }
-                    catch (...) {
-                        // Ignore regex errors
+                std::wstring path = GetAppDataFilePath(kCookieFileName);
+                std::string encrypted;
+                if (path.empty() || !ProtectForUser(contents, encrypted)) {
+                    return S_OK;
+                }
+                std::wstring tempPath = path + L".tmp";
+                {
+                    std::ofstream o(tempPath, std::ios::binary);
+                    o.write(encrypted.data(), encrypted.size());
+                    if (!o.good()) {
+                        return S_OK;
                     }
                 }
-                else {
-                    break;
+                if (MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+                    g_exportedCookies = contents;
+                } else {
+                    DeleteFileW(tempPath.c_str());
                 }
-            }
-            
-            // Read any error output
-            while (ReadFile(hChildStd_ERR_Rd, buffer, sizeof(buffer) - 1, &dwRead, NULL) && dwRead > 0) {
-                buffer[dwRead] = '\0';
-                error_output += buffer;
-            }
-            
-            // If we have error output and the download failed, show it
-            if (!error_output.empty()) {
-                // Only log error output, don't show message box here to avoid UI blocks
-                OutputDebugStringA(("yt-dlp error output:\n" + error_output).c_str());
-            }
-        }
-        catch (...) {
-            // Reading output failed, but we'll continue to check the exit code
+                return S_OK;
+            }).Get());
+}
+
+// Give a yt-dlp run its own decrypted copy of the exported cookies; yt-dlp writes the jar back
+// when it exits, so runs sharing one file would overwrite each other. The caller deletes the
+// copy when the run ends. Returns "" if nothing is exported.
+std::wstring CopyCookieFileForRun() {
+    std::wstring source = GetAppDataFilePath(kCookieFileName);
+    std::wstring folder = GetAppDataFilePath(kCookieRunFolder);
+    if (source.empty() || folder.empty()) {
+        return L"";
+    }
+    std::string encrypted;
+    {
+        std::ifstream i(source, std::ios::binary);
+        if (!i.good()) {
+            return L"";
         }
-        
-        // Get process exit code to determine success
-        DWORD exitCode = 1; // Default to failure
-        if (GetExitCodeProcess(pi.hProcess, &exitCode)) {
-            success = (exitCode == 0);
+        encrypted.assign((std::istreambuf_iterator<char>(i)), std::istreambuf_iterator<char>());
+    }
+    std::string contents;
+    if (!UnprotectForUser(encrypted, contents)) {
+        return L"";
+    }
+
+    // Named after this process, so the startup sweep can tell which copies are still in use
+    CreateDirectoryW(folder.c_str(), NULL);
+    std::wstring path = folder + L"\\" + std::to_wstring(GetCurrentProcessId()) + L"-" +
+                        std::to_wstring(++g_cookieRunCount) + L".txt";
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_TEMPORARY | FILE_ATTRIBUTE_NOT_CONTENT_INDEXED, NULL);
+    bool written = false;
+    if (hFile != INVALID_HANDLE_VALUE) {
+        DWORD bytesWritten = 0;
+        written = WriteFile(hFile, contents.data(), (DWORD)contents.size(), &bytesWritten, NULL) &&
+                  bytesWritten == contents.size();
+        CloseHandle(hFile);
+    }
+    SecureZeroMemory(&contents[0], contents.size());
+    if (!written) {
+        DeleteFileW(path.c_str());
+        return L"";
+    }
+    return path;
+}
+
+// Delete the cookie copies of runs that never got to clean up, because their instance crashed
+// or was killed, and the plaintext export earlier versions kept. Copies that belong to a
+// running instance are left alone.
+void SweepCookieRunCopies() {
+    std::wstring legacy = GetAppDataFilePath(kLegacyCookieFileName);
+    if (!legacy.empty()) {
+        DeleteFileW(legacy.c_str());
+    }
+    std::wstring folder = GetAppDataFilePath(kCookieRunFolder);
+    if (folder.empty()) {
+        return;
+    }
+    WIN32_FIND_DATAW findData;
+    HANDLE hFind = FindFirstFileW((folder + L"\\*.txt").c_str(), &findData);
+    if (hFind == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    do {
+        DWORD pid = wcstoul(findData.cFileName, nullptr, 10);
+        bool inUse = false;
+        if (pid == GetCurrentProcessId()) {
+            inUse = true;
+        }
+        else if (pid != 0) {
+            HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+            if (hProcess) {
+                DWORD exitCode = 0;
+                inUse = GetExitCodeProcess(hProcess, &exitCode) && exitCode == STILL_ACTIVE;
+                CloseHandle(hProcess);
+            }
+        }
+        if (!inUse) {
+            DeleteFileW((folder + L"\\" + findData.cFileName).c_str());
         }
+    } while (FindNextFileW(hFind, &findData));
+    FindClose(hFind);
+}
 
-        // Clean up handles
-        CloseHandle(pi.hThread);
-        CloseHandle(hChildStd_OUT_Rd);
-        CloseHandle(hChildStd_ERR_Rd);
-        
-        // Close process handle
-        CloseHandle(pi.hProcess);
-        item->hProcess = NULL;
+// Handle a message the page posted with chrome.webview.postMessage
+void HandleWebMessage(const std::wstring& messageJson) {
+    try {
+        auto message = nlohmann::json::parse(WideToUtf8(messageJson));
+        if (!message.is_object() || JsonString(message, "type") != "playerResponse") {
+            return;
+        }
+        auto response = message.find("response");
+        if (response == message.end() || !response->is_object()) {
+            return;
+        }
+
+        auto info = std::make_shared<VideoInfo>();
+        if (!ParsePlayerResponse(*response, *info)) {
+            return;
+        }
+        // A yt-dlp probe result is kept: it also knows sizes the page leaves out
+        if (!GetCachedVideoInfo(info->id)) {
+            StoreVideoInfo(info);
+        }
+        CompleteMetadataProbe(info->id);
     }
-    else {
-        // Process creation failed, clean up
-        CloseHandle(hChildStd_OUT_Rd);
-        CloseHandle(hChildStd_ERR_Rd);
-        
-        // Log the error for debugging
-        std::wstring errorMsg = L"Failed to start yt-dlp process. Error code: " + std::to_wstring(lastError);
-        errorMsg += L"\nCommand: " + command;
-        OutputDebugStringW(errorMsg.c_str());
+    catch (...) {
+        // Ignore malformed messages from the page
     }
+}
 
-    // Update item status if not already cancelled
-    if (item->status != Cancelled) {
-        item->status = success ? Completed : Failed;
+// Script added to every document: posts the watch page's player metadata to the host
+const wchar_t* kPlayerResponseBridgeScript = LR"(
+    (() => {
+        const postPlayerResponse = () => {
+            if (location.pathname !== '/watch' || !window.chrome || !window.chrome.webview) return;
+            const player = document.getElementById('movie_player');
+            const response = (player && player.getPlayerResponse && player.getPlayerResponse()) || window.ytInitialPlayerResponse;
+            const videoId = new URLSearchParams(location.search).get('v');
+            if (!response || !response.videoDetails || response.videoDetails.videoId !== videoId) return;
+            const details = response.videoDetails;
+            window.chrome.webview.postMessage({
+                type: 'playerResponse',
+                response: {
+                    videoDetails: { videoId: details.videoId, title: details.title, lengthSeconds: details.lengthSeconds },
+                    streamingData: response.streamingData
+                }
+            });
+        };
+        // yt-navigate-finish covers YouTube's in-page navigations, load covers full page loads
+        document.addEventListener('yt-navigate-finish', () => setTimeout(postPlayerResponse, 0));
+        window.addEventListener('load', postPlayerResponse);
+    })();
+)";
+
+// Stop notifying a window, and drop queued probes nobody else is waiting for
+void CancelMetadataProbes(HWND hNotify) {
+    std::lock_guard<std::mutex> lock(g_metadataMutex);
+    for (auto it = g_metadataQueue.begin(); it != g_metadataQueue.end();) {
+        auto pending = g_metadataPending.find(it->videoId);
+        if (pending == g_metadataPending.end()) {
+            ++it;
+            continue;
+        }
+        std::vector<HWND>& waiters = pending->second;
+        auto waiter = std::find(waiters.begin(), waiters.end(), hNotify);
+        if (waiter == waiters.end()) {
+            ++it;
+            continue;
+        }
+        waiters.erase(waiter);
+        if (waiters.empty()) {
+            g_metadataPending.erase(pending);
+            it = g_metadataQueue.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    // Probes already running finish into the cache; just stop telling this window
+    for (auto& pending : g_metadataPending) {
+        auto& waiters = pending.second;
+        waiters.erase(std::remove(waiters.begin(), waiters.end(), hNotify), waiters.end());
     }
+}
 
-    return success ? 0 : 1;
+// Structure to hold playlist video info
+struct PlaylistVideo {
+    std::wstring id;
+    std::wstring title;
+    std::wstring url;
+    std::wstring channel;
+    double duration;    // Seconds, 0 if unknown
+};
+
+// Results of one playlist fetch. A published snapshot is never modified again:
+// the fetch thread builds the next one and swaps it in with std::atomic_store,
+// so the UI thread reads its copy without taking a lock or blocking the fetch.
+// Snapshots share the fetched entries chunk by chunk instead of copying them.
+struct PlaylistResults {
+    unsigned int generation;                // Which dialog session fetched these results
+    bool complete;                          // The fetch thread has finished
+    ChunkedList<PlaylistVideo> videos;      // Only ever grows within a generation
+};
+typedef std::shared_ptr<const PlaylistResults> PlaylistSnapshot;
+
+PlaylistSnapshot g_playlistSnapshot;                // Latest published results (atomic access only)
+std::atomic<unsigned int> g_playlistGeneration(0); // Bumped each time the playlist dialog opens
+
+// Playlist dialog state, owned by the UI thread
+PlaylistSnapshot g_playlistVideos;      // Snapshot currently shown
+std::vector<char> g_playlistSelected;   // Checkbox state for each entry of g_playlistVideos
+
+// Number of entries between incremental snapshots while a playlist is being fetched
+const size_t kPlaylistPublishBatch = 200;
+
+// Helper function to swap in a new set of fetched videos for readers
+void PublishPlaylistSnapshot(unsigned int generation, const ChunkedListBuilder<PlaylistVideo>& videos, bool complete) {
+    auto snapshot = std::make_shared<PlaylistResults>();
+    snapshot->generation = generation;
+    snapshot->complete = complete;
+    snapshot->videos = videos.snapshot();
+    std::atomic_store(&g_playlistSnapshot, PlaylistSnapshot(snapshot));
 }
 
-// Dialog procedure for the download progress dialog
-INT_PTR CALLBACK DownloadProgressProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
-    static DownloadOptions* pOptions = nullptr;
-    static DownloadItem* pItem = nullptr;
-    static HANDLE hThread = NULL;
-    static DWORD startTime = 0;
-    static std::wstring downloadFilename;
-    
-    switch (message) {
-    case WM_INITDIALOG: {
-        if (lParam == 0) {
-            // Invalid parameter
-            MessageBox(hDlg, L"Invalid download options provided.", L"Error", MB_OK | MB_ICONERROR);
-            DestroyWindow(hDlg);
-            return (INT_PTR)TRUE;
+// Number of videos in the snapshot the dialog is showing
+size_t PlaylistVideoCount() {
+    return g_playlistVideos ? g_playlistVideos->videos.size() : 0;
+}
+
+// Case-folded copy of all playlist titles packed into one buffer, so a filter
+// keystroke is a single linear scan rather than one search per title.
+struct PlaylistTitleIndex {
+    std::wstring folded;            // Titles separated by L'\n'
+    std::vector<size_t> starts;     // Offset of each title within folded
+};
+
+PlaylistTitleIndex g_playlistTitleIndex;
+std::vector<int> g_playlistVisible; // Indices into g_playlistVideos shown in the list
+
+// Helper function to fold case for search (output has the same length as the input)
+std::wstring FoldCaseForSearch(const std::wstring& text) {
+    std::wstring folded = text;
+    if (!folded.empty()) {
+        LCMapStringEx(LOCALE_NAME_INVARIANT, LCMAP_LOWERCASE, text.c_str(), (int)text.size(),
+                      &folded[0], (int)folded.size(), NULL, NULL, 0);
+    }
+    return folded;
+}
+
+// Fold the titles not yet in the index (snapshots only grow, so earlier titles are kept)
+void AppendPlaylistTitles(const ChunkedList<PlaylistVideo>& videos, PlaylistTitleIndex& index) {
+    // Line breaks separate titles, so a match can never span two of them
+    std::wstring packed;
+    for (size_t i = index.starts.size(); i < videos.size(); i++) {
+        index.starts.push_back(index.folded.size() + packed.size());
+        for (wchar_t c : videos[i].title) {
+            packed += (c == L'\n' || c == L'\r') ? L' ' : c;
         }
-        
-        try {
-            pOptions = (DownloadOptions*)lParam;
-            if (!pOptions) {
-                MessageBox(hDlg, L"Invalid download options.", L"Error", MB_OK | MB_ICONERROR);
-                DestroyWindow(hDlg);
-                return (INT_PTR)TRUE;
-            }
-            
-            // Store dialog handle in options
-            pOptions->hDlg = hDlg;
-            
-            // Initialize progress bar
-            HWND hProgress = GetDlgItem(hDlg, IDC_PROGRESS);
-            if (hProgress) {
-                SendMessage(hProgress, PBM_SETRANGE, 0, MAKELPARAM(0, 100));
-                SendMessage(hProgress, PBM_SETSTEP, 1, 0);
-                SendMessage(hProgress, PBM_SETPOS, 0, 0);
+        packed += L'\n';
+    }
+
+    index.folded += FoldCaseForSearch(packed);
+}
+
+// Find every title containing the (already folded) needle. SSE2 compares the
+// needle's first and last characters against eight positions at a time and only
+// verifies the middle on candidates; after a hit the scan skips to the next title.
+void FindMatchingTitles(const PlaylistTitleIndex& index, const std::wstring& needle, std::vector<int>& matches) {
+    matches.clear();
+
+    const wchar_t* hay = index.folded.c_str();
+    const size_t n = index.folded.size();
+    const size_t m = needle.size();
+    if (m == 0 || m > n) {
+        return;
+    }
+
+    size_t title = 0;
+    auto recordMatch = [&](size_t pos) -> size_t {
+        while (title + 1 < index.starts.size() && index.starts[title + 1] <= pos) {
+            title++;
+        }
+        matches.push_back((int)title);
+        return title + 1 < index.starts.size() ? index.starts[title + 1] : n;
+    };
+
+    size_t i = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+    const __m128i first = _mm_set1_epi16((short)needle[0]);
+    const __m128i last = _mm_set1_epi16((short)needle[m - 1]);
+    while (i + m - 1 + 8 <= n) {
+        __m128i blockFirst = _mm_loadu_si128((const __m128i*)(hay + i));
+        __m128i blockLast = _mm_loadu_si128((const __m128i*)(hay + i + m - 1));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi16(first, blockFirst), _mm_cmpeq_epi16(last, blockLast)));
+
+        size_t next = i + 8;
+        while (mask != 0) {
+            unsigned long bit;
+            _BitScanForward(&bit, mask);
+            size_t pos = i + bit / 2;
+            if (m <= 2 || wmemcmp(hay + pos + 1, needle.c_str() + 1, m - 2) == 0) {
+                next = recordMatch(pos);
+                break;
             }
-            
-            // Update progress text with video URL
-            if (!pOptions->videoUrl.empty()) {
-                // Truncate long URLs for display
-                std::wstring displayUrl = pOptions->videoUrl;
-                if (displayUrl.length() > 80) {
-                    displayUrl = displayUrl.substr(0, 77) + L"...";
+            mask &= ~(3u << bit); // Each wchar_t lane sets two mask bits
+        }
+        i = next;
+    }
+#endif
+
+    // Scalar tail (and the whole scan on platforms without SSE2)
+    while (i + m <= n) {
+        if (hay[i] == needle[0] && hay[i + m - 1] == needle[m - 1] &&
+            (m <= 2 || wmemcmp(hay + i + 1, needle.c_str() + 1, m - 2) == 0)) {
+            i = recordMatch(i);
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+// Re-run the filter box against the title index and resize the virtual list
+void RefreshPlaylistFilter(HWND hDlg) {
+    wchar_t filter[256] = { 0 };
+    GetDlgItemText(hDlg, IDC_EDIT_FILTER, filter, 256);
+
+    if (filter[0] == L'\0') {
+        g_playlistVisible.resize(PlaylistVideoCount());
+        for (size_t i = 0; i < g_playlistVisible.size(); i++) {
+            g_playlistVisible[i] = (int)i;
+        }
+    }
+    else {
+        FindMatchingTitles(g_playlistTitleIndex, FoldCaseForSearch(filter), g_playlistVisible);
+    }
+
+    HWND hList = GetDlgItem(hDlg, IDC_PLAYLIST_LIST);
+    ListView_SetItemCountEx(hList, (int)g_playlistVisible.size(), 0);
+    InvalidateRect(hList, NULL, FALSE);
+}
+
+// Set the checkbox of every video currently shown in the list
+void SetVisiblePlaylistSelection(HWND hDlg, bool selected) {
+    for (int index : g_playlistVisible) {
+        if (index >= 0 && index < (int)g_playlistSelected.size()) {
+            g_playlistSelected[index] = selected;
+        }
+    }
+    InvalidateRect(GetDlgItem(hDlg, IDC_PLAYLIST_LIST), NULL, FALSE);
+}
+
+// Flip the checkbox of a list row
+void TogglePlaylistRow(HWND hList, int row) {
+    if (row >= 0 && row < (int)g_playlistVisible.size()) {
+        int index = g_playlistVisible[row];
+        if (index >= 0 && index < (int)g_playlistSelected.size()) {
+            g_playlistSelected[index] = !g_playlistSelected[index];
+            ListView_RedrawItems(hList, row, row);
+        }
+    }
+}
+
+// Parse one line of yt-dlp --dump-json output and add the video it describes
+bool ParsePlaylistLine(const std::string& line, std::vector<PlaylistVideo>& videos) {
+    if (line.empty()) return false;
+    
+    PlaylistEntrySax entry;
+    try {
+        // A false result is expected when the handler stops early
+        nlohmann::json::sax_parse(line, &entry);
+    }
+    catch (...) {
+        return false; // Skip any lines that don't parse correctly
+    }
+    
+    // Use "id" instead of "url" for better compatibility
+    if (!entry.hasId || !entry.hasTitle || entry.id.empty()) {
+        return false;
+    }
+    
+    // Construct the YouTube video URL directly from video ID
+    PlaylistVideo video;
+    video.id = Utf8ToWide(entry.id);
+    video.title = Utf8ToWide(entry.title);
+    video.url = L"https://www.youtube.com/watch?v=" + video.id;
+    video.channel = Utf8ToWide(entry.channel);
+    video.duration = entry.duration;
+    videos.push_back(video);
+    return true;
+}
+
+// Helper function to POST a JSON body and read a 200 response
+bool HttpPostJson(HINTERNET hSession, const std::wstring& url, const std::string& body, std::string& response) {
+    wchar_t host[256];
+    wchar_t path[2048];
+    wchar_t extra[2048];
+    URL_COMPONENTS parts = { sizeof(parts) };
+    parts.lpszHostName = host;
+    parts.dwHostNameLength = _countof(host);
+    parts.lpszUrlPath = path;
+    parts.dwUrlPathLength = _countof(path);
+    parts.lpszExtraInfo = extra;
+    parts.dwExtraInfoLength = _countof(extra);
+    if (!WinHttpCrackUrl(url.c_str(), 0, 0, &parts)) {
+        return false;
+    }
+
+    HINTERNET hConnect = WinHttpConnect(hSession, host, parts.nPort, 0);
+    if (!hConnect) {
+        return false;
+    }
+    std::wstring object = std::wstring(path) + extra;
+    HINTERNET hRequest = WinHttpOpenRequest(hConnect, L"POST", object.c_str(), NULL, WINHTTP_NO_REFERER,
+                                            WINHTTP_DEFAULT_ACCEPT_TYPES,
+                                            parts.nScheme == INTERNET_SCHEME_HTTPS ? WINHTTP_FLAG_SECURE : 0);
+    bool success = false;
+    if (hRequest) {
+        if (WinHttpSendRequest(hRequest, L"Content-Type: application/json\r\n", (DWORD)-1L,
+                               (LPVOID)body.data(), (DWORD)body.size(), (DWORD)body.size(), 0) &&
+            WinHttpReceiveResponse(hRequest, NULL)) {
+            DWORD status = 0;
+            DWORD size = sizeof(status);
+            WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                                WINHTTP_HEADER_NAME_BY_INDEX, &status, &size, WINHTTP_NO_HEADER_INDEX);
+            if (status == 200) {
+                success = true;
+                while (true) {
+                    DWORD available = 0;
+                    if (!WinHttpQueryDataAvailable(hRequest, &available)) {
+                        success = false;
+                        break;
+                    }
+                    if (available == 0) {
+                        break;
+                    }
+                    size_t offset = response.size();
+                    response.resize(offset + available);
+                    DWORD bytesRead = 0;
+                    if (!WinHttpReadData(hRequest, &response[offset], available, &bytesRead)) {
+                        success = false;
+                        break;
+                    }
+                    response.resize(offset + bytesRead);
                 }
-                SetDlgItemText(hDlg, IDC_PROGRESS_TEXT, displayUrl.c_str());
-            } else {
-                SetDlgItemText(hDlg, IDC_PROGRESS_TEXT, L"Downloading video...");
-            }
-            
-            // Initialize progress text fields
-            SetDlgItemText(hDlg, IDC_PROGRESS_PERCENT, L"0% completed");
-            SetDlgItemText(hDlg, IDC_TIME_REMAINING, L"Time remaining: Calculating...");
-            SetDlgItemText(hDlg, IDC_DOWNLOAD_SPEED, L"Download speed: Calculating...");
-            
-            // Create download item
-            pItem = new DownloadItem();
-            pItem->url = pOptions->videoUrl;
-            pItem->resolution = pOptions->resolution;
-            pItem->path = pOptions->path.empty() ? g_settings.defaultDownloadPath : pOptions->path;
-            pItem->downloadSubtitles = pOptions->downloadSubtitles;
-            pItem->status = Downloading;
-            pItem->progress = 0;
-            pItem->hProcess = NULL;
-            pItem->threadId = 0;
-            pItem->progressDlg = hDlg;
-            
-            // Record start time for calculating speed and remaining time
-            startTime = GetTickCount();
-            
-            // Create download thread with appropriate error handling
-            hThread = CreateThread(NULL, 0, DownloadThread, (LPVOID)pItem, 0, &pItem->threadId);
-            if (hThread == NULL) {
-                DWORD error = GetLastError();
-                wchar_t buffer[256];
-                swprintf_s(buffer, L"Failed to start download thread. Error code: %d", error);
-                MessageBox(hDlg, buffer, L"Error", MB_OK | MB_ICONERROR);
-                delete pItem;
-                pItem = nullptr;
-                DestroyWindow(hDlg);
-                return (INT_PTR)TRUE;
             }
-            
-            // Set a timer to check download progress
-            SetTimer(hDlg, 1, 500, NULL);
-            
-            return (INT_PTR)TRUE;
         }
-        catch (...) {
-            MessageBox(hDlg, L"An unexpected error occurred while initializing the download.", 
-                      L"Error", MB_OK | MB_ICONERROR);
-            if (pItem) {
-                delete pItem;
-                pItem = nullptr;
-            }
-            DestroyWindow(hDlg);
-            return (INT_PTR)TRUE;
+        WinHttpCloseHandle(hRequest);
+    }
+    WinHttpCloseHandle(hConnect);
+    return success;
+}
+
+// Enumerate a playlist through InnerTube's browse API, following continuation tokens.
+// onPage (if set) is called after every page. Returns false on any error, leaving the
+// entries read so far in videos, so the caller can fall back to yt-dlp.
+bool EnumeratePlaylistInnerTube(const std::wstring& listId, std::vector<PlaylistVideo>& videos,
+                                const std::function<void(const std::vector<PlaylistVideo>&)>& onPage) {
+    if (listId.empty()) {
+        return false;
+    }
+
+    HINTERNET hSession = WinHttpOpen(L"Mozilla/5.0 (Windows NT 10.0; Win64; x64) YoutubePlus",
+                                     WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+    if (!hSession) {
+        return false;
+    }
+    WinHttpSetTimeouts(hSession, 10000, 10000, 10000, 15000);
+    DWORD decompression = WINHTTP_DECOMPRESSION_FLAG_ALL;
+    WinHttpSetOption(hSession, WINHTTP_OPTION_DECOMPRESSION, &decompression, sizeof(decompression));
+
+    std::wstring endpoint = g_settings.innerTubeBaseUrl;
+    while (!endpoint.empty() && endpoint.back() == L'/') {
+        endpoint.pop_back();
+    }
+    endpoint += L"/youtubei/v1/browse?prettyPrint=false";
+
+    // Convert each page's new entries as they arrive, so onPage sees them
+    std::vector<InnerTubePlaylistEntry> entries;
+    auto convert = [&](const std::vector<InnerTubePlaylistEntry>& page) {
+        for (size_t i = videos.size(); i < page.size(); i++) {
+            PlaylistVideo video;
+            video.id = Utf8ToWide(page[i].videoId);
+            video.title = Utf8ToWide(page[i].title);
+            video.url = L"https://www.youtube.com/watch?v=" + video.id;
+            video.channel = Utf8ToWide(page[i].channel);
+            video.duration = page[i].duration;
+            videos.push_back(video);
         }
+    };
+    bool success = EnumerateInnerTubePlaylist(WideToUtf8(listId), WideToUtf8(g_settings.innerTubeClientVersion),
+        [&](const std::string& body, std::string& response) {
+            return HttpPostJson(hSession, endpoint, body, response);
+        },
+        entries,
+        [&](const std::vector<InnerTubePlaylistEntry>& page) {
+            convert(page);
+            if (onPage) {
+                onPage(videos);
+            }
+        });
+    convert(entries);
+
+    WinHttpCloseHandle(hSession);
+    return success;
+}
+
+// Parse playlist page to extract videos
+DWORD WINAPI FetchPlaylistVideosThread(LPVOID lpParam) {
+    HWND hDlg = (HWND)lpParam;
+    unsigned int generation = g_playlistGeneration;
+    
+    // Get the playlist URL safely
+    std::wstring playlistUrl;
+    
+    // Get the playlist URL with safer access
+    void* userData = (void*)GetWindowLongPtr(hDlg, GWLP_USERDATA);
+    if (!userData) {
+        MessageBox(hDlg, L"Failed to get playlist URL from dialog.", L"Error", MB_OK | MB_ICONERROR);
+        return 1;
     }
     
-    case WM_TIMER:
-        if (pItem) {
-            // Calculate elapsed time in seconds
-            DWORD currentTime = GetTickCount();
-            double elapsedSec = (currentTime - startTime) / 1000.0;
-            if (elapsedSec < 0.1) elapsedSec = 0.1; // Avoid division by zero
-            
-            // Update progress bar
-            HWND hProgress = GetDlgItem(hDlg, IDC_PROGRESS);
-            if (hProgress) {
+    try {
+        playlistUrl = *(std::wstring*)userData;
+    }
+    catch (...) {
+        MessageBox(hDlg, L"Error accessing playlist URL data.", L"Error", MB_OK | MB_ICONERROR);
+        return 1;
+    }
+    
+    if (playlistUrl.empty()) {
+        MessageBox(hDlg, L"Playlist URL is empty.", L"Error", MB_OK | MB_ICONERROR);
+        return 1;
+    }
+    
+    // Support both playlist URLs and watch?v=XXX&list=XXX format
+    std::wstring playlistId = ClassifyYouTubeUrl(playlistUrl).playlistId;
+    
+    if (playlistId.empty()) {
+        MessageBox(hDlg, L"The URL does not appear to be a YouTube playlist.", L"Error", MB_OK | MB_ICONERROR);
+        return 1;
+    }
+    
+    // Page through the playlist natively first; starting yt-dlp's interpreter alone can take seconds
+    std::vector<PlaylistVideo> pages;
+    ChunkedListBuilder<PlaylistVideo> nativeVideos(kPlaylistPublishBatch);
+    bool enumerated = EnumeratePlaylistInnerTube(playlistId, pages,
+        [&](const std::vector<PlaylistVideo>& page) {
+            for (size_t i = nativeVideos.size(); i < page.size(); i++) {
+                nativeVideos.push_back(page[i]);
+            }
+            PublishPlaylistSnapshot(generation, nativeVideos, false);
+            PostMessage(hDlg, WM_COMMAND, MAKEWPARAM(IDC_PLAYLIST_LIST, LBN_SELCHANGE), 0);
+        });
+    if (enumerated) {
+        PublishPlaylistSnapshot(generation, nativeVideos, true);
+        PostMessage(hDlg, WM_COMMAND, MAKEWPARAM(IDC_PLAYLIST_LIST, LBN_SELCHANGE), 0);
+        return 0;
+    }
+    std::vector<PlaylistVideo>().swap(pages);
+
+    // Fall back to yt-dlp. It lists the playlist in the same order, so entries already
+    // shown are not published again until it has read past them.
+    ChunkedListBuilder<PlaylistVideo> videos(kPlaylistPublishBatch);
+    std::vector<PlaylistVideo> parsed;
+    size_t publishedCount = nativeVideos.size();
+
+    // Get full path to yt-dlp.exe
+    wchar_t exePath[MAX_PATH];
+    GetModuleFileNameW(NULL, exePath, MAX_PATH);
+    std::wstring exeDir = exePath;
+    size_t pos = exeDir.find_last_of(L"\\/");
+    std::wstring ytdlpPath = L"yt-dlp.exe";
+    std::wstring workingDir;
+    if (pos != std::wstring::npos) {
+        workingDir = exeDir.substr(0, pos);
+        ytdlpPath = L"\"" + workingDir + L"\\yt-dlp.exe\"";
+    }
+
+    // Run yt-dlp to get playlist info in JSON format
+    std::wstring command = ytdlpPath + L" --flat-playlist --dump-json \"" + playlistUrl + L"\"";
+
+    ProcessOptions options;
+    options.workingDirectory = WideToUtf8(workingDir);
+    options.errors = ErrorsSeparate;
+    ChildProcess process;
+    if (!process.Start(WideToUtf8(command), options)) {
+        // Get the error message
+        DWORD errorCode = GetLastError();
+        wchar_t errorMsg[256];
+        swprintf_s(errorMsg, L"Failed to start yt-dlp.exe. Error code: %d", errorCode);
+        MessageBox(hDlg, errorMsg, L"Error", MB_OK | MB_ICONERROR);
+        return 1;
+    }
+    
+    // Read the output, publishing snapshots as entries arrive so large playlists fill in progressively
+    std::string pendingOutput;
+    std::string errorOutput;
+    char buffer[4096];
+    int bytesRead;
+    
+    // Read standard output one JSON object per line
+    while ((bytesRead = process.ReadOutput(buffer, sizeof(buffer) - 1)) > 0) {
+        pendingOutput.append(buffer, bytesRead);
+        
+        size_t lineStart = 0;
+        size_t lineEnd;
+        while ((lineEnd = pendingOutput.find('\n', lineStart)) != std::string::npos) {
+            ParsePlaylistLine(pendingOutput.substr(lineStart, lineEnd - lineStart), parsed);
+            lineStart = lineEnd + 1;
+        }
+        pendingOutput.erase(0, lineStart);
+        for (auto& video : parsed) {
+            videos.push_back(std::move(video));
+        }
+        parsed.clear();
+        
+        if (videos.size() >= publishedCount + kPlaylistPublishBatch) {
+            PublishPlaylistSnapshot(generation, videos, false);
+            publishedCount = videos.size();
+            PostMessage(hDlg, WM_COMMAND, MAKEWPARAM(IDC_PLAYLIST_LIST, LBN_SELCHANGE), 0);
+        }
+    }
+    if (ParsePlaylistLine(pendingOutput, parsed)) {
+        videos.push_back(std::move(parsed.back()));
+    }
+    
+    // Read error output
+    while ((bytesRead = process.ReadErrors(buffer, sizeof(buffer) - 1)) > 0) {
+        buffer[bytesRead] = '\0';
+        errorOutput += buffer;
+    }
+    
+    // Wait for process to finish with timeout
+    process.Wait(30000); // 30 second timeout
+    DWORD exitCode = (DWORD)process.ExitCode();
+
+    if (exitCode != 0) {
+        // Process failed
+        wchar_t errorMsg[4096];
+        if (!errorOutput.empty()) {
+            // Convert error output to wstring for display
+            int size_needed = MultiByteToWideChar(CP_UTF8, 0, errorOutput.c_str(), (int)errorOutput.size(), NULL, 0);
+            std::wstring wErrorOutput(size_needed, 0);
+            MultiByteToWideChar(CP_UTF8, 0, errorOutput.c_str(), (int)errorOutput.size(), &wErrorOutput[0], size_needed);
+            
+            swprintf_s(errorMsg, L"Failed to extract playlist data. yt-dlp.exe returned error code %d.\n\nError: %s", 
+                       exitCode, wErrorOutput.c_str());
+        } else {
+            swprintf_s(errorMsg, L"Failed to extract playlist data. yt-dlp.exe returned error code %d.", exitCode);
+        }
+        
+        MessageBox(hDlg, errorMsg, L"Error", MB_OK | MB_ICONERROR);
+        return 1;
+    }
+
+    if (videos.size() < nativeVideos.size()) {
+        std::swap(videos, nativeVideos); // Never shrink what the dialog already shows
+    }
+
+    if (videos.empty()) {
+        MessageBox(hDlg, L"No videos were found in the playlist.", L"Warning", MB_OK | MB_ICONWARNING);
+        return 1;
+    }
+    
+    PublishPlaylistSnapshot(generation, videos, true);
+    
+    // Update the UI with the fetched videos
+    if (IsWindow(hDlg)) {
+        // Use PostMessage instead of SendMessage to avoid deadlocks
+        PostMessage(hDlg, WM_COMMAND, MAKEWPARAM(IDC_PLAYLIST_LIST, LBN_SELCHANGE), 0);
+    }
+    
+    return 0;
+}
+
+// Helper function to create a queue item for a URL with the given options
+DownloadItem* CreateDownloadItem(const std::wstring& url, const DownloadOptions& options,
+                                 const std::wstring& outputTemplate, const std::wstring& archivePath) {
+    DownloadItem* item = new DownloadItem();
+    item->id = g_nextDownloadId++;
+    item->url = url;
+    item->resolution = options.resolution;
+    item->path = options.path.empty() ? g_settings.defaultDownloadPath : options.path;
+    item->downloadSubtitles = options.downloadSubtitles;
+    item->status = Queued;
+    item->progress = 0;
+    item->process = nullptr;
+    item->hThread = NULL;
+    item->threadId = 0;
+    item->progressDlg = NULL;
+    item->startTime = 0;
+    if (!outputTemplate.empty()) {
+        item->outputTemplate = outputTemplate;
+    }
+    item->archivePath = archivePath;
+    item->sections = options.sections;
+    VideoInfoPtr info = GetCachedVideoInfo(GetWatchVideoId(url));
+    if (info) {
+        item->title = info->title;
+        item->estimatedSize = EstimateItemSize(*info, ResolutionToHeight(item->resolution), item->sections);
+    }
+    return item;
+}
+
+// Add a download to the global queue; it starts as soon as a slot is free
+DownloadItem* EnqueueDownload(const std::wstring& url, const DownloadOptions& options,
+                              const std::wstring& outputTemplate = L"", const std::wstring& archivePath = L"") {
+    DownloadItem* item = CreateDownloadItem(url, options, outputTemplate, archivePath);
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        g_downloadQueue.push_back(item);
+    }
+    StartQueuedDownloads();
+    return item;
+}
+
+// Add many downloads at once: one lock and one scheduling pass instead of one per URL
+void EnqueueDownloads(const std::vector<std::wstring>& urls, const DownloadOptions& options,
+                      const std::wstring& outputTemplate = L"", const std::wstring& archivePath = L"") {
+    if (urls.empty()) {
+        return;
+    }
+    std::vector<DownloadItem*> items;
+    items.reserve(urls.size());
+    for (const auto& url : urls) {
+        items.push_back(CreateDownloadItem(url, options, outputTemplate, archivePath));
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        g_downloadQueue.insert(g_downloadQueue.end(), items.begin(), items.end());
+    }
+    StartQueuedDownloads();
+}
+
+// Collect the URLs already waiting or downloading into a folder
+void GetPendingDownloadUrls(const std::wstring& path, std::unordered_set<std::wstring>& urls) {
+    std::lock_guard<std::mutex> lock(g_queueMutex);
+    for (const auto* item : g_downloadQueue) {
+        if (item->status != Completed && item->status != Failed && item->status != Cancelled && item->path == path) {
+            urls.insert(item->url);
+        }
+    }
+}
+
+// Archive of finished downloads, keyed by video ID, so a video that is already on disk is
+// linked or skipped instead of fetched again from another playlist or a later session.
+// archive.idx is memory-mapped: a header, an open-addressing table of fixed-size slots and
+// a heap of UTF-8 (format, path) entries the slots point into. A lookup hashes the ID and
+// probes a few slots in place; nothing is loaded or parsed at startup.
+const DWORD kArchiveMagic = 0x49415059;     // "YPAI"
+const DWORD kArchiveVersion = 1;
+const DWORD kArchiveInitialSlots = 4096;    // Power of two
+const DWORD kArchiveInitialHeap = 1 << 20;
+
+struct ArchiveHeader {
+    DWORD magic;
+    DWORD version;
+    DWORD capacity;     // Slots, a power of two
+    DWORD count;        // Slots in use
+    DWORD heapSize;     // Bytes reserved for entries after the slot table
+    DWORD heapUsed;
+    DWORD reserved[2];
+};
+
+struct ArchiveSlot {
+    char videoId[11];
+    BYTE used;
+    DWORD entry;        // Heap offset of the entry: format and path lengths (WORDs), then their bytes
+};
+
+HANDLE g_hArchiveFile = INVALID_HANDLE_VALUE;
+HANDLE g_hArchiveMapping = NULL;
+BYTE* g_archiveView = nullptr;
+std::mutex g_archiveMutex;
+
+// Helper function to unmap the archive index and close its file
+void CloseDownloadArchiveLocked() {
+    if (g_archiveView) UnmapViewOfFile(g_archiveView);
+    if (g_hArchiveMapping) CloseHandle(g_hArchiveMapping);
+    if (g_hArchiveFile != INVALID_HANDLE_VALUE) CloseHandle(g_hArchiveFile);
+    g_archiveView = nullptr;
+    g_hArchiveMapping = NULL;
+    g_hArchiveFile = INVALID_HANDLE_VALUE;
+}
+
+// Helper function to map an archive index file. A new file, or one that doesn't hold a table this
+// version understands, is reset to an empty table with the given number of slots and heap bytes.
+BYTE* MapArchiveFile(const std::wstring& path, DWORD capacity, DWORD heapSize, HANDLE& hFile, HANDLE& hMapping) {
+    hFile = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    ArchiveHeader header = {};
+    DWORD bytesRead = 0;
+    LARGE_INTEGER size;
+    bool valid = ReadFile(hFile, &header, sizeof(header), &bytesRead, NULL) && bytesRead == sizeof(header) &&
+                 GetFileSizeEx(hFile, &size) &&
+                 header.magic == kArchiveMagic && header.version == kArchiveVersion &&
+                 header.capacity != 0 && (header.capacity & (header.capacity - 1)) == 0 &&
+                 header.count < header.capacity && header.heapUsed <= header.heapSize &&
+                 size.QuadPart == (LONGLONG)(sizeof(ArchiveHeader) + (size_t)header.capacity * sizeof(ArchiveSlot) + header.heapSize);
+    if (!valid) {
+        size.QuadPart = (LONGLONG)(sizeof(ArchiveHeader) + (size_t)capacity * sizeof(ArchiveSlot) + heapSize);
+        LARGE_INTEGER start = {};
+        SetFilePointerEx(hFile, start, NULL, FILE_BEGIN);
+        SetEndOfFile(hFile); // Mapping extends the file to the new size, zero-filled
+    }
+
+    hMapping = CreateFileMappingW(hFile, NULL, PAGE_READWRITE, size.HighPart, size.LowPart, NULL);
+    BYTE* view = hMapping ? (BYTE*)MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (hMapping) CloseHandle(hMapping);
+        CloseHandle(hFile);
+        hMapping = NULL;
+        hFile = INVALID_HANDLE_VALUE;
+        return nullptr;
+    }
+    if (!valid) {
+        ArchiveHeader* newHeader = (ArchiveHeader*)view;
+        newHeader->magic = kArchiveMagic;
+        newHeader->version = kArchiveVersion;
+        newHeader->capacity = capacity;
+        newHeader->heapSize = heapSize;
+    }
+    return view;
+}
+
+// Helper function to find the slot for a video ID: its own slot, or the empty one it would go in
+ArchiveSlot* FindArchiveSlot(BYTE* view, const std::string& videoId) {
+    ArchiveHeader* header = (ArchiveHeader*)view;
+    ArchiveSlot* slots = (ArchiveSlot*)(view + sizeof(ArchiveHeader));
+    DWORD hash = 2166136261u; // FNV-1a
+    for (char c : videoId) {
+        hash = (hash ^ (BYTE)c) * 16777619u;
+    }
+    for (DWORD i = hash & (header->capacity - 1);; i = (i + 1) & (header->capacity - 1)) {
+        if (!slots[i].used || memcmp(slots[i].videoId, videoId.data(), sizeof(slots[i].videoId)) == 0) {
+            return &slots[i];
+        }
+    }
+}
+
+// Helper function to read a slot's format and path; false if the entry runs past the used heap
+bool ReadArchiveEntry(BYTE* view, const ArchiveSlot* slot, std::string& format, std::string& path) {
+    ArchiveHeader* header = (ArchiveHeader*)view;
+    if ((unsigned long long)slot->entry + 2 * sizeof(WORD) > header->heapUsed) {
+        return false;
+    }
+    const BYTE* entry = view + sizeof(ArchiveHeader) + (size_t)header->capacity * sizeof(ArchiveSlot) + slot->entry;
+    WORD formatBytes, pathBytes;
+    memcpy(&formatBytes, entry, sizeof(WORD));
+    memcpy(&pathBytes, entry + sizeof(WORD), sizeof(WORD));
+    if ((unsigned long long)slot->entry + 2 * sizeof(WORD) + formatBytes + pathBytes > header->heapUsed) {
+        return false;
+    }
+    format.assign((const char*)entry + 2 * sizeof(WORD), formatBytes);
+    path.assign((const char*)entry + 2 * sizeof(WORD) + formatBytes, pathBytes);
+    return true;
+}
+
+// Helper function to store an entry in a mapped table that is known to have room for it
+void WriteArchiveEntry(BYTE* view, const std::string& videoId, const std::string& format, const std::string& path) {
+    ArchiveHeader* header = (ArchiveHeader*)view;
+    BYTE* heap = view + sizeof(ArchiveHeader) + (size_t)header->capacity * sizeof(ArchiveSlot);
+    DWORD offset = header->heapUsed;
+    WORD formatBytes = (WORD)format.size();
+    WORD pathBytes = (WORD)path.size();
+    memcpy(heap + offset, &formatBytes, sizeof(WORD));
+    memcpy(heap + offset + sizeof(WORD), &pathBytes, sizeof(WORD));
+    memcpy(heap + offset + 2 * sizeof(WORD), format.data(), formatBytes);
+    memcpy(heap + offset + 2 * sizeof(WORD) + formatBytes, path.data(), pathBytes);
+    header->heapUsed += 2 * sizeof(WORD) + formatBytes + pathBytes;
+
+    // The entry is complete before a slot points at it; a replaced entry stays in the heap until the next rebuild
+    ArchiveSlot* slot = FindArchiveSlot(view, videoId);
+    if (!slot->used) {
+        memcpy(slot->videoId, videoId.data(), sizeof(slot->videoId));
+        header->count++;
+    }
+    slot->entry = offset;
+    slot->used = 1;
+}
+
+// Helper function to open the archive index; called once at startup
+bool OpenDownloadArchive() {
+    std::lock_guard<std::mutex> lock(g_archiveMutex);
+    std::wstring path = GetAppDataFilePath(L"archive.idx");
+    if (g_archiveView || path.empty()) {
+        return g_archiveView != nullptr;
+    }
+    g_archiveView = MapArchiveFile(path, kArchiveInitialSlots, kArchiveInitialHeap, g_hArchiveFile, g_hArchiveMapping);
+    return g_archiveView != nullptr;
+}
+
+// Helper function to rebuild the archive into a larger file once the table or heap fills up.
+// The new file is written beside the old one and swapped in, so a crash leaves one of them intact.
+bool GrowDownloadArchiveLocked(size_t extraBytes) {
+    ArchiveHeader* header = (ArchiveHeader*)g_archiveView;
+    DWORD capacity = header->capacity;
+    if (header->count + 1 > capacity / 4 * 3) {
+        capacity *= 2;
+    }
+    unsigned long long heapSize = header->heapSize;
+    while (heapSize < (unsigned long long)header->heapUsed + extraBytes) {
+        heapSize *= 2;
+    }
+    if (heapSize > 0x7FFFFFFF) {
+        return false;
+    }
+
+    std::wstring path = GetAppDataFilePath(L"archive.idx");
+    std::wstring tempPath = path + L".tmp";
+    DeleteFileW(tempPath.c_str());
+    HANDLE hFile, hMapping;
+    BYTE* view = MapArchiveFile(tempPath, capacity, (DWORD)heapSize, hFile, hMapping);
+    if (!view) {
+        return false;
+    }
+    const ArchiveSlot* slots = (const ArchiveSlot*)(g_archiveView + sizeof(ArchiveHeader));
+    for (DWORD i = 0; i < header->capacity; i++) {
+        if (slots[i].used) {
+            std::string format, file;
+            if (!ReadArchiveEntry(g_archiveView, &slots[i], format, file)) continue;
+            WriteArchiveEntry(view, std::string(slots[i].videoId, sizeof(slots[i].videoId)), format, file);
+        }
+    }
+    FlushViewOfFile(view, 0);
+    UnmapViewOfFile(view);
+    CloseHandle(hMapping);
+    CloseHandle(hFile);
+
+    CloseDownloadArchiveLocked();
+    if (!MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileW(tempPath.c_str());
+    }
+    g_archiveView = MapArchiveFile(path, kArchiveInitialSlots, kArchiveInitialHeap, g_hArchiveFile, g_hArchiveMapping);
+    return g_archiveView != nullptr;
+}
+
+// Helper function to look up where a video was downloaded to and in which format
+bool LookupArchivedDownload(const std::wstring& videoId, std::wstring& format, std::wstring& path) {
+    std::string id = WideToUtf8(videoId);
+    if (id.size() != sizeof(ArchiveSlot::videoId)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(g_archiveMutex);
+    if (!g_archiveView) {
+        return false;
+    }
+    ArchiveSlot* slot = FindArchiveSlot(g_archiveView, id);
+    if (!slot->used) {
+        return false;
+    }
+    std::string formatText, pathText;
+    if (!ReadArchiveEntry(g_archiveView, slot, formatText, pathText)) {
+        return false;
+    }
+    format = Utf8ToWide(formatText);
+    path = Utf8ToWide(pathText);
+    return true;
+}
+
+// Helper function to record a finished download in the archive, replacing any earlier entry for the video
+void RecordArchivedDownload(const std::wstring& videoId, const std::wstring& format, const std::wstring& path) {
+    std::string id = WideToUtf8(videoId);
+    std::string formatText = WideToUtf8(format);
+    std::string pathText = WideToUtf8(path);
+    if (id.size() != sizeof(ArchiveSlot::videoId) || formatText.size() > 0xFFFF || pathText.size() > 0xFFFF) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(g_archiveMutex);
+    if (!g_archiveView) {
+        return;
+    }
+    ArchiveHeader* header = (ArchiveHeader*)g_archiveView;
+    size_t bytes = 2 * sizeof(WORD) + formatText.size() + pathText.size();
+    if (header->count + 1 > header->capacity / 4 * 3 || header->heapUsed + bytes > header->heapSize) {
+        if (!GrowDownloadArchiveLocked(bytes)) {
+            return;
+        }
+    }
+    WriteArchiveEntry(g_archiveView, id, formatText, pathText);
+}
+
+// Helper function to find the archived file a queued item could be satisfied from.
+// Only looks at the archive's mapping, so it is cheap enough to call with g_queueMutex held.
+bool FindArchivedDownload(const DownloadItem* item, std::wstring& file) {
+    // Only whole videos without subtitles are recorded, so those are all that can match
+    if (!item->sections.empty() || item->downloadSubtitles || IsSubtitleOnly(item->resolution) || item->path.empty()) {
+        return false;
+    }
+    std::wstring videoId = GetWatchVideoId(item->url);
+    std::wstring format;
+    return !videoId.empty() && LookupArchivedDownload(videoId, format, file) && format == item->resolution;
+}
+
+// Helper function to satisfy a queued item from an archived file instead of downloading it. The file
+// is hard-linked into the item's folder, or the item is simply done when it is already there.
+// Called without g_queueMutex, since the file system may be slow; the item's running flag keeps it
+// from being started or freed meanwhile. Returns the plan to show, empty when it has to be downloaded.
+std::wstring ReuseArchivedDownload(const DownloadItem* item, const std::wstring& file) {
+    if (GetFileAttributesW(file.c_str()) == INVALID_FILE_ATTRIBUTES) {
+        return L""; // Moved or deleted since; fetch it again
+    }
+
+    std::wstring target = item->path;
+    if (target.back() != L'\\' && target.back() != L'/') {
+        target += L'\\';
+    }
+    target += file.substr(file.find_last_of(L"\\/") + 1);
+    std::wstring plan;
+    if (_wcsicmp(target.c_str(), file.c_str()) == 0 || GetFileAttributesW(target.c_str()) != INVALID_FILE_ATTRIBUTES) {
+        plan = L"Already downloaded";
+    }
+    else if (CreateHardLinkW(target.c_str(), file.c_str(), NULL)) {
+        plan = L"Hard-linked from archive";
+    }
+    else {
+        return L""; // Another volume, or a file system without hard links
+    }
+
+    // Keep a mirror's yt-dlp archive in step, so the next sync doesn't queue the video again
+    if (!item->archivePath.empty()) {
+        std::ofstream archive(item->archivePath, std::ios::app);
+        archive << "youtube " << WideToUtf8(GetWatchVideoId(item->url)) << "\n";
+    }
+    return plan;
+}
+
+// Helper function to check whether an item has reached a final status
+bool IsDownloadFinished(const DownloadItem* item) {
+    return item->status == Completed || item->status == Failed || item->status == Cancelled;
+}
+
+// Free the oldest finished items beyond kMaxFinishedDownloads. Items a download or
+// post-processing worker still holds are skipped. Caller holds g_queueMutex.
+void PruneFinishedDownloadsLocked() {
+    size_t finished = std::count_if(g_downloadQueue.begin(), g_downloadQueue.end(), IsDownloadFinished);
+    if (finished <= kMaxFinishedDownloads) {
+        return;
+    }
+    size_t excess = finished - kMaxFinishedDownloads;
+    auto kept = std::remove_if(g_downloadQueue.begin(), g_downloadQueue.end(), [&excess](DownloadItem* item) {
+        if (excess == 0 || !IsDownloadFinished(item) || item->running || item->postProcessing) {
+            return false;
+        }
+        excess--;
+        delete item;
+        return true;
+    });
+    g_downloadQueue.erase(kept, g_downloadQueue.end());
+}
+
+// Start queued downloads until the concurrency limit is reached. Items the download archive may
+// satisfy are held and added to archived instead. Caller holds g_queueMutex.
+void StartQueuedDownloadsLocked(std::vector<std::pair<DownloadItem*, std::wstring>>& archived) {
+    PruneFinishedDownloadsLocked();
+    int maxDownloads = g_settings.maxConcurrentDownloads;
+    
+    // Subtitle-only jobs have their own, larger pool of slots
+    int running = 0;
+    int runningSubtitles = 0;
+    for (const auto* item : g_downloadQueue) {
+        if (item->status == Downloading) {
+            if (IsSubtitleOnly(item->resolution)) runningSubtitles++;
+            else running++;
+        }
+    }
+    
+    for (auto* item : g_downloadQueue) {
+        if (running >= maxDownloads && runningSubtitles >= kMaxConcurrentSubtitleJobs) break;
+        if (item->status != Queued || item->running) continue;
+        std::wstring archivedFile;
+        if (!item->archiveChecked && FindArchivedDownload(item, archivedFile)) {
+            // The caller links it once the lock is released; it is held like a running download until then
+            item->running = true;
+            archived.push_back(std::make_pair(item, archivedFile));
+            continue;
+        }
+        bool subtitles = IsSubtitleOnly(item->resolution);
+        if (subtitles ? runningSubtitles >= kMaxConcurrentSubtitleJobs : running >= maxDownloads) continue;
+        
+        item->status = Downloading;
+        item->startTime = GetTickCount();
+        item->running = true;
+        HANDLE hThread = CreateThread(NULL, 0, DownloadThread, (LPVOID)item, 0, &item->threadId);
+        if (!hThread) {
+            item->status = Failed;
+            item->running = false;
+            continue;
+        }
+        CloseHandle(hThread); // Progress is tracked through the item, nobody waits on the thread
+        if (subtitles) runningSubtitles++;
+        else running++;
+    }
+}
+
+// Start queued downloads until the concurrency limit is reached
+void StartQueuedDownloads() {
+    std::vector<std::pair<DownloadItem*, std::wstring>> archived;
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        StartQueuedDownloadsLocked(archived);
+    }
+    if (archived.empty()) {
+        return;
+    }
+
+    for (const auto& candidate : archived) {
+        DownloadItem* item = candidate.first;
+        std::wstring plan = ReuseArchivedDownload(item, candidate.second);
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        item->running = false;
+        item->archiveChecked = true;
+        if (!plan.empty() && item->status == Queued) {
+            item->plan = plan;
+            item->progress = 100;
+            item->status = Completed;
+        }
+        // Paused and resumed meanwhile, like a download whose thread was still stopping
+        if (item->resumeRequested) {
+            item->resumeRequested = false;
+            if (item->status == Paused) {
+                item->status = Queued;
+            }
+        }
+    }
+    // The items the archive couldn't satisfy are downloaded after all
+    StartQueuedDownloads();
+}
+
+// Dialog procedure for playlist selection
+INT_PTR CALLBACK PlaylistDialogProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
+    static std::wstring* pPlaylistUrl = nullptr;
+    
+    switch (message) {
+    case WM_INITDIALOG: {
+        pPlaylistUrl = (std::wstring*)lParam;
+        SetWindowLongPtr(hDlg, GWLP_USERDATA, (LONG_PTR)pPlaylistUrl);
+        
+        // Initialize the list view
+        HWND hList = GetDlgItem(hDlg, IDC_PLAYLIST_LIST);
+        
+        // Add columns to the list view
+        LVCOLUMNW lvc = { 0 };
+        lvc.mask = LVCF_TEXT | LVCF_WIDTH | LVCF_SUBITEM;
+        
+        lvc.iSubItem = 0;
+        lvc.pszText = (LPWSTR)L"Title";
+        lvc.cx = 260;
+        ListView_InsertColumn(hList, 0, &lvc);
+        
+        lvc.iSubItem = 1;
+        lvc.pszText = (LPWSTR)L"URL";
+        lvc.cx = 60;
+        ListView_InsertColumn(hList, 1, &lvc);
+        
+        lvc.iSubItem = 2;
+        lvc.pszText = (LPWSTR)L"Duration";
+        lvc.cx = 60;
+        ListView_InsertColumn(hList, 2, &lvc);
+        
+        lvc.iSubItem = 3;
+        lvc.pszText = (LPWSTR)L"Size";
+        lvc.cx = 70;
+        ListView_InsertColumn(hList, 3, &lvc);
+        
+        lvc.iSubItem = 4;
+        lvc.pszText = (LPWSTR)L"Quality";
+        lvc.cx = 60;
+        ListView_InsertColumn(hList, 4, &lvc);
+        
+        // Set extended style to enable checkboxes
+        ListView_SetExtendedListViewStyle(hList, LVS_EX_CHECKBOXES | LVS_EX_FULLROWSELECT);
+        
+        // The list is virtual (LVS_OWNERDATA), so checkbox state comes from g_playlistSelected
+        ListView_SetCallbackMask(hList, LVIS_STATEIMAGEMASK);
+        
+        // Start a new generation so snapshots from an earlier fetch are ignored
+        g_playlistGeneration++;
+        g_playlistVideos.reset();
+        g_playlistSelected.clear();
+        g_playlistTitleIndex = PlaylistTitleIndex();
+        g_playlistVisible.clear();
+        
+        // Start thread to fetch playlist data
+        CreateThread(NULL, 0, FetchPlaylistVideosThread, (LPVOID)hDlg, 0, NULL);
+        
+        return (INT_PTR)TRUE;
+    }
+    
+    case WM_COMMAND:
+        if (LOWORD(wParam) == IDOK) {
+            // Process selected videos
+            std::vector<std::wstring> selectedUrls;
+            
+            for (size_t i = 0; i < PlaylistVideoCount(); i++) {
+                if (g_playlistSelected[i]) {
+                    selectedUrls.push_back(g_playlistVideos->videos[i].url);
+                }
+            }
+            
+            if (!selectedUrls.empty()) {
+                // Ask for download options first
+                DownloadOptions options = { nullptr, L"Best", g_settings.defaultDownloadPath, L"", false };
+                if (DialogBoxParam(hInst, MAKEINTRESOURCE(IDD_DOWNLOAD_OPTIONS), hDlg, DownloadOptionsProc, (LPARAM)&options) == IDOK) {
+                    // Queue the selected videos and show their progress in the Download Manager
+                    for (const auto& url : selectedUrls) {
+                        EnqueueDownload(url, options);
+                    }
+                    ShowDownloadManager();
+                }
+            }
+            
+            EndDialog(hDlg, IDOK);
+            return (INT_PTR)TRUE;
+        }
+        else if (LOWORD(wParam) == IDCANCEL) {
+            EndDialog(hDlg, IDCANCEL);
+            return (INT_PTR)TRUE;
+        }
+        else if (LOWORD(wParam) == IDC_BUTTON_SELECT_ALL) {
+            std::fill(g_playlistSelected.begin(), g_playlistSelected.end(), (char)1);
+            InvalidateRect(GetDlgItem(hDlg, IDC_PLAYLIST_LIST), NULL, FALSE);
+            return (INT_PTR)TRUE;
+        }
+        else if (LOWORD(wParam) == IDC_BUTTON_DESELECT_ALL) {
+            std::fill(g_playlistSelected.begin(), g_playlistSelected.end(), (char)0);
+            InvalidateRect(GetDlgItem(hDlg, IDC_PLAYLIST_LIST), NULL, FALSE);
+            return (INT_PTR)TRUE;
+        }
+        else if (LOWORD(wParam) == IDC_BUTTON_SELECT_MATCHING) {
+            SetVisiblePlaylistSelection(hDlg, true);
+            return (INT_PTR)TRUE;
+        }
+        else if (LOWORD(wParam) == IDC_BUTTON_DESELECT_MATCHING) {
+            SetVisiblePlaylistSelection(hDlg, false);
+            return (INT_PTR)TRUE;
+        }
+        else if (LOWORD(wParam) == IDC_BUTTON_PROBE) {
+            // Probe the checked videos in the background; rows fill in as results arrive
+            for (size_t i = 0; i < PlaylistVideoCount(); i++) {
+                if (g_playlistSelected[i]) {
+                    const auto& video = g_playlistVideos->videos[i];
+                    QueueMetadataProbe(video.id, video.url, hDlg);
+                }
+            }
+            return (INT_PTR)TRUE;
+        }
+        else if (LOWORD(wParam) == IDC_EDIT_FILTER && HIWORD(wParam) == EN_CHANGE) {
+            RefreshPlaylistFilter(hDlg);
+            return (INT_PTR)TRUE;
+        }
+        else if (LOWORD(wParam) == IDC_PLAYLIST_LIST && HIWORD(wParam) == LBN_SELCHANGE) {
+            // Pick up the latest snapshot published by the fetch thread
+            PlaylistSnapshot snapshot = std::atomic_load(&g_playlistSnapshot);
+            if (snapshot && snapshot->generation == g_playlistGeneration && snapshot != g_playlistVideos) {
+                g_playlistVideos = snapshot;
+                // New entries start selected unless the library already has them
+                size_t known = g_playlistSelected.size();
+                g_playlistSelected.resize(snapshot->videos.size(), 1);
+                for (size_t i = known; i < snapshot->videos.size(); i++) {
+                    g_playlistSelected[i] = IsVideoInLibrary(snapshot->videos[i].id) ? 0 : 1;
+                }
+                
+                // Index the new titles and show the videos matching the current filter
+                AppendPlaylistTitles(snapshot->videos, g_playlistTitleIndex);
+                RefreshPlaylistFilter(hDlg);
+            }
+            return (INT_PTR)TRUE;
+        }
+        break;
+    
+    case WM_NOTIFY: {
+        NMHDR* pnmhdr = (NMHDR*)lParam;
+        if (pnmhdr->idFrom != IDC_PLAYLIST_LIST) {
+            break;
+        }
+        
+        if (pnmhdr->code == LVN_GETDISPINFO) {
+            NMLVDISPINFOW* pdi = (NMLVDISPINFOW*)lParam;
+            int row = pdi->item.iItem;
+            if (row < 0 || row >= (int)g_playlistVisible.size()) {
+                break;
+            }
+            int index = g_playlistVisible[row];
+            const auto& video = g_playlistVideos->videos[index];
+            
+            if (pdi->item.mask & LVIF_TEXT) {
+                std::wstring text;
+                switch (pdi->item.iSubItem) {
+                case 0: text = video.title; break;
+                case 1: text = L"View"; break;
+                case 2: text = FormatDuration(video.duration); break;
+                case 3:
+                case 4: {
+                    VideoInfoPtr info = GetCachedVideoInfo(video.id);
+                    if (info && pdi->item.iSubItem == 3) {
+                        text = FormatFileSize(EstimateDownloadSize(*info, 0));
+                    }
+                    else if (info && GetMaxVideoHeight(*info) > 0) {
+                        text = std::to_wstring(GetMaxVideoHeight(*info)) + L"p";
+                    }
+                    break;
+                }
+                }
+                wcsncpy_s(pdi->item.pszText, pdi->item.cchTextMax, text.c_str(), _TRUNCATE);
+            }
+            pdi->item.mask |= LVIF_STATE;
+            pdi->item.stateMask = LVIS_STATEIMAGEMASK;
+            pdi->item.state = INDEXTOSTATEIMAGEMASK(g_playlistSelected[index] ? 2 : 1);
+        }
+        else if (pnmhdr->code == NM_CLICK) {
+            // Virtual lists don't toggle checkboxes on their own
+            NMITEMACTIVATE* pnmia = (NMITEMACTIVATE*)lParam;
+            LVHITTESTINFO hit = { 0 };
+            hit.pt = pnmia->ptAction;
+            ListView_SubItemHitTest(pnmhdr->hwndFrom, &hit);
+            if (hit.flags & LVHT_ONITEMSTATEICON) {
+                TogglePlaylistRow(pnmhdr->hwndFrom, hit.iItem);
+            }
+        }
+        else if (pnmhdr->code == LVN_KEYDOWN && ((NMLVKEYDOWN*)lParam)->wVKey == VK_SPACE) {
+            int row = -1;
+            while ((row = ListView_GetNextItem(pnmhdr->hwndFrom, row, LVNI_SELECTED)) != -1) {
+                TogglePlaylistRow(pnmhdr->hwndFrom, row);
+            }
+        }
+        break;
+    }
+    
+    case WM_APP_VIDEOINFO_READY:
+        // A probe finished; repaint so the Size and Quality columns pick it up
+        InvalidateRect(GetDlgItem(hDlg, IDC_PLAYLIST_LIST), NULL, FALSE);
+        return (INT_PTR)TRUE;
+    
+    case WM_DESTROY:
+        CancelMetadataProbes(hDlg);
+        break;
+    }
+    
+    return (INT_PTR)FALSE;
+}
+
+// Function to parse yt-dlp output and update progress bar
+void UpdateDownloadProgress(const std::string& output, HWND hDlg, int itemIndex) {
+    if (output.empty() || itemIndex < 0) {
+        return; // No output or invalid index
+    }
+    
+    try {
+        // More robust regex to match yt-dlp progress outputs
+        std::regex progressRegex(R"(\[download\]\s+([0-9\.]+)%\s+of\s+~?)");
+        std::smatch match;
+        std::string lastMatch;
+        
+        // Find all matches and use the last one (most recent progress)
+        std::string::const_iterator searchStart(output.cbegin());
+        while (std::regex_search(searchStart, output.cend(), match, progressRegex)) {
+            lastMatch = match[1].str();
+            searchStart = match.suffix().first;
+        }
+        
+        if (!lastMatch.empty()) {
+            try {
+                float progress = std::stof(lastMatch);
+                {
+                    std::lock_guard<std::mutex> lock(g_queueMutex);
+                    if (itemIndex < g_downloadQueue.size() && g_downloadQueue[itemIndex] != nullptr) {
+                        g_downloadQueue[itemIndex]->progress = progress;
+                    }
+                }
+            }
+            catch (const std::invalid_argument&) {
+                // Invalid number format in progress output
+            }
+            catch (const std::out_of_range&) {
+                // Progress number out of range
+            }
+        }
+    }
+    catch (const std::regex_error&) {
+        // Regex error - don't crash the application
+    }
+    catch (...) {
+        // Unknown error - don't crash the application
+    }
+}
+
+// Format selection and post-processing chosen for a download
+struct PostProcessPlan {
+    std::wstring arguments;     // yt-dlp download-stage options, each with a leading space
+    std::wstring targetExt;     // Container the post-processing stage writes
+    std::wstring description;   // Shown in the download manager
+};
+
+// Pick the cheapest pipeline for the requested output. The download stage only fetches
+// streams; merging and audio conversion run later in the post-processing stage, where
+// audio is stream-copied into its container when possible and re-encoded only for mp3
+// or when no matching stream exists.
+PostProcessPlan PlanPostProcessing(const std::wstring& resolution, const VideoInfo* info, bool sections) {
+    PostProcessPlan plan;
+    if (IsSubtitleOnly(resolution)) {
+        // The downloaded WebVTT is converted natively once yt-dlp exits; there is nothing for ffmpeg to do
+        plan.arguments = L" --skip-download --write-subs --write-auto-subs --sub-format vtt";
+        plan.description = resolution == kSubtitlesOnlySrt ? L"Subtitles to srt" : L"Subtitles to text";
+        return plan;
+    }
+
+    std::string sourceExt;
+    if (resolution == kAudioOnlyM4a) {
+        sourceExt = "m4a";
+        plan.targetExt = L"m4a";
+    }
+    else if (resolution == kAudioOnlyOpus) {
+        sourceExt = "webm"; // YouTube's webm audio streams are opus
+        plan.targetExt = L"opus";
+    }
+    else if (resolution == kAudioOnlyMp3) {
+        plan.targetExt = L"mp3";
+    }
+
+    if (sections) {
+        // yt-dlp cuts each section with ffmpeg while downloading and muxes it in the same pass,
+        // so there are no whole streams left for a separate stage to work on
+        if (plan.targetExt.empty()) {
+            plan.arguments = L" --merge-output-format mp4";
+            if (resolution != L"Best") {
+                std::wstring res = resolution;
+                if (!res.empty() && res.back() == 'p') {
+                    res.pop_back();
+                }
+                plan.arguments += L" -f \"bv*[height<=" + res + L"]+ba/b\"";
+            }
+            plan.description = L"Cut sections into mp4";
+        }
+        else {
+            if (!sourceExt.empty()) {
+                plan.arguments = L" -f \"bestaudio[ext=" + Utf8ToWide(sourceExt) + L"]/bestaudio\"";
+            }
+            plan.arguments += L" -x --audio-format " + plan.targetExt;
+            plan.description = L"Cut sections into " + plan.targetExt;
+        }
+        plan.targetExt.clear();
+        return plan;
+    }
+
+    if (plan.targetExt.empty()) {
+        // Video and audio are fetched as separate files (the comma) and merged into mp4 without re-encoding
+        std::wstring video = L"bv*";
+        if (resolution != L"Best") {
+            std::wstring res = resolution;
+            if (!res.empty() && res.back() == 'p') {
+                res.pop_back();
+            }
+            video += L"[height<=" + res + L"]";
+        }
+        plan.arguments = L" -f \"" + video + L",ba/b\"";
+        plan.targetExt = L"mp4";
+        plan.description = L"Merge into mp4";
+        return plan;
+    }
+
+    if (sourceExt.empty()) {
+        plan.arguments = L" -f bestaudio";
+        plan.description = L"Transcode to " + plan.targetExt;
+        return plan;
+    }
+
+    // Without metadata, assume the streams YouTube normally offers
+    bool hasStream = info == nullptr;
+    if (info) {
+        for (const auto& format : info->formats) {
+            if (format.hasAudio && !format.hasVideo && format.ext == sourceExt) {
+                hasStream = true;
+                break;
+            }
+        }
+    }
+    plan.arguments = L" -f \"bestaudio[ext=" + Utf8ToWide(sourceExt) + L"]/bestaudio\"";
+    plan.description = hasStream ? L"Remux to " + plan.targetExt + L" (stream copy)" : L"Transcode to " + plan.targetExt;
+    return plan;
+}
+
+// Convert a downloaded .vtt file to .srt or .txt beside it, removing the original on success
+bool ConvertVttFile(const std::wstring& vttPath, bool srt) {
+    std::string vtt;
+    {
+        std::ifstream i(vttPath, std::ios::binary);
+        if (!i.good()) {
+            return false;
+        }
+        vtt.assign((std::istreambuf_iterator<char>(i)), std::istreambuf_iterator<char>());
+    }
+
+    std::vector<SubtitleLine> lines;
+    ParseWebVtt(vtt, lines);
+
+    std::wstring outputPath = vttPath.substr(0, vttPath.find_last_of(L'.')) + (srt ? L".srt" : L".txt");
+    {
+        std::string output = FormatSubtitles(lines, srt);
+        std::ofstream o(outputPath, std::ios::binary);
+        o.write(output.data(), output.size());
+        if (!o.good()) {
+            return false;
+        }
+    }
+    DeleteFileW(vttPath.c_str());
+    return true;
+}
+
+// Convert the .vtt files yt-dlp wrote next to a download: basePath.vtt and basePath.<lang>.vtt.
+// Other videos in the folder may share basePath as a prefix, so nothing else is matched.
+void ConvertSubtitlesBeside(const std::wstring& basePath, bool srt) {
+    std::wstring exact = basePath + L".vtt";
+    DWORD attributes = GetFileAttributesW(exact.c_str());
+    if (attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        ConvertVttFile(exact, srt);
+    }
+
+    size_t slash = basePath.find_last_of(L"\\/");
+    std::wstring folder = slash != std::wstring::npos ? basePath.substr(0, slash + 1) : L"";
+    std::wstring prefix = basePath.substr(folder.size()) + L".";
+    WIN32_FIND_DATAW findData;
+    HANDLE hFind = FindFirstFileW((basePath + L".*.vtt").c_str(), &findData);
+    if (hFind == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    do {
+        // The pattern is also tried against 8.3 short names, which can match unrelated files
+        std::wstring name = findData.cFileName;
+        if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && name.compare(0, prefix.size(), prefix) == 0) {
+            ConvertVttFile(folder + name, srt);
+        }
+    } while (FindNextFileW(hFind, &findData));
+    FindClose(hFind);
+}
+
+// yt-dlp logs this line for every subtitle file it writes
+const char* kSubtitleFileMarker = "[info] Writing video subtitles to: ";
+
+// yt-dlp prints this before the format ID and path of every file the download stage writes
+const char* kStageFileMarker = "YTPFILE ";
+
+// Helper function to get the extension of a path, without the dot
+std::wstring GetFileExtension(const std::wstring& path) {
+    size_t dot = path.find_last_of(L'.');
+    size_t slash = path.find_last_of(L"\\/");
+    if (dot == std::wstring::npos || (slash != std::wstring::npos && dot < slash)) {
+        return L"";
+    }
+    return path.substr(dot + 1);
+}
+
+// Run a command with its children, recording their CPU time on the item; it can be cancelled through item->process
+bool RunAccountedProcess(const std::wstring& command, DownloadItem* item, DWORD& exitCode) {
+    exitCode = 1;
+    ProcessOptions options;
+    options.workingDirectory = WideToUtf8(GetAppDirectory());
+    options.captureOutput = false;
+    ChildProcess process;
+    if (!process.Start(WideToUtf8(command), options)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        item->process = &process;
+        // Stopped while the process was starting
+        if (IsDownloadStopped(item)) {
+            process.Kill();
+        }
+    }
+    process.Wait();
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        item->process = nullptr;
+        item->cpuSeconds += process.CpuSeconds();
+    }
+    int code = process.ExitCode();
+    exitCode = code < 0 ? 1 : (DWORD)code;
+    return true;
+}
+
+// Content deduplication. The same upload reappears under other titles and channels, so every
+// finished file is hashed and looked up by size and hash among the files downloaded before it.
+// A match is confirmed byte for byte and the new file replaced with a hard link to the old one.
+// The hash-to-path index is a text file, hashes.txt, in the AppData folder. New files are appended;
+// entries whose file is gone or has changed size are dropped and the file rewritten without them.
+struct ContentHashEntry {
+    ULONGLONG size;
+    std::wstring path;
+};
+
+std::unordered_map<ULONGLONG, std::vector<ContentHashEntry>> g_contentHashes;
+bool g_contentHashesLoaded = false;
+std::mutex g_contentHashMutex;
+std::atomic<long long> g_dedupReclaimedBytes(0);   // Bytes freed this session, shown in the Download Manager
+
+const DWORD kHashBufferBytes = 1 << 20;
+
+// Helper function to hash a file with XXH64; false if it can't be read
+bool HashFileContents(const std::wstring& path, ULONGLONG& hash, ULONGLONG& size) {
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    Xxh64State state;
+    std::vector<BYTE> buffer(kHashBufferBytes);
+    DWORD bytesRead = 0;
+    bool ok;
+    while ((ok = ReadFile(hFile, buffer.data(), (DWORD)buffer.size(), &bytesRead, NULL) != FALSE) && bytesRead > 0) {
+        Xxh64Update(state, buffer.data(), bytesRead);
+    }
+    CloseHandle(hFile);
+    hash = Xxh64Digest(state);
+    size = state.total;
+    return ok;
+}
+
+// Helper function to compare two files byte for byte
+bool FilesHaveSameContent(const std::wstring& first, const std::wstring& second) {
+    HANDLE hFirst = CreateFileW(first.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    HANDLE hSecond = CreateFileW(second.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    bool same = hFirst != INVALID_HANDLE_VALUE && hSecond != INVALID_HANDLE_VALUE;
+    BY_HANDLE_FILE_INFORMATION firstInfo, secondInfo;
+    if (same && GetFileInformationByHandle(hFirst, &firstInfo) && GetFileInformationByHandle(hSecond, &secondInfo) &&
+        firstInfo.dwVolumeSerialNumber == secondInfo.dwVolumeSerialNumber &&
+        firstInfo.nFileIndexHigh == secondInfo.nFileIndexHigh && firstInfo.nFileIndexLow == secondInfo.nFileIndexLow) {
+        same = false; // Already one file; nothing to reclaim
+    }
+    std::vector<BYTE> firstBuffer(kHashBufferBytes), secondBuffer(kHashBufferBytes);
+    while (same) {
+        DWORD firstRead = 0, secondRead = 0;
+        if (!ReadFile(hFirst, firstBuffer.data(), kHashBufferBytes, &firstRead, NULL) ||
+            !ReadFile(hSecond, secondBuffer.data(), kHashBufferBytes, &secondRead, NULL)) {
+            same = false;
+            break;
+        }
+        if (firstRead != secondRead || memcmp(firstBuffer.data(), secondBuffer.data(), firstRead) != 0) {
+            same = false;
+        }
+        if (firstRead == 0) break;
+    }
+    if (hFirst != INVALID_HANDLE_VALUE) CloseHandle(hFirst);
+    if (hSecond != INVALID_HANDLE_VALUE) CloseHandle(hSecond);
+    return same;
+}
+
+// Helper function to check whether an index entry's file is gone or no longer has its size
+bool IsContentHashEntryStale(const ContentHashEntry& entry) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(entry.path.c_str(), GetFileExInfoStandard, &data)) {
+        DWORD error = GetLastError();
+        return error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND;
+    }
+    return (((ULONGLONG)data.nFileSizeHigh << 32) | data.nFileSizeLow) != entry.size;
+}
+
+// Helper function to format an index entry as a hashes.txt line
+std::string FormatContentHashLine(ULONGLONG hash, const ContentHashEntry& entry) {
+    char hashText[17];
+    sprintf_s(hashText, "%016llx", hash);
+    return std::string(hashText) + " " + std::to_string(entry.size) + " " + WideToUtf8(entry.path) + "\n";
+}
+
+// Helper function to rewrite hashes.txt from the index. It is written beside the old file and
+// swapped in, so a crash keeps one or the other. Caller holds g_contentHashMutex.
+void SaveContentHashesLocked() {
+    std::wstring path = GetAppDataFilePath(L"hashes.txt");
+    std::wstring tempPath = path + L".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary);
+        for (const auto& hashEntries : g_contentHashes) {
+            for (const auto& entry : hashEntries.second) {
+                file << FormatContentHashLine(hashEntries.first, entry);
+            }
+        }
+        if (!file.good()) {
+            file.close();
+            DeleteFileW(tempPath.c_str());
+            return;
+        }
+    }
+    if (!MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileW(tempPath.c_str());
+    }
+}
+
+// Helper function to drop the entries of files that turned out to be gone or changed, and rewrite
+// hashes.txt without them. Caller holds g_contentHashMutex.
+void DropContentHashesLocked(ULONGLONG hash, ULONGLONG size, const std::vector<std::wstring>& paths) {
+    if (paths.empty()) {
+        return;
+    }
+    auto& entries = g_contentHashes[hash];
+    size_t entryCount = entries.size();
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const ContentHashEntry& entry) {
+        return entry.size == size && std::any_of(paths.begin(), paths.end(),
+            [&](const std::wstring& path) { return _wcsicmp(entry.path.c_str(), path.c_str()) == 0; });
+    }), entries.end());
+    if (entries.size() != entryCount) {
+        SaveContentHashesLocked();
+    }
+}
+
+// Helper function to load hashes.txt on first use, dropping duplicate and stale entries.
+// Caller holds g_contentHashMutex.
+void LoadContentHashesLocked() {
+    if (g_contentHashesLoaded) {
+        return;
+    }
+    g_contentHashesLoaded = true;
+    std::ifstream file(GetAppDataFilePath(L"hashes.txt"));
+    std::string line;
+    bool dropped = false;
+    while (std::getline(file, line)) {
+        // "<hash as 16 hex digits> <size> <UTF-8 path>"
+        std::istringstream fields(line);
+        std::string hashText;
+        ContentHashEntry entry;
+        if (!(fields >> hashText >> entry.size) || hashText.size() != 16 ||
+            hashText.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+            dropped = true;
+            continue;
+        }
+        std::string path;
+        std::getline(fields >> std::ws, path);
+        entry.path = Utf8ToWide(path);
+        auto& entries = g_contentHashes[std::stoull(hashText, nullptr, 16)];
+        bool duplicate = std::any_of(entries.begin(), entries.end(), [&](const ContentHashEntry& other) {
+            return other.size == entry.size && _wcsicmp(other.path.c_str(), entry.path.c_str()) == 0;
+        });
+        if (entry.path.empty() || duplicate || IsContentHashEntryStale(entry)) {
+            dropped = true;
+            continue;
+        }
+        entries.push_back(entry);
+    }
+    file.close();
+    if (dropped) {
+        SaveContentHashesLocked();
+    }
+}
+
+// Helper function to replace a finished file with a hard link to an identical earlier download.
+// Returns the bytes reclaimed and sets original to the file it now shares, or 0 if it was kept.
+ULONGLONG DeduplicateFile(const std::wstring& path, std::wstring& original) {
+    ULONGLONG hash, size;
+    if (!HashFileContents(path, hash, size) || size == 0) {
+        return 0;
+    }
+
+    std::vector<std::wstring> candidates;
+    {
+        std::lock_guard<std::mutex> lock(g_contentHashMutex);
+        LoadContentHashesLocked();
+        auto it = g_contentHashes.find(hash);
+        if (it != g_contentHashes.end()) {
+            for (const auto& entry : it->second) {
+                if (entry.size == size && _wcsicmp(entry.path.c_str(), path.c_str()) != 0) {
+                    candidates.push_back(entry.path);
+                }
+            }
+        }
+    }
+
+    // Candidates that were moved or changed since fail to match and are dropped from the index
+    std::vector<std::wstring> staleCandidates;
+    for (const auto& candidate : candidates) {
+        if (!FilesHaveSameContent(path, candidate)) {
+            if (IsContentHashEntryStale({ size, candidate })) {
+                staleCandidates.push_back(candidate);
+            }
+            continue;
+        }
+        // Link under a temporary name first, so the file is replaced in one step or not at all
+        std::wstring linkPath = path + L".dedup";
+        DeleteFileW(linkPath.c_str());
+        if (!CreateHardLinkW(linkPath.c_str(), candidate.c_str(), NULL)) {
+            continue; // Another volume, a file system without hard links, or the link limit
+        }
+        if (!MoveFileExW(linkPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+            DeleteFileW(linkPath.c_str());
+            continue;
+        }
+        original = candidate;
+        g_dedupReclaimedBytes += (long long)size;
+        std::lock_guard<std::mutex> lock(g_contentHashMutex);
+        DropContentHashesLocked(hash, size, staleCandidates);
+        return size;
+    }
+
+    // Unique so far: later downloads are checked against this file
+    std::lock_guard<std::mutex> lock(g_contentHashMutex);
+    DropContentHashesLocked(hash, size, staleCandidates);
+    auto& entries = g_contentHashes[hash];
+    for (const auto& entry : entries) {
+        if (entry.size == size && _wcsicmp(entry.path.c_str(), path.c_str()) == 0) {
+            return 0;
+        }
+    }
+    entries.push_back({ size, path });
+    std::ofstream file(GetAppDataFilePath(L"hashes.txt"), std::ios::app | std::ios::binary);
+    file << FormatContentHashLine(hash, entries.back());
+    return 0;
+}
+
+// Post-processing stage: merge or convert the downloaded streams with ffmpeg into the final file
+bool RunPostProcessing(DownloadItem* item) {
+    if (item->stageFiles.empty()) {
+        return false;
+    }
+
+    // Final name: the first stream's name without its ".f<format id>.<ext>" suffix
+    std::wstring first = item->stageFiles[0];
+    size_t suffix = first.rfind(L".f");
+    std::wstring basePath = first.substr(0, suffix != std::wstring::npos ? suffix : first.find_last_of(L'.'));
+    std::wstring outputPath = basePath + L"." + item->targetExt;
+
+    std::wstring ffmpegPath = GetAppDirectory() + L"\\ffmpeg.exe";
+    std::wstring ffmpeg = GetFileAttributesW(ffmpegPath.c_str()) != INVALID_FILE_ATTRIBUTES ? L"\"" + ffmpegPath + L"\"" : L"ffmpeg.exe";
+    std::wstring command = ffmpeg + L" -y -v error";
+    for (const auto& file : item->stageFiles) {
+        command += L" -i \"" + file + L"\"";
+    }
+
+    std::wstring plan;
+    if (item->targetExt == L"mp4") {
+        if (item->stageFiles.size() > 1) {
+            command += L" -map 0:v:0 -map 1:a:0";
+        }
+        command += L" -c copy -movflags +faststart";
+        plan = L"Merge into mp4";
+    }
+    else {
+        // Copy the audio when the stream already has the target codec
+        std::wstring sourceExt = GetFileExtension(first);
+        bool copy = (item->targetExt == L"m4a" && sourceExt == L"m4a") ||
+                    (item->targetExt == L"opus" && sourceExt == L"webm");
+        command += L" -vn";
+        if (copy) {
+            command += L" -c:a copy";
+            plan = L"Remux to " + item->targetExt + L" (stream copy)";
+        }
+        else {
+            if (item->targetExt == L"m4a") command += L" -c:a aac -b:a 192k";
+            else if (item->targetExt == L"opus") command += L" -c:a libopus -b:a 160k";
+            else command += L" -c:a libmp3lame -q:a 2";
+            plan = L"Transcode to " + item->targetExt;
+        }
+    }
+    command += L" \"" + outputPath + L"\"";
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        item->plan = plan;
+    }
+
+    DWORD exitCode = 1;
+    if (!RunAccountedProcess(command, item, exitCode) || exitCode != 0) {
+        return false; // Keep the streams so nothing downloaded is lost
+    }
+    for (const auto& file : item->stageFiles) {
+        if (_wcsicmp(file.c_str(), outputPath.c_str()) != 0) {
+            DeleteFileW(file.c_str());
+        }
+    }
+    item->stageFiles.clear();
+    RecordArchivedDownload(GetWatchVideoId(item->url), item->resolution, outputPath);
+
+    // An identical file from an earlier download makes this one a hard link to it
+    std::wstring original;
+    ULONGLONG reclaimed = g_settings.deduplicateDownloads ? DeduplicateFile(outputPath, original) : 0;
+    if (reclaimed > 0) {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        item->plan += L", linked to " + original.substr(original.find_last_of(L"\\/") + 1) +
+                      L" (" + FormatFileSize((double)reclaimed) + L" reclaimed)";
+    }
+
+    // The download stage runs quietly, so its subtitle files are found by name instead of from the log
+    if (item->downloadSubtitles) {
+        ConvertSubtitlesBeside(basePath, true);
+    }
+    return true;
+}
+
+// Post-processing is CPU-bound, so it gets one worker per core, separate from the network slots
+std::deque<DownloadItem*> g_postQueue;
+int g_postWorkers = 0;
+std::mutex g_postMutex;
+
+// Worker thread that drains the post-processing queue
+DWORD WINAPI PostProcessThread(LPVOID lpParam) {
+    UNREFERENCED_PARAMETER(lpParam);
+    while (true) {
+        DownloadItem* item;
+        {
+            std::lock_guard<std::mutex> lock(g_postMutex);
+            if (g_postQueue.empty()) {
+                g_postWorkers--;
+                return 0;
+            }
+            item = g_postQueue.front();
+            g_postQueue.pop_front();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(g_queueMutex);
+            if (item->status == Cancelled) {
+                item->postProcessing = false;
+                continue;
+            }
+            item->status = Processing;
+        }
+        bool success = RunPostProcessing(item);
+        {
+            std::lock_guard<std::mutex> lock(g_queueMutex);
+            if (item->status != Cancelled) {
+                item->status = success ? Completed : Failed;
+            }
+            item->postProcessing = false;
+        }
+    }
+}
+
+// Hand a downloaded item to the post-processing pool
+void QueuePostProcessing(DownloadItem* item) {
+    std::lock_guard<std::mutex> lock(g_postMutex);
+    g_postQueue.push_back(item);
+
+    unsigned int cores = std::thread::hardware_concurrency();
+    int maxWorkers = cores > 0 ? (int)cores : 2;
+    if (g_postWorkers < maxWorkers) {
+        HANDLE hThread = CreateThread(NULL, 0, PostProcessThread, NULL, 0, NULL);
+        if (hThread) {
+            g_postWorkers++;
+            CloseHandle(hThread);
+        }
+    }
+}
+
+// Throttling detection. YouTube sometimes throttles a single stream URL to a crawl; a fresh
+// extraction gets a new URL at full speed. An item counts as throttled once its speed stays
+// below a fraction of the session's recent median for a while.
+const double kThrottleSpeedRatio = 0.2;
+const DWORD kThrottleWarmupMs = 15000;      // Ignore the slow start of every connection
+const DWORD kThrottleGraceMs = 30000;       // How long an item must stay slow before it is restarted
+const size_t kSpeedSampleCount = 120;       // Recent samples the median is taken over
+const size_t kMinSpeedSamples = 20;         // No verdicts until the session has this many samples
+const int kMaxThrottleRestarts = 3;
+
+std::deque<double> g_speedSamples;
+std::mutex g_speedMutex;
+std::atomic<int> g_throttleRestarts(0);     // Restarts across the session, shown in the Download Manager
+
+// Helper function to record a speed sample and return the median of the recent ones (0 if too few)
+double RecordSpeedSample(double speed) {
+    std::lock_guard<std::mutex> lock(g_speedMutex);
+    if (speed > 0) {
+        g_speedSamples.push_back(speed);
+        if (g_speedSamples.size() > kSpeedSampleCount) {
+            g_speedSamples.pop_front();
+        }
+    }
+    if (g_speedSamples.size() < kMinSpeedSamples) {
+        return 0;
+    }
+    std::vector<double> sorted(g_speedSamples.begin(), g_speedSamples.end());
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    return sorted[sorted.size() / 2];
+}
+
+// Segmented range downloads. When yt-dlp can resolve a job to plain HTTP URLs the host fetches
+// each one itself as byte ranges over several connections (see core/SegmentedTransfer.h).
+const int kSegmentRequestTimeoutMs = 30000;
+
+// A media stream yt-dlp resolved to a direct URL
+struct DirectMediaSource {
+    std::wstring url;
+    std::wstring headers;   // Request headers yt-dlp would send, "Name: value\r\n" each
+    std::wstring path;      // Stage file to write
+    long long size = 0;
+};
+
+// Helper function to split a URL into the parts WinHttpConnect and WinHttpOpenRequest take
+bool CrackHttpUrl(const std::wstring& url, std::wstring& host, INTERNET_PORT& port, bool& secure, std::wstring& object) {
+    URL_COMPONENTS parts = { sizeof(parts) };
+    parts.dwHostNameLength = (DWORD)-1;
+    parts.dwUrlPathLength = (DWORD)-1;
+    parts.dwExtraInfoLength = (DWORD)-1;
+    if (!WinHttpCrackUrl(url.c_str(), 0, 0, &parts)) {
+        return false;
+    }
+    host.assign(parts.lpszHostName, parts.dwHostNameLength);
+    object.assign(parts.lpszUrlPath, parts.dwUrlPathLength);
+    object.append(parts.lpszExtraInfo, parts.dwExtraInfoLength);
+    port = parts.nPort;
+    secure = parts.nScheme == INTERNET_SCHEME_HTTPS;
+    return true;
+}
+
+// Helper function to send a ranged GET; returns the request handle once a 206 response arrives
+HINTERNET OpenRangeRequest(HINTERNET hConnect, const std::wstring& object, bool secure, const std::wstring& headers,
+                           long long start, long long end) {
+    HINTERNET hRequest = WinHttpOpenRequest(hConnect, L"GET", object.c_str(), NULL, WINHTTP_NO_REFERER,
+                                            WINHTTP_DEFAULT_ACCEPT_TYPES, secure ? WINHTTP_FLAG_SECURE : 0);
+    if (!hRequest) {
+        return NULL;
+    }
+    WinHttpSetTimeouts(hRequest, kSegmentRequestTimeoutMs, kSegmentRequestTimeoutMs, kSegmentRequestTimeoutMs, kSegmentRequestTimeoutMs);
+    std::wstring requestHeaders = headers + L"Range: bytes=" + std::to_wstring(start) + L"-" + std::to_wstring(end - 1) + L"\r\n";
+    DWORD status = 0;
+    DWORD size = sizeof(status);
+    if (!WinHttpSendRequest(hRequest, requestHeaders.c_str(), (DWORD)-1L, WINHTTP_NO_REQUEST_DATA, 0, 0, 0) ||
+        !WinHttpReceiveResponse(hRequest, NULL) ||
+        !WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                             WINHTTP_HEADER_NAME_BY_INDEX, &status, &size, WINHTTP_NO_HEADER_INDEX) ||
+        status != 206) {
+        WinHttpCloseHandle(hRequest);
+        return NULL;
+    }
+    return hRequest;
+}
+
+// Helper function to read the total size from a "Content-Range: bytes 0-0/12345" response; 0 if unknown
+long long QueryRangeTotal(HINTERNET hRequest) {
+    wchar_t contentRange[128];
+    DWORD size = sizeof(contentRange);
+    if (!WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_CONTENT_RANGE, WINHTTP_HEADER_NAME_BY_INDEX,
+                             contentRange, &size, WINHTTP_NO_HEADER_INDEX)) {
+        return 0;
+    }
+    const wchar_t* slash = wcschr(contentRange, L'/');
+    return slash ? _wtoi64(slash + 1) : 0;
+}
+
+// Helper function to check that a server honours ranges for a URL and learn the file size
+bool ProbeRangeSupport(HINTERNET hSession, DirectMediaSource& source) {
+    std::wstring host, object;
+    INTERNET_PORT port;
+    bool secure;
+    if (!CrackHttpUrl(source.url, host, port, secure, object)) {
+        return false;
+    }
+    HINTERNET hConnect = WinHttpConnect(hSession, host.c_str(), port, 0);
+    if (!hConnect) {
+        return false;
+    }
+    HINTERNET hRequest = OpenRangeRequest(hConnect, object, secure, source.headers, 0, 1);
+    if (hRequest) {
+        source.size = QueryRangeTotal(hRequest);
+        WinHttpCloseHandle(hRequest);
+    }
+    WinHttpCloseHandle(hConnect);
+    return hRequest != NULL && source.size > 0;
+}
+
+// A native download records the ranges it has written beside the file, so an interrupted
+// download (app exit or crash) resumes with only the missing ranges
+std::wstring GetSegmentStatePath(const std::wstring& path) {
+    return path + L".ytpseg";
+}
+
+// Helper function to record the ranges of a transfer that are on disk
+void SaveSegmentState(SegmentScheduler& scheduler, const std::wstring& statePath) {
+    nlohmann::json j;
+    j["size"] = scheduler.Size();
+    j["done"] = nlohmann::json::array();
+    for (const auto& range : scheduler.Completed()) {
+        j["done"].push_back({ range.first, range.second });
+    }
+    std::wstring tempPath = statePath + L".tmp";
+    {
+        std::ofstream o(tempPath);
+        o << j.dump();
+        if (!o.good()) {
+            return;
+        }
+    }
+    if (!MoveFileExW(tempPath.c_str(), statePath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileW(tempPath.c_str());
+    }
+}
+
+// Helper function to read the recorded ranges of an interrupted download of the given size
+bool LoadSegmentState(const std::wstring& statePath, long long size, ByteRanges& done) {
+    std::ifstream i(statePath);
+    if (!i.good()) {
+        return false;
+    }
+    try {
+        nlohmann::json j;
+        i >> j;
+        if (j.value("size", 0LL) != size || !j.contains("done") || !j["done"].is_array()) {
+            return false;
+        }
+        for (const auto& range : j["done"]) {
+            long long start = range.at(0).get<long long>();
+            long long end = range.at(1).get<long long>();
+            if (start >= 0 && start < end && end <= size) {
+                done.push_back(std::make_pair(start, end));
+            }
+        }
+    }
+    catch (...) {
+        return false;
+    }
+    MergeRanges(done);
+    return true;
+}
+
+// One WinHTTP connection to a media server. A connection handle is logical: WinHTTP opens a
+// new socket underneath when the server dropped the last one.
+class WinHttpRangeConnection : public RangeConnection {
+public:
+    WinHttpRangeConnection(HINTERNET hConnect, const std::wstring& object, bool secure, const std::wstring& headers)
+        : hConnect(hConnect), hRequest(NULL), object(object), secure(secure), headers(headers) {}
+
+    ~WinHttpRangeConnection() override {
+        if (hRequest) {
+            WinHttpCloseHandle(hRequest);
+        }
+        WinHttpCloseHandle(hConnect);
+    }
+
+    bool Request(long long start, long long end) override {
+        if (hRequest) {
+            WinHttpCloseHandle(hRequest);
+        }
+        hRequest = OpenRangeRequest(hConnect, object, secure, headers, start, end);
+        return hRequest != NULL;
+    }
+
+    size_t Read(char* buffer, size_t size) override {
+        DWORD bytesRead = 0;
+        if (!hRequest || !WinHttpReadData(hRequest, buffer, (DWORD)size, &bytesRead)) {
+            return 0;
+        }
+        return bytesRead;
+    }
+
+private:
+    HINTERNET hConnect;
+    HINTERNET hRequest;
+    std::wstring object;
+    bool secure;
+    std::wstring headers;
+};
+
+// Fetch one stream as parallel ranges into a preallocated file.
+// bytesBefore and bytesTotal place this stream within the item's overall progress.
+// A paused download's file and range record are kept so the next attempt resumes it.
+bool SegmentedDownload(HINTERNET hSession, const DirectMediaSource& source, DownloadItem* item,
+                       long long bytesBefore, long long bytesTotal) {
+    std::wstring host, object;
+    INTERNET_PORT port;
+    bool secure;
+    if (!CrackHttpUrl(source.url, host, port, secure, object)) {
+        return false;
+    }
+
+    // Pick up where an earlier attempt stopped: queue only the gaps between the recorded ranges
+    SegmentScheduler scheduler(source.size);
+    std::wstring statePath = GetSegmentStatePath(source.path);
+    ByteRanges done;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    if (LoadSegmentState(statePath, source.size, done)) {
+        hFile = CreateFileW(source.path.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        LARGE_INTEGER existingSize;
+        if (hFile != INVALID_HANDLE_VALUE &&
+            (!GetFileSizeEx(hFile, &existingSize) || existingSize.QuadPart != source.size)) {
+            CloseHandle(hFile);
+            hFile = INVALID_HANDLE_VALUE;
+        }
+    }
+    if (hFile != INVALID_HANDLE_VALUE) {
+        scheduler.Resume(done);
+    }
+    else {
+        hFile = CreateFileW(source.path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hFile == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        fileSize.QuadPart = source.size;
+        if (!SetFilePointerEx(hFile, fileSize, NULL, FILE_BEGIN) || !SetEndOfFile(hFile)) {
+            CloseHandle(hFile);
+            DeleteFileW(source.path.c_str());
+            return false;
+        }
+    }
+
+    SegmentIo io;
+    io.connect = [&]() {
+        HINTERNET hConnect = WinHttpConnect(hSession, host.c_str(), port, 0);
+        return std::unique_ptr<RangeConnection>(hConnect ? new WinHttpRangeConnection(hConnect, object, secure, source.headers) : nullptr);
+    };
+    io.write = [&](long long offset, const char* data, size_t size) {
+        OVERLAPPED overlapped = { 0 };
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD written = 0;
+        return WriteFile(hFile, data, (DWORD)size, &written, &overlapped) && written == size;
+    };
+    // Workers never read the item; the transfer's controlling thread polls the status
+    io.stopped = [&]() { return PollDownloadStopped(item); };
+    io.onProgress = [&](long long bytesDone) {
+        item->progress = ((bytesBefore + bytesDone) * 100.0 / bytesTotal);
+    };
+    io.onInterval = [&](double rate) {
+        item->speed = rate;
+        SaveSegmentState(scheduler, statePath);
+    };
+    bool complete = RunSegmentedTransfer(scheduler, io);
+    CloseHandle(hFile);
+
+    if (complete || (scheduler.Stopped() && PollDownloadPaused(item))) {
+        // Record the final state; a finished stream keeps it until the item's other streams are done
+        SaveSegmentState(scheduler, statePath);
+    } else {
+        DeleteFileW(source.path.c_str());
+        DeleteFileW(statePath.c_str());
+    }
+    return complete;
+}
+
+// Ask yt-dlp which streams a job needs, without downloading. formatIds receives the selected
+// format IDs either way; the call only succeeds when every stream is a plain HTTP URL, since
+// manifests and fragmented formats are left to yt-dlp.
+bool ResolveDirectMediaSources(const std::wstring& arguments, std::vector<DirectMediaSource>& sources, std::wstring& formatIds) {
+    std::string output;
+    DWORD exitCode = 1;
+    if (!RunYtDlpCapture(L"-j --no-playlist --no-warnings" + arguments, output, exitCode) || exitCode != 0) {
+        return false;
+    }
+    // One JSON object per line, one line per stream the format selector picked
+    std::istringstream lines(output);
+    std::string line;
+    bool direct = true;
+    formatIds.clear();
+    while (std::getline(lines, line)) {
+        if (line.empty() || line[0] != '{') {
+            continue;
+        }
+        try {
+            auto j = nlohmann::json::parse(line);
+            if (!formatIds.empty()) {
+                formatIds += L",";
+            }
+            formatIds += Utf8ToWide(JsonString(j, "format_id"));
+            std::string protocol = JsonString(j, "protocol");
+            if ((protocol != "https" && protocol != "http") || !j.contains("url") || !j.contains("_filename")) {
+                direct = false;
+                continue;
+            }
+            DirectMediaSource source;
+            source.url = Utf8ToWide(JsonString(j, "url"));
+            source.path = Utf8ToWide(JsonString(j, "_filename"));
+            auto headers = j.find("http_headers");
+            if (headers != j.end() && headers->is_object()) {
+                for (auto it = headers->begin(); it != headers->end(); ++it) {
+                    if (it.value().is_string()) {
+                        source.headers += Utf8ToWide(it.key() + ": " + it.value().get<std::string>()) + L"\r\n";
+                    }
+                }
+            }
+            sources.push_back(source);
+        }
+        catch (...) {
+            return false;
+        }
+    }
+    return direct && !sources.empty();
+}
+
+// Download an item's streams natively. On success, files holds the stage files for post-processing;
+// on failure nothing is left behind and the caller falls back to yt-dlp. A paused download keeps
+// its files and range records for the next attempt; a cancelled one leaves nothing behind either.
+bool DownloadDirectMedia(DownloadItem* item, const std::wstring& resolveArguments, std::vector<std::wstring>& files) {
+    std::vector<DirectMediaSource> sources;
+    std::wstring formatIds;
+    bool direct = ResolveDirectMediaSources(resolveArguments, sources, formatIds);
+    if (!formatIds.empty()) {
+        // Recorded in queue.json, so a resumed download asks for the same streams its partial files hold
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        item->formatIds = formatIds;
+    }
+    if (!direct) {
+        return false;
+    }
+
+    HINTERNET hSession = WinHttpOpen(L"Mozilla/5.0", WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY,
+                                     WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+    if (!hSession) {
+        return false;
+    }
+    // Check every stream first, so progress covers the whole item and nothing starts that can't finish
+    long long total = 0;
+    bool success = true;
+    for (auto& source : sources) {
+        if (!ProbeRangeSupport(hSession, source)) {
+            success = false;
+            break;
+        }
+        total += source.size;
+    }
+
+    long long done = 0;
+    for (size_t i = 0; success && i < sources.size(); i++) {
+        success = SegmentedDownload(hSession, sources[i], item, done, total) && !PollDownloadStopped(item);
+        if (success) {
+            files.push_back(sources[i].path);
+            done += sources[i].size;
+        }
+    }
+    WinHttpCloseHandle(hSession);
+
+    if (success) {
+        for (const auto& source : sources) {
+            DeleteFileW(GetSegmentStatePath(source.path).c_str());
+        }
+    }
+    else {
+        // The stream that was stopped part way cleaned up after itself; this covers the finished ones
+        if (!PollDownloadPaused(item)) {
+            for (const auto& file : files) {
+                DeleteFileW(file.c_str());
+                DeleteFileW(GetSegmentStatePath(file).c_str());
+            }
+        }
+        files.clear();
+    }
+    return success;
+}
+
+// Hand a finished download stage on: its streams go to post-processing, otherwise the item is done
+DWORD FinishDownloadStage(DownloadItem* item, bool success, const std::vector<std::wstring>& stageFiles) {
+    // Hand the streams to the post-processing stage; the download slot is free from here on
+    if (success && !stageFiles.empty()) {
+        bool ownedByQueue;
+        {
+            std::lock_guard<std::mutex> lock(g_queueMutex);
+            if (IsDownloadStopped(item)) {
+                return 1;
+            }
+            item->stageFiles = stageFiles;
+            ownedByQueue = item->progressDlg == NULL;
+            item->status = ownedByQueue ? WaitingToProcess : Processing;
+            item->postProcessing = ownedByQueue;
+        }
+        if (ownedByQueue) {
+            QueuePostProcessing(item);
+            return 0;
+        }
+        // The progress dialog deletes its item once it sees a final status, so it is processed here
+        success = RunPostProcessing(item);
+    }
+
+    // Update item status if not already cancelled
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        if (!IsDownloadStopped(item)) {
+            item->status = success ? Completed : Failed;
+        }
+    }
+
+    return success ? 0 : 1;
+}
+
+// Run yt-dlp for a download item and capture its output
+DWORD RunDownload(DownloadItem* item) {
+    if (!item) {
+        // Invalid parameter
+        return 1;
+    }
+    
+    // Make sure URL is not empty
+    if (item->url.empty()) {
+        item->status = Failed;
+        return 1;
+    }
+    
+    // Construct the command with user-selected options
+    std::wstring command;
+    std::wstring infoJsonPath;
+    std::wstring cookiePath;
+    std::wstring resolveArguments; // For the native downloader; empty when the job needs yt-dlp itself
+    try {
+        // Get full path to yt-dlp.exe
+        wchar_t exePath[MAX_PATH];
+        GetModuleFileNameW(NULL, exePath, MAX_PATH);
+        std::wstring exeDir = exePath;
+        size_t pos = exeDir.find_last_of(L"\\/");
+        std::wstring ytdlpPath = L"yt-dlp.exe";
+        if (pos != std::wstring::npos) {
+            ytdlpPath = L"\"" + exeDir.substr(0, pos) + L"\\yt-dlp.exe\"";
+        }
+
+        VideoInfoPtr info = GetCachedVideoInfo(GetWatchVideoId(item->url));
+        PostProcessPlan plan = PlanPostProcessing(item->resolution, info.get(), !item->sections.empty());
+        {
+            std::lock_guard<std::mutex> lock(g_queueMutex);
+            item->plan = plan.description;
+            if (item->throttleRestarts > 0) {
+                item->plan += L", restarted " + std::to_wstring(item->throttleRestarts) + L"x after throttling";
+            }
+            item->targetExt = plan.targetExt;
+            item->stageFiles.clear();
+        }
+        // A resumed item asks for the streams it was downloading, so the partial files still match
+        std::wstring formatArguments = plan.arguments;
+        if (item->resumed && !item->formatIds.empty() && !plan.targetExt.empty()) {
+            formatArguments = L" -f " + QuoteArgument(item->formatIds);
+        }
+        command = ytdlpPath + L" --progress --newline --no-playlist --no-check-certificates --encoding utf-8" + formatArguments;
+        if (!plan.targetExt.empty()) {
+            // Download stage only: yt-dlp fetches the streams and reports where it put them
+            command += L" --no-simulate --print \"after_move:" + Utf8ToWide(kStageFileMarker) + L"%(format_id)s %(filepath)s\"";
+        }
+
+        // Time ranges are passed with yt-dlp's "*" prefix; anything else is matched against chapter titles
+        for (const auto& section : SplitSections(item->sections)) {
+            double start, end;
+            std::wstring spec = ParseTimeRange(section, start, end) ? L"*" + section : section;
+            command += L" --download-sections " + QuoteArgument(spec);
+        }
+
+        if (item->downloadSubtitles) {
+            command += L" --write-auto-sub";
+        }
+
+        std::wstring path = item->path;
+        if (path.empty()) {
+            // Default to Documents folder if path is empty
+            PWSTR documentsPath = nullptr;
+            if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_Documents, 0, nullptr, &documentsPath))) {
+                path = documentsPath;
+                CoTaskMemFree(documentsPath);
+            }
+        }
+        
+        if (!path.empty() && path.back() != L'\\' && path.back() != L'/') {
+            path += L'\\';
+        }
+        
+        // Create the output directory if it doesn't exist
+        CreateDirectoryW(path.c_str(), NULL);
+        
+        if (!item->archivePath.empty()) {
+            command += L" --download-archive " + QuoteArgument(item->archivePath);
+        }
+        
+        // Streams get the format ID in their name so a video and its audio never collide,
+        // and each section gets its range so several sections of one video don't overwrite each other
+        std::wstring stageTemplate = item->outputTemplate;
+        size_t extPos = stageTemplate.rfind(L".%(ext)s");
+        if (extPos != std::wstring::npos) {
+            if (!item->sections.empty()) {
+                stageTemplate.insert(extPos, L" [%(section_start)d-%(section_end)d]");
+            }
+            else if (!plan.targetExt.empty()) {
+                stageTemplate.insert(extPos, L".f%(format_id)s");
+            }
+        }
+        command += L" -o " + QuoteArgument(path + stageTemplate);
+
+        // Start from the info JSON a recent probe saved, so yt-dlp doesn't extract the page again
+        infoJsonPath = item->skipInfoJsonCache ? L"" : GetFreshInfoJsonPath(GetWatchVideoId(item->url));
+        if (!infoJsonPath.empty()) {
+            command += L" --load-info-json " + QuoteArgument(infoJsonPath);
+        } else {
+            command += L" " + QuoteArgument(item->url);
+        }
+
+        // Sign-in and consent cookies from the browser session unlock members-only and age-gated videos
+        cookiePath = CopyCookieFileForRun();
+        if (!cookiePath.empty()) {
+            command += L" --cookies " + QuoteArgument(cookiePath);
+        }
+
+        // Whole streams headed for post-processing can be fetched natively. Subtitles and the
+        // download archive are only written by yt-dlp, so those jobs stay with it.
+        if (!plan.targetExt.empty() && !item->downloadSubtitles && item->archivePath.empty()) {
+            resolveArguments = formatArguments + L" -o " + QuoteArgument(path + stageTemplate);
+            if (!cookiePath.empty()) {
+                resolveArguments += L" --cookies " + QuoteArgument(cookiePath);
+            }
+            resolveArguments += infoJsonPath.empty() ? L" " + QuoteArgument(item->url) : L" --load-info-json " + QuoteArgument(infoJsonPath);
+        }
+        
+        // Log the command for debugging purposes
+        OutputDebugStringW((L"Running command: " + command).c_str());
+    }
+    catch (...) {
+        // Error constructing command
+        if (!cookiePath.empty()) {
+            DeleteFileW(cookiePath.c_str());
+        }
+        item->status = Failed;
+        return 1;
+    }
+
+    if (!resolveArguments.empty()) {
+        std::vector<std::wstring> nativeFiles;
+        if (DownloadDirectMedia(item, resolveArguments, nativeFiles)) {
+            if (!cookiePath.empty()) {
+                DeleteFileW(cookiePath.c_str());
+            }
+            return FinishDownloadStage(item, true, nativeFiles);
+        }
+        if (PollDownloadStopped(item)) {
+            if (!cookiePath.empty()) {
+                DeleteFileW(cookiePath.c_str());
+            }
+            return 1;
+        }
+        item->progress = 0; // Start over with yt-dlp's own downloader
+    }
+
+    bool success = false;
+    bool throttled = false;
+    std::vector<std::wstring> stageFiles;
+    std::vector<std::wstring> subtitleFiles;
+
+    // yt-dlp and the ffmpeg processes it starts run as one tree, so their CPU time can be totalled.
+    // The tree dies with the app, leaving a .part file the next run resumes rather than an orphan process.
+    // Errors share the output pipe, so a chatty stderr can't fill up while nobody reads it.
+    ProcessOptions options;
+    options.workingDirectory = WideToUtf8(GetAppDirectory());
+    options.errors = ErrorsToOutput;
+    ChildProcess process;
+    bool processStarted = process.Start(WideToUtf8(command), options);
+    DWORD lastError = processStarted ? 0 : GetLastError();
+    
+    if (processStarted) {
+        {
+            // The control API and the progress dialog kill it through the item, under this lock
+            std::lock_guard<std::mutex> lock(g_queueMutex);
+            item->process = &process;
+            if (IsDownloadStopped(item)) {
+                process.Kill();
+            }
+        }
+        item->speed = 0;
+        DWORD processStart = GetTickCount();
+        DWORD lastSample = 0;
+        DWORD slowSince = 0;
+        
+        char buffer[256];
+        std::string full_output;
+        std::string error_output;
+        LineAccumulator progressLines;
+        
+        // Read process output with better error handling
+        try {
+            while (true) {
+                // Check if download was cancelled
+                if (PollDownloadStopped(item)) {
+                    break;
+                }
+                
+                // Wait a moment for output, so a cancel is noticed even while yt-dlp is quiet
+                int bytesRead = process.ReadOutput(buffer, sizeof(buffer), 100);
+                if (bytesRead == kProcessReadClosed) {
+                    break;
+                }
+                if (bytesRead > 0) {
+                    full_output.append(buffer, bytesRead);
+                    
+                    // A read can end part way through a line, so progress is parsed from complete lines only
+                    progressLines.Append(buffer, bytesRead, [&](const std::string& line) {
+                        double progress = ParseProgressPercent(line);
+                        if (progress >= 0) {
+                            item->progress = progress;
+                        }
+                        double speed = ParseProgressSpeed(line);
+                        if (speed > 0) {
+                            item->speed = speed;
+                        }
+                        if (line.compare(0, 6, "ERROR:") == 0 || line.compare(0, 8, "WARNING:") == 0) {
+                            error_output += line + "\n";
+                        }
+                    });
+                }
+
+                // Sample the speed once a second and restart the item if it has stayed throttled
+                DWORD now = GetTickCount();
+                if (item->speed > 0 && now - lastSample >= 1000 && now - processStart >= kThrottleWarmupMs) {
+                    lastSample = now;
+                    double median = RecordSpeedSample(slowSince ? 0 : item->speed.load());
+                    if (median > 0 && item->speed < median * kThrottleSpeedRatio) {
+                        if (!slowSince) {
+                            slowSince = now;
+                        }
+                        else if (now - slowSince >= kThrottleGraceMs && item->throttleRestarts < kMaxThrottleRestarts) {
+                            throttled = true;
+                            process.Kill();
+                            break;
+                        }
+                    }
+                    else {
+                        slowSince = 0;
+                    }
+                }
+            }
+            
+            // Drain whatever the process wrote before it exited
+            if (!PollDownloadStopped(item)) {
+                int bytesRead;
+                while ((bytesRead = process.ReadOutput(buffer, sizeof(buffer))) > 0) {
+                    full_output.append(buffer, bytesRead);
+                }
+            }
+
+            // Collect the stream files for the post-processing stage and any subtitle files written
+            size_t lineStart = 0;
+            while (lineStart < full_output.size()) {
+                size_t lineEnd = full_output.find('\n', lineStart);
+                if (lineEnd == std::string::npos) lineEnd = full_output.size();
+                std::string line = full_output.substr(lineStart, lineEnd - lineStart);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (line.compare(0, strlen(kSubtitleFileMarker), kSubtitleFileMarker) == 0) {
+                    subtitleFiles.push_back(Utf8ToWide(line.substr(strlen(kSubtitleFileMarker))));
+                }
+                else if (line.compare(0, strlen(kStageFileMarker), kStageFileMarker) == 0) {
+                    size_t space = line.find(' ', strlen(kStageFileMarker));
+                    if (space != std::string::npos) {
+                        std::wstring file = Utf8ToWide(line.substr(space + 1));
+                        if (std::find(stageFiles.begin(), stageFiles.end(), file) == stageFiles.end()) {
+                            stageFiles.push_back(file);
+                        }
+                    }
+                }
+                lineStart = lineEnd + 1;
+            }
+
+            // If we have error output and the download failed, show it
+            if (!error_output.empty()) {
+                // Only log error output, don't show message box here to avoid UI blocks
+                OutputDebugStringA(("yt-dlp error output:\n" + error_output).c_str());
+            }
+        }
+        catch (...) {
+            // Reading output failed, but we'll continue to check the exit code
+        }
+        
+        // Get process exit code to determine success
+        process.Wait();
+        success = process.ExitCode() == 0;
+        {
+            std::lock_guard<std::mutex> lock(g_queueMutex);
+            item->process = nullptr;
+            item->cpuSeconds += process.CpuSeconds();
+        }
+    }
+    else {
+        // Log the error for debugging
+        std::wstring errorMsg = L"Failed to start yt-dlp process. Error code: " + std::to_wstring(lastError);
+        errorMsg += L"\nCommand: " + command;
+        OutputDebugStringW(errorMsg.c_str());
+    }
+    if (!cookiePath.empty()) {
+        DeleteFileW(cookiePath.c_str());
+    }
+
+    // A throttled stream URL is abandoned for a fresh extraction; yt-dlp resumes from the .part file
+    if (throttled && !PollDownloadStopped(item)) {
+        if (!infoJsonPath.empty()) {
+            DeleteFileW(infoJsonPath.c_str());
+            item->skipInfoJsonCache = true; // Its stream URLs are the throttled ones
+        }
+        item->throttleRestarts++;
+        g_throttleRestarts++;
+        item->speed = 0;
+        return RunDownload(item);
+    }
+
+    // Cached format URLs may have expired early; drop the cache entry and extract from the URL instead.
+    // The retry skips the cache even if the file can't be deleted, so this happens at most once.
+    if (!success && !infoJsonPath.empty() && !PollDownloadStopped(item)) {
+        DeleteFileW(infoJsonPath.c_str());
+        item->skipInfoJsonCache = true;
+        item->progress = 0;
+        return RunDownload(item);
+    }
+
+    // The pinned formats may no longer be offered; choose again from the resolution
+    if (!success && item->resumed && !PollDownloadStopped(item)) {
+        item->resumed = false;
+        item->progress = 0;
+        return RunDownload(item);
+    }
+
+    // WebVTT is cheap to convert, so it is done right here rather than in the post-processing stage
+    if (success) {
+        bool srt = item->resolution != kSubtitlesOnlyText;
+        for (const auto& file : subtitleFiles) {
+            if (GetFileExtension(file) == L"vtt") {
+                ConvertVttFile(file, srt);
+            }
+        }
+    }
+
+    return FinishDownloadStage(item, success, stageFiles);
+}
+
+// Thread function to run yt-dlp and capture its output
+DWORD WINAPI DownloadThread(LPVOID lpParam) {
+    DownloadItem* item = (DownloadItem*)lpParam;
+    DWORD result = RunDownload(item);
+    
+    bool release;
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        item->running = false;
+        release = item->releaseOnExit;
+        // A resume that arrived while this thread was still stopping can start now
+        if (item->resumeRequested) {
+            item->resumeRequested = false;
+            if (item->status == Paused) {
+                item->status = Queued;
+                item->resumed = true;
+            }
+        }
+    }
+    if (release) {
+        delete item;
+    }
+    
+    // Hand the slot to the next queued download
+    StartQueuedDownloads();
+    
+    return result;
+}
+
+// Unfinished queue items are saved to queue.json while the app runs and restored at startup
+std::string g_savedQueue;   // Contents last written, so an unchanged queue isn't rewritten
+const UINT_PTR kQueueSaveTimerId = 1;
+
+// Helper function to save every unfinished queue item. Runs on the UI thread.
+void SaveDownloadQueue() {
+    nlohmann::json j;
+    j["items"] = nlohmann::json::array();
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        for (const auto* item : g_downloadQueue) {
+            if (item->status == Completed || item->status == Failed || item->status == Cancelled) {
+                continue;
+            }
+            nlohmann::json i;
+            i["url"] = WideToUtf8(item->url);
+            i["resolution"] = WideToUtf8(item->resolution);
+            i["path"] = WideToUtf8(item->path);
+            i["downloadSubtitles"] = item->downloadSubtitles;
+            i["outputTemplate"] = WideToUtf8(item->outputTemplate);
+            i["archivePath"] = WideToUtf8(item->archivePath);
+            i["title"] = WideToUtf8(item->title);
+            i["sections"] = WideToUtf8(item->sections);
+            i["estimatedSize"] = item->estimatedSize;
+            i["formatIds"] = WideToUtf8(item->formatIds);
+            i["progress"] = (int)item->progress;
+            i["paused"] = item->status == Paused && !item->resumeRequested;
+            // Streams waiting for post-processing are complete; only that stage has to run again
+            if (item->status == WaitingToProcess || item->status == Processing) {
+                i["targetExt"] = WideToUtf8(item->targetExt);
+                i["stageFiles"] = nlohmann::json::array();
+                for (const auto& file : item->stageFiles) {
+                    i["stageFiles"].push_back(WideToUtf8(file));
+                }
+            }
+            j["items"].push_back(i);
+        }
+    }
+
+    std::string contents = j.dump(4);
+    if (contents == g_savedQueue) {
+        return;
+    }
+    std::wstring queuePath = GetAppDataFilePath(L"queue.json");
+    if (queuePath.empty()) {
+        return;
+    }
+    // Write beside the target and swap it in, so a crash mid-write can't lose the queue
+    std::wstring tempPath = queuePath + L".tmp";
+    {
+        std::ofstream o(tempPath);
+        o << contents << std::endl;
+        if (!o.good()) {
+            return;
+        }
+    }
+    if (MoveFileExW(tempPath.c_str(), queuePath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        g_savedQueue = contents;
+    } else {
+        DeleteFileW(tempPath.c_str());
+    }
+}
+
+// Helper function to restore the unfinished downloads of the previous session and start them.
+// yt-dlp resumes its .part files and the native downloader its recorded ranges.
+void LoadDownloadQueue() {
+    std::wstring queuePath = GetAppDataFilePath(L"queue.json");
+    if (queuePath.empty()) {
+        return;
+    }
+    std::ifstream i(queuePath);
+    if (!i.good()) {
+        return;
+    }
+
+    std::vector<DownloadItem*> postProcess;
+    try {
+        nlohmann::json j;
+        i >> j;
+        if (!j.contains("items") || !j["items"].is_array()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        for (const auto& entry : j["items"]) {
+            DownloadItem* item = new DownloadItem();
+            item->id = g_nextDownloadId++;
+            item->url = Utf8ToWide(JsonString(entry, "url"));
+            item->resolution = Utf8ToWide(JsonString(entry, "resolution"));
+            item->path = Utf8ToWide(JsonString(entry, "path"));
+            item->downloadSubtitles = entry.value("downloadSubtitles", false);
+            item->status = Queued;
+            item->progress = entry.value("progress", 0);
+            item->process = nullptr;
+            item->hThread = NULL;
+            item->threadId = 0;
+            item->progressDlg = NULL;
+            item->startTime = 0;
+            std::string outputTemplate = JsonString(entry, "outputTemplate");
+            if (!outputTemplate.empty()) {
+                item->outputTemplate = Utf8ToWide(outputTemplate);
+            }
+            item->archivePath = Utf8ToWide(JsonString(entry, "archivePath"));
+            item->title = Utf8ToWide(JsonString(entry, "title"));
+            item->sections = Utf8ToWide(JsonString(entry, "sections"));
+            item->estimatedSize = entry.value("estimatedSize", 0.0);
+            item->formatIds = Utf8ToWide(JsonString(entry, "formatIds"));
+            item->resumed = true;
+            if (entry.value("paused", false)) {
+                item->status = Paused;
+            }
+            if (item->url.empty()) {
+                delete item;
+                continue;
+            }
+
+            // Post-processing can pick up again if every stream is still there
+            if (entry.contains("stageFiles") && entry["stageFiles"].is_array() && !entry["stageFiles"].empty()) {
+                item->targetExt = Utf8ToWide(JsonString(entry, "targetExt"));
+                bool present = !item->targetExt.empty();
+                for (const auto& file : entry["stageFiles"]) {
+                    std::wstring stageFile = file.is_string() ? Utf8ToWide(file.get<std::string>()) : L"";
+                    present = present && GetFileAttributesW(stageFile.c_str()) != INVALID_FILE_ATTRIBUTES;
+                    item->stageFiles.push_back(stageFile);
+                }
+                if (present) {
+                    item->status = WaitingToProcess;
+                    item->postProcessing = true;
+                    postProcess.push_back(item);
+                } else {
+                    item->stageFiles.clear();
+                }
+            }
+            g_downloadQueue.push_back(item);
+        }
+    }
+    catch (...) {
+        // A damaged queue file just means nothing is resumed
+    }
+
+    for (DownloadItem* item : postProcess) {
+        QueuePostProcessing(item);
+    }
+    StartQueuedDownloads();
+}
+
+// Local control API. Scripts enqueue and manage downloads over HTTP/JSON on 127.0.0.1:
+//   GET  /api/downloads               all queue items
+//   GET  /api/downloads/{id}          one item
+//   POST /api/downloads               {"url" or "urls", "resolution", "path", "subtitles", "sections"}
+//   POST /api/downloads/{id}/pause    also /resume and /cancel
+//   GET  /api/events                  server-sent "progress" events with the items that changed
+// Handlers read the scheduler's queue directly; nothing goes through the UI thread.
+const int kMaxApiConnections = 64;
+const size_t kMaxApiRequestBytes = 1024 * 1024;
+const DWORD kApiEventIntervalMs = 500;
+const DWORD kApiHeartbeatMs = 15000;
+SOCKET g_apiListenSocket = INVALID_SOCKET;
+std::atomic<int> g_apiConnections(0);
+
+// Helper function to get the status name the API reports
+const char* GetDownloadStatusKey(DownloadStatus status) {
+    switch (status) {
+    case Queued: return "queued";
+    case Downloading: return "downloading";
+    case WaitingToProcess: return "waiting";
+    case Processing: return "processing";
+    case Completed: return "completed";
+    case Failed: return "failed";
+    case Cancelled: return "cancelled";
+    case Paused: return "paused";
+    }
+    return "";
+}
+
+// Fields of a queue item as the API reports them, copied out under the queue lock
+struct ApiItemSnapshot {
+    int id;
+    DownloadStatus status;
+    double progress;
+    double speed;
+    std::wstring url;
+    std::wstring title;
+    std::wstring resolution;
+    std::wstring path;
+};
+
+// Helper function to copy the queue (or one item of it, when id is non-zero) for a response
+void SnapshotDownloads(int id, std::vector<ApiItemSnapshot>& items) {
+    std::lock_guard<std::mutex> lock(g_queueMutex);
+    items.reserve(id ? 1 : g_downloadQueue.size());
+    for (const auto* item : g_downloadQueue) {
+        if (id && item->id != id) {
+            continue;
+        }
+        items.push_back({ item->id, item->status, item->status == Completed ? 100.0 : item->progress,
+                          item->status == Downloading ? item->speed.load() : 0, item->url, item->title, item->resolution, item->path });
+    }
+}
+
+// Helper function to describe a snapshot as JSON
+nlohmann::json ApiItemJson(const ApiItemSnapshot& item) {
+    nlohmann::json j;
+    j["id"] = item.id;
+    j["status"] = GetDownloadStatusKey(item.status);
+    j["progress"] = item.progress;
+    j["speed"] = item.speed;
+    j["url"] = WideToUtf8(item.url);
+    j["title"] = WideToUtf8(item.title);
+    j["resolution"] = WideToUtf8(item.resolution);
+    j["path"] = WideToUtf8(item.path);
+    return j;
+}
+
+// Pause, resume or cancel a queue item; returns the HTTP status for the outcome
+int ControlDownload(int id, const std::string& action) {
+    bool start = false;
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        auto it = std::find_if(g_downloadQueue.begin(), g_downloadQueue.end(),
+                               [id](const DownloadItem* item) { return item->id == id; });
+        if (it == g_downloadQueue.end()) {
+            return 404;
+        }
+        DownloadItem* item = *it;
+        if (action == "pause") {
+            if (item->status != Queued && item->status != Downloading) {
+                return 409;
+            }
+            // The partial file stays; resuming continues it
+            item->status = Paused;
+        }
+        else if (action == "resume") {
+            if (item->status != Paused) {
+                return 409;
+            }
+            if (item->running) {
+                // The old thread may still be tearing down its process, segment workers or a
+                // retry; it moves the item back to Queued once it has exited
+                item->resumeRequested = true;
+                return 200;
+            }
+            item->status = Queued;
+            item->resumed = true; // Ask for the streams the partial files hold
+            start = true;
+        }
+        else if (action == "cancel") {
+            if (item->status == Completed || item->status == Failed || item->status == Cancelled) {
+                return 409;
+            }
+            item->status = Cancelled;
+        }
+        else {
+            return 404;
+        }
+        // The download thread clears process under this lock before it goes away
+        if (item->status != Queued && item->process) {
+            item->process->Kill();
+        }
+    }
+    if (start) {
+        StartQueuedDownloads();
+    }
+    return 200;
+}
+
+// Helper function to check an API field for quotes and control characters, which have no
+// place in a URL, a folder or a section list but could end or extend a command line argument
+bool HasUnsafeArgumentCharacters(const std::wstring& text) {
+    for (wchar_t c : text) {
+        if (c == L'"' || c < 0x20 || c == 0x7F) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Helper function to check for an existing folder given as "X:\..." or "\\server\share\..."
+bool IsAbsoluteDirectory(const std::wstring& path) {
+    bool drive = path.size() >= 3 && iswalpha(path[0]) && path[1] == L':' && (path[2] == L'\\' || path[2] == L'/');
+    bool unc = path.size() >= 3 && path[0] == L'\\' && path[1] == L'\\';
+    if (!drive && !unc) {
+        return false;
+    }
+    DWORD attributes = GetFileAttributesW(path.c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+// Enqueue the URLs of a POST /api/downloads body; returns the new item IDs
+bool EnqueueFromApi(const std::string& body, nlohmann::json& ids, std::string& error) {
+    nlohmann::json request;
+    try {
+        request = nlohmann::json::parse(body);
+    }
+    catch (...) {
+        error = "Request body is not valid JSON";
+        return false;
+    }
+    if (!request.is_object()) {
+        error = "Request body must be a JSON object";
+        return false;
+    }
+
+    std::vector<std::wstring> urls;
+    if (request.contains("url") && request["url"].is_string()) {
+        urls.push_back(Utf8ToWide(request["url"].get<std::string>()));
+    }
+    if (request.contains("urls") && request["urls"].is_array()) {
+        for (const auto& url : request["urls"]) {
+            if (url.is_string()) {
+                urls.push_back(Utf8ToWide(url.get<std::string>()));
+            }
+        }
+    }
+    for (const auto& url : urls) {
+        if (!IsYouTubeUrl(url) || HasUnsafeArgumentCharacters(url)) {
+            error = "Not a YouTube URL: " + WideToUtf8(url);
+            return false;
+        }
+    }
+    if (urls.empty()) {
+        error = "Expected \"url\" or \"urls\"";
+        return false;
+    }
+
+    DownloadOptions options;
+    options.hDlg = NULL;
+    options.resolution = Utf8ToWide(JsonString(request, "resolution"));
+    if (options.resolution.empty()) {
+        options.resolution = L"Best";
+    }
+    options.path = Utf8ToWide(JsonString(request, "path"));
+    if (!options.path.empty() && (HasUnsafeArgumentCharacters(options.path) || !IsAbsoluteDirectory(options.path))) {
+        error = "\"path\" must be an existing folder given as an absolute path";
+        return false;
+    }
+    options.downloadSubtitles = request.value("subtitles", false);
+    options.sections = Utf8ToWide(JsonString(request, "sections"));
+    if (HasUnsafeArgumentCharacters(options.sections)) {
+        error = "\"sections\" must not contain quotes or control characters";
+        return false;
+    }
+
+    ids = nlohmann::json::array();
+    for (const auto& url : urls) {
+        ids.push_back(EnqueueDownload(url, options)->id);
+    }
+    return true;
+}
+
+// Helper function to send a whole buffer on a socket
+bool SendAll(SOCKET s, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int result = send(s, data.data() + sent, (int)(data.size() - sent), 0);
+        if (result <= 0) {
+            return false;
+        }
+        sent += result;
+    }
+    return true;
+}
+
+// Helper function to send a JSON response
+bool SendJsonResponse(SOCKET s, int status, const std::string& body) {
+    const char* reason = status == 200 ? "OK" : status == 201 ? "Created" : status == 400 ? "Bad Request" :
+                         status == 403 ? "Forbidden" : status == 404 ? "Not Found" : status == 409 ? "Conflict" :
+                         status == 413 ? "Payload Too Large" : "Service Unavailable";
+    std::string response = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n"
+                           "Content-Type: application/json\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Cache-Control: no-store\r\n\r\n" + body;
+    return SendAll(s, response);
+}
+
+// Stream progress events until the client goes away. Only items whose status or rounded
+// progress changed since the last event are sent.
+void ServeApiEvents(SOCKET s) {
+    if (!SendAll(s, "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-store\r\n\r\n")) {
+        return;
+    }
+    std::unordered_map<int, std::pair<DownloadStatus, int>> sent;
+    DWORD lastSend = GetTickCount();
+    while (true) {
+        std::vector<ApiItemSnapshot> items;
+        SnapshotDownloads(0, items);
+        nlohmann::json changed = nlohmann::json::array();
+        for (const auto& item : items) {
+            auto state = std::make_pair(item.status, (int)(item.progress * 10));
+            auto it = sent.find(item.id);
+            if (it == sent.end() || it->second != state) {
+                sent[item.id] = state;
+                changed.push_back(ApiItemJson(item));
+            }
+        }
+
+        DWORD now = GetTickCount();
+        if (!changed.empty()) {
+            if (!SendAll(s, "event: progress\ndata: " + changed.dump() + "\n\n")) {
+                return;
+            }
+            lastSend = now;
+        }
+        else if (now - lastSend >= kApiHeartbeatMs) {
+            // A comment line; it keeps proxies from timing out and tells us when the client is gone
+            if (!SendAll(s, ": keep-alive\n\n")) {
+                return;
+            }
+            lastSend = now;
+        }
+        Sleep(kApiEventIntervalMs);
+    }
+}
+
+// Route one request; returns false if the connection should be closed
+bool HandleApiRequest(SOCKET s, const std::string& method, const std::string& target, const std::string& body) {
+    std::string path = target.substr(0, target.find('?'));
+    if (path == "/api/events" && method == "GET") {
+        ServeApiEvents(s);
+        return false;
+    }
+
+    if (path == "/api/downloads") {
+        if (method == "GET") {
+            std::vector<ApiItemSnapshot> items;
+            SnapshotDownloads(0, items);
+            nlohmann::json j = nlohmann::json::array();
+            for (const auto& item : items) {
+                j.push_back(ApiItemJson(item));
+            }
+            return SendJsonResponse(s, 200, j.dump());
+        }
+        if (method == "POST") {
+            nlohmann::json ids;
+            std::string error;
+            if (!EnqueueFromApi(body, ids, error)) {
+                return SendJsonResponse(s, 400, nlohmann::json({ { "error", error } }).dump());
+            }
+            return SendJsonResponse(s, 201, nlohmann::json({ { "ids", ids } }).dump());
+        }
+    }
+
+    // /api/downloads/{id} and /api/downloads/{id}/{action}
+    const std::string prefix = "/api/downloads/";
+    if (path.compare(0, prefix.size(), prefix) == 0) {
+        std::string rest = path.substr(prefix.size());
+        size_t slash = rest.find('/');
+        int id = atoi(rest.substr(0, slash).c_str());
+        if (id > 0 && slash == std::string::npos && method == "GET") {
+            std::vector<ApiItemSnapshot> items;
+            SnapshotDownloads(id, items);
+            if (items.empty()) {
+                return SendJsonResponse(s, 404, "{\"error\":\"No such download\"}");
+            }
+            return SendJsonResponse(s, 200, ApiItemJson(items[0]).dump());
+        }
+        if (id > 0 && slash != std::string::npos && method == "POST") {
+            int status = ControlDownload(id, rest.substr(slash + 1));
+            return SendJsonResponse(s, status, status == 200 ? "{}" : status == 404 ? "{\"error\":\"Not found\"}" :
+                                                 "{\"error\":\"Not possible in the download's current state\"}");
+        }
+    }
+    return SendJsonResponse(s, 404, "{\"error\":\"Not found\"}");
+}
+
+// Thread serving one keep-alive connection
+DWORD WINAPI ApiConnectionThread(LPVOID lpParam) {
+    SOCKET s = (SOCKET)lpParam;
+    DWORD timeout = 30000; // Idle keep-alive connections are dropped after this
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+    std::string buffer;
+    char chunk[4096];
+    bool open = true;
+    while (open) {
+        // Read the request head
+        size_t headerEnd;
+        while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+            int received = recv(s, chunk, sizeof(chunk), 0);
+            if (received <= 0 || buffer.size() > kMaxApiRequestBytes) {
+                open = false;
+                break;
+            }
+            buffer.append(chunk, received);
+        }
+        if (!open) {
+            break;
+        }
+
+        std::istringstream head(buffer.substr(0, headerEnd));
+        std::string method, target, version, line;
+        head >> method >> target >> version;
+        std::getline(head, line);
+        size_t contentLength = 0;
+        bool keepAlive = version == "HTTP/1.1";
+        bool fromBrowser = false;
+        while (std::getline(head, line)) {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            std::string name = line.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            std::string value = line.substr(colon + 1);
+            value.erase(0, value.find_first_not_of(' '));
+            if (!value.empty() && value.back() == '\r') value.pop_back();
+            if (name == "content-length") {
+                contentLength = strtoul(value.c_str(), nullptr, 10);
+            }
+            else if (name == "connection") {
+                std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+                keepAlive = value == "keep-alive" || (keepAlive && value != "close");
+            }
+            else if (name == "origin") {
+                // Browsers label every cross-site request with its origin; scripts don't. This keeps
+                // web pages from driving the API through the user's browser.
+                fromBrowser = true;
+            }
+        }
+        if (contentLength > kMaxApiRequestBytes) {
+            SendJsonResponse(s, 413, "{\"error\":\"Request too large\"}");
+            break;
+        }
+
+        // Read the body
+        buffer.erase(0, headerEnd + 4);
+        while (buffer.size() < contentLength) {
+            int received = recv(s, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                open = false;
+                break;
+            }
+            buffer.append(chunk, received);
+        }
+        if (!open) {
+            break;
+        }
+        std::string body = buffer.substr(0, contentLength);
+        buffer.erase(0, contentLength);
+
+        if (fromBrowser) {
+            SendJsonResponse(s, 403, "{\"error\":\"Browser requests are not accepted\"}");
+            break;
+        }
+        open = HandleApiRequest(s, method, target, body) && keepAlive;
+    }
+
+    closesocket(s);
+    g_apiConnections--;
+    return 0;
+}
+
+// Thread accepting API connections, one thread per connection
+DWORD WINAPI ApiListenThread(LPVOID lpParam) {
+    UNREFERENCED_PARAMETER(lpParam);
+    while (true) {
+        SOCKET s = accept(g_apiListenSocket, NULL, NULL);
+        if (s == INVALID_SOCKET) {
+            return 0; // Listening socket closed at exit
+        }
+        if (g_apiConnections >= kMaxApiConnections) {
+            SendJsonResponse(s, 503, "{\"error\":\"Too many connections\"}");
+            closesocket(s);
+            continue;
+        }
+        g_apiConnections++;
+        HANDLE hThread = CreateThread(NULL, 0, ApiConnectionThread, (LPVOID)s, 0, NULL);
+        if (hThread) {
+            CloseHandle(hThread);
+        } else {
+            closesocket(s);
+            g_apiConnections--;
+        }
+    }
+}
+
+// Start the control API if a port is configured. It binds to the loopback interface only.
+void StartControlApi() {
+    if (g_settings.controlApiPort <= 0 || g_settings.controlApiPort > 65535) {
+        return;
+    }
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        return;
+    }
+    g_apiListenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (g_apiListenSocket == INVALID_SOCKET) {
+        return;
+    }
+    sockaddr_in address = { 0 };
+    address.sin_family = AF_INET;
+    address.sin_port = htons((u_short)g_settings.controlApiPort);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(g_apiListenSocket, (sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(g_apiListenSocket, SOMAXCONN) != 0) {
+        OutputDebugStringW((L"Control API could not listen on port " + std::to_wstring(g_settings.controlApiPort)).c_str());
+        closesocket(g_apiListenSocket);
+        g_apiListenSocket = INVALID_SOCKET;
+        return;
+    }
+    HANDLE hThread = CreateThread(NULL, 0, ApiListenThread, NULL, 0, NULL);
+    if (hThread) {
+        CloseHandle(hThread);
+    }
+}
+
+// Stop accepting API connections
+void StopControlApi() {
+    if (g_apiListenSocket != INVALID_SOCKET) {
+        closesocket(g_apiListenSocket);
+        g_apiListenSocket = INVALID_SOCKET;
+    }
+}
+
+// Helper function to cancel a progress dialog's download and let go of its item. The item is
+// freed here if its thread has already finished with it, otherwise by the thread as it exits.
+void ReleaseDialogDownload(DownloadItem* item) {
+    bool running;
+    {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        // Set even without a process: the native downloader and the stages between processes stop on it
+        if (!IsDownloadFinished(item)) {
+            item->status = Cancelled;
+        }
+        if (item->process) {
+            item->process->Kill();
+        }
+        running = item->running;
+        item->releaseOnExit = running;
+    }
+    if (!running) {
+        delete item;
+    }
+}
+
+// Dialog procedure for the download progress dialog
+INT_PTR CALLBACK DownloadProgressProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
+    static DownloadOptions* pOptions = nullptr;
+    static DownloadItem* pItem = nullptr;
+    static HANDLE hThread = NULL;
+    static DWORD startTime = 0;
+    static std::wstring downloadFilename;
+    
+    switch (message) {
+    case WM_INITDIALOG: {
+        if (lParam == 0) {
+            // Invalid parameter
+            MessageBox(hDlg, L"Invalid download options provided.", L"Error", MB_OK | MB_ICONERROR);
+            DestroyWindow(hDlg);
+            return (INT_PTR)TRUE;
+        }
+        
+        try {
+            pOptions = (DownloadOptions*)lParam;
+            if (!pOptions) {
+                MessageBox(hDlg, L"Invalid download options.", L"Error", MB_OK | MB_ICONERROR);
+                DestroyWindow(hDlg);
+                return (INT_PTR)TRUE;
+            }
+            
+            // Store dialog handle in options
+            pOptions->hDlg = hDlg;
+            
+            // Initialize progress bar
+            HWND hProgress = GetDlgItem(hDlg, IDC_PROGRESS);
+            if (hProgress) {
+                SendMessage(hProgress, PBM_SETRANGE, 0, MAKELPARAM(0, 100));
+                SendMessage(hProgress, PBM_SETSTEP, 1, 0);
+                SendMessage(hProgress, PBM_SETPOS, 0, 0);
+            }
+            
+            // Update progress text with video URL
+            if (!pOptions->videoUrl.empty()) {
+                // Truncate long URLs for display
+                std::wstring displayUrl = pOptions->videoUrl;
+                if (displayUrl.length() > 80) {
+                    displayUrl = displayUrl.substr(0, 77) + L"...";
+                }
+                SetDlgItemText(hDlg, IDC_PROGRESS_TEXT, displayUrl.c_str());
+            } else {
+                SetDlgItemText(hDlg, IDC_PROGRESS_TEXT, L"Downloading video...");
+            }
+            
+            // Initialize progress text fields
+            SetDlgItemText(hDlg, IDC_PROGRESS_PERCENT, L"0% completed");
+            SetDlgItemText(hDlg, IDC_TIME_REMAINING, L"Time remaining: Calculating...");
+            SetDlgItemText(hDlg, IDC_DOWNLOAD_SPEED, L"Download speed: Calculating...");
+            
+            // Create download item
+            pItem = new DownloadItem();
+            pItem->url = pOptions->videoUrl;
+            pItem->resolution = pOptions->resolution;
+            pItem->path = pOptions->path.empty() ? g_settings.defaultDownloadPath : pOptions->path;
+            pItem->downloadSubtitles = pOptions->downloadSubtitles;
+            pItem->sections = pOptions->sections;
+            pItem->status = Downloading;
+            pItem->progress = 0;
+            pItem->process = nullptr;
+            pItem->threadId = 0;
+            pItem->progressDlg = hDlg;
+            pItem->running = true;
+            
+            // Record start time for calculating speed and remaining time
+            startTime = GetTickCount();
+            
+            // Create download thread with appropriate error handling
+            hThread = CreateThread(NULL, 0, DownloadThread, (LPVOID)pItem, 0, &pItem->threadId);
+            if (hThread == NULL) {
+                DWORD error = GetLastError();
+                wchar_t buffer[256];
+                swprintf_s(buffer, L"Failed to start download thread. Error code: %d", error);
+                MessageBox(hDlg, buffer, L"Error", MB_OK | MB_ICONERROR);
+                delete pItem;
+                pItem = nullptr;
+                DestroyWindow(hDlg);
+                return (INT_PTR)TRUE;
+            }
+            
+            // Set a timer to check download progress
+            SetTimer(hDlg, 1, 500, NULL);
+            
+            return (INT_PTR)TRUE;
+        }
+        catch (...) {
+            MessageBox(hDlg, L"An unexpected error occurred while initializing the download.", 
+                      L"Error", MB_OK | MB_ICONERROR);
+            if (pItem) {
+                delete pItem;
+                pItem = nullptr;
+            }
+            DestroyWindow(hDlg);
+            return (INT_PTR)TRUE;
+        }
+    }
+    
+    case WM_TIMER:
+        if (pItem) {
+            // Calculate elapsed time in seconds
+            DWORD currentTime = GetTickCount();
+            double elapsedSec = (currentTime - startTime) / 1000.0;
+            if (elapsedSec < 0.1) elapsedSec = 0.1; // Avoid division by zero
+            
+            // Update progress bar
+            HWND hProgress = GetDlgItem(hDlg, IDC_PROGRESS);
+            if (hProgress) {
                 SendMessage(hProgress, PBM_SETPOS, (int)pItem->progress, 0);
             }
             
@@ -950,493 +4496,1390 @@ INT_PTR CALLBACK DownloadProgressProc(HWND hDlg, UINT message, WPARAM wParam, LP
             }
             SetDlgItemText(hDlg, IDC_DOWNLOAD_SPEED, speedText.c_str());
             
-            // Calculate and update estimated time remaining
-            if (pItem->progress > 0) {
-                double remainingPercentage = 100.0 - pItem->progress;
-                double timePerPercent = elapsedSec / pItem->progress;
-                int remainingSeconds = (int)(remainingPercentage * timePerPercent);
-                
-                std::wstring timeText;
-                if (remainingSeconds > 60) {
-                    timeText = L"Time remaining: " + std::to_wstring(remainingSeconds / 60) + L" min " + 
-                               std::to_wstring(remainingSeconds % 60) + L" sec";
-                } else {
-                    timeText = L"Time remaining: " + std::to_wstring(remainingSeconds) + L" sec";
-                }
-                SetDlgItemText(hDlg, IDC_TIME_REMAINING, timeText.c_str());
+            // Calculate and update estimated time remaining
+            if (pItem->progress > 0) {
+                double remainingPercentage = 100.0 - pItem->progress;
+                double timePerPercent = elapsedSec / pItem->progress;
+                int remainingSeconds = (int)(remainingPercentage * timePerPercent);
+                
+                std::wstring timeText;
+                if (remainingSeconds > 60) {
+                    timeText = L"Time remaining: " + std::to_wstring(remainingSeconds / 60) + L" min " + 
+                               std::to_wstring(remainingSeconds % 60) + L" sec";
+                } else {
+                    timeText = L"Time remaining: " + std::to_wstring(remainingSeconds) + L" sec";
+                }
+                SetDlgItemText(hDlg, IDC_TIME_REMAINING, timeText.c_str());
+            }
+            
+            // The thread sets the final status a moment before it lets go of the item;
+            // the item is freed on a later tick once it has
+            bool threadRunning;
+            {
+                std::lock_guard<std::mutex> lock(g_queueMutex);
+                threadRunning = pItem->running;
+            }
+            if (threadRunning) {
+                return (INT_PTR)TRUE;
+            }
+            
+            // Check if download is complete
+            if (pItem->status == Completed) {
+                KillTimer(hDlg, 1);
+                MessageBox(hDlg, L"Download completed successfully!", L"Success", MB_OK | MB_ICONINFORMATION);
+                
+                // Clean up
+                if (hThread) {
+                    CloseHandle(hThread);
+                    hThread = NULL;
+                }
+                
+                delete pItem;
+                pItem = nullptr;
+                
+                // Don't close the dialog automatically, wait for user to dismiss it
+                SetDlgItemText(hDlg, IDC_PROGRESS_PERCENT, L"100% completed");
+                SetDlgItemText(hDlg, IDC_TIME_REMAINING, L"Download completed successfully!");
+                SetDlgItemText(hDlg, IDC_DOWNLOAD_SPEED, L"");
+                
+                // Change the cancel button text to "Close"
+                SetDlgItemText(hDlg, IDCANCEL, L"Close");
+            }
+            else if (pItem->status == Failed) {
+                KillTimer(hDlg, 1);
+                MessageBox(hDlg, L"Download failed. Please try again.", L"Error", MB_OK | MB_ICONERROR);
+                
+                // Clean up
+                if (hThread) {
+                    CloseHandle(hThread);
+                    hThread = NULL;
+                }
+                
+                delete pItem;
+                pItem = nullptr;
+                
+                DestroyWindow(hDlg);
+            }
+            else if (pItem->status == Cancelled) {
+                KillTimer(hDlg, 1);
+                
+                // Clean up
+                if (hThread) {
+                    CloseHandle(hThread);
+                    hThread = NULL;
+                }
+                
+                delete pItem;
+                pItem = nullptr;
+                
+                DestroyWindow(hDlg);
+            }
+        }
+        return (INT_PTR)TRUE;
+        
+    case WM_COMMAND:
+        if (LOWORD(wParam) == IDCANCEL) {
+            try {
+                KillTimer(hDlg, 1);
+                
+                // The thread may still be stopping; it frees the item itself then
+                if (pItem) {
+                    ReleaseDialogDownload(pItem);
+                    pItem = nullptr;
+                }
+                
+                if (hThread) {
+                    CloseHandle(hThread);
+                    hThread = NULL;
+                }
+            }
+            catch (...) {
+                // Ignore errors when trying to terminate the process
+            }
+            DestroyWindow(hDlg);
+            return (INT_PTR)TRUE;
+        }
+        else if (LOWORD(wParam) == IDC_HIDE_BUTTON) {
+            // Hide the dialog but keep the download going
+            ShowWindow(hDlg, SW_HIDE);
+            return (INT_PTR)TRUE;
+        }
+        break;
+        
+    case WM_DESTROY:
+        KillTimer(hDlg, 1);
+        if (hThread) {
+            CloseHandle(hThread);
+            hThread = NULL;
+        }
+        if (pItem) {
+            ReleaseDialogDownload(pItem);
+            pItem = nullptr;
+        }
+        break;
+    }
+    return (INT_PTR)FALSE;
+}
+
+// Resolution choices are stored as a height cap: 0 = best available, negative = no video
+// (-1 m4a, -2 opus, -3 mp3, -4 srt subtitles, -5 plain text subtitles)
+int ResolutionToHeight(const std::wstring& resolution) {
+    if (resolution == L"Best") return 0;
+    if (resolution == kAudioOnlyM4a) return -1;
+    if (resolution == kAudioOnlyOpus) return -2;
+    if (resolution == kAudioOnlyMp3) return -3;
+    if (resolution == kSubtitlesOnlySrt) return -4;
+    if (resolution == kSubtitlesOnlyText) return -5;
+    return _wtoi(resolution.c_str());
+}
+
+std::wstring HeightToResolution(int height) {
+    if (height == 0) return L"Best";
+    if (height == -1) return kAudioOnlyM4a;
+    if (height == -2) return kAudioOnlyOpus;
+    if (height == -3) return kAudioOnlyMp3;
+    if (height == -4) return kSubtitlesOnlySrt;
+    if (height < 0) return kSubtitlesOnlyText;
+    return std::to_wstring(height) + L"p";
+}
+
+// Fill the resolution combo, listing the video's real resolutions and sizes once it has been probed
+void FillResolutionCombo(HWND hCombo, const VideoInfo* info, int selectedHeight) {
+    std::vector<int> heights;
+    if (info) {
+        for (const auto& format : info->formats) {
+            if (format.hasVideo && format.height > 0) heights.push_back(format.height);
+        }
+        std::sort(heights.begin(), heights.end(), std::greater<int>());
+        heights.erase(std::unique(heights.begin(), heights.end()), heights.end());
+    }
+    if (heights.empty()) {
+        // Not probed (yet); offer the usual caps
+        heights.push_back(1080);
+        heights.push_back(720);
+    }
+    heights.insert(heights.begin(), 0);
+    heights.push_back(-1);
+    heights.push_back(-2);
+    heights.push_back(-3);
+    heights.push_back(-4);
+    heights.push_back(-5);
+
+    SendMessage(hCombo, CB_RESETCONTENT, 0, 0);
+    int selection = 0;
+    for (int height : heights) {
+        std::wstring text = HeightToResolution(height);
+        if (info && height >= -3) {
+            if (height == 0 && GetMaxVideoHeight(*info) > 0) {
+                text += L" (" + std::to_wstring(GetMaxVideoHeight(*info)) + L"p)";
+            }
+            std::wstring size = FormatFileSize(EstimateDownloadSize(*info, height));
+            if (!size.empty()) {
+                text += L"  ~" + size;
+            }
+        }
+        int index = (int)SendMessage(hCombo, CB_ADDSTRING, 0, (LPARAM)text.c_str());
+        SendMessage(hCombo, CB_SETITEMDATA, index, (LPARAM)height);
+        if (height == selectedHeight) {
+            selection = index;
+        }
+    }
+    SendMessage(hCombo, CB_SETCURSEL, selection, 0);
+}
+
+// Height cap of the selected resolution combo item
+int GetSelectedResolutionHeight(HWND hCombo) {
+    int sel = (int)SendMessage(hCombo, CB_GETCURSEL, 0, 0);
+    if (sel == CB_ERR) return 0;
+    return (int)SendMessage(hCombo, CB_GETITEMDATA, sel, 0);
+}
+
+// Dialog procedure for download options
+INT_PTR CALLBACK DownloadOptionsProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
+    static DownloadOptions* pOptions;
+    switch (message) {
+    case WM_INITDIALOG: {
+        pOptions = (DownloadOptions*)lParam;
+        // List the real formats if the watch page probe has already finished, otherwise wait for it
+        std::wstring videoId = GetWatchVideoId(pOptions->videoUrl);
+        VideoInfoPtr info = videoId.empty() ? nullptr : GetCachedVideoInfo(videoId);
+        FillResolutionCombo(GetDlgItem(hDlg, IDC_COMBO_RESOLUTION), info.get(), ResolutionToHeight(pOptions->resolution));
+        if (!info && !videoId.empty()) {
+            QueueMetadataProbe(videoId, pOptions->videoUrl, hDlg);
+        }
+        SetDlgItemText(hDlg, IDC_EDIT_PATH, g_settings.defaultDownloadPath.c_str());
+        return (INT_PTR)TRUE;
+    }
+    case WM_APP_VIDEOINFO_READY: {
+        VideoInfoPtr info = GetCachedVideoInfo(GetWatchVideoId(pOptions->videoUrl));
+        if (info) {
+            HWND hCombo = GetDlgItem(hDlg, IDC_COMBO_RESOLUTION);
+            FillResolutionCombo(hCombo, info.get(), GetSelectedResolutionHeight(hCombo));
+        }
+        return (INT_PTR)TRUE;
+    }
+    case WM_DESTROY:
+        CancelMetadataProbes(hDlg);
+        break;
+    case WM_COMMAND:
+        if (LOWORD(wParam) == IDOK) {
+            wchar_t buffer[MAX_PATH];
+            GetDlgItemText(hDlg, IDC_EDIT_PATH, buffer, MAX_PATH);
+            pOptions->path = buffer;
+            pOptions->resolution = HeightToResolution(GetSelectedResolutionHeight(GetDlgItem(hDlg, IDC_COMBO_RESOLUTION)));
+            pOptions->downloadSubtitles = IsDlgButtonChecked(hDlg, IDC_CHECK_SUBTITLES) == BST_CHECKED;
+            GetDlgItemText(hDlg, IDC_EDIT_SECTIONS, buffer, MAX_PATH);
+            pOptions->sections = buffer;
+            EndDialog(hDlg, IDOK);
+            return (INT_PTR)TRUE;
+        }
+        if (LOWORD(wParam) == IDCANCEL) {
+            EndDialog(hDlg, IDCANCEL);
+            return (INT_PTR)TRUE;
+        }
+        if (LOWORD(wParam) == IDC_BUTTON_BROWSE) {
+            BROWSEINFOW bi = { 0 };
+            bi.lpszTitle = L"Select a download folder";
+            bi.ulFlags = BIF_RETURNONLYFSDIRS | BIF_NEWDIALOGSTYLE;
+            LPITEMIDLIST pidl = SHBrowseForFolderW(&bi);
+            if (pidl) {
+                wchar_t path[MAX_PATH];
+                if (SHGetPathFromIDListW(pidl, path)) {
+                    SetDlgItemText(hDlg, IDC_EDIT_PATH, path);
+                }
+                CoTaskMemFree(pidl);
+            }
+        }
+        break;
+    }
+    return (INT_PTR)FALSE;
+}
+
+// Dialog procedure for settings
+INT_PTR CALLBACK SettingsProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
+    switch (message) {
+    case WM_INITDIALOG:
+        CheckDlgButton(hDlg, IDC_CHECK_ADBLOCK_STARTUP, g_settings.adBlockOnStartup ? BST_CHECKED : BST_UNCHECKED);
+        SetDlgItemText(hDlg, IDC_EDIT_DEFAULT_PATH, g_settings.defaultDownloadPath.c_str());
+        
+        // Set theme radio buttons
+        switch (g_settings.themeMode) {
+            case AppSettings::ThemeMode::Light:
+                CheckDlgButton(hDlg, IDC_RADIO_LIGHT_MODE, BST_CHECKED);
+                break;
+            case AppSettings::ThemeMode::Dark:
+                CheckDlgButton(hDlg, IDC_RADIO_DARK_MODE, BST_CHECKED);
+                break;
+            case AppSettings::ThemeMode::System:
+                CheckDlgButton(hDlg, IDC_RADIO_SYSTEM_THEME, BST_CHECKED);
+                break;
+        }
+        
+        return (INT_PTR)TRUE;
+    case WM_COMMAND:
+        if (LOWORD(wParam) == IDOK) {
+            g_settings.adBlockOnStartup = IsDlgButtonChecked(hDlg, IDC_CHECK_ADBLOCK_STARTUP) == BST_CHECKED;
+            
+            // Get theme mode from radio buttons
+            if (IsDlgButtonChecked(hDlg, IDC_RADIO_LIGHT_MODE) == BST_CHECKED) {
+                g_settings.themeMode = AppSettings::ThemeMode::Light;
             }
-            
-            // Check if download is complete
-            if (pItem->status == Completed) {
-                KillTimer(hDlg, 1);
-                MessageBox(hDlg, L"Download completed successfully!", L"Success", MB_OK | MB_ICONINFORMATION);
-                
-                // Clean up
-                if (hThread) {
-                    CloseHandle(hThread);
-                    hThread = NULL;
-                }
-                
-                delete pItem;
-                pItem = nullptr;
-                
-                // Don't close the dialog automatically, wait for user to dismiss it
-                SetDlgItemText(hDlg, IDC_PROGRESS_PERCENT, L"100% completed");
-                SetDlgItemText(hDlg, IDC_TIME_REMAINING, L"Download completed successfully!");
-                SetDlgItemText(hDlg, IDC_DOWNLOAD_SPEED, L"");
-                
-                // Change the cancel button text to "Close"
-                SetDlgItemText(hDlg, IDCANCEL, L"Close");
+            else if (IsDlgButtonChecked(hDlg, IDC_RADIO_DARK_MODE) == BST_CHECKED) {
+                g_settings.themeMode = AppSettings::ThemeMode::Dark;
             }
-            else if (pItem->status == Failed) {
-                KillTimer(hDlg, 1);
-                MessageBox(hDlg, L"Download failed. Please try again.", L"Error", MB_OK | MB_ICONERROR);
-                
-                // Clean up
-                if (hThread) {
-                    CloseHandle(hThread);
-                    hThread = NULL;
-                }
-                
-                delete pItem;
-                pItem = nullptr;
-                
-                DestroyWindow(hDlg);
+            else if (IsDlgButtonChecked(hDlg, IDC_RADIO_SYSTEM_THEME) == BST_CHECKED) {
+                g_settings.themeMode = AppSettings::ThemeMode::System;
             }
-            else if (pItem->status == Cancelled) {
-                KillTimer(hDlg, 1);
-                
-                // Clean up
-                if (hThread) {
-                    CloseHandle(hThread);
-                    hThread = NULL;
+            
+            wchar_t path[MAX_PATH];
+            GetDlgItemText(hDlg, IDC_EDIT_DEFAULT_PATH, path, MAX_PATH);
+            g_settings.defaultDownloadPath = path;
+            SaveSettings(); // Save settings when OK is clicked
+            StartLibraryIndex();
+            
+            // Apply theme based on settings
+            ApplyThemeMode();
+            
+            EndDialog(hDlg, IDOK);
+            return (INT_PTR)TRUE;
+        }
+        if (LOWORD(wParam) == IDCANCEL) {
+            EndDialog(hDlg, IDCANCEL);
+            return (INT_PTR)TRUE;
+        }
+        if (LOWORD(wParam) == IDC_BUTTON_DEFAULT_BROWSE) {
+            BROWSEINFOW bi = { 0 };
+            bi.lpszTitle = L"Select a default download folder";
+            bi.ulFlags = BIF_RETURNONLYFSDIRS | BIF_NEWDIALOGSTYLE;
+            LPITEMIDLIST pidl = SHBrowseForFolderW(&bi);
+            if (pidl) {
+                wchar_t path[MAX_PATH];
+                if (SHGetPathFromIDListW(pidl, path)) {
+                    SetDlgItemText(hDlg, IDC_EDIT_DEFAULT_PATH, path);
                 }
-                
-                delete pItem;
-                pItem = nullptr;
-                
-                DestroyWindow(hDlg);
+                CoTaskMemFree(pidl);
             }
         }
-        return (INT_PTR)TRUE;
+        break;
+    }
+    return (INT_PTR)FALSE;
+}
+
+// Helper to resize WebView2 when window size changes
+void ResizeWebView2(HWND hWnd) {
+    if (g_webViewController) {
+        RECT bounds;
+        GetClientRect(hWnd, &bounds);
+        g_webViewController->put_Bounds(bounds);
+    }
+}
+
+// Helper function to inject ad-blocking JavaScript
+void InjectAdBlockScript() {
+    if (g_webView) {
+        // This script uses a MutationObserver to remove ads as they are dynamically added to the page.
+        // It targets a wider range of ad-related selectors for better coverage.
+        std::wstring script = LR"(
+            const adSelectors = [
+                '.ad-showing',
+                '.video-ads',
+                'ytd-ad-slot-renderer',
+                'ytd-promoted-sparkles-web-renderer',
+                'ytd-in-feed-ad-layout-renderer',
+                '#player-ads',
+                '#masthead-ad',
+                '.ytd-ad-slot-renderer',
+                '.ytp-ad-module'
+            ];
+
+            const removeAds = () => {
+                const ads = document.querySelectorAll(adSelectors.join(', '));
+                ads.forEach(ad => {
+                    let parent = ad.parentElement;
+                    while (parent && parent.tagName.toLowerCase() !== 'ytd-rich-item-renderer' && parent.tagName.toLowerCase() !== 'ytd-video-renderer' && parent.tagName.toLowerCase() !== 'body') {
+                        parent = parent.parentElement;
+                    }
+                    if (parent && (parent.tagName.toLowerCase() === 'ytd-rich-item-renderer' || parent.tagName.toLowerCase() === 'ytd-video-renderer')) {
+                        parent.style.display = 'none';
+                    } else {
+                        ad.style.display = 'none';
+                    }
+                });
+            };
+
+            const observer = new MutationObserver((mutations) => {
+                removeAds();
+            });
+
+            observer.observe(document.body, {
+                childList: true,
+                subtree: true
+            });
+
+            // Initial cleanup
+            removeAds();
+        )";
+        g_webView->AddScriptToExecuteOnDocumentCreated(script.c_str(), nullptr);
+    }
+}
+
+void ToggleDarkMode() {
+    if (g_settings.themeMode == AppSettings::ThemeMode::Dark) {
+        SetLightMode();
+    } else {
+        SetDarkMode();
+    }
+}
+
+void TogglePictureInPicture() {
+    if (g_webView) {
+        // This script attempts to find the primary video element and request picture-in-picture.
+        std::wstring script = LR"(
+            const video = document.querySelector('video');
+            if (video && document.pictureInPictureElement !== video) {
+                video.requestPictureInPicture();
+            } else if (document.pictureInPictureElement) {
+                document.exitPictureInPicture();
+            }
+        )";
+        g_webView->ExecuteScript(script.c_str(), nullptr);
+    }
+}
+
+void ToggleAudioOnlyPlayer() {
+    if (g_webViewController) {
+        g_isAudioOnly = !g_isAudioOnly;
+        g_webViewController->put_IsVisible(!g_isAudioOnly);
+    }
+}
+
+// Helper to get current URL from WebView2
+std::wstring GetCurrentWebViewUrl() {
+    if (!g_webView) return L"";
+    LPWSTR uri = nullptr;
+    if (SUCCEEDED(g_webView->get_Source(&uri)) && uri) {
+        std::wstring result(uri);
+        CoTaskMemFree(uri);
+        return result;
+    }
+    return L"";
+}
+
+// Determine if system theme is dark mode
+bool IsSystemInDarkMode() {
+    DWORD value = 0;
+    DWORD dataSize = sizeof(value);
+    HKEY hKey;
+    
+    if (RegOpenKeyExW(HKEY_CURRENT_USER,
+        L"Software\\Microsoft\\Windows\\CurrentVersion\\Themes\\Personalize",
+        0, KEY_READ, &hKey) == ERROR_SUCCESS) {
         
-    case WM_COMMAND:
-        if (LOWORD(wParam) == IDCANCEL) {
-            try {
-                KillTimer(hDlg, 1);
-                
-                if (pItem && pItem->hProcess) {
-                    TerminateProcess(pItem->hProcess, 0);
-                    pItem->status = Cancelled;
-                }
-                
-                if (hThread) {
-                    // Give the thread a moment to clean up
-                    WaitForSingleObject(hThread, 1000);
-                    CloseHandle(hThread);
-                    hThread = NULL;
-                }
-                
-                if (pItem) {
-                    delete pItem;
-                    pItem = nullptr;
-                }
+        if (RegQueryValueExW(hKey, L"AppsUseLightTheme", nullptr, nullptr,
+            reinterpret_cast<LPBYTE>(&value), &dataSize) == ERROR_SUCCESS) {
+            RegCloseKey(hKey);
+            return value == 0; // 0 means dark theme is enabled
+        }
+        RegCloseKey(hKey);
+    }
+    
+    return false; // Default to light mode if registry read fails
+}
+
+// Apply theme based on current settings
+void ApplyThemeMode() {
+    if (!g_webView) return;
+    
+    bool shouldUseDarkMode = false;
+    
+    switch (g_settings.themeMode) {
+        case AppSettings::ThemeMode::Light:
+            shouldUseDarkMode = false;
+            break;
+        case AppSettings::ThemeMode::Dark:
+            shouldUseDarkMode = true;
+            break;
+        case AppSettings::ThemeMode::System:
+            shouldUseDarkMode = IsSystemInDarkMode();
+            break;
+    }
+    
+    // Apply the appropriate theme
+    std::wstring script = LR"(
+        const html = document.documentElement;
+        if ()";
+    
+    script += shouldUseDarkMode ? L"true" : L"false";
+    
+    script += LR"() {
+            if (!html.hasAttribute('dark')) {
+                html.setAttribute('dark', 'true');
             }
-            catch (...) {
-                // Ignore errors when trying to terminate the process
+        } else {
+            if (html.hasAttribute('dark')) {
+                html.removeAttribute('dark');
             }
-            DestroyWindow(hDlg);
-            return (INT_PTR)TRUE;
         }
-        else if (LOWORD(wParam) == IDC_HIDE_BUTTON) {
-            // Hide the dialog but keep the download going
-            ShowWindow(hDlg, SW_HIDE);
-            return (INT_PTR)TRUE;
+    )";
+    
+    g_webView->ExecuteScript(script.c_str(), nullptr);
+}
+
+// Theme-related functions
+void SetLightMode() {
+    if (!g_webView) return;
+    
+    g_settings.themeMode = AppSettings::ThemeMode::Light;
+    SaveSettings();
+    
+    // Apply light theme to WebView
+    std::wstring script = LR"(
+        const html = document.documentElement;
+        if (html.hasAttribute('dark')) {
+            html.removeAttribute('dark');
         }
-        break;
+    )";
+    
+    g_webView->ExecuteScript(script.c_str(), nullptr);
+    MessageBox(nullptr, L"Light mode enabled", L"Theme Changed", MB_OK | MB_ICONINFORMATION);
+}
+
+void SetDarkMode() {
+    if (!g_webView) return;
+    
+    g_settings.themeMode = AppSettings::ThemeMode::Dark;
+    SaveSettings();
+    
+    // Apply dark theme to WebView
+    std::wstring script = LR"(
+        const html = document.documentElement;
+        if (!html.hasAttribute('dark')) {
+            html.setAttribute('dark', 'true');
+        }
+    )";
+    
+    g_webView->ExecuteScript(script.c_str(), nullptr);
+    MessageBox(nullptr, L"Dark mode enabled", L"Theme Changed", MB_OK | MB_ICONINFORMATION);
+}
+
+void UseSystemTheme() {
+    if (!g_webView) return;
+    
+    g_settings.themeMode = AppSettings::ThemeMode::System;
+    SaveSettings();
+    
+    // Apply theme based on system settings
+    ApplyThemeMode();
+    MessageBox(nullptr, L"Using system theme", L"Theme Changed", MB_OK | MB_ICONINFORMATION);
+}
+
+// Helper function to directly start a download
+void StartDownload(const std::wstring& url, HWND parentWindow = NULL) {
+    if (url.empty()) {
+        MessageBox(NULL, L"Cannot download empty URL.", L"Error", MB_OK | MB_ICONERROR);
+        return;
+    }
+    
+    try {
+        DownloadOptions options;
+        options.resolution = L"Best";
+        options.path = g_settings.defaultDownloadPath;
+        options.videoUrl = url;
+        options.downloadSubtitles = false;
+        options.hProcess = NULL;
         
-    case WM_DESTROY:
-        KillTimer(hDlg, 1);
-        if (hThread) {
-            CloseHandle(hThread);
-            hThread = NULL;
+        if (!parentWindow) {
+            parentWindow = GetActiveWindow();
         }
-        if (pItem) {
-            delete pItem;
-            pItem = nullptr;
+        
+        if (DialogBoxParam(hInst, MAKEINTRESOURCE(IDD_DOWNLOAD_OPTIONS), parentWindow, 
+                         DownloadOptionsProc, (LPARAM)&options) == IDOK) {
+            // Start the download with progress dialog (modeless)
+            HWND hProgress = CreateDialogParam(hInst, MAKEINTRESOURCE(IDD_DOWNLOAD_PROGRESS), parentWindow, DownloadProgressProc, (LPARAM)&options);
+            ShowWindow(hProgress, SW_SHOW);
         }
-        break;
     }
-    return (INT_PTR)FALSE;
+    catch (const std::exception& e) {
+        char buffer[256];
+        sprintf_s(buffer, "Failed to start download: %s", e.what());
+        
+        int size_needed = MultiByteToWideChar(CP_UTF8, 0, buffer, -1, NULL, 0);
+        std::wstring wErrorMsg(size_needed, 0);
+        MultiByteToWideChar(CP_UTF8, 0, buffer, -1, &wErrorMsg[0], size_needed);
+        
+        MessageBox(NULL, wErrorMsg.c_str(), L"Download Error", MB_OK | MB_ICONERROR);
+    }
+    catch (...) {
+        MessageBox(NULL, L"An unexpected error occurred when preparing download.", 
+                  L"Download Error", MB_OK | MB_ICONERROR);
+    }
 }
 
-// Dialog procedure for download options
-INT_PTR CALLBACK DownloadOptionsProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
-    static DownloadOptions* pOptions;
-    switch (message) {
-    case WM_INITDIALOG:
-        pOptions = (DownloadOptions*)lParam;
-        // Populate resolutions (example, you can get these from yt-dlp)
-        SendDlgItemMessage(hDlg, IDC_COMBO_RESOLUTION, CB_ADDSTRING, 0, (LPARAM)L"Best");
-        SendDlgItemMessage(hDlg, IDC_COMBO_RESOLUTION, CB_ADDSTRING, 0, (LPARAM)L"1080p");
-        SendDlgItemMessage(hDlg, IDC_COMBO_RESOLUTION, CB_ADDSTRING, 0, (LPARAM)L"720p");
-        SendDlgItemMessage(hDlg, IDC_COMBO_RESOLUTION, CB_ADDSTRING, 0, (LPARAM)L"Audio Only (mp3)");
-        SendDlgItemMessage(hDlg, IDC_COMBO_RESOLUTION, CB_SETCURSEL, 0, 0);
-        SetDlgItemText(hDlg, IDC_EDIT_PATH, g_settings.defaultDownloadPath.c_str());
-        return (INT_PTR)TRUE;
-    case WM_COMMAND:
-        if (LOWORD(wParam) == IDOK) {
-            wchar_t buffer[MAX_PATH];
-            GetDlgItemText(hDlg, IDC_EDIT_PATH, buffer, MAX_PATH);
-            pOptions->path = buffer;
-            int sel = SendDlgItemMessage(hDlg, IDC_COMBO_RESOLUTION, CB_GETCURSEL, 0, 0);
-            SendDlgItemMessage(hDlg, IDC_COMBO_RESOLUTION, CB_GETLBTEXT, sel, (LPARAM)buffer);
-            pOptions->resolution = buffer;
-            pOptions->downloadSubtitles = IsDlgButtonChecked(hDlg, IDC_CHECK_SUBTITLES) == BST_CHECKED;
-            EndDialog(hDlg, IDOK);
-            return (INT_PTR)TRUE;
-        }
-        if (LOWORD(wParam) == IDCANCEL) {
-            EndDialog(hDlg, IDCANCEL);
-            return (INT_PTR)TRUE;
+// A playlist kept in sync with a local folder
+struct PlaylistMirror {
+    std::wstring url;           // https://www.youtube.com/playlist?list=...
+    std::wstring path;          // Destination folder
+    std::wstring resolution;
+    bool downloadSubtitles = false;
+    std::wstring status;        // Result of the last sync (not saved)
+};
+
+std::vector<PlaylistMirror> g_mirrors;
+bool g_mirrorReportRemoved = false;
+std::mutex g_mirrorsMutex;
+
+// Mirror files carry the video ID so the folder itself records what it holds
+const wchar_t* kMirrorOutputTemplate = L"%(title)s [%(id)s].%(ext)s";
+const int kMaxMirrorSyncs = 4;
+std::atomic<size_t> g_mirrorSyncNext(0);
+std::atomic<bool> g_mirrorSyncRunning(false);
+HWND g_hMirrorsDlg = NULL;
+
+// Helper function to save mirror definitions
+void SaveMirrors() {
+    nlohmann::json j;
+    j["reportRemoved"] = g_mirrorReportRemoved;
+    j["mirrors"] = nlohmann::json::array();
+    {
+        std::lock_guard<std::mutex> lock(g_mirrorsMutex);
+        for (const auto& mirror : g_mirrors) {
+            nlohmann::json m;
+            m["url"] = WideToUtf8(mirror.url);
+            m["path"] = WideToUtf8(mirror.path);
+            m["resolution"] = WideToUtf8(mirror.resolution);
+            m["downloadSubtitles"] = mirror.downloadSubtitles;
+            j["mirrors"].push_back(m);
         }
-        if (LOWORD(wParam) == IDC_BUTTON_BROWSE) {
-            BROWSEINFOW bi = { 0 };
-            bi.lpszTitle = L"Select a download folder";
-            bi.ulFlags = BIF_RETURNONLYFSDIRS | BIF_NEWDIALOGSTYLE;
-            LPITEMIDLIST pidl = SHBrowseForFolderW(&bi);
-            if (pidl) {
-                wchar_t path[MAX_PATH];
-                if (SHGetPathFromIDListW(pidl, path)) {
-                    SetDlgItemText(hDlg, IDC_EDIT_PATH, path);
+    }
+
+    std::wstring mirrorsPath = GetAppDataFilePath(L"mirrors.json");
+    if (!mirrorsPath.empty()) {
+        std::ofstream o(mirrorsPath);
+        o << j.dump(4) << std::endl;
+    }
+}
+
+// Helper function to load mirror definitions
+void LoadMirrors() {
+    std::wstring mirrorsPath = GetAppDataFilePath(L"mirrors.json");
+    if (mirrorsPath.empty()) {
+        return;
+    }
+    std::ifstream i(mirrorsPath);
+    if (!i.good()) {
+        return;
+    }
+
+    try {
+        nlohmann::json j;
+        i >> j;
+        g_mirrorReportRemoved = j.value("reportRemoved", false);
+
+        std::lock_guard<std::mutex> lock(g_mirrorsMutex);
+        g_mirrors.clear();
+        if (j.contains("mirrors") && j["mirrors"].is_array()) {
+            for (const auto& m : j["mirrors"]) {
+                PlaylistMirror mirror;
+                mirror.url = Utf8ToWide(JsonString(m, "url"));
+                mirror.path = Utf8ToWide(JsonString(m, "path"));
+                mirror.resolution = Utf8ToWide(JsonString(m, "resolution"));
+                mirror.downloadSubtitles = m.value("downloadSubtitles", false);
+                if (mirror.resolution.empty()) mirror.resolution = L"Best";
+                if (!mirror.url.empty() && !mirror.path.empty()) {
+                    g_mirrors.push_back(mirror);
                 }
-                CoTaskMemFree(pidl);
             }
         }
-        break;
     }
-    return (INT_PTR)FALSE;
+    catch (...) {
+        // Ignore a damaged mirrors file rather than failing startup
+    }
 }
 
-// Dialog procedure for settings
-INT_PTR CALLBACK SettingsProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
-    switch (message) {
-    case WM_INITDIALOG:
-        CheckDlgButton(hDlg, IDC_CHECK_ADBLOCK_STARTUP, g_settings.adBlockOnStartup ? BST_CHECKED : BST_UNCHECKED);
-        SetDlgItemText(hDlg, IDC_EDIT_DEFAULT_PATH, g_settings.defaultDownloadPath.c_str());
-        
-        // Set theme radio buttons
-        switch (g_settings.themeMode) {
-            case AppSettings::ThemeMode::Light:
-                CheckDlgButton(hDlg, IDC_RADIO_LIGHT_MODE, BST_CHECKED);
-                break;
-            case AppSettings::ThemeMode::Dark:
-                CheckDlgButton(hDlg, IDC_RADIO_DARK_MODE, BST_CHECKED);
-                break;
-            case AppSettings::ThemeMode::System:
-                CheckDlgButton(hDlg, IDC_RADIO_SYSTEM_THEME, BST_CHECKED);
-                break;
+// Helper function to pull the video ID out of a "Title [id].ext" file name
+std::wstring ExtractVideoIdFromFilename(const std::wstring& fileName) {
+    size_t close = fileName.find_last_of(L']');
+    if (close == std::wstring::npos || close < 12 || fileName[close - 12] != L'[') {
+        return L"";
+    }
+    std::wstring id = fileName.substr(close - 11, 11);
+    for (wchar_t c : id) {
+        if (!iswalnum(c) && c != L'-' && c != L'_') {
+            return L"";
         }
-        
+    }
+    return id;
+}
+
+// yt-dlp download archive kept inside a mirror folder
+std::wstring GetMirrorArchivePath(const std::wstring& folder) {
+    std::wstring path = folder;
+    if (!path.empty() && path.back() != L'\\' && path.back() != L'/') {
+        path += L'\\';
+    }
+    return path + L".youtubeplus-archive.txt";
+}
+
+// Collect the video IDs a folder already holds, from its download archive and file names
+void LoadLocalVideoIds(const std::wstring& folder, std::unordered_map<std::wstring, std::wstring>& ids) {
+    std::ifstream archive(GetMirrorArchivePath(folder));
+    std::string line;
+    while (std::getline(archive, line)) {
+        // Archive lines look like "youtube <id>"
+        size_t space = line.find(' ');
+        if (space != std::string::npos) {
+            std::string id = line.substr(space + 1);
+            while (!id.empty() && (id.back() == '\r' || id.back() == ' ')) id.pop_back();
+            if (!id.empty()) ids.emplace(Utf8ToWide(id), L"");
+        }
+    }
+
+    WIN32_FIND_DATAW findData;
+    HANDLE hFind = FindFirstFileExW((folder + L"\\*").c_str(), FindExInfoBasic, &findData,
+                                    FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if (hFind == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    do {
+        if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        std::wstring id = ExtractVideoIdFromFilename(findData.cFileName);
+        if (!id.empty()) {
+            ids[id] = findData.cFileName;
+        }
+    } while (FindNextFileW(hFind, &findData));
+    FindClose(hFind);
+}
+
+// Sync one mirror: queue the playlist videos its folder doesn't have yet
+std::wstring SyncPlaylistMirror(const PlaylistMirror& mirror, bool reportRemoved) {
+    std::vector<PlaylistVideo> videos;
+    if (!EnumeratePlaylistInnerTube(ClassifyYouTubeUrl(mirror.url).playlistId, videos, nullptr)) {
+        videos.clear();
+        std::string output;
+        DWORD exitCode = 1;
+        // Listing a large playlist takes far longer than probing one video
+        if (!RunYtDlpCapture(L"--flat-playlist --dump-json --no-warnings \"" + mirror.url + L"\"", output, exitCode,
+                             kYtDlpCaptureTimeoutMs * 10) || exitCode != 0) {
+            return L"Failed to read playlist";
+        }
+        std::istringstream stream(output);
+        std::string line;
+        while (std::getline(stream, line)) {
+            ParsePlaylistLine(line, videos);
+        }
+    }
+    if (videos.empty()) {
+        return L"Playlist is empty";
+    }
+
+    std::unordered_map<std::wstring, std::wstring> localIds;
+    LoadLocalVideoIds(mirror.path, localIds);
+    std::unordered_set<std::wstring> pendingUrls;
+    GetPendingDownloadUrls(mirror.path, pendingUrls);
+
+    DownloadOptions options = { nullptr, mirror.resolution, mirror.path, L"", mirror.downloadSubtitles };
+    std::wstring archivePath = GetMirrorArchivePath(mirror.path);
+    std::unordered_set<std::wstring> playlistIds;
+    std::vector<std::wstring> missing;
+    for (const auto& video : videos) {
+        playlistIds.insert(video.id);
+        if (localIds.count(video.id) || pendingUrls.count(video.url)) {
+            continue;
+        }
+        missing.push_back(video.url);
+    }
+    // The whole diff goes in as one batch, so a sync costs one scheduling pass however large the playlist
+    EnqueueDownloads(missing, options, kMirrorOutputTemplate, archivePath);
+    int queued = (int)missing.size();
+
+    // Videos the folder holds that are no longer in the playlist
+    std::string report;
+    int removed = 0;
+    for (const auto& local : localIds) {
+        if (!playlistIds.count(local.first)) {
+            removed++;
+            report += WideToUtf8(local.first);
+            if (!local.second.empty()) report += "\t" + WideToUtf8(local.second);
+            report += "\n";
+        }
+    }
+    if (reportRemoved && removed > 0) {
+        std::ofstream o(mirror.path + L"\\removed-from-playlist.txt");
+        o << report;
+    }
+
+    wchar_t status[128];
+    if (queued == 0 && removed == 0) {
+        swprintf_s(status, L"Up to date (%d videos)", (int)videos.size());
+    } else {
+        swprintf_s(status, L"%d queued, %d removed from playlist", queued, removed);
+    }
+    return status;
+}
+
+// Worker that syncs mirrors until none are left
+DWORD WINAPI MirrorSyncWorker(LPVOID lpParam) {
+    bool reportRemoved = lpParam != NULL;
+    while (true) {
+        size_t index = g_mirrorSyncNext++;
+        PlaylistMirror mirror;
+        {
+            std::lock_guard<std::mutex> lock(g_mirrorsMutex);
+            if (index >= g_mirrors.size()) {
+                return 0;
+            }
+            g_mirrors[index].status = L"Syncing...";
+            mirror = g_mirrors[index];
+        }
+        if (g_hMirrorsDlg) PostMessage(g_hMirrorsDlg, WM_APP_MIRROR_STATUS, 0, 0);
+
+        std::wstring status = SyncPlaylistMirror(mirror, reportRemoved);
+        {
+            std::lock_guard<std::mutex> lock(g_mirrorsMutex);
+            if (index < g_mirrors.size()) {
+                g_mirrors[index].status = status;
+            }
+        }
+        if (g_hMirrorsDlg) PostMessage(g_hMirrorsDlg, WM_APP_MIRROR_STATUS, 0, 0);
+    }
+}
+
+// Sync every mirror, a few playlists at a time
+DWORD WINAPI MirrorSyncThread(LPVOID lpParam) {
+    g_mirrorSyncNext = 0;
+    HANDLE workers[kMaxMirrorSyncs];
+    DWORD workerCount = 0;
+    for (int i = 0; i < kMaxMirrorSyncs; i++) {
+        HANDLE hThread = CreateThread(NULL, 0, MirrorSyncWorker, lpParam, 0, NULL);
+        if (hThread) workers[workerCount++] = hThread;
+    }
+    if (workerCount > 0) {
+        WaitForMultipleObjects(workerCount, workers, TRUE, INFINITE);
+    }
+    for (DWORD i = 0; i < workerCount; i++) {
+        CloseHandle(workers[i]);
+    }
+
+    g_mirrorSyncRunning = false;
+    if (g_hMirrorsDlg) PostMessage(g_hMirrorsDlg, WM_APP_MIRROR_SYNC_DONE, 0, 0);
+    return 0;
+}
+
+// Refill the mirrors list from g_mirrors
+void RefreshMirrorList(HWND hDlg) {
+    HWND hList = GetDlgItem(hDlg, IDC_MIRROR_LIST);
+    int selected = ListView_GetNextItem(hList, -1, LVNI_SELECTED);
+    ListView_DeleteAllItems(hList);
+
+    std::lock_guard<std::mutex> lock(g_mirrorsMutex);
+    for (size_t i = 0; i < g_mirrors.size(); i++) {
+        const auto& mirror = g_mirrors[i];
+        LVITEMW lvi = { 0 };
+        lvi.mask = LVIF_TEXT;
+        lvi.iItem = (int)i;
+        lvi.pszText = (LPWSTR)mirror.url.c_str();
+        int index = ListView_InsertItem(hList, &lvi);
+        ListView_SetItemText(hList, index, 1, (LPWSTR)mirror.path.c_str());
+        ListView_SetItemText(hList, index, 2, (LPWSTR)mirror.resolution.c_str());
+        ListView_SetItemText(hList, index, 3, (LPWSTR)mirror.status.c_str());
+    }
+    if (selected >= 0) {
+        ListView_SetItemState(hList, selected, LVIS_SELECTED, LVIS_SELECTED);
+    }
+}
+
+// Enable the buttons that change the mirror list only while no sync is running
+void UpdateMirrorButtons(HWND hDlg) {
+    BOOL idle = g_mirrorSyncRunning ? FALSE : TRUE;
+    EnableWindow(GetDlgItem(hDlg, IDC_BUTTON_MIRROR_ADD), idle);
+    EnableWindow(GetDlgItem(hDlg, IDC_BUTTON_MIRROR_REMOVE), idle);
+    EnableWindow(GetDlgItem(hDlg, IDC_BUTTON_MIRROR_SYNC), idle);
+}
+
+// Dialog procedure for playlist mirrors
+INT_PTR CALLBACK MirrorsProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
+    UNREFERENCED_PARAMETER(lParam);
+    switch (message) {
+    case WM_INITDIALOG: {
+        g_hMirrorsDlg = hDlg;
+        HWND hList = GetDlgItem(hDlg, IDC_MIRROR_LIST);
+        ListView_SetExtendedListViewStyle(hList, LVS_EX_FULLROWSELECT | LVS_EX_GRIDLINES);
+
+        LVCOLUMNW lvc = { 0 };
+        lvc.mask = LVCF_TEXT | LVCF_WIDTH;
+        lvc.pszText = (LPWSTR)L"Playlist";
+        lvc.cx = 190;
+        ListView_InsertColumn(hList, 0, &lvc);
+
+        lvc.pszText = (LPWSTR)L"Folder";
+        lvc.cx = 150;
+        ListView_InsertColumn(hList, 1, &lvc);
+
+        lvc.pszText = (LPWSTR)L"Quality";
+        lvc.cx = 60;
+        ListView_InsertColumn(hList, 2, &lvc);
+
+        lvc.pszText = (LPWSTR)L"Last Sync";
+        lvc.cx = 160;
+        ListView_InsertColumn(hList, 3, &lvc);
+
+        CheckDlgButton(hDlg, IDC_CHECK_MIRROR_REPORT, g_mirrorReportRemoved ? BST_CHECKED : BST_UNCHECKED);
+        RefreshMirrorList(hDlg);
+        UpdateMirrorButtons(hDlg);
+        return (INT_PTR)TRUE;
+    }
+
+    case WM_APP_MIRROR_STATUS:
+        RefreshMirrorList(hDlg);
+        return (INT_PTR)TRUE;
+
+    case WM_APP_MIRROR_SYNC_DONE:
+        RefreshMirrorList(hDlg);
+        UpdateMirrorButtons(hDlg);
+        ShowDownloadManager();
         return (INT_PTR)TRUE;
+
     case WM_COMMAND:
-        if (LOWORD(wParam) == IDOK) {
-            g_settings.adBlockOnStartup = IsDlgButtonChecked(hDlg, IDC_CHECK_ADBLOCK_STARTUP) == BST_CHECKED;
-            
-            // Get theme mode from radio buttons
-            if (IsDlgButtonChecked(hDlg, IDC_RADIO_LIGHT_MODE) == BST_CHECKED) {
-                g_settings.themeMode = AppSettings::ThemeMode::Light;
+        if (LOWORD(wParam) == IDC_BUTTON_MIRROR_ADD) {
+            std::wstring url = GetCurrentWebViewUrl();
+            std::wstring listId = ClassifyYouTubeUrl(url).playlistId;
+            if (listId.empty()) {
+                MessageBox(hDlg, L"Please navigate to a YouTube playlist page or a video that's part of a playlist.",
+                           L"Playlist Mirrors", MB_OK | MB_ICONINFORMATION);
+                return (INT_PTR)TRUE;
             }
-            else if (IsDlgButtonChecked(hDlg, IDC_RADIO_DARK_MODE) == BST_CHECKED) {
-                g_settings.themeMode = AppSettings::ThemeMode::Dark;
+
+            PlaylistMirror mirror;
+            mirror.url = L"https://www.youtube.com/playlist?list=" + listId;
+            {
+                std::lock_guard<std::mutex> lock(g_mirrorsMutex);
+                for (const auto& existing : g_mirrors) {
+                    if (existing.url == mirror.url) {
+                        MessageBox(hDlg, L"This playlist is already mirrored.", L"Playlist Mirrors", MB_OK | MB_ICONINFORMATION);
+                        return (INT_PTR)TRUE;
+                    }
+                }
             }
-            else if (IsDlgButtonChecked(hDlg, IDC_RADIO_SYSTEM_THEME) == BST_CHECKED) {
-                g_settings.themeMode = AppSettings::ThemeMode::System;
+
+            // Reuse the download options dialog for the folder, quality and subtitles
+            DownloadOptions options = { nullptr, L"Best", g_settings.defaultDownloadPath, L"", false };
+            if (DialogBoxParam(hInst, MAKEINTRESOURCE(IDD_DOWNLOAD_OPTIONS), hDlg, DownloadOptionsProc, (LPARAM)&options) != IDOK) {
+                return (INT_PTR)TRUE;
             }
-            
-            wchar_t path[MAX_PATH];
-            GetDlgItemText(hDlg, IDC_EDIT_DEFAULT_PATH, path, MAX_PATH);
-            g_settings.defaultDownloadPath = path;
-            SaveSettings(); // Save settings when OK is clicked
-            
-            // Apply theme based on settings
-            ApplyThemeMode();
-            
-            EndDialog(hDlg, IDOK);
+            if (options.path.empty()) {
+                MessageBox(hDlg, L"Please choose a folder for the mirror.", L"Playlist Mirrors", MB_OK | MB_ICONINFORMATION);
+                return (INT_PTR)TRUE;
+            }
+            mirror.path = options.path;
+            mirror.resolution = options.resolution;
+            mirror.downloadSubtitles = options.downloadSubtitles;
+            {
+                std::lock_guard<std::mutex> lock(g_mirrorsMutex);
+                g_mirrors.push_back(mirror);
+            }
+            SaveMirrors();
+            RefreshMirrorList(hDlg);
             return (INT_PTR)TRUE;
         }
-        if (LOWORD(wParam) == IDCANCEL) {
-            EndDialog(hDlg, IDCANCEL);
+        else if (LOWORD(wParam) == IDC_BUTTON_MIRROR_REMOVE) {
+            int selected = ListView_GetNextItem(GetDlgItem(hDlg, IDC_MIRROR_LIST), -1, LVNI_SELECTED);
+            if (selected >= 0) {
+                {
+                    std::lock_guard<std::mutex> lock(g_mirrorsMutex);
+                    if (selected < (int)g_mirrors.size()) {
+                        g_mirrors.erase(g_mirrors.begin() + selected);
+                    }
+                }
+                SaveMirrors();
+                RefreshMirrorList(hDlg);
+            }
             return (INT_PTR)TRUE;
         }
-        if (LOWORD(wParam) == IDC_BUTTON_DEFAULT_BROWSE) {
-            BROWSEINFOW bi = { 0 };
-            bi.lpszTitle = L"Select a default download folder";
-            bi.ulFlags = BIF_RETURNONLYFSDIRS | BIF_NEWDIALOGSTYLE;
-            LPITEMIDLIST pidl = SHBrowseForFolderW(&bi);
-            if (pidl) {
-                wchar_t path[MAX_PATH];
-                if (SHGetPathFromIDListW(pidl, path)) {
-                    SetDlgItemText(hDlg, IDC_EDIT_DEFAULT_PATH, path);
+        else if (LOWORD(wParam) == IDC_BUTTON_MIRROR_SYNC) {
+            if (!g_mirrorSyncRunning) {
+                g_mirrorSyncRunning = true;
+                HANDLE hThread = CreateThread(NULL, 0, MirrorSyncThread, g_mirrorReportRemoved ? (LPVOID)1 : NULL, 0, NULL);
+                if (hThread) {
+                    CloseHandle(hThread);
+                } else {
+                    g_mirrorSyncRunning = false;
                 }
-                CoTaskMemFree(pidl);
+                UpdateMirrorButtons(hDlg);
             }
+            return (INT_PTR)TRUE;
+        }
+        else if (LOWORD(wParam) == IDC_CHECK_MIRROR_REPORT) {
+            g_mirrorReportRemoved = IsDlgButtonChecked(hDlg, IDC_CHECK_MIRROR_REPORT) == BST_CHECKED;
+            SaveMirrors();
+            return (INT_PTR)TRUE;
+        }
+        else if (LOWORD(wParam) == IDOK || LOWORD(wParam) == IDCANCEL) {
+            EndDialog(hDlg, LOWORD(wParam));
+            return (INT_PTR)TRUE;
         }
         break;
+
+    case WM_DESTROY:
+        g_hMirrorsDlg = NULL;
+        break;
     }
     return (INT_PTR)FALSE;
 }
 
-// Helper to resize WebView2 when window size changes
-void ResizeWebView2(HWND hWnd) {
-    if (g_webViewController) {
-        RECT bounds;
-        GetClientRect(hWnd, &bounds);
-        g_webViewController->put_Bounds(bounds);
-    }
-}
+// Library index: the media files under the default download folder and the video IDs they hold,
+// so playlists can show what is already on disk. The folder is scanned once; after that a
+// ReadDirectoryChangesW watch keeps the index current. The index is saved to library.json
+// and a file whose size and modification time haven't changed keeps its saved ID, so a
+// restart only lists the folder instead of opening every file again.
+struct LibraryFile {
+    std::wstring videoId;       // Empty if neither the name nor the metadata gave one away
+    ULONGLONG size;
+    ULONGLONG modified;         // FILETIME
+};
 
-// Helper function to inject ad-blocking JavaScript
-void InjectAdBlockScript() {
-    if (g_webView) {
-        // This script uses a MutationObserver to remove ads as they are dynamically added to the page.
-        // It targets a wider range of ad-related selectors for better coverage.
-        std::wstring script = LR"(
-            const adSelectors = [
-                '.ad-showing',
-                '.video-ads',
-                'ytd-ad-slot-renderer',
-                'ytd-promoted-sparkles-web-renderer',
-                'ytd-in-feed-ad-layout-renderer',
-                '#player-ads',
-                '#masthead-ad',
-                '.ytd-ad-slot-renderer',
-                '.ytp-ad-module'
-            ];
+std::unordered_map<std::wstring, LibraryFile> g_libraryFiles;  // Lowercase path relative to the root
+std::unordered_map<std::wstring, int> g_libraryIds;            // Video ID -> files holding it
+std::wstring g_libraryRoot;
+bool g_libraryDirty = false;
+std::mutex g_libraryMutex;
+HANDLE g_hLibraryStopEvent = NULL;
+HANDLE g_hLibraryThread = NULL;
 
-            const removeAds = () => {
-                const ads = document.querySelectorAll(adSelectors.join(', '));
-                ads.forEach(ad => {
-                    let parent = ad.parentElement;
-                    while (parent && parent.tagName.toLowerCase() !== 'ytd-rich-item-renderer' && parent.tagName.toLowerCase() !== 'ytd-video-renderer' && parent.tagName.toLowerCase() !== 'body') {
-                        parent = parent.parentElement;
-                    }
-                    if (parent && (parent.tagName.toLowerCase() === 'ytd-rich-item-renderer' || parent.tagName.toLowerCase() === 'ytd-video-renderer')) {
-                        parent.style.display = 'none';
-                    } else {
-                        ad.style.display = 'none';
-                    }
-                });
-            };
+const size_t kLibrarySniffBytes = 64 * 1024;   // yt-dlp's metadata tags sit in the first few KB
+const DWORD kLibrarySaveDelayMs = 30000;        // Batch saves while a download is writing files
 
-            const observer = new MutationObserver((mutations) => {
-                removeAds();
-            });
+// Helper function to check whether a file name has an extension the library indexes
+bool IsLibraryMediaFile(const std::wstring& fileName) {
+    std::wstring ext = GetFileExtension(fileName);
+    for (auto& c : ext) c = towlower(c);
+    return ext == L"mp4" || ext == L"m4a" || ext == L"mkv" || ext == L"webm" ||
+           ext == L"mp3" || ext == L"opus" || ext == L"ogg";
+}
 
-            observer.observe(document.body, {
-                childList: true,
-                subtree: true
-            });
+// Helper function to find a video ID in a media file's embedded metadata: yt-dlp --embed-metadata
+// stores the watch URL in the purl/comment tags, near the start of the file
+std::wstring SniffVideoIdFromMetadata(const std::wstring& path) {
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return L"";
+    }
+    std::string buffer(kLibrarySniffBytes, '\0');
+    DWORD bytesRead = 0;
+    BOOL ok = ReadFile(hFile, &buffer[0], (DWORD)buffer.size(), &bytesRead, NULL);
+    CloseHandle(hFile);
+    if (!ok) {
+        return L"";
+    }
+    buffer.resize(bytesRead);
 
-            // Initial cleanup
-            removeAds();
-        )";
-        g_webView->AddScriptToExecuteOnDocumentCreated(script.c_str(), nullptr);
+    for (const char* marker : { "watch?v=", "youtu.be/" }) {
+        size_t pos = 0;
+        while ((pos = buffer.find(marker, pos)) != std::string::npos) {
+            pos += strlen(marker);
+            size_t idEnd = pos;
+            while (idEnd < buffer.size() && IsYouTubeIdChar(buffer[idEnd])) idEnd++;
+            if (idEnd - pos == 11) {
+                return std::wstring(buffer.begin() + pos, buffer.begin() + idEnd);
+            }
+        }
     }
+    return L"";
 }
 
-void ToggleDarkMode() {
-    if (g_settings.themeMode == AppSettings::ThemeMode::Dark) {
-        SetLightMode();
-    } else {
-        SetDarkMode();
+// Helper function to lowercase a path so it can key the index the way NTFS compares names
+std::wstring LibraryKey(const std::wstring& relativePath) {
+    std::wstring key = relativePath;
+    if (!key.empty()) {
+        CharLowerBuffW(&key[0], (DWORD)key.size());
     }
+    return key;
 }
 
-void TogglePictureInPicture() {
-    if (g_webView) {
-        // This script attempts to find the primary video element and request picture-in-picture.
-        std::wstring script = LR"(
-            const video = document.querySelector('video');
-            if (video && document.pictureInPictureElement !== video) {
-                video.requestPictureInPicture();
-            } else if (document.pictureInPictureElement) {
-                document.exitPictureInPicture();
+// Helper function to add, replace or remove (file == nullptr) an index entry. Caller holds g_libraryMutex.
+void SetLibraryFileLocked(const std::wstring& key, const LibraryFile* file) {
+    auto it = g_libraryFiles.find(key);
+    if (it != g_libraryFiles.end()) {
+        if (!it->second.videoId.empty() && --g_libraryIds[it->second.videoId] <= 0) {
+            g_libraryIds.erase(it->second.videoId);
+        }
+        if (!file) {
+            g_libraryFiles.erase(it);
+        }
+    }
+    if (file) {
+        g_libraryFiles[key] = *file;
+        if (!file->videoId.empty()) {
+            g_libraryIds[file->videoId]++;
+        }
+    }
+    g_libraryDirty = true;
+}
+
+// Helper function to index one file, reusing the known ID when the file hasn't changed
+void IndexLibraryFile(const std::wstring& relativePath, ULONGLONG size, ULONGLONG modified) {
+    std::wstring key = LibraryKey(relativePath);
+    {
+        std::lock_guard<std::mutex> lock(g_libraryMutex);
+        auto it = g_libraryFiles.find(key);
+        if (it != g_libraryFiles.end() && it->second.size == size && it->second.modified == modified) {
+            return;
+        }
+    }
+
+    LibraryFile file = { L"", size, modified };
+    size_t slash = relativePath.find_last_of(L'\\');
+    file.videoId = ExtractVideoIdFromFilename(slash == std::wstring::npos ? relativePath : relativePath.substr(slash + 1));
+    if (file.videoId.empty()) {
+        file.videoId = SniffVideoIdFromMetadata(g_libraryRoot + L"\\" + relativePath);
+    }
+    std::lock_guard<std::mutex> lock(g_libraryMutex);
+    SetLibraryFileLocked(key, &file);
+}
+
+// Helper function to index a folder and everything below it. Keys of the files found are added to
+// seen so a full scan can drop entries for files that went away while the app wasn't running.
+bool ScanLibraryFolder(const std::wstring& relativeFolder, std::unordered_set<std::wstring>* seen) {
+    std::vector<std::wstring> pending(1, relativeFolder);
+    while (!pending.empty()) {
+        std::wstring folder = pending.back();
+        pending.pop_back();
+        std::wstring prefix = folder.empty() ? L"" : folder + L"\\";
+
+        WIN32_FIND_DATAW findData;
+        HANDLE hFind = FindFirstFileExW((g_libraryRoot + L"\\" + prefix + L"*").c_str(), FindExInfoBasic, &findData,
+                                        FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+        if (hFind == INVALID_HANDLE_VALUE) {
+            continue;
+        }
+        do {
+            // A single folder can hold thousands of files, so shutdown is checked for each one
+            if (WaitForSingleObject(g_hLibraryStopEvent, 0) == WAIT_OBJECT_0) {
+                FindClose(hFind);
+                return false;
             }
-        )";
-        g_webView->ExecuteScript(script.c_str(), nullptr);
+            if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                // Junctions could loop back into the library
+                if (wcscmp(findData.cFileName, L".") != 0 && wcscmp(findData.cFileName, L"..") != 0 &&
+                    !(findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+                    pending.push_back(prefix + findData.cFileName);
+                }
+                continue;
+            }
+            if (!IsLibraryMediaFile(findData.cFileName)) continue;
+            std::wstring relativePath = prefix + findData.cFileName;
+            IndexLibraryFile(relativePath,
+                             ((ULONGLONG)findData.nFileSizeHigh << 32) | findData.nFileSizeLow,
+                             ((ULONGLONG)findData.ftLastWriteTime.dwHighDateTime << 32) | findData.ftLastWriteTime.dwLowDateTime);
+            if (seen) seen->insert(LibraryKey(relativePath));
+        } while (FindNextFileW(hFind, &findData));
+        FindClose(hFind);
     }
+    return true;
 }
 
-void ToggleAudioOnlyPlayer() {
-    if (g_webViewController) {
-        g_isAudioOnly = !g_isAudioOnly;
-        g_webViewController->put_IsVisible(!g_isAudioOnly);
+// Helper function to bring one changed path up to date: a file is indexed again, a folder that
+// arrived is scanned, and a path that no longer exists is dropped along with anything below it
+void RefreshLibraryPath(const std::wstring& relativePath, bool arrived) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (GetFileAttributesExW((g_libraryRoot + L"\\" + relativePath).c_str(), GetFileExInfoStandard, &data)) {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            // A folder moved or copied in arrives as a single notification for the folder.
+            // Folders also report a change whenever their files do; those are covered by the files' own.
+            if (arrived && !(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+                ScanLibraryFolder(relativePath, nullptr);
+            }
+        }
+        else if (IsLibraryMediaFile(relativePath)) {
+            IndexLibraryFile(relativePath,
+                             ((ULONGLONG)data.nFileSizeHigh << 32) | data.nFileSizeLow,
+                             ((ULONGLONG)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime);
+        }
+        return;
+    }
+
+    std::wstring key = LibraryKey(relativePath);
+    std::lock_guard<std::mutex> lock(g_libraryMutex);
+    if (g_libraryFiles.count(key)) {
+        SetLibraryFileLocked(key, nullptr);
+        return;
+    }
+    std::wstring folderPrefix = key + L"\\";
+    std::vector<std::wstring> removed;
+    for (const auto& entry : g_libraryFiles) {
+        if (entry.first.compare(0, folderPrefix.size(), folderPrefix) == 0) {
+            removed.push_back(entry.first);
+        }
+    }
+    for (const auto& removedKey : removed) {
+        SetLibraryFileLocked(removedKey, nullptr);
     }
 }
 
-// Helper to get current URL from WebView2
-std::wstring GetCurrentWebViewUrl() {
-    if (!g_webView) return L"";
-    LPWSTR uri = nullptr;
-    if (SUCCEEDED(g_webView->get_Source(&uri)) && uri) {
-        std::wstring result(uri);
-        CoTaskMemFree(uri);
-        return result;
+// Helper function to save the index, if it changed, for the next start
+void SaveLibraryIndex() {
+    nlohmann::json files = nlohmann::json::array();
+    std::wstring root;
+    {
+        std::lock_guard<std::mutex> lock(g_libraryMutex);
+        if (!g_libraryDirty) {
+            return;
+        }
+        g_libraryDirty = false;
+        root = g_libraryRoot;
+        for (const auto& entry : g_libraryFiles) {
+            files.push_back({ WideToUtf8(entry.first), WideToUtf8(entry.second.videoId), entry.second.size, entry.second.modified });
+        }
+    }
+    nlohmann::json j = { { "root", WideToUtf8(root) }, { "files", files } };
+    std::wstring indexPath = GetAppDataFilePath(L"library.json");
+    if (indexPath.empty()) {
+        return;
+    }
+    // Write beside the target and swap it in, so a crash mid-write can't leave a truncated index
+    std::wstring tempPath = indexPath + L".tmp";
+    bool written;
+    {
+        std::ofstream file(tempPath, std::ios::binary);
+        file << j.dump();
+        written = file.good();
+    }
+    if (!written || !MoveFileExW(tempPath.c_str(), indexPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        DeleteFileW(tempPath.c_str());
+        std::lock_guard<std::mutex> lock(g_libraryMutex);
+        g_libraryDirty = true; // Try again with the next save
     }
-    return L"";
 }
 
-// Determine if system theme is dark mode
-bool IsSystemInDarkMode() {
-    DWORD value = 0;
-    DWORD dataSize = sizeof(value);
-    HKEY hKey;
-    
-    if (RegOpenKeyExW(HKEY_CURRENT_USER,
-        L"Software\\Microsoft\\Windows\\CurrentVersion\\Themes\\Personalize",
-        0, KEY_READ, &hKey) == ERROR_SUCCESS) {
-        
-        if (RegQueryValueExW(hKey, L"AppsUseLightTheme", nullptr, nullptr,
-            reinterpret_cast<LPBYTE>(&value), &dataSize) == ERROR_SUCCESS) {
-            RegCloseKey(hKey);
-            return value == 0; // 0 means dark theme is enabled
+// Helper function to load the saved index if it belongs to the current root
+void LoadLibraryIndex() {
+    std::ifstream file(GetAppDataFilePath(L"library.json"), std::ios::binary);
+    if (!file) {
+        return;
+    }
+    try {
+        nlohmann::json j = nlohmann::json::parse(file);
+        if (Utf8ToWide(j.value("root", "")) != g_libraryRoot) {
+            return;
         }
-        RegCloseKey(hKey);
+        std::lock_guard<std::mutex> lock(g_libraryMutex);
+        for (const auto& entry : j.at("files")) {
+            LibraryFile libraryFile = { Utf8ToWide(entry.at(1).get<std::string>()), entry.at(2).get<ULONGLONG>(), entry.at(3).get<ULONGLONG>() };
+            SetLibraryFileLocked(Utf8ToWide(entry.at(0).get<std::string>()), &libraryFile);
+        }
+        g_libraryDirty = false;
+    }
+    catch (...) {
+        // A damaged index is rebuilt by the scan
     }
-    
-    return false; // Default to light mode if registry read fails
 }
 
-// Apply theme based on current settings
-void ApplyThemeMode() {
-    if (!g_webView) return;
-    
-    bool shouldUseDarkMode = false;
-    
-    switch (g_settings.themeMode) {
-        case AppSettings::ThemeMode::Light:
-            shouldUseDarkMode = false;
-            break;
-        case AppSettings::ThemeMode::Dark:
-            shouldUseDarkMode = true;
-            break;
-        case AppSettings::ThemeMode::System:
-            shouldUseDarkMode = IsSystemInDarkMode();
-            break;
+// Background thread that scans the library once and then follows its change notifications
+DWORD WINAPI LibraryIndexThread(LPVOID lpParam) {
+    UNREFERENCED_PARAMETER(lpParam);
+    HANDLE hDirectory = CreateFileW(g_libraryRoot.c_str(), FILE_LIST_DIRECTORY,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                                    FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (hDirectory == INVALID_HANDLE_VALUE) {
+        return 1;
     }
-    
-    // Apply the appropriate theme
-    std::wstring script = LR"(
-        const html = document.documentElement;
-        if ()";
-    
-    script += shouldUseDarkMode ? L"true" : L"false";
-    
-    script += LR"() {
-            if (!html.hasAttribute('dark')) {
-                html.setAttribute('dark', 'true');
-            }
-        } else {
-            if (html.hasAttribute('dark')) {
-                html.removeAttribute('dark');
+    OVERLAPPED overlapped = { 0 };
+    overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    std::vector<DWORD> buffer(16 * 1024); // DWORD-aligned, as ReadDirectoryChangesW requires
+    const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+                         FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
+    auto watch = [&]() {
+        ResetEvent(overlapped.hEvent);
+        return ReadDirectoryChangesW(hDirectory, buffer.data(), (DWORD)(buffer.size() * sizeof(DWORD)), TRUE,
+                                     filter, NULL, &overlapped, NULL) != FALSE;
+    };
+
+    // The watch is armed before the scan, so files that change while it runs are caught up afterwards
+    bool watching = overlapped.hEvent && watch();
+    bool rescan = true;
+    ULONGLONG lastSave = GetTickCount64();
+    HANDLE handles[2] = { g_hLibraryStopEvent, overlapped.hEvent };
+    if (watching) {
+        LoadLibraryIndex();
+    }
+    while (watching) {
+        if (rescan) {
+            rescan = false;
+            std::unordered_set<std::wstring> seen;
+            if (!ScanLibraryFolder(L"", &seen)) {
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(g_libraryMutex);
+                std::vector<std::wstring> gone;
+                for (const auto& entry : g_libraryFiles) {
+                    if (!seen.count(entry.first)) gone.push_back(entry.first);
+                }
+                for (const auto& key : gone) {
+                    SetLibraryFileLocked(key, nullptr);
+                }
             }
+            SaveLibraryIndex();
+            lastSave = GetTickCount64();
         }
-    )";
-    
-    g_webView->ExecuteScript(script.c_str(), nullptr);
-}
 
-// Theme-related functions
-void SetLightMode() {
-    if (!g_webView) return;
-    
-    g_settings.themeMode = AppSettings::ThemeMode::Light;
-    SaveSettings();
-    
-    // Apply light theme to WebView
-    std::wstring script = LR"(
-        const html = document.documentElement;
-        if (html.hasAttribute('dark')) {
-            html.removeAttribute('dark');
+        DWORD wait = WaitForMultipleObjects(2, handles, FALSE, kLibrarySaveDelayMs);
+        if (wait == WAIT_OBJECT_0) {
+            break;
+        }
+        if (wait == WAIT_TIMEOUT) {
+            SaveLibraryIndex();
+            lastSave = GetTickCount64();
+            continue;
         }
-    )";
-    
-    g_webView->ExecuteScript(script.c_str(), nullptr);
-    MessageBox(nullptr, L"Light mode enabled", L"Theme Changed", MB_OK | MB_ICONINFORMATION);
-}
 
-void SetDarkMode() {
-    if (!g_webView) return;
-    
-    g_settings.themeMode = AppSettings::ThemeMode::Dark;
-    SaveSettings();
-    
-    // Apply dark theme to WebView
-    std::wstring script = LR"(
-        const html = document.documentElement;
-        if (!html.hasAttribute('dark')) {
-            html.setAttribute('dark', 'true');
+        DWORD bytes = 0;
+        if (!GetOverlappedResult(hDirectory, &overlapped, &bytes, FALSE)) {
+            break; // The folder itself went away
         }
-    )";
-    
-    g_webView->ExecuteScript(script.c_str(), nullptr);
-    MessageBox(nullptr, L"Dark mode enabled", L"Theme Changed", MB_OK | MB_ICONINFORMATION);
+        // Collect the batch first; a file being written reports many changes in one batch
+        std::unordered_map<std::wstring, bool> changed; // Path -> added or renamed into place
+        if (bytes == 0) {
+            rescan = true; // The buffer overflowed, so some changes are unknown
+        }
+        else {
+            const BYTE* record = (const BYTE*)buffer.data();
+            while (true) {
+                const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)record;
+                bool& arrived = changed[std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR))];
+                arrived = arrived || info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_RENAMED_NEW_NAME;
+                if (!info->NextEntryOffset) break;
+                record += info->NextEntryOffset;
+            }
+        }
+        watching = watch();
+        for (const auto& path : changed) {
+            RefreshLibraryPath(path.first, path.second);
+        }
+        if (GetTickCount64() - lastSave >= kLibrarySaveDelayMs) {
+            SaveLibraryIndex();
+            lastSave = GetTickCount64();
+        }
+    }
+
+    CancelIoEx(hDirectory, &overlapped);
+    if (overlapped.hEvent) {
+        DWORD bytes;
+        GetOverlappedResult(hDirectory, &overlapped, &bytes, TRUE);
+        CloseHandle(overlapped.hEvent);
+    }
+    CloseHandle(hDirectory);
+    SaveLibraryIndex();
+    return 0;
 }
 
-void UseSystemTheme() {
-    if (!g_webView) return;
-    
-    g_settings.themeMode = AppSettings::ThemeMode::System;
-    SaveSettings();
-    
-    // Apply theme based on system settings
-    ApplyThemeMode();
-    MessageBox(nullptr, L"Using system theme", L"Theme Changed", MB_OK | MB_ICONINFORMATION);
+// Stop the library watcher, saving what it has
+void StopLibraryIndex() {
+    if (!g_hLibraryThread) {
+        return;
+    }
+    SetEvent(g_hLibraryStopEvent);
+    WaitForSingleObject(g_hLibraryThread, INFINITE);
+    CloseHandle(g_hLibraryThread);
+    CloseHandle(g_hLibraryStopEvent);
+    g_hLibraryThread = NULL;
+    g_hLibraryStopEvent = NULL;
 }
 
-// Helper function to directly start a download
-void StartDownload(const std::wstring& url, HWND parentWindow = NULL) {
-    if (url.empty()) {
-        MessageBox(NULL, L"Cannot download empty URL.", L"Error", MB_OK | MB_ICONERROR);
+// Start indexing the default download folder; called at startup and again when the folder changes
+void StartLibraryIndex() {
+    std::wstring root = g_settings.defaultDownloadPath;
+    while (!root.empty() && (root.back() == L'\\' || root.back() == L'/')) {
+        root.pop_back();
+    }
+    if (g_hLibraryThread && root == g_libraryRoot) {
         return;
     }
-    
-    try {
-        DownloadOptions options;
-        options.resolution = L"Best";
-        options.path = g_settings.defaultDownloadPath;
-        options.videoUrl = url;
-        options.downloadSubtitles = false;
-        options.hProcess = NULL;
-        
-        if (!parentWindow) {
-            parentWindow = GetActiveWindow();
-        }
-        
-        if (DialogBoxParam(hInst, MAKEINTRESOURCE(IDD_DOWNLOAD_OPTIONS), parentWindow, 
-                         DownloadOptionsProc, (LPARAM)&options) == IDOK) {
-            // Start the download with progress dialog (modeless)
-            HWND hProgress = CreateDialogParam(hInst, MAKEINTRESOURCE(IDD_DOWNLOAD_PROGRESS), parentWindow, DownloadProgressProc, (LPARAM)&options);
-            ShowWindow(hProgress, SW_SHOW);
-        }
+    StopLibraryIndex();
+    {
+        std::lock_guard<std::mutex> lock(g_libraryMutex);
+        g_libraryFiles.clear();
+        g_libraryIds.clear();
+        g_libraryDirty = false;
+        g_libraryRoot = root;
     }
-    catch (const std::exception& e) {
-        char buffer[256];
-        sprintf_s(buffer, "Failed to start download: %s", e.what());
-        
-        int size_needed = MultiByteToWideChar(CP_UTF8, 0, buffer, -1, NULL, 0);
-        std::wstring wErrorMsg(size_needed, 0);
-        MultiByteToWideChar(CP_UTF8, 0, buffer, -1, &wErrorMsg[0], size_needed);
-        
-        MessageBox(NULL, wErrorMsg.c_str(), L"Download Error", MB_OK | MB_ICONERROR);
+    if (root.empty()) {
+        return;
     }
-    catch (...) {
-        MessageBox(NULL, L"An unexpected error occurred when preparing download.", 
-                  L"Download Error", MB_OK | MB_ICONERROR);
+    g_hLibraryStopEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    g_hLibraryThread = g_hLibraryStopEvent ? CreateThread(NULL, 0, LibraryIndexThread, NULL, 0, NULL) : NULL;
+    if (!g_hLibraryThread && g_hLibraryStopEvent) {
+        CloseHandle(g_hLibraryStopEvent);
+        g_hLibraryStopEvent = NULL;
     }
 }
 
+// Helper function to check whether a video is already somewhere in the library
+bool IsVideoInLibrary(const std::wstring& videoId) {
+    std::lock_guard<std::mutex> lock(g_libraryMutex);
+    return g_libraryIds.count(videoId) != 0;
+}
+
 #define MAX_LOADSTRING 100
 
 // Global Variables:
@@ -1449,27 +5892,88 @@ BOOL                InitInstance(HINSTANCE, int);
 LRESULT CALLBACK    WndProc(HWND, UINT, WPARAM, LPARAM);
 INT_PTR CALLBACK    About(HWND, UINT, WPARAM, LPARAM);
 
-// New dialog procedure for the Download Manager
-INT_PTR CALLBACK DownloadManagerProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
-    static std::vector<DownloadItem*> downloadItems;
-    static std::pair<std::vector<std::wstring>, DownloadOptions>* managerData = nullptr;
+// Helper function to get the canonical watch URL for a pasted video link, empty if it isn't one
+std::wstring CanonicalVideoUrl(const std::wstring& text) {
+    YouTubeUrlInfo info = ClassifyYouTubeUrl(text);
+    if (!IsVideoUrlKind(info.kind)) {
+        return L"";
+    }
+    return L"https://www.youtube.com/watch?v=" + info.videoId;
+}
 
-    switch (message) {
-    case WM_INITDIALOG: {
-        managerData = (std::pair<std::vector<std::wstring>, DownloadOptions>*)lParam;
-        if (!managerData) {
-            EndDialog(hDlg, IDCANCEL);
-            return (INT_PTR)FALSE;
+// Text pasted into the Download Manager, handed to the thread that queues it
+struct BulkQueueJob {
+    HWND hDlg;
+    std::wstring text;
+};
+
+// Thread that splits a bulk paste into URLs, canonicalizes and deduplicates them (also against
+// downloads already pending) and queues the rest in one pass, keeping the dialog responsive
+DWORD WINAPI BulkQueueThread(LPVOID lpParam) {
+    std::unique_ptr<BulkQueueJob> job((BulkQueueJob*)lpParam);
+
+    DownloadOptions options;
+    options.hDlg = NULL;
+    options.resolution = L"Best";
+    options.path = g_settings.defaultDownloadPath;
+    options.downloadSubtitles = false;
+
+    std::unordered_set<std::wstring> seen;
+    GetPendingDownloadUrls(options.path, seen);
+    std::vector<std::wstring> urls;
+    size_t skipped = 0;
+    const std::wstring& text = job->text;
+    size_t start = 0;
+    while (start < text.size()) {
+        // Any whitespace separates entries, so lists copied from spreadsheets or chat work too
+        size_t end = text.find_first_of(L" \t\r\n", start);
+        if (end == std::wstring::npos) end = text.size();
+        if (end > start) {
+            std::wstring url = CanonicalVideoUrl(text.substr(start, end - start));
+            if (url.empty() || !seen.insert(url).second) {
+                skipped++;
+            } else {
+                urls.push_back(url);
+            }
         }
+        start = end + 1;
+    }
+
+    EnqueueDownloads(urls, options);
+    if (IsWindow(job->hDlg)) {
+        PostMessage(job->hDlg, WM_APP_BULK_QUEUED, (WPARAM)urls.size(), (LPARAM)skipped);
+    }
+    return 0;
+}
+
+// Display text for a download status
+const wchar_t* GetDownloadStatusText(DownloadStatus status) {
+    switch (status) {
+    case Queued: return L"Queued";
+    case Downloading: return L"Downloading";
+    case WaitingToProcess: return L"Waiting to process";
+    case Processing: return L"Processing";
+    case Completed: return L"Completed";
+    case Failed: return L"Failed";
+    case Cancelled: return L"Cancelled";
+    case Paused: return L"Paused";
+    }
+    return L"";
+}
 
+// Dialog procedure for the Download Manager. It is a modeless view over
+// g_downloadQueue: closing it hides the list, the downloads keep running.
+INT_PTR CALLBACK DownloadManagerProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
+    switch (message) {
+    case WM_INITDIALOG: {
         HWND hList = GetDlgItem(hDlg, IDC_DOWNLOAD_LIST);
         ListView_SetExtendedListViewStyle(hList, LVS_EX_FULLROWSELECT | LVS_EX_GRIDLINES);
 
         // Add columns
         LVCOLUMNW lvc = { 0 };
         lvc.mask = LVCF_TEXT | LVCF_WIDTH;
-        lvc.pszText = (LPWSTR)L"Video URL";
-        lvc.cx = 200;
+        lvc.pszText = (LPWSTR)L"Video";
+        lvc.cx = 220;
         ListView_InsertColumn(hList, 0, &lvc);
 
         lvc.pszText = (LPWSTR)L"Progress";
@@ -1480,35 +5984,29 @@ INT_PTR CALLBACK DownloadManagerProc(HWND hDlg, UINT message, WPARAM wParam, LPA
         lvc.cx = 100;
         ListView_InsertColumn(hList, 2, &lvc);
 
-        // Populate the list with videos to download
-        for (const auto& url : managerData->first) {
-            DownloadItem* newItem = new DownloadItem();
-            newItem->url = url;
-            newItem->resolution = managerData->second.resolution;
-            newItem->path = managerData->second.path;
-            newItem->downloadSubtitles = managerData->second.downloadSubtitles;
-            newItem->status = Downloading;
-            newItem->progress = 0;
-            newItem->hProcess = NULL;
-            newItem->hThread = NULL;
-            newItem->threadId = 0;
-            newItem->progressDlg = hDlg; // The manager is the dialog
-            newItem->startTime = 0;
-            downloadItems.push_back(newItem);
-
-            LVITEMW lvi = { 0 };
-            lvi.mask = LVIF_TEXT;
-            lvi.iItem = downloadItems.size() - 1;
-            lvi.pszText = (LPWSTR)url.c_str();
-            ListView_InsertItem(hList, &lvi);
-            ListView_SetItemText(hList, lvi.iItem, 1, (LPWSTR)L"0%");
-            ListView_SetItemText(hList, lvi.iItem, 2, (LPWSTR)L"Queued");
-        }
-
-        // Start the first download
-        if (!downloadItems.empty()) {
-            downloadItems[0]->startTime = GetTickCount();
-            downloadItems[0]->hThread = CreateThread(NULL, 0, DownloadThread, (LPVOID)downloadItems[0], 0, &downloadItems[0]->threadId);
+        lvc.pszText = (LPWSTR)L"Processing";
+        lvc.cx = 140;
+        ListView_InsertColumn(hList, 3, &lvc);
+
+        lvc.pszText = (LPWSTR)L"CPU Time";
+        lvc.cx = 70;
+        ListView_InsertColumn(hList, 4, &lvc);
+
+        lvc.pszText = (LPWSTR)L"Est. Size";
+        lvc.cx = 70;
+        ListView_InsertColumn(hList, 5, &lvc);
+
+        lvc.pszText = (LPWSTR)L"Speed";
+        lvc.cx = 70;
+        ListView_InsertColumn(hList, 6, &lvc);
+
+        // The default limit of 30,000 characters would cut a large paste short
+        SendDlgItemMessage(hDlg, IDC_EDIT_URLS, EM_SETLIMITTEXT, 0, 0);
+
+        // The list is virtual (LVS_OWNERDATA); rows are read from the queue on demand
+        {
+            std::lock_guard<std::mutex> lock(g_queueMutex);
+            ListView_SetItemCountEx(hList, (int)g_downloadQueue.size(), 0);
         }
 
         SetTimer(hDlg, 1, 1000, NULL); // Timer to update progress
@@ -1517,93 +6015,290 @@ INT_PTR CALLBACK DownloadManagerProc(HWND hDlg, UINT message, WPARAM wParam, LPA
 
     case WM_TIMER: {
         HWND hList = GetDlgItem(hDlg, IDC_DOWNLOAD_LIST);
-        bool allDone = true;
-        for (size_t i = 0; i < downloadItems.size(); ++i) {
-            DownloadItem* item = downloadItems[i];
-            if (item->status == Downloading) {
-                allDone = false;
-                wchar_t progressText[16];
-                swprintf_s(progressText, L"%.1f%%", item->progress);
-                ListView_SetItemText(hList, i, 1, progressText);
-
-                // If process finished but progress didn't reach 100, we'll still rely on status
-                if (item->progress >= 100.0) {
-                    item->status = Completed;
-                    ListView_SetItemText(hList, i, 2, (LPWSTR)L"Completed");
-                    // Start next download if not already started
-                    if (i + 1 < downloadItems.size()) {
-                        DownloadItem* nextItem = downloadItems[i + 1];
-                        if (nextItem->hThread == NULL && nextItem->status == Downloading) {
-                            nextItem->startTime = GetTickCount();
-                            nextItem->hThread = CreateThread(NULL, 0, DownloadThread, (LPVOID)nextItem, 0, &nextItem->threadId);
-                        }
-                    }
+        size_t count;
+        {
+            std::lock_guard<std::mutex> lock(g_queueMutex);
+            count = g_downloadQueue.size();
+        }
+        if ((int)count != ListView_GetItemCount(hList)) {
+            ListView_SetItemCountEx(hList, (int)count, LVSICF_NOSCROLL | LVSICF_NOINVALIDATEALL);
+        }
+        InvalidateRect(hList, NULL, FALSE);
+
+        std::wstring caption = L"Download Manager";
+        int restarts = g_throttleRestarts;
+        if (restarts > 0) {
+            caption += L" - " + std::to_wstring(restarts) + L" throttled restart" + (restarts == 1 ? L"" : L"s");
+        }
+        long long reclaimed = g_dedupReclaimedBytes;
+        if (reclaimed > 0) {
+            caption += L" - " + FormatFileSize((double)reclaimed) + L" reclaimed by deduplication";
+        }
+        if (restarts > 0 || reclaimed > 0) {
+            SetWindowText(hDlg, caption.c_str());
+        }
+        return (INT_PTR)TRUE;
+    }
+
+    case WM_NOTIFY: {
+        NMHDR* pnmhdr = (NMHDR*)lParam;
+        if (pnmhdr->idFrom == IDC_DOWNLOAD_LIST && pnmhdr->code == LVN_GETDISPINFO) {
+            NMLVDISPINFOW* pdi = (NMLVDISPINFOW*)lParam;
+            if (!(pdi->item.mask & LVIF_TEXT)) {
+                break;
+            }
+
+            std::wstring text;
+            {
+                std::lock_guard<std::mutex> lock(g_queueMutex);
+                int row = pdi->item.iItem;
+                if (row < 0 || row >= (int)g_downloadQueue.size()) {
+                    break;
                 }
-            } else if (item->status == Completed) {
-                // Ensure UI shows completed and progress set to 100
-                ListView_SetItemText(hList, i, 2, (LPWSTR)L"Completed");
-                ListView_SetItemText(hList, i, 1, (LPWSTR)L"100.0%");
-                // Start next download if not already started
-                if (i + 1 < downloadItems.size()) {
-                    DownloadItem* nextItem = downloadItems[i + 1];
-                    if (nextItem->hThread == NULL && nextItem->status == Downloading) {
-                        nextItem->startTime = GetTickCount();
-                        nextItem->hThread = CreateThread(NULL, 0, DownloadThread, (LPVOID)nextItem, 0, &nextItem->threadId);
-                        allDone = false;
-                    }
+                const DownloadItem* item = g_downloadQueue[row];
+                switch (pdi->item.iSubItem) {
+                case 0:
+                    text = item->title.empty() ? item->url : item->title;
+                    break;
+                case 1: {
+                    wchar_t progressText[16];
+                    swprintf_s(progressText, L"%.1f%%", item->status == Completed ? 100.0 : item->progress);
+                    text = progressText;
+                    break;
                 }
-            } else if (item->status == Failed) {
-                ListView_SetItemText(hList, i, 2, (LPWSTR)L"Failed");
-                // If a failed item hasn't started next, start it
-                if (i + 1 < downloadItems.size()) {
-                    DownloadItem* nextItem = downloadItems[i + 1];
-                    if (nextItem->hThread == NULL && nextItem->status == Downloading) {
-                        nextItem->startTime = GetTickCount();
-                        nextItem->hThread = CreateThread(NULL, 0, DownloadThread, (LPVOID)nextItem, 0, &nextItem->threadId);
-                        allDone = false;
+                case 2:
+                    text = GetDownloadStatusText(item->status);
+                    break;
+                case 3:
+                    text = item->plan;
+                    break;
+                case 4:
+                    if (item->cpuSeconds > 0) {
+                        wchar_t cpuText[32];
+                        swprintf_s(cpuText, L"%.1f s", item->cpuSeconds);
+                        text = cpuText;
+                    }
+                    break;
+                case 5:
+                    text = FormatFileSize(item->estimatedSize);
+                    break;
+                case 6:
+                    if (item->status == Downloading && item->speed > 0) {
+                        text = FormatFileSize(item->speed) + L"/s";
                     }
+                    break;
                 }
             }
+            wcsncpy_s(pdi->item.pszText, pdi->item.cchTextMax, text.c_str(), _TRUNCATE);
         }
-        if (allDone) {
-            KillTimer(hDlg, 1);
+        break;
+    }
+
+    case WM_APP_BULK_QUEUED: {
+        std::wstring result = std::to_wstring(wParam) + L" video(s) queued";
+        if (lParam > 0) {
+            result += L", " + std::to_wstring(lParam) + L" duplicate or unrecognized entries skipped";
         }
+        SetDlgItemText(hDlg, IDC_STATIC_QUEUE_RESULT, result.c_str());
+        EnableWindow(GetDlgItem(hDlg, IDC_BUTTON_QUEUE), TRUE);
         return (INT_PTR)TRUE;
     }
 
     case WM_COMMAND:
-        if (LOWORD(wParam) == IDOK || LOWORD(wParam) == IDCANCEL) {
-            KillTimer(hDlg, 1);
-            for (auto& item : downloadItems) {
-                if (item->hThread) {
-                    if (item->hProcess) TerminateProcess(item->hProcess, 1);
-                    CloseHandle(item->hThread);
-                }
-                delete item;
+        if (LOWORD(wParam) == IDC_BUTTON_QUEUE) {
+            HWND hEdit = GetDlgItem(hDlg, IDC_EDIT_URLS);
+            int length = GetWindowTextLength(hEdit);
+            if (length == 0) {
+                return (INT_PTR)TRUE;
+            }
+            BulkQueueJob* job = new BulkQueueJob();
+            job->hDlg = hDlg;
+            job->text.resize(length + 1);
+            job->text.resize(GetWindowText(hEdit, &job->text[0], length + 1));
+            SetWindowText(hEdit, L"");
+            EnableWindow(GetDlgItem(hDlg, IDC_BUTTON_QUEUE), FALSE);
+            SetDlgItemText(hDlg, IDC_STATIC_QUEUE_RESULT, L"Queueing...");
+
+            HANDLE hThread = CreateThread(NULL, 0, BulkQueueThread, job, 0, NULL);
+            if (hThread) {
+                CloseHandle(hThread);
+            } else {
+                delete job;
+                EnableWindow(GetDlgItem(hDlg, IDC_BUTTON_QUEUE), TRUE);
             }
-            downloadItems.clear();
-            delete managerData;
-            EndDialog(hDlg, LOWORD(wParam));
+            return (INT_PTR)TRUE;
+        }
+        if (LOWORD(wParam) == IDOK || LOWORD(wParam) == IDCANCEL) {
+            DestroyWindow(hDlg);
             return (INT_PTR)TRUE;
         }
         break;
 
     case WM_DESTROY:
         KillTimer(hDlg, 1);
-        for (auto& item : downloadItems) {
-            if (item->hThread) {
-                if (item->hProcess) TerminateProcess(item->hProcess, 1);
-                CloseHandle(item->hThread);
-            }
-            delete item;
-        }
-        downloadItems.clear();
-        if(managerData) delete managerData;
+        g_hDownloadManager = NULL;
         break;
     }
     return (INT_PTR)FALSE;
 }
 
+// Show the Download Manager, creating it if it isn't open yet
+void ShowDownloadManager() {
+    if (!g_hDownloadManager) {
+        g_hDownloadManager = CreateDialog(hInst, MAKEINTRESOURCE(IDD_DOWNLOAD_MANAGER), g_hMainWnd, DownloadManagerProc);
+    }
+    if (g_hDownloadManager) {
+        ShowWindow(g_hDownloadManager, SW_SHOW);
+        SetForegroundWindow(g_hDownloadManager);
+    }
+}
+
+// Single instance. The first process owns a mutex and a named pipe; later launches send their
+// command-line URLs down the pipe and exit before any of the expensive startup runs.
+const wchar_t* kInstanceMutexName = L"Local\\YoutubePlus.SingleInstance";
+HANDLE g_hInstanceMutex = NULL;
+HANDLE g_hInstancePipe = INVALID_HANDLE_VALUE; // Created with the mutex; InstancePipeThread takes it over
+
+// Helper function to get the pipe name; pipe names are machine-wide, so it includes the session
+std::wstring GetInstancePipeName() {
+    DWORD sessionId = 0;
+    ProcessIdToSessionId(GetCurrentProcessId(), &sessionId);
+    return L"\\\\.\\pipe\\YoutubePlus.Instance." + std::to_wstring(sessionId);
+}
+
+// Helper function to create one instance of the pipe later launches write to
+HANDLE CreateInstancePipe() {
+    return CreateNamedPipeW(GetInstancePipeName().c_str(), PIPE_ACCESS_INBOUND,
+                            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                            PIPE_UNLIMITED_INSTANCES, 0, 4096, 0, NULL);
+}
+
+// Helper function to collect the YouTube URLs passed on the command line
+void GetCommandLineUrls(std::vector<std::wstring>& urls) {
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (!argv) {
+        return;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (IsYouTubeUrl(argv[i])) {
+            urls.push_back(argv[i]);
+        }
+    }
+    LocalFree(argv);
+}
+
+// Helper function to queue URLs with the default options; returns how many were queued.
+// Like a bulk paste, links are canonicalized and deduplicated (also against downloads already
+// pending); playlist-only links are skipped, since each queue item downloads one video.
+int EnqueueCommandLineUrls(const std::vector<std::wstring>& urls) {
+    DownloadOptions options;
+    options.hDlg = NULL;
+    options.resolution = L"Best";
+    options.path = g_settings.defaultDownloadPath;
+    options.downloadSubtitles = false;
+
+    std::unordered_set<std::wstring> seen;
+    GetPendingDownloadUrls(options.path, seen);
+    std::vector<std::wstring> videoUrls;
+    for (const auto& url : urls) {
+        std::wstring videoUrl = CanonicalVideoUrl(url);
+        if (!videoUrl.empty() && seen.insert(videoUrl).second) {
+            videoUrls.push_back(videoUrl);
+        }
+    }
+    EnqueueDownloads(videoUrls, options);
+    return (int)videoUrls.size();
+}
+
+// Claim the single-instance mutex and create the pipe at once, so a later launch can connect
+// while this one is still starting up; what it writes waits in the pipe until the queue is loaded.
+// If another instance holds the mutex, hand it this launch's URLs (one UTF-8 line each) and
+// return false so the caller exits.
+bool ClaimSingleInstance() {
+    g_hInstanceMutex = CreateMutexW(NULL, FALSE, kInstanceMutexName);
+    if (!g_hInstanceMutex || GetLastError() != ERROR_ALREADY_EXISTS) {
+        g_hInstancePipe = CreateInstancePipe();
+        return true;
+    }
+
+    std::vector<std::wstring> urls;
+    GetCommandLineUrls(urls);
+    std::string message;
+    for (const auto& url : urls) {
+        message += WideToUtf8(url) + "\n";
+    }
+
+    // The running instance creates the pipe right after the mutex, or is busy with another launch
+    std::wstring pipeName = GetInstancePipeName();
+    HANDLE hPipe = INVALID_HANDLE_VALUE;
+    for (int attempt = 0; attempt < 50 && hPipe == INVALID_HANDLE_VALUE; attempt++) {
+        hPipe = CreateFileW(pipeName.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (hPipe == INVALID_HANDLE_VALUE && !WaitNamedPipeW(pipeName.c_str(), 100)) {
+            Sleep(100);
+        }
+    }
+    if (hPipe == INVALID_HANDLE_VALUE) {
+        // A second instance would share the queue, archive and settings files with the first
+        MessageBox(nullptr, L"YoutubePlus is already running but is not responding.", L"YoutubePlus",
+                   MB_OK | MB_ICONWARNING);
+        return false;
+    }
+
+    // Let the running instance bring its window to the front
+    AllowSetForegroundWindow(ASFW_ANY);
+    DWORD written = 0;
+    WriteFile(hPipe, message.data(), (DWORD)message.size(), &written, NULL);
+    CloseHandle(hPipe);
+    return false;
+}
+
+// Thread that receives URLs from later launches and queues them
+DWORD WINAPI InstancePipeThread(LPVOID lpParam) {
+    UNREFERENCED_PARAMETER(lpParam);
+    while (true) {
+        HANDLE hPipe = g_hInstancePipe != INVALID_HANDLE_VALUE ? g_hInstancePipe : CreateInstancePipe();
+        g_hInstancePipe = INVALID_HANDLE_VALUE;
+        if (hPipe == INVALID_HANDLE_VALUE) {
+            return 1;
+        }
+        // A launch during startup may have written its URLs and closed already; they are still in the pipe
+        if (!ConnectNamedPipe(hPipe, NULL) && GetLastError() != ERROR_PIPE_CONNECTED && GetLastError() != ERROR_NO_DATA) {
+            CloseHandle(hPipe);
+            continue;
+        }
+
+        std::string message;
+        char buffer[4096];
+        DWORD bytesRead = 0;
+        while (ReadFile(hPipe, buffer, sizeof(buffer), &bytesRead, NULL) && bytesRead > 0 && message.size() < 1024 * 1024) {
+            message.append(buffer, bytesRead);
+        }
+        DisconnectNamedPipe(hPipe);
+        CloseHandle(hPipe);
+
+        std::vector<std::wstring> urls;
+        std::istringstream lines(message);
+        std::string line;
+        while (std::getline(lines, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty()) {
+                urls.push_back(Utf8ToWide(line));
+            }
+        }
+        int queued = EnqueueCommandLineUrls(urls);
+        PostMessage(g_hMainWnd, WM_APP_INSTANCE_ACTIVATE, (WPARAM)queued, 0);
+    }
+}
+
+// Start listening for later launches
+void StartInstancePipe() {
+    HANDLE hThread = CreateThread(NULL, 0, InstancePipeThread, NULL, 0, NULL);
+    if (hThread) {
+        CloseHandle(hThread);
+    }
+}
+
 int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
                      _In_opt_ HINSTANCE hPrevInstance,
                      _In_ LPWSTR    lpCmdLine,
@@ -1612,6 +6307,28 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     UNREFERENCED_PARAMETER(hPrevInstance);
     UNREFERENCED_PARAMETER(lpCmdLine);
 
+    // This is a windowed program, so a shell doesn't wait for it and Ctrl+C never reaches it;
+    // headless runs are the console program's job
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    bool headless = false;
+    for (int i = 1; argv && i < argc; i++) {
+        headless = headless || wcscmp(argv[i], L"--headless") == 0;
+    }
+    if (argv) {
+        LocalFree(argv);
+    }
+    if (headless) {
+        MessageBox(nullptr, L"Headless downloads are run with YoutubePlusHeadless.exe, installed next to this app.",
+                   L"YoutubePlus", MB_OK | MB_ICONINFORMATION);
+        return 2;
+    }
+
+    // A second launch only forwards its URLs to the running instance
+    if (!ClaimSingleInstance()) {
+        return 0;
+    }
+
     // Initialize COM
     HRESULT hr = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
     if (FAILED(hr))
@@ -1621,6 +6338,13 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     }
 
     LoadSettings(); // Load settings on startup
+    LoadMirrors();
+    PruneInfoJsonCache();
+    SweepCookieRunCopies();
+    OpenDownloadArchive();
+    LoadDownloadQueue();
+    StartControlApi();
+    StartLibraryIndex();
 
     // Check if WebView2 Runtime is installed
     if (!IsWebView2RuntimeInstalled()) {
@@ -1644,6 +6368,14 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
         return FALSE;
     }
 
+    // URLs this launch was started with, then any from later launches
+    std::vector<std::wstring> urls;
+    GetCommandLineUrls(urls);
+    if (EnqueueCommandLineUrls(urls) > 0) {
+        ShowDownloadManager();
+    }
+    StartInstancePipe();
+
     HACCEL hAccelTable = LoadAccelerators(hInstance, MAKEINTRESOURCE(IDC_YOUTUBEPLUS));
 
     MSG msg;
@@ -1651,6 +6383,10 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     // Main message loop:
     while (GetMessage(&msg, nullptr, 0, 0))
     {
+        if (g_hDownloadManager && IsDialogMessage(g_hDownloadManager, &msg))
+        {
+            continue;
+        }
         if (!TranslateAccelerator(msg.hwnd, hAccelTable, &msg))
         {
             TranslateMessage(&msg);
@@ -1710,6 +6446,8 @@ BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
       return FALSE;
    }
 
+   g_hMainWnd = hWnd;
+
    ShowWindow(hWnd, nCmdShow);
    UpdateWindow(hWnd);
 
@@ -1731,6 +6469,9 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     switch (message)
     {
     case WM_CREATE:
+        // Keep queue.json current so downloads survive a crash as well as a normal exit
+        SetTimer(hWnd, kQueueSaveTimerId, 2000, NULL);
+
         // Check if WebView2 Runtime is installed
         if (!IsWebView2RuntimeInstalled()) {
             if (InstallWebView2Runtime(hWnd)) {
@@ -1797,7 +6538,11 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
                                                     [](ICoreWebView2* webview, ICoreWebView2NavigationCompletedEventArgs* args) -> HRESULT {
                                                         BOOL success;
                                                         args->get_IsSuccess(&success);
-                                                        if (!success) {
+                                                        if (success) {
+                                                            // Pick up sign-ins and refreshed session cookies for yt-dlp
+                                                            ExportWebViewCookies();
+                                                        }
+                                                        else {
                                                             COREWEBVIEW2_WEB_ERROR_STATUS webErrorStatus;
                                                             args->get_WebErrorStatus(&webErrorStatus);
                                                             
@@ -1815,6 +6560,30 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
                                                         return S_OK;
                                                     }).Get(), &navToken);
                                             
+                                            // Watch pages post their player metadata to the host, so the download
+                                            // dialog can list real resolutions without running yt-dlp first
+                                            g_webView->AddScriptToExecuteOnDocumentCreated(kPlayerResponseBridgeScript, nullptr);
+                                            EventRegistrationToken messageToken;
+                                            g_webView->add_WebMessageReceived(
+                                                Callback<ICoreWebView2WebMessageReceivedEventHandler>(
+                                                    [](ICoreWebView2* webview, ICoreWebView2WebMessageReceivedEventArgs* args) -> HRESULT {
+                                                        LPWSTR source = nullptr;
+                                                        if (FAILED(args->get_Source(&source)) || !source) {
+                                                            return S_OK;
+                                                        }
+                                                        bool trusted = IsTrustedMessageSource(source);
+                                                        CoTaskMemFree(source);
+                                                        if (!trusted) {
+                                                            return S_OK;
+                                                        }
+                                                        LPWSTR messageJson = nullptr;
+                                                        if (SUCCEEDED(args->get_WebMessageAsJson(&messageJson)) && messageJson) {
+                                                            HandleWebMessage(messageJson);
+                                                            CoTaskMemFree(messageJson);
+                                                        }
+                                                        return S_OK;
+                                                    }).Get(), &messageToken);
+
                                             // Add content loading handler for settings application
                                             EventRegistrationToken contentToken;
                                             g_webView->add_ContentLoading(
@@ -1876,8 +6645,10 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
                             break;
                         }
                         
-                        if (url.find(L"youtube.com/watch") != std::wstring::npos) {
-                            StartDownload(url, hWnd);
+                        // Shorts, live and music pages download like any watch page
+                        std::wstring videoUrl = CanonicalVideoUrl(url);
+                        if (!videoUrl.empty()) {
+                            StartDownload(videoUrl, hWnd);
                         } else {
                             MessageBox(hWnd, L"Please navigate to a YouTube video page to download.", 
                                       L"Download", MB_OK | MB_ICONINFORMATION);
@@ -1913,11 +6684,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
                 // Get current playlist URL from WebView2
                 if (g_webView) {
                     std::wstring url = GetCurrentWebViewUrl();
-                    bool isPlaylistPage = url.find(L"youtube.com/playlist") != std::wstring::npos;
-                    bool isWatchListPage = url.find(L"youtube.com/watch") != std::wstring::npos && 
-                                          url.find(L"list=") != std::wstring::npos;
-                                          
-                    if (isPlaylistPage || isWatchListPage) {
+                    if (!ClassifyYouTubeUrl(url).playlistId.empty()) {
                         // Pass the playlist URL to the playlist dialog
                         DialogBoxParam(hInst, MAKEINTRESOURCE(IDD_PLAYLIST), hWnd, PlaylistDialogProc, (LPARAM)&url);
                     } else {
@@ -1928,6 +6695,12 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
                     MessageBox(hWnd, L"WebView2 not initialized.", L"Download", MB_OK | MB_ICONERROR);
                 }
                 break;
+            case IDM_DOWNLOAD_MANAGER:
+                ShowDownloadManager();
+                break;
+            case IDM_PLAYLIST_MIRRORS:
+                DialogBox(hInst, MAKEINTRESOURCE(IDD_MIRRORS), hWnd, MirrorsProc);
+                break;
             case IDM_ADBLOCK:
                 InjectAdBlockScript();
                 MessageBox(hWnd, L"AdBlock script injected (if WebView2 is running).", L"AdBlock", MB_OK | MB_ICONINFORMATION);
@@ -1978,6 +6751,21 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
             }
         }
         break;
+    case WM_TIMER:
+        if (wParam == kQueueSaveTimerId) {
+            SaveDownloadQueue();
+        }
+        break;
+    case WM_APP_INSTANCE_ACTIVATE:
+        // Another launch handed over; come to the front instead of it
+        if (IsIconic(hWnd)) {
+            ShowWindow(hWnd, SW_RESTORE);
+        }
+        SetForegroundWindow(hWnd);
+        if (wParam > 0) {
+            ShowDownloadManager();
+        }
+        break;
     case WM_PAINT:
         {
             PAINTSTRUCT ps;
@@ -1998,6 +6786,10 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
             g_webView->Release();
             g_webView = nullptr;
         }
+        KillTimer(hWnd, kQueueSaveTimerId);
+        StopControlApi();
+        StopLibraryIndex();
+        SaveDownloadQueue();
         SaveSettings(); // Save settings on exit
         PostQuitMessage(0);
         break;
@@ -0,0 +1,82 @@
+// ChunkedList.h : Append-only lists whose snapshots share storage with the list being built.
+//
+// Entries are stored in fixed-size chunks. A full chunk is never modified again, so
+// every snapshot taken after it filled points at the same chunk instead of copying it.
+// Taking a snapshot costs one pointer per full chunk plus a copy of the unfinished
+// tail, which keeps publishing every few hundred entries linear in the list size.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+template <typename T>
+class ChunkedListBuilder;
+
+// Immutable view of a list as it was when the snapshot was taken
+template <typename T>
+class ChunkedList {
+public:
+    ChunkedList() : count(0), chunkSize(1) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](size_t index) const { return (*chunks[index / chunkSize])[index % chunkSize]; }
+
+private:
+    friend class ChunkedListBuilder<T>;
+
+    std::vector<std::shared_ptr<const std::vector<T>>> chunks;
+    size_t count;
+    size_t chunkSize;
+};
+
+// The writer's side: owned by one thread, which appends entries and takes snapshots
+// that other threads may read while it keeps appending.
+template <typename T>
+class ChunkedListBuilder {
+public:
+    explicit ChunkedListBuilder(size_t chunkSize) : chunkSize(chunkSize ? chunkSize : 1) {
+        tail.reserve(this->chunkSize);
+    }
+
+    size_t size() const { return full.size() * chunkSize + tail.size(); }
+    bool empty() const { return size() == 0; }
+
+    const T& operator[](size_t index) const {
+        size_t chunk = index / chunkSize;
+        return chunk < full.size() ? (*full[chunk])[index % chunkSize] : tail[index % chunkSize];
+    }
+
+    void push_back(T value) {
+        tail.push_back(std::move(value));
+        if (tail.size() == chunkSize) {
+            full.push_back(std::make_shared<const std::vector<T>>(std::move(tail)));
+            tail = std::vector<T>();
+            tail.reserve(chunkSize);
+        }
+    }
+
+    void clear() {
+        full.clear();
+        tail.clear();
+    }
+
+    ChunkedList<T> snapshot() const {
+        ChunkedList<T> list;
+        list.chunkSize = chunkSize;
+        list.count = size();
+        list.chunks = full;
+        if (!tail.empty()) {
+            list.chunks.push_back(std::make_shared<const std::vector<T>>(tail));
+        }
+        return list;
+    }
+
+private:
+    size_t chunkSize;
+    std::vector<std::shared_ptr<const std::vector<T>>> full;  // Chunks that are never modified again
+    std::vector<T> tail;                                       // Entries after the last full chunk
+};
@@ -0,0 +1,33 @@
+// Cookies.cpp : Formatting of exported cookies.
+
+#include "Cookies.h"
+
+std::string FormatNetscapeCookies(const std::vector<NetscapeCookie>& cookies) {
+    std::string output = "# Netscape HTTP Cookie File\n";
+    for (const auto& cookie : cookies) {
+        // A tab or line break would shift the columns of every field after it
+        bool valid = !cookie.domain.empty() && !cookie.name.empty();
+        for (const std::string* field : { &cookie.domain, &cookie.path, &cookie.name, &cookie.value }) {
+            if (field->find_first_of("\t\r\n") != std::string::npos) {
+                valid = false;
+            }
+        }
+        if (!valid) {
+            continue;
+        }
+        if (cookie.httpOnly) {
+            output += "#HttpOnly_";
+        }
+        output += cookie.domain;
+        output += cookie.domain[0] == '.' ? "\tTRUE\t" : "\tFALSE\t";
+        output += cookie.path.empty() ? "/" : cookie.path;
+        output += cookie.secure ? "\tTRUE\t" : "\tFALSE\t";
+        output += std::to_string(cookie.expires > 0 ? cookie.expires : 0);
+        output += '\t';
+        output += cookie.name;
+        output += '\t';
+        output += cookie.value;
+        output += '\n';
+    }
+    return output;
+}
@@ -0,0 +1,21 @@
+// Cookies.h : Netscape cookie files for yt-dlp's --cookies option.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// One cookie from the WebView2 profile, in the fields a Netscape cookie file records
+struct NetscapeCookie {
+    std::string domain;   // A leading dot means the cookie is sent to subdomains too
+    std::string path;
+    std::string name;
+    std::string value;
+    long long expires;    // Unix time; 0 for session cookies
+    bool secure;
+    bool httpOnly;
+};
+
+// Write cookies in the Netscape format yt-dlp reads with --cookies. Cookies with no domain
+// or name, or with a tab or line break in any field, are left out.
+std::string FormatNetscapeCookies(const std::vector<NetscapeCookie>& cookies);
@@ -0,0 +1,298 @@
+// Headless.cpp : The console download queue. Each URL is one yt-dlp run through ChildProcess,
+// with its progress read the same way the app reads it.
+
+#include "Headless.h"
+#include "JsonFields.h"
+#include "Process.h"
+#include "ProgressLines.h"
+#include "YouTubeUrl.h"
+
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// yt-dlp prints the title after this prefix just before it starts downloading
+const char* kTitleMarker = "ytp-title ";
+
+// Audio-only choices, named as in the download dialog
+const char* kAudioOnlyM4a = "Audio Only (m4a)";
+const char* kAudioOnlyOpus = "Audio Only (opus)";
+const char* kAudioOnlyMp3 = "Audio Only (mp3)";
+
+// Helper function to get the yt-dlp format arguments for a resolution choice; empty if it isn't one.
+// There is no post-processing stage here, so yt-dlp merges and extracts the streams itself.
+std::string GetFormatArguments(const std::string& resolution) {
+    if (resolution == "Best") {
+        return " -f \"bv*+ba/b\" --merge-output-format mp4";
+    }
+    if (resolution == kAudioOnlyM4a) {
+        return " -f \"bestaudio[ext=m4a]/bestaudio\" -x --audio-format m4a";
+    }
+    if (resolution == kAudioOnlyOpus) {
+        return " -f \"bestaudio[ext=webm]/bestaudio\" -x --audio-format opus"; // YouTube's webm audio is opus
+    }
+    if (resolution == kAudioOnlyMp3) {
+        return " -f bestaudio -x --audio-format mp3";
+    }
+    // A height such as "720p"
+    if (resolution.size() >= 2 && resolution.back() == 'p' &&
+        resolution.find_first_not_of("0123456789") == resolution.size() - 1) {
+        return " -f \"bv*[height<=" + resolution.substr(0, resolution.size() - 1) + "]+ba/b\" --merge-output-format mp4";
+    }
+    return "";
+}
+
+struct HeadlessItem {
+    int id = 0;
+    std::string url;
+    std::string title;
+    const char* status = "queued";  // Status keys as the control API reports them
+    double progress = 0;
+    double speed = 0;
+    std::string error;              // The last ERROR: line yt-dlp printed
+};
+
+// Writes JSON lines from several download threads without interleaving them
+class HeadlessReporter {
+public:
+    HeadlessReporter(const HeadlessOptions& options, const std::function<void(const std::string&)>& writeLine)
+        : options(options), writeLine(writeLine) {}
+
+    void Write(const nlohmann::json& j) {
+        // Titles are whatever yt-dlp printed, so invalid UTF-8 is replaced rather than thrown on
+        std::string line = j.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+        std::lock_guard<std::mutex> lock(mutex);
+        writeLine(line);
+    }
+
+    void Status(const HeadlessItem& item) {
+        nlohmann::json j;
+        j["event"] = "status";
+        j["id"] = item.id;
+        j["status"] = item.status;
+        j["progress"] = item.progress;
+        j["speed"] = item.speed;
+        j["url"] = item.url;
+        j["title"] = item.title;
+        j["resolution"] = options.resolution;
+        j["path"] = options.downloadPath;
+        if (!item.error.empty()) {
+            j["error"] = item.error;
+        }
+        Write(j);
+    }
+
+private:
+    const HeadlessOptions& options;
+    const std::function<void(const std::string&)>& writeLine;
+    std::mutex mutex;
+};
+
+// Run one download to its end, reporting each status change and each whole percent of progress
+void RunHeadlessItem(HeadlessItem& item, const HeadlessOptions& options, HeadlessReporter& reporter,
+                     const std::atomic<bool>& stop) {
+    if (stop) {
+        item.status = "cancelled";
+        reporter.Status(item);
+        return;
+    }
+    item.status = "downloading";
+    reporter.Status(item);
+
+    // Errors share the output pipe, so the ERROR: lines arrive in order with the rest
+    ProcessOptions processOptions;
+    processOptions.errors = ErrorsToOutput;
+    ChildProcess process;
+    if (!process.Start(BuildHeadlessCommand(options, item.url), processOptions)) {
+        item.status = "failed";
+        item.error = "Cannot start " + options.ytDlpPath;
+        reporter.Status(item);
+        return;
+    }
+
+    bool cancelled = false;
+    int reportedPercent = 0;
+    char buffer[4096];
+    LineAccumulator lines;
+    while (true) {
+        if (stop) {
+            process.Kill();
+            cancelled = true;
+            break;
+        }
+        // Wait a moment for output, so a stop is noticed even while yt-dlp is quiet
+        int bytesRead = process.ReadOutput(buffer, sizeof(buffer), 100);
+        if (bytesRead == kProcessReadClosed) {
+            break;
+        }
+        bool changed = false;
+        if (bytesRead > 0) {
+            lines.Append(buffer, bytesRead, [&](const std::string& line) {
+                if (line.compare(0, strlen(kTitleMarker), kTitleMarker) == 0) {
+                    item.title = line.substr(strlen(kTitleMarker));
+                    changed = true;
+                }
+                else if (line.compare(0, 6, "ERROR:") == 0) {
+                    item.error = line;
+                }
+                double progress = ParseProgressPercent(line);
+                if (progress >= 0) {
+                    item.progress = progress;
+                }
+                double speed = ParseProgressSpeed(line);
+                if (speed > 0) {
+                    item.speed = speed;
+                }
+            });
+        }
+        if (changed || (int)item.progress != reportedPercent) {
+            reportedPercent = (int)item.progress;
+            reporter.Status(item);
+        }
+    }
+
+    process.Wait();
+    item.status = cancelled ? "cancelled" : process.ExitCode() == 0 ? "completed" : "failed";
+    item.speed = 0;
+    reporter.Status(item);
+}
+
+}  // namespace
+
+void ApplyHeadlessSettings(const std::string& settingsJson, HeadlessOptions& options) {
+    nlohmann::json j = nlohmann::json::parse(settingsJson, nullptr, false);
+    if (!j.is_object()) {
+        return;
+    }
+    std::string path = JsonString(j, "defaultDownloadPath");
+    if (!path.empty()) {
+        options.downloadPath = path;
+    }
+    auto limit = j.find("maxConcurrentDownloads");
+    if (limit != j.end() && limit->is_number_integer()) {
+        int value = limit->get<int>();
+        options.maxConcurrentDownloads = value < 1 ? 1 : (value > 16 ? 16 : value);
+    }
+}
+
+bool ParseHeadlessArguments(const std::vector<std::string>& arguments, HeadlessOptions& options,
+                            std::string& input, std::vector<std::string>& urls, std::string& error) {
+    for (size_t i = 0; i < arguments.size(); i++) {
+        const std::string& arg = arguments[i];
+        if (arg == "--input" || arg == "--resolution" || arg == "--path" || arg == "--yt-dlp") {
+            if (i + 1 >= arguments.size()) {
+                error = arg + " needs a value";
+                return false;
+            }
+            const std::string& value = arguments[++i];
+            if (arg == "--input") input = value;
+            else if (arg == "--resolution") options.resolution = value;
+            else if (arg == "--path") options.downloadPath = value;
+            else options.ytDlpPath = value;
+        }
+        else if (arg == "--subtitles") {
+            options.downloadSubtitles = true;
+        }
+        else if (arg.size() > 1 && arg[0] == '-') {
+            error = "Unknown option " + arg;
+            return false;
+        }
+        else {
+            urls.push_back(arg);
+        }
+    }
+    // Subtitle-only choices need the app's WebVTT converter
+    if (GetFormatArguments(options.resolution).empty()) {
+        error = "Unsupported resolution " + options.resolution;
+        return false;
+    }
+    if (input.empty() && urls.empty()) {
+        input = "-";
+    }
+    return true;
+}
+
+void ParseUrlList(const std::string& contents, std::vector<std::string>& urls) {
+    size_t lineStart = 0;
+    while (lineStart < contents.size()) {
+        size_t lineEnd = contents.find('\n', lineStart);
+        if (lineEnd == std::string::npos) lineEnd = contents.size();
+        std::string line = contents.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        size_t start = line.find_first_not_of(" \t\r\xEF\xBB\xBF");
+        size_t end = line.find_last_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+        urls.push_back(line.substr(start, end - start + 1));
+    }
+}
+
+std::string BuildHeadlessCommand(const HeadlessOptions& options, const std::string& url) {
+    std::string command = QuoteCommandArgument(options.ytDlpPath) +
+                          " --progress --newline --encoding utf-8 --no-simulate --print " +
+                          QuoteCommandArgument(std::string("before_dl:") + kTitleMarker + "%(title)s");
+    // A playlist URL is one item that downloads every video in it
+    if (ClassifyYouTubeUrl(url).kind != UrlPlaylist) {
+        command += " --no-playlist";
+    }
+    command += GetFormatArguments(options.resolution);
+    if (options.downloadSubtitles) {
+        command += " --write-auto-sub";
+    }
+    std::string path = options.downloadPath;
+    if (!path.empty() && path.back() != '\\' && path.back() != '/') {
+        path += '/';
+    }
+    command += " -o " + QuoteCommandArgument(path + "%(title)s.%(ext)s");
+    command += " " + QuoteCommandArgument(url);
+    return command;
+}
+
+int RunHeadlessQueue(const std::vector<std::string>& urls, const HeadlessOptions& options,
+                     const std::function<void(const std::string&)>& writeLine, const std::atomic<bool>& stop) {
+    HeadlessReporter reporter(options, writeLine);
+    std::vector<HeadlessItem> items;
+    for (const auto& url : urls) {
+        if (!IsYouTubeUrl(url)) {
+            reporter.Write({ { "event", "skipped" }, { "url", url }, { "error", "Not a YouTube URL" } });
+            continue;
+        }
+        HeadlessItem item;
+        item.id = (int)items.size() + 1;
+        item.url = url;
+        items.push_back(item);
+    }
+    for (const auto& item : items) {
+        reporter.Status(item);
+    }
+
+    // Each thread takes the next waiting item until none are left
+    std::atomic<size_t> next(0);
+    size_t threadCount = options.maxConcurrentDownloads < 1 ? 1 : (size_t)options.maxConcurrentDownloads;
+    if (threadCount > items.size()) {
+        threadCount = items.size();
+    }
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; t++) {
+        threads.emplace_back([&]() {
+            for (size_t i = next++; i < items.size(); i = next++) {
+                RunHeadlessItem(items[i], options, reporter, stop);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    int completed = 0;
+    for (const auto& item : items) {
+        completed += strcmp(item.status, "completed") == 0 ? 1 : 0;
+    }
+    int failed = (int)items.size() - completed;
+    reporter.Write({ { "event", "done" }, { "completed", completed }, { "failed", failed } });
+    return failed == 0 ? 0 : 1;
+}
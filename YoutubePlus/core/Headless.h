@@ -0,0 +1,49 @@
+// Headless.h : The download queue run from a console, with no window, WebView2 or dialogs.
+//
+// "YoutubePlusHeadless [options] [URL...]" downloads each URL with yt-dlp and reports every
+// status change as a JSON line on stdout, with the same fields as the control API's events:
+//   --input FILE      read URLs from FILE, one per line ("-" for stdin; the default without URLs)
+//   --resolution R    "Best", a height such as "720p", or an audio-only choice from the download dialog
+//   --path DIR        output folder (default: the configured download folder)
+//   --subtitles       also download subtitles
+//   --yt-dlp PROGRAM  the yt-dlp to run (default: the one next to the app, or yt-dlp on PATH)
+// yt-dlp merges and converts the streams itself; the native downloader, browser cookies and
+// the download archive stay with the app.
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct HeadlessOptions {
+    std::string ytDlpPath = "yt-dlp";
+    std::string downloadPath;               // UTF-8; empty for the working directory
+    std::string resolution = "Best";
+    bool downloadSubtitles = false;
+    int maxConcurrentDownloads = 2;         // Same default and limits as the app's setting
+};
+
+// Take the download folder and the concurrency limit from the app's settings.json contents.
+// Anything missing or malformed keeps its current value.
+void ApplyHeadlessSettings(const std::string& settingsJson, HeadlessOptions& options);
+
+// Parse the command line after the program name into options, the --input source and the URLs
+// given directly. Returns false with a message for an unknown option, a missing value or a
+// resolution the console can't produce.
+bool ParseHeadlessArguments(const std::vector<std::string>& arguments, HeadlessOptions& options,
+                            std::string& input, std::vector<std::string>& urls, std::string& error);
+
+// Append the URLs in a list, one per line; blank lines, # comments and a UTF-8 BOM are skipped
+void ParseUrlList(const std::string& contents, std::vector<std::string>& urls);
+
+// The yt-dlp command line for one URL
+std::string BuildHeadlessCommand(const HeadlessOptions& options, const std::string& url);
+
+// Download the URLs, at most maxConcurrentDownloads at a time, passing each JSON line to
+// writeLine (from one thread at a time). URLs that aren't YouTube videos or playlists are
+// reported as skipped. Setting stop cancels whatever still runs or waits. Returns the exit
+// code: 0 when every download completed, 1 otherwise.
+int RunHeadlessQueue(const std::vector<std::string>& urls, const HeadlessOptions& options,
+                     const std::function<void(const std::string&)>& writeLine, const std::atomic<bool>& stop);
@@ -0,0 +1,109 @@
+// InnerTube.cpp : Builds browse requests and reads playlist pages from their responses.
+
+#include "InnerTube.h"
+#include "JsonFields.h"
+
+#include <unordered_set>
+
+const char* kInnerTubeClientVersion = "2.20240726.00.00";
+
+std::string InnerTubeText(const nlohmann::json& node, const char* key) {
+    auto it = node.find(key);
+    if (it == node.end() || !it->is_object()) {
+        return "";
+    }
+    if (it->contains("simpleText")) {
+        return JsonString(*it, "simpleText");
+    }
+    std::string text;
+    auto runs = it->find("runs");
+    if (runs != it->end() && runs->is_array()) {
+        for (const auto& run : *runs) {
+            text += JsonString(run, "text");
+        }
+    }
+    return text;
+}
+
+// The renderers are searched for rather than reached by a fixed path, since YouTube
+// moves them around between the first page and continuations.
+void CollectPlaylistRenderers(const nlohmann::json& node, std::vector<InnerTubePlaylistEntry>& entries,
+                              std::string& continuation) {
+    if (node.is_object()) {
+        auto renderer = node.find("playlistVideoRenderer");
+        if (renderer != node.end() && renderer->is_object()) {
+            std::string id = JsonString(*renderer, "videoId");
+            if (!id.empty()) {
+                InnerTubePlaylistEntry entry;
+                entry.videoId = id;
+                entry.title = InnerTubeText(*renderer, "title");
+                entry.channel = InnerTubeText(*renderer, "shortBylineText");
+                entry.duration = JsonNumeric(*renderer, "lengthSeconds");
+                entries.push_back(entry);
+            }
+            return;
+        }
+        auto command = node.find("continuationCommand");
+        if (command != node.end() && command->is_object()) {
+            std::string token = JsonString(*command, "token");
+            if (!token.empty()) {
+                continuation = token;
+            }
+            return;
+        }
+        for (const auto& child : node) {
+            CollectPlaylistRenderers(child, entries, continuation);
+        }
+    }
+    else if (node.is_array()) {
+        for (const auto& child : node) {
+            CollectPlaylistRenderers(child, entries, continuation);
+        }
+    }
+}
+
+bool EnumerateInnerTubePlaylist(const std::string& listId, const std::string& clientVersion, const InnerTubePost& post,
+                                std::vector<InnerTubePlaylistEntry>& entries,
+                                const std::function<void(const std::vector<InnerTubePlaylistEntry>&)>& onPage) {
+    if (listId.empty()) {
+        return false;
+    }
+
+    nlohmann::json request;
+    request["context"]["client"]["clientName"] = "WEB";
+    request["context"]["client"]["clientVersion"] = clientVersion.empty() ? kInnerTubeClientVersion : clientVersion;
+    request["context"]["client"]["hl"] = "en";
+    request["browseId"] = "VL" + listId;
+
+    try {
+        std::unordered_set<std::string> seenTokens;
+        while (true) {
+            std::string response;
+            if (!post(request.dump(), response)) {
+                return false;
+            }
+
+            size_t before = entries.size();
+            std::string continuation;
+            CollectPlaylistRenderers(nlohmann::json::parse(response), entries, continuation);
+            if (entries.size() == before && before == 0) {
+                return false; // Not a layout we understand; let yt-dlp handle it
+            }
+            if (onPage) {
+                onPage(entries);
+            }
+
+            if (continuation.empty()) {
+                return true;
+            }
+            if (!seenTokens.insert(continuation).second) {
+                return false; // A repeated token would loop forever
+            }
+            request.erase("browseId");
+            request["continuation"] = continuation;
+        }
+    }
+    catch (...) {
+        return false;
+    }
+}
@@ -0,0 +1,39 @@
+// InnerTube.h : Playlist enumeration through InnerTube's browse API.
+//
+// The HTTP side is left to the caller, which passes a function that POSTs one request
+// body and returns the response body, so the paging logic runs the same against
+// youtube.com and against a stand-in that replays recorded pages.
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "nlohmann/json.hpp"
+
+// Web client version sent when the settings name none
+extern const char* kInnerTubeClientVersion;
+
+// One playlist entry as InnerTube lists it; text is UTF-8
+struct InnerTubePlaylistEntry {
+    std::string videoId;
+    std::string title;
+    std::string channel;
+    double duration = 0;    // Seconds, 0 if unknown
+};
+
+// POST a JSON body to the browse endpoint and read a 200 response
+typedef std::function<bool(const std::string& body, std::string& response)> InnerTubePost;
+
+// Read the text of an InnerTube "runs" or "simpleText" object
+std::string InnerTubeText(const nlohmann::json& node, const char* key);
+
+// Walk a browse response for playlist entries and the token of the next page
+void CollectPlaylistRenderers(const nlohmann::json& node, std::vector<InnerTubePlaylistEntry>& entries,
+                              std::string& continuation);
+
+// Enumerate a playlist, following continuation tokens. onPage (if set) is called after
+// every page. Returns false on any error, leaving the entries read so far in entries.
+bool EnumerateInnerTubePlaylist(const std::string& listId, const std::string& clientVersion, const InnerTubePost& post,
+                                std::vector<InnerTubePlaylistEntry>& entries,
+                                const std::function<void(const std::vector<InnerTubePlaylistEntry>&)>& onPage);
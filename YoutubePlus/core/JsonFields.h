@@ -0,0 +1,28 @@
+// JsonFields.h : Lenient readers for optional fields of yt-dlp and YouTube JSON.
+
+#pragma once
+
+#include <cstdlib>
+#include <string>
+#include "nlohmann/json.hpp"
+
+// Helper function to read an optional number from a JSON object
+inline double JsonNumber(const nlohmann::json& j, const char* key) {
+    auto it = j.find(key);
+    return (it != j.end() && it->is_number()) ? it->get<double>() : 0;
+}
+
+// Helper function to read an optional string from a JSON object
+inline std::string JsonString(const nlohmann::json& j, const char* key) {
+    auto it = j.find(key);
+    return (it != j.end() && it->is_string()) ? it->get<std::string>() : "";
+}
+
+// Helper function to read a number that may be encoded as a string, as the player response does
+inline double JsonNumeric(const nlohmann::json& j, const char* key) {
+    auto it = j.find(key);
+    if (it == j.end()) return 0;
+    if (it->is_number()) return it->get<double>();
+    if (it->is_string()) return strtod(it->get_ref<const std::string&>().c_str(), nullptr);
+    return 0;
+}
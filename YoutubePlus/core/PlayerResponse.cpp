@@ -0,0 +1,62 @@
+// PlayerResponse.cpp : Parsing of the player metadata the watch page posts to the host.
+
+#include "PlayerResponse.h"
+#include "JsonFields.h"
+
+bool ParsePlayerResponseJson(const nlohmann::json& response, PlayerResponseInfo& info) {
+    try {
+        auto details = response.find("videoDetails");
+        if (details == response.end() || !details->is_object() || JsonString(*details, "videoId").empty()) {
+            return false;
+        }
+
+        info.videoId = JsonString(*details, "videoId");
+        info.title = JsonString(*details, "title");
+        info.duration = JsonNumeric(*details, "lengthSeconds");
+        info.formats.clear();
+
+        auto streaming = response.find("streamingData");
+        if (streaming == response.end() || !streaming->is_object()) {
+            return true; // Live streams and premieres may have no formats yet
+        }
+        for (const char* list : { "formats", "adaptiveFormats" }) {
+            auto formats = streaming->find(list);
+            if (formats == streaming->end() || !formats->is_array()) {
+                continue;
+            }
+            for (const auto& f : *formats) {
+                // mimeType looks like: video/mp4; codecs="avc1.42001E, mp4a.40.2"
+                std::string mimeType = JsonString(f, "mimeType");
+                size_t slash = mimeType.find('/');
+                if (slash == std::string::npos) {
+                    continue;
+                }
+                std::string kind = mimeType.substr(0, slash);
+                std::string subtype = mimeType.substr(slash + 1, mimeType.find(';') - slash - 1);
+
+                VideoFormat format;
+                format.formatId = std::to_string((int)JsonNumeric(f, "itag"));
+                format.hasVideo = kind == "video";
+                // Muxed video formats list two codecs
+                format.hasAudio = kind == "audio" || mimeType.find(',', slash) != std::string::npos;
+                format.ext = (kind == "audio" && subtype == "mp4") ? "m4a" : subtype;
+                format.height = format.hasVideo ? (int)JsonNumeric(f, "height") : 0;
+                format.filesize = JsonNumeric(f, "contentLength");
+                double bitrate = JsonNumeric(f, "averageBitrate");
+                format.tbr = (bitrate > 0 ? bitrate : JsonNumeric(f, "bitrate")) / 1000.0;
+                if (format.hasVideo || format.hasAudio) {
+                    info.formats.push_back(format);
+                }
+            }
+        }
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool IsTrustedMessageSource(const std::wstring& source) {
+    return source.compare(0, 24, L"https://www.youtube.com/") == 0 ||
+           source.compare(0, 22, L"https://m.youtube.com/") == 0;
+}
@@ -0,0 +1,34 @@
+// PlayerResponse.h : Video formats and the page's ytInitialPlayerResponse.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "nlohmann/json.hpp"
+
+// Single format of a video as reported by yt-dlp
+struct VideoFormat {
+    std::string formatId;
+    std::string ext;
+    int height;         // 0 for audio-only formats
+    bool hasVideo;
+    bool hasAudio;
+    double filesize;    // Bytes (exact or approximate), 0 if unknown
+    double tbr;         // Total bitrate in KBit/s, 0 if unknown
+};
+
+// What the videoDetails and streamingData of a player response describe; text is UTF-8
+struct PlayerResponseInfo {
+    std::string videoId;
+    std::string title;
+    double duration = 0;                // Seconds
+    std::vector<VideoFormat> formats;
+};
+
+// Parse the videoDetails and streamingData of a page's ytInitialPlayerResponse.
+// Returns false when the response names no video or is not shaped like one.
+bool ParsePlayerResponseJson(const nlohmann::json& response, PlayerResponseInfo& info);
+
+// True when a web message came from a YouTube page. The view can be navigated anywhere,
+// and a message from another site must not feed the video info cache.
+bool IsTrustedMessageSource(const std::wstring& source);
@@ -0,0 +1,88 @@
+// PlaylistEntrySax.h : Streaming extraction of playlist entries from yt-dlp's JSON lines.
+
+#pragma once
+
+#include <string>
+#include "nlohmann/json.hpp"
+
+// SAX handler that pulls the top-level id, title, duration and channel out of a
+// yt-dlp --dump-json line. Every other field is skipped without building a DOM,
+// and parsing stops as soon as all four have been seen.
+class PlaylistEntrySax final : public nlohmann::json_sax<nlohmann::json> {
+public:
+    std::string id;
+    std::string title;
+    std::string channel;
+    double duration = 0;
+    bool hasId = false;
+    bool hasTitle = false;
+
+    bool null() override { return scalar(); }
+    bool boolean(bool) override { return scalar(); }
+    bool number_integer(number_integer_t val) override { return number((double)val); }
+    bool number_unsigned(number_unsigned_t val) override { return number((double)val); }
+    bool number_float(number_float_t val, const string_t&) override { return number((double)val); }
+    bool binary(binary_t&) override { return scalar(); }
+
+    bool string(string_t& val) override {
+        if (depth == 1) {
+            switch (field) {
+            case Field::Id: id = std::move(val); hasId = true; found |= 1; break;
+            case Field::Title: title = std::move(val); hasTitle = true; found |= 2; break;
+            case Field::Channel: channel = std::move(val); found |= 4; break;
+            default: break;
+            }
+        }
+        return scalar();
+    }
+
+    bool key(string_t& val) override {
+        if (depth == 1) {
+            if (val == "id") field = Field::Id;
+            else if (val == "title") field = Field::Title;
+            else if (val == "channel") field = Field::Channel;
+            else if (val == "duration") field = Field::Duration;
+            else field = Field::None;
+        }
+        return true;
+    }
+
+    bool start_object(std::size_t) override { return open(); }
+    bool end_object() override { return close(); }
+    bool start_array(std::size_t) override { return open(); }
+    bool end_array() override { return close(); }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) override {
+        return false;
+    }
+
+    // Every wanted field has been read, so the rest of the line can be skipped
+    bool done() const { return found == 15; }
+
+private:
+    enum class Field { None, Id, Title, Channel, Duration };
+    Field field = Field::None;
+    int depth = 0;
+    unsigned int found = 0;
+
+    bool number(double val) {
+        if (depth == 1 && field == Field::Duration) {
+            duration = val;
+            found |= 8;
+        }
+        return scalar();
+    }
+    bool scalar() {
+        if (depth == 1) field = Field::None;
+        return !done();
+    }
+    bool open() {
+        if (depth == 1) field = Field::None; // Nested values are never wanted
+        depth++;
+        return true;
+    }
+    bool close() {
+        depth--;
+        return true;
+    }
+};
@@ -0,0 +1,85 @@
+// Process.cpp : Command line quoting shared by both ChildProcess implementations.
+
+#include "Process.h"
+
+std::string QuoteCommandArgument(const std::string& argument) {
+    if (!argument.empty() && argument.find_first_of(" \t\n\v\"") == std::string::npos) {
+        return argument;
+    }
+    std::string quoted = "\"";
+    size_t backslashes = 0;
+    for (char c : argument) {
+        if (c == '\\') {
+            backslashes++;
+            continue;
+        }
+        // Backslashes are only special before a quote, where each of them has to be doubled
+        quoted.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+        backslashes = 0;
+        quoted += c;
+    }
+    quoted.append(backslashes * 2, '\\');
+    quoted += '"';
+    return quoted;
+}
+
+std::vector<std::string> SplitCommandLine(const std::string& commandLine) {
+    std::vector<std::string> arguments;
+    size_t i = 0;
+    size_t length = commandLine.size();
+    while (i < length && (commandLine[i] == ' ' || commandLine[i] == '\t')) i++;
+    if (i == length) {
+        return arguments;
+    }
+
+    // The program name ends at the closing quote or the first space; backslashes are path separators there
+    std::string program;
+    if (commandLine[i] == '"') {
+        size_t close = commandLine.find('"', i + 1);
+        program = commandLine.substr(i + 1, close == std::string::npos ? std::string::npos : close - i - 1);
+        i = close == std::string::npos ? length : close + 1;
+    }
+    while (i < length && commandLine[i] != ' ' && commandLine[i] != '\t') {
+        program += commandLine[i++];
+    }
+    arguments.push_back(program);
+
+    while (true) {
+        while (i < length && (commandLine[i] == ' ' || commandLine[i] == '\t')) i++;
+        if (i == length) {
+            break;
+        }
+        std::string argument;
+        bool quoted = false;
+        while (i < length && (quoted || (commandLine[i] != ' ' && commandLine[i] != '\t'))) {
+            size_t backslashes = 0;
+            while (i < length && commandLine[i] == '\\') {
+                backslashes++;
+                i++;
+            }
+            if (i < length && commandLine[i] == '"') {
+                // 2n backslashes and a quote are n backslashes and a delimiter; 2n+1 are n and a literal quote
+                argument.append(backslashes / 2, '\\');
+                if (backslashes % 2 == 1) {
+                    argument += '"';
+                }
+                else if (quoted && i + 1 < length && commandLine[i + 1] == '"') {
+                    argument += '"';
+                    i++;
+                }
+                else {
+                    quoted = !quoted;
+                }
+                i++;
+            }
+            else {
+                argument.append(backslashes, '\\');
+                if (i < length && (quoted || (commandLine[i] != ' ' && commandLine[i] != '\t'))) {
+                    argument += commandLine[i++];
+                }
+            }
+        }
+        arguments.push_back(argument);
+    }
+    return arguments;
+}
@@ -0,0 +1,73 @@
+// Process.h : Starting helper processes (yt-dlp, ffmpeg) and reading what they print.
+//
+// A process and everything it starts are kept together, in a job object on Windows and a
+// process group elsewhere, so a cancel or a timeout doesn't leave orphaned children behind.
+// ProcessWin.cpp and ProcessPosix.cpp implement ChildProcess; one of them is built per platform.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Where a child's standard error goes
+enum ProcessErrors {
+    ErrorsDiscarded,    // To the null device, so a full pipe can't stall a child nobody listens to
+    ErrorsSeparate,     // To a pipe of its own, read with ReadErrors
+    ErrorsToOutput      // Into the output pipe, interleaved with standard output
+};
+
+struct ProcessOptions {
+    std::string workingDirectory;           // UTF-8; empty for the caller's
+    bool captureOutput = true;              // Standard output to a pipe read with ReadOutput
+    ProcessErrors errors = ErrorsDiscarded; // Only used with captureOutput
+};
+
+const unsigned kProcessWaitForever = 0xFFFFFFFF;
+
+// Result of a read with a timeout, when it isn't a byte count
+const int kProcessReadTimeout = 0;
+const int kProcessReadClosed = -1;
+
+// One child process and its descendants
+class ChildProcess {
+public:
+    ChildProcess();
+    ~ChildProcess();    // Kills whatever still runs
+
+    // Start a command line (UTF-8), quoted the way CommandLineToArgvW splits it. Outside Windows
+    // it is split with the same rules and the program is looked up on PATH.
+    bool Start(const std::string& commandLine, const ProcessOptions& options);
+
+    // Read standard output or error. Returns the bytes read, kProcessReadTimeout when nothing
+    // arrived within timeoutMs, or kProcessReadClosed once every writer has closed the pipe.
+    int ReadOutput(char* buffer, size_t size, unsigned timeoutMs = kProcessWaitForever);
+    int ReadErrors(char* buffer, size_t size, unsigned timeoutMs = kProcessWaitForever);
+
+    // Wait for the process to exit; false if it still runs after timeoutMs
+    bool Wait(unsigned timeoutMs = kProcessWaitForever);
+
+    // Exit code once Wait has returned true; -1 before, or when it couldn't be read
+    int ExitCode();
+
+    // Kill the process and everything it started. May be called from any thread while another
+    // reads or waits, as long as the object outlives the call.
+    void Kill();
+
+    // User and kernel time of the process and its descendants, in seconds, once it has exited
+    double CpuSeconds();
+
+private:
+    ChildProcess(const ChildProcess&) = delete;
+    ChildProcess& operator=(const ChildProcess&) = delete;
+
+    struct Platform;
+    std::unique_ptr<Platform> platform;
+};
+
+// Quote one argument for a command line, so SplitCommandLine (and CommandLineToArgvW) return it unchanged
+std::string QuoteCommandArgument(const std::string& argument);
+
+// Split a command line into arguments with the CommandLineToArgvW rules: spaces separate arguments
+// outside double quotes, backslashes only escape a quote, and "" inside quotes is a literal quote
+std::vector<std::string> SplitCommandLine(const std::string& commandLine);
@@ -0,0 +1,211 @@
+// ProcessPosix.cpp : ChildProcess over fork/exec, with the child leading its own process group.
+
+#include "Process.h"
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct ChildProcess::Platform {
+    pid_t pid = -1;
+    int output = -1;
+    int errors = -1;
+    // Held while the child is reaped, so Kill never signals a process group whose ID was reused
+    std::mutex mutex;
+    bool exited = false;
+    int exitCode = -1;
+    double cpuSeconds = 0;
+};
+
+namespace {
+
+bool CreatePipe(int fds[2]) {
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+void CloseFd(int& fd) {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+int ReadPipe(int fd, char* buffer, size_t size, unsigned timeoutMs) {
+    if (fd < 0) {
+        return kProcessReadClosed;
+    }
+    while (true) {
+        pollfd ready = { fd, POLLIN, 0 };
+        int polled = poll(&ready, 1, timeoutMs == kProcessWaitForever ? -1 : (int)timeoutMs);
+        if (polled < 0 && errno == EINTR) {
+            continue;
+        }
+        if (polled == 0) {
+            return kProcessReadTimeout;
+        }
+        ssize_t bytesRead = read(fd, buffer, size);
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        return bytesRead > 0 ? (int)bytesRead : kProcessReadClosed;
+    }
+}
+
+}  // namespace
+
+ChildProcess::ChildProcess() : platform(new Platform) {}
+
+ChildProcess::~ChildProcess() {
+    if (platform->pid > 0) {
+        Kill();
+        Wait();
+    }
+    CloseFd(platform->output);
+    CloseFd(platform->errors);
+}
+
+bool ChildProcess::Start(const std::string& commandLine, const ProcessOptions& options) {
+    std::vector<std::string> arguments = SplitCommandLine(commandLine);
+    if (arguments.empty() || platform->pid > 0) {
+        return false;
+    }
+    // Everything the child needs is prepared before fork, since it may only make system calls afterwards
+    std::vector<char*> argv;
+    for (auto& argument : arguments) {
+        argv.push_back(&argument[0]);
+    }
+    argv.push_back(nullptr);
+
+    int output[2] = { -1, -1 };
+    int errors[2] = { -1, -1 };
+    int status[2] = { -1, -1 };   // Carries errno back when exec fails; closed by a successful exec
+    int null = open("/dev/null", O_RDWR | O_CLOEXEC);
+    bool pipes = null >= 0 && CreatePipe(status) &&
+                 (!options.captureOutput || CreatePipe(output)) &&
+                 (!options.captureOutput || options.errors != ErrorsSeparate || CreatePipe(errors));
+    pid_t pid = pipes ? fork() : -1;
+    if (pid == 0) {
+        setpgid(0, 0);
+        // The child never reads the caller's stdin, which headless runs use for the URL list
+        dup2(null, STDIN_FILENO);
+        if (options.captureOutput) {
+            dup2(output[1], STDOUT_FILENO);
+            int errorTarget = options.errors == ErrorsSeparate ? errors[1] :
+                              options.errors == ErrorsToOutput ? output[1] : null;
+            dup2(errorTarget, STDERR_FILENO);
+        }
+        if (!options.workingDirectory.empty() && chdir(options.workingDirectory.c_str()) != 0) {
+            int error = errno;
+            (void)!write(status[1], &error, sizeof(error));
+            _exit(127);
+        }
+        execvp(argv[0], argv.data());
+        int error = errno;
+        (void)!write(status[1], &error, sizeof(error));
+        _exit(127);
+    }
+
+    if (pid > 0) {
+        setpgid(pid, pid);  // Also from this side, so Kill works even before the child ran
+    }
+    CloseFd(output[1]);
+    CloseFd(errors[1]);
+    CloseFd(status[1]);
+    if (null >= 0) close(null);
+
+    int error = 0;
+    bool execFailed = false;
+    if (pid > 0) {
+        ssize_t bytesRead;
+        do {
+            bytesRead = read(status[0], &error, sizeof(error));
+        } while (bytesRead < 0 && errno == EINTR);
+        execFailed = bytesRead == (ssize_t)sizeof(error);
+        if (execFailed) {
+            waitpid(pid, nullptr, 0);
+        }
+    }
+    CloseFd(status[0]);
+    if (pid <= 0 || execFailed) {
+        CloseFd(output[0]);
+        CloseFd(errors[0]);
+        return false;
+    }
+    platform->pid = pid;
+    platform->output = output[0];
+    platform->errors = errors[0];
+    return true;
+}
+
+int ChildProcess::ReadOutput(char* buffer, size_t size, unsigned timeoutMs) {
+    return ReadPipe(platform->output, buffer, size, timeoutMs);
+}
+
+int ChildProcess::ReadErrors(char* buffer, size_t size, unsigned timeoutMs) {
+    return ReadPipe(platform->errors, buffer, size, timeoutMs);
+}
+
+bool ChildProcess::Wait(unsigned timeoutMs) {
+    if (platform->pid <= 0) {
+        return false;
+    }
+    if (timeoutMs == kProcessWaitForever) {
+        // Block until it exits without reaping it; that happens below, under the lock
+        siginfo_t info;
+        while (waitid(P_PID, (id_t)platform->pid, &info, WEXITED | WNOWAIT) != 0 && errno == EINTR) {
+        }
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(platform->mutex);
+            if (platform->exited) {
+                return true;
+            }
+            int status = 0;
+            rusage usage = {};
+            if (wait4(platform->pid, &status, WNOHANG, &usage) == platform->pid) {
+                platform->exited = true;
+                platform->exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+                // Covers the descendants the child waited for, which is how yt-dlp runs ffmpeg
+                platform->cpuSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+                                       usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+                return true;
+            }
+        }
+        if (timeoutMs != kProcessWaitForever && std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+int ChildProcess::ExitCode() {
+    std::lock_guard<std::mutex> lock(platform->mutex);
+    return platform->exited ? platform->exitCode : -1;
+}
+
+void ChildProcess::Kill() {
+    std::lock_guard<std::mutex> lock(platform->mutex);
+    if (platform->pid > 0 && !platform->exited) {
+        kill(-platform->pid, SIGKILL);
+    }
+}
+
+double ChildProcess::CpuSeconds() {
+    std::lock_guard<std::mutex> lock(platform->mutex);
+    return platform->cpuSeconds;
+}
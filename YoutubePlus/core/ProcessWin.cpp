@@ -0,0 +1,192 @@
+// ProcessWin.cpp : ChildProcess over CreateProcessW, with the child and its descendants in a job object.
+
+#include "Process.h"
+
+#include <windows.h>
+
+struct ChildProcess::Platform {
+    HANDLE process = NULL;
+    HANDLE job = NULL;
+    HANDLE output = NULL;
+    HANDLE errors = NULL;
+};
+
+namespace {
+
+std::wstring Widen(const std::string& text) {
+    if (text.empty()) {
+        return L"";
+    }
+    int size = MultiByteToWideChar(CP_UTF8, 0, text.data(), (int)text.size(), NULL, 0);
+    std::wstring wide(size, 0);
+    MultiByteToWideChar(CP_UTF8, 0, text.data(), (int)text.size(), &wide[0], size);
+    return wide;
+}
+
+void CloseHandleOnce(HANDLE& handle) {
+    if (handle && handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(handle);
+    }
+    handle = NULL;
+}
+
+// A blocking ReadFile on an anonymous pipe can't time out, so a read with a timeout polls the pipe
+int ReadPipe(HANDLE pipe, char* buffer, size_t size, unsigned timeoutMs) {
+    if (!pipe) {
+        return kProcessReadClosed;
+    }
+    if (timeoutMs == kProcessWaitForever) {
+        DWORD bytesRead = 0;
+        if (!ReadFile(pipe, buffer, (DWORD)size, &bytesRead, NULL) || bytesRead == 0) {
+            return kProcessReadClosed;
+        }
+        return (int)bytesRead;
+    }
+    ULONGLONG deadline = GetTickCount64() + timeoutMs;
+    while (true) {
+        DWORD available = 0;
+        if (!PeekNamedPipe(pipe, NULL, 0, NULL, &available, NULL)) {
+            return kProcessReadClosed; // Every writer has exited
+        }
+        if (available > 0) {
+            DWORD bytesRead = 0;
+            DWORD chunk = available < (DWORD)size ? available : (DWORD)size;
+            if (!ReadFile(pipe, buffer, chunk, &bytesRead, NULL) || bytesRead == 0) {
+                return kProcessReadClosed;
+            }
+            return (int)bytesRead;
+        }
+        if (GetTickCount64() >= deadline) {
+            return kProcessReadTimeout;
+        }
+        Sleep(20);
+    }
+}
+
+}  // namespace
+
+ChildProcess::ChildProcess() : platform(new Platform) {}
+
+ChildProcess::~ChildProcess() {
+    if (platform->process) {
+        Kill();
+        WaitForSingleObject(platform->process, INFINITE);
+    }
+    CloseHandleOnce(platform->process);
+    CloseHandleOnce(platform->job);
+    CloseHandleOnce(platform->output);
+    CloseHandleOnce(platform->errors);
+}
+
+bool ChildProcess::Start(const std::string& commandLine, const ProcessOptions& options) {
+    if (platform->process) {
+        return false;
+    }
+    std::wstring command = Widen(commandLine);
+    std::wstring workingDirectory = Widen(options.workingDirectory);
+
+    SECURITY_ATTRIBUTES sa;
+    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+    sa.bInheritHandle = TRUE;
+    sa.lpSecurityDescriptor = NULL;
+
+    HANDLE outputWrite = NULL;
+    HANDLE errorsWrite = NULL;
+    HANDLE nul = INVALID_HANDLE_VALUE;
+    STARTUPINFOW si = { sizeof(si) };
+    if (options.captureOutput) {
+        if (!CreatePipe(&platform->output, &outputWrite, &sa, 0)) {
+            return false;
+        }
+        SetHandleInformation(platform->output, HANDLE_FLAG_INHERIT, 0);
+        if (options.errors == ErrorsSeparate) {
+            if (!CreatePipe(&platform->errors, &errorsWrite, &sa, 0)) {
+                CloseHandleOnce(platform->output);
+                CloseHandleOnce(outputWrite);
+                return false;
+            }
+            SetHandleInformation(platform->errors, HANDLE_FLAG_INHERIT, 0);
+        }
+        else if (options.errors == ErrorsDiscarded) {
+            nul = CreateFileW(L"NUL", GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, &sa, OPEN_EXISTING, 0, NULL);
+        }
+        si.hStdOutput = outputWrite;
+        si.hStdError = options.errors == ErrorsSeparate ? errorsWrite :
+                       options.errors == ErrorsToOutput ? outputWrite : nul;
+        si.dwFlags |= STARTF_USESTDHANDLES;
+    }
+
+    // The job dies with its last handle, so the app exiting takes the children along with it
+    platform->job = CreateJobObjectW(NULL, NULL);
+    if (platform->job) {
+        JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits = { 0 };
+        limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+        SetInformationJobObject(platform->job, JobObjectExtendedLimitInformation, &limits, sizeof(limits));
+    }
+
+    // Started suspended, so it is in the job before it can start anything of its own
+    PROCESS_INFORMATION pi = { 0 };
+    bool started = CreateProcessW(nullptr, &command[0], nullptr, nullptr, options.captureOutput ? TRUE : FALSE,
+                                  CREATE_NO_WINDOW | CREATE_SUSPENDED, nullptr,
+                                  workingDirectory.empty() ? nullptr : workingDirectory.c_str(), &si, &pi) != FALSE;
+    CloseHandleOnce(outputWrite);
+    CloseHandleOnce(errorsWrite);
+    CloseHandleOnce(nul);
+    if (!started) {
+        CloseHandleOnce(platform->job);
+        CloseHandleOnce(platform->output);
+        CloseHandleOnce(platform->errors);
+        return false;
+    }
+    if (platform->job) {
+        AssignProcessToJobObject(platform->job, pi.hProcess);
+    }
+    ResumeThread(pi.hThread);
+    CloseHandle(pi.hThread);
+    platform->process = pi.hProcess;
+    return true;
+}
+
+int ChildProcess::ReadOutput(char* buffer, size_t size, unsigned timeoutMs) {
+    return ReadPipe(platform->output, buffer, size, timeoutMs);
+}
+
+int ChildProcess::ReadErrors(char* buffer, size_t size, unsigned timeoutMs) {
+    return ReadPipe(platform->errors, buffer, size, timeoutMs);
+}
+
+bool ChildProcess::Wait(unsigned timeoutMs) {
+    return platform->process && WaitForSingleObject(platform->process, timeoutMs) == WAIT_OBJECT_0;
+}
+
+int ChildProcess::ExitCode() {
+    DWORD exitCode = 0;
+    if (!platform->process || !GetExitCodeProcess(platform->process, &exitCode) || exitCode == STILL_ACTIVE) {
+        return -1;
+    }
+    return (int)exitCode;
+}
+
+void ChildProcess::Kill() {
+    if (!platform->process) {
+        return;
+    }
+    if (!platform->job || !TerminateJobObject(platform->job, 1)) {
+        TerminateProcess(platform->process, 1);
+    }
+}
+
+double ChildProcess::CpuSeconds() {
+    // Times are in 100 ns units
+    JOBOBJECT_BASIC_ACCOUNTING_INFORMATION accounting;
+    if (platform->job && QueryInformationJobObject(platform->job, JobObjectBasicAccountingInformation,
+                                                   &accounting, sizeof(accounting), NULL)) {
+        return (accounting.TotalUserTime.QuadPart + accounting.TotalKernelTime.QuadPart) / 1e7;
+    }
+    FILETIME created, exited, kernel, user;
+    if (platform->process && GetProcessTimes(platform->process, &created, &exited, &kernel, &user)) {
+        return ((((ULONGLONG)user.dwHighDateTime << 32) | user.dwLowDateTime) +
+                (((ULONGLONG)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime)) / 1e7;
+    }
+    return 0;
+}
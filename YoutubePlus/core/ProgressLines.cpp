@@ -0,0 +1,44 @@
+// ProgressLines.cpp : Fields of yt-dlp's --newline progress lines.
+
+#include "ProgressLines.h"
+
+#include <cstdlib>
+#include <cstring>
+
+double ParseProgressPercent(const std::string& line) {
+    const char* marker = "[download]";
+    if (line.compare(0, strlen(marker), marker) != 0) {
+        return -1;
+    }
+    const char* p = line.c_str() + strlen(marker);
+    if (*p != ' ' && *p != '\t') {
+        return -1;
+    }
+    while (*p == ' ' || *p == '\t') p++;
+    char* end = nullptr;
+    double value = strtod(p, &end);
+    if (end == p || *end != '%') {
+        return -1;
+    }
+    return value;
+}
+
+double ParseProgressSpeed(const std::string& line) {
+    size_t at = line.rfind(" at ");
+    if (at == std::string::npos) {
+        return 0;
+    }
+    const char* p = line.c_str() + at + 4;
+    while (*p == ' ') p++;
+    char* end = nullptr;
+    double value = strtod(p, &end);
+    if (end == p) {
+        return 0; // "Unknown B/s"
+    }
+    switch (*end) {
+    case 'K': value *= 1024; break;
+    case 'M': value *= 1024.0 * 1024; break;
+    case 'G': value *= 1024.0 * 1024 * 1024; break;
+    }
+    return value;
+}
@@ -0,0 +1,40 @@
+// ProgressLines.h : Reading yt-dlp's progress output as it arrives from a pipe.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Splits output read in arbitrary chunks into complete lines. A read can end in the middle
+// of a line, so the unfinished tail is kept until the rest of it arrives.
+class LineAccumulator {
+public:
+    // Append a chunk and call onLine(const std::string&) for each line it completes,
+    // without the line terminator. Both \n and \r end a line; empty lines are skipped.
+    template <typename OnLine>
+    void Append(const char* data, size_t size, OnLine onLine) {
+        for (size_t i = 0; i < size; i++) {
+            char c = data[i];
+            if (c == '\n' || c == '\r') {
+                if (!pending.empty()) {
+                    onLine(pending);
+                    pending.clear();
+                }
+            } else {
+                pending += c;
+            }
+        }
+    }
+
+    // The text after the last line terminator
+    const std::string& Pending() const { return pending; }
+
+private:
+    std::string pending;
+};
+
+// Read the percentage from a yt-dlp progress line ("[download]  42.0% of ..."); -1 if none
+double ParseProgressPercent(const std::string& line);
+
+// Read the speed in bytes per second from a yt-dlp progress line ("... at  1.23MiB/s ETA ..."); 0 if unknown
+double ParseProgressSpeed(const std::string& line);
@@ -0,0 +1,270 @@
+// SegmentedTransfer.cpp : Range scheduling, the connection count, and the worker threads.
+
+#include "SegmentedTransfer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+void MergeRanges(ByteRanges& ranges) {
+    std::sort(ranges.begin(), ranges.end());
+    size_t merged = 0;
+    for (size_t i = 0; i < ranges.size(); i++) {
+        if (merged > 0 && ranges[i].first <= ranges[merged - 1].second) {
+            if (ranges[i].second > ranges[merged - 1].second) {
+                ranges[merged - 1].second = ranges[i].second;
+            }
+        } else {
+            ranges[merged++] = ranges[i];
+        }
+    }
+    ranges.resize(merged);
+}
+
+SegmentScheduler::SegmentScheduler(long long size) : size(size) {}
+
+void SegmentScheduler::Resume(const ByteRanges& done) {
+    ByteRanges ranges = done;
+    MergeRanges(ranges);
+    std::lock_guard<std::mutex> lock(mutex);
+    long long gapStart = 0;
+    ranges.push_back(std::make_pair(size, size));
+    for (const auto& range : ranges) {
+        for (long long start = gapStart; start < range.first; start += kMaxSegmentSize) {
+            long long end = range.first - start > kMaxSegmentSize ? start + kMaxSegmentSize : range.first;
+            retries.push_back({ start, end, 0 });
+        }
+        bytesDone += range.second - range.first;
+        gapStart = range.second;
+    }
+    ranges.pop_back();
+    completed = ranges;
+    nextOffset = size;
+}
+
+bool SegmentScheduler::Next(SegmentRange& range) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!retries.empty()) {
+        range = retries.front();
+        retries.pop_front();
+        return true;
+    }
+    if (nextOffset >= size) {
+        return false;
+    }
+    long long length = kMinSegmentSize;
+    if (connectionRate > 0) {
+        length = (long long)(connectionRate * kSegmentTargetSeconds);
+        if (length < kMinSegmentSize) length = kMinSegmentSize;
+        if (length > kMaxSegmentSize) length = kMaxSegmentSize;
+    }
+    range.start = nextOffset;
+    range.end = size - range.start > length ? range.start + length : size;
+    range.attempts = 0;
+    nextOffset = range.end;
+    return true;
+}
+
+void SegmentScheduler::Finish(SegmentRange range, long long reached, double seconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (reached > range.start) {
+        completed.push_back(std::make_pair(range.start, reached));
+    }
+    if (reached == range.end) {
+        if (seconds > 0.05) {
+            double rate = (range.end - range.start) / seconds;
+            connectionRate = connectionRate > 0 ? connectionRate * 0.7 + rate * 0.3 : rate;
+        }
+    }
+    else if (!failed && !stopped) {
+        // Requeue what is missing; the bytes already written stay
+        range.start = reached;
+        if (++range.attempts >= kMaxSegmentAttempts) {
+            failed = true;
+        } else {
+            retries.push_back(range);
+        }
+    }
+}
+
+bool SegmentScheduler::MoreWork() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !retries.empty() || nextOffset < size;
+}
+
+ByteRanges SegmentScheduler::Completed() {
+    std::lock_guard<std::mutex> lock(mutex);
+    MergeRanges(completed);
+    return completed;
+}
+
+const double ConnectionController::kGrowRatio = 1.15;
+const double ConnectionController::kShrinkRatio = 0.85;
+
+ConnectionController::ConnectionController()
+    : connections(kInitialSegmentConnections), ceiling(kMaxSegmentConnections), lastRate(0) {}
+
+int ConnectionController::Update(double rate, bool moreWork) {
+    if (rate < lastRate * kShrinkRatio && connections > 1) {
+        connections--;
+        ceiling = connections;
+    }
+    else if (moreWork && connections < ceiling && rate > lastRate * kGrowRatio) {
+        connections++;
+    }
+    lastRate = rate;
+    return connections;
+}
+
+namespace {
+
+// One connection's thread. The controlling thread sets retire to drop the connection once its
+// current range is done; the worker sets exited as its last action.
+struct SegmentWorker {
+    std::thread thread;
+    std::atomic<bool> retire{ false };
+    std::atomic<bool> connectFailed{ false };
+    std::atomic<bool> exited{ false };
+};
+
+// Fetch ranges over one connection until none is left, the transfer ends, or the worker is retired
+void RunSegmentWorker(SegmentScheduler& scheduler, const SegmentIo& io, SegmentWorker& worker) {
+    std::unique_ptr<RangeConnection> connection = io.connect();
+    if (!connection) {
+        worker.connectFailed = true;
+        worker.exited = true;
+        return;
+    }
+
+    std::vector<char> buffer(64 * 1024);
+    SegmentRange range;
+    while (!scheduler.Failed() && !scheduler.Stopped() && !worker.retire && scheduler.Next(range)) {
+        auto started = std::chrono::steady_clock::now();
+        long long offset = range.start;
+        if (connection->Request(range.start, range.end)) {
+            while (offset < range.end && !scheduler.Stopped()) {
+                size_t bytesRead = connection->Read(buffer.data(), buffer.size());
+                if (bytesRead == 0) {
+                    break;
+                }
+                if ((long long)bytesRead > range.end - offset) {
+                    bytesRead = (size_t)(range.end - offset);
+                }
+                // Each range owns its part of the file, so connections write without coordinating
+                if (!io.write(offset, buffer.data(), bytesRead)) {
+                    scheduler.Fail();
+                    break;
+                }
+                offset += bytesRead;
+                scheduler.AddBytes(bytesRead);
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        scheduler.Finish(range, offset, seconds);
+    }
+    connection.reset();
+    worker.exited = true;
+}
+
+}  // namespace
+
+bool RunSegmentedTransfer(SegmentScheduler& scheduler, const SegmentIo& io) {
+    if (scheduler.Complete()) {
+        return true;
+    }
+
+    std::vector<std::unique_ptr<SegmentWorker>> workers;
+    int connectFailures = 0;
+    auto addWorker = [&]() {
+        std::unique_ptr<SegmentWorker> worker(new SegmentWorker);
+        SegmentWorker* state = worker.get();
+        worker->thread = std::thread([&scheduler, &io, state]() { RunSegmentWorker(scheduler, io, *state); });
+        workers.push_back(std::move(worker));
+    };
+    auto activeWorkers = [&]() {
+        int active = 0;
+        for (const auto& worker : workers) {
+            if (!worker->retire) active++;
+        }
+        return active;
+    };
+
+    ConnectionController controller;
+    for (int i = 0; i < controller.Connections(); i++) {
+        addWorker();
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    long long lastBytes = scheduler.BytesDone();
+    Clock::time_point lastCheck = Clock::now();
+    Clock::time_point lastProgress = lastCheck;
+    while (!workers.empty()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if (io.stopped && io.stopped()) {
+            scheduler.Stop();
+        }
+
+        // Reap the connections that ended
+        for (size_t i = 0; i < workers.size();) {
+            if (workers[i]->exited) {
+                workers[i]->thread.join();
+                if (workers[i]->connectFailed) {
+                    connectFailures++;
+                }
+                workers.erase(workers.begin() + i);
+            } else {
+                i++;
+            }
+        }
+        if (scheduler.Failed() || scheduler.Stopped() || scheduler.Complete()) {
+            continue; // Wait for the rest to finish their reads
+        }
+        if (connectFailures >= kMaxSegmentAttempts && workers.empty()) {
+            scheduler.Fail(); // The server can't be reached any more
+            continue;
+        }
+        // A range that failed after the other connections ran out of work needs a connection again
+        if (workers.empty() && scheduler.MoreWork()) {
+            addWorker();
+        }
+
+        Clock::time_point now = Clock::now();
+        if (now - lastProgress >= std::chrono::milliseconds(500)) {
+            lastProgress = now;
+            if (io.onProgress) {
+                io.onProgress(scheduler.BytesDone());
+            }
+        }
+        double elapsed = std::chrono::duration<double>(now - lastCheck).count();
+        if (elapsed * 1000 < io.checkIntervalMs) {
+            continue;
+        }
+        long long done = scheduler.BytesDone();
+        double rate = (done - lastBytes) / elapsed;
+        lastBytes = done;
+        lastCheck = now;
+        if (io.onInterval) {
+            io.onInterval(rate);
+        }
+
+        bool moreWork = scheduler.MoreWork();
+        int wanted = controller.Update(rate, moreWork);
+        int active = activeWorkers();
+        while (active < wanted && moreWork) {
+            addWorker();
+            active++;
+        }
+        // Drop the newest connections; they finish the range they hold first
+        for (size_t i = workers.size(); i-- > 0 && active > wanted;) {
+            if (!workers[i]->retire) {
+                workers[i]->retire = true;
+                active--;
+            }
+        }
+    }
+
+    if (io.onProgress) {
+        io.onProgress(scheduler.BytesDone());
+    }
+    return scheduler.Complete() && !scheduler.Stopped();
+}
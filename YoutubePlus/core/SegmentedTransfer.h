@@ -0,0 +1,135 @@
+// SegmentedTransfer.h : Fetching one file as byte ranges over several connections.
+//
+// A single connection to a media URL is often throttled, so the file is split into ranges
+// that a few connections fetch in parallel, each writing straight to its place in a
+// preallocated file. The HTTP and file sides are left to the caller through SegmentIo,
+// so the scheduling runs the same over WinHTTP and against a local test server.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+const long long kMinSegmentSize = 256 * 1024;
+const long long kMaxSegmentSize = 8 * 1024 * 1024;     // Larger ranges tend to get throttled themselves
+const double kSegmentTargetSeconds = 2.0;              // Segments are sized to take about this long
+const int kInitialSegmentConnections = 2;
+const int kMaxSegmentConnections = 8;
+const int kMaxSegmentAttempts = 3;
+
+// Byte ranges as [start, end) pairs
+typedef std::vector<std::pair<long long, long long>> ByteRanges;
+
+// Sort byte ranges and merge the ones that touch
+void MergeRanges(ByteRanges& ranges);
+
+// A byte range still to fetch, and how many times it has failed
+struct SegmentRange {
+    long long start;
+    long long end;          // Exclusive
+    int attempts;
+};
+
+// Hands out the ranges of one transfer to its connections and records what reached the file.
+// Every member may be called from any thread.
+class SegmentScheduler {
+public:
+    explicit SegmentScheduler(long long size);
+
+    // Queue only the gaps between the ranges an earlier attempt wrote
+    void Resume(const ByteRanges& done);
+
+    // Take the next range to fetch, sized from the measured per-connection rate; false when none is left
+    bool Next(SegmentRange& range);
+
+    // Report that a range was fetched up to reached after the given time. What is missing is
+    // queued again, and the transfer fails once a range has failed kMaxSegmentAttempts times.
+    void Finish(SegmentRange range, long long reached, double seconds);
+
+    void AddBytes(long long bytes) { bytesDone += bytes; }
+    void Fail() { failed = true; }
+    void Stop() { stopped = true; }
+
+    long long Size() const { return size; }
+    long long BytesDone() const { return bytesDone; }
+    bool Failed() const { return failed; }
+    bool Stopped() const { return stopped; }
+    bool Complete() const { return !failed && bytesDone == size; }
+
+    // True while some range has not been handed out yet
+    bool MoreWork();
+
+    // The ranges on disk, merged, for recording beside the file
+    ByteRanges Completed();
+
+private:
+    const long long size;
+    std::mutex mutex;
+    long long nextOffset = 0;
+    std::deque<SegmentRange> retries;
+    double connectionRate = 0;          // Bytes per second one connection achieves, averaged
+    ByteRanges completed;
+    std::atomic<long long> bytesDone{ 0 };
+    std::atomic<bool> failed{ false };
+    std::atomic<bool> stopped{ false };
+};
+
+// Decides how many connections a transfer runs. A connection is added while each addition
+// still raises the aggregate rate by kGrowRatio. When the aggregate rate falls instead, one
+// is dropped, and the transfer does not grow back past that count, since a server that
+// throttles extra connections would otherwise be probed again every other interval.
+class ConnectionController {
+public:
+    ConnectionController();
+
+    int Connections() const { return connections; }
+
+    // Feed the aggregate rate of the last interval; returns the connection count for the next one
+    int Update(double rate, bool moreWork);
+
+private:
+    static const double kGrowRatio;
+    static const double kShrinkRatio;
+
+    int connections;
+    int ceiling;
+    double lastRate;
+};
+
+// One connection to the server, used by one worker
+class RangeConnection {
+public:
+    virtual ~RangeConnection() {}
+
+    // Request [start, end); false unless the server answers with that range
+    virtual bool Request(long long start, long long end) = 0;
+
+    // Read the next part of the response body into buffer; 0 at the end or on an error
+    virtual size_t Read(char* buffer, size_t size) = 0;
+};
+
+// What a transfer needs from its caller
+struct SegmentIo {
+    // Open a connection; null when the server can't be reached
+    std::function<std::unique_ptr<RangeConnection>()> connect;
+    // Write bytes at an offset of the preallocated file; called from several threads at once
+    std::function<bool(long long offset, const char* data, size_t size)> write;
+    // True once the download was cancelled or paused; polled by the controlling thread only
+    std::function<bool()> stopped;
+    // Called about every 500 ms with the bytes on disk
+    std::function<void(long long bytesDone)> onProgress;
+    // Called every check interval with the aggregate rate in bytes per second
+    std::function<void(double rate)> onInterval;
+    // How often the rate is measured and the connection count revisited
+    int checkIntervalMs = 2000;
+};
+
+// Fetch every range still missing and return true once the whole file is on disk. Returns
+// false when the transfer failed, was stopped, or no connection could be opened.
+bool RunSegmentedTransfer(SegmentScheduler& scheduler, const SegmentIo& io);
@@ -0,0 +1,158 @@
+// Subtitles.cpp : WebVTT cleanup and SRT / transcript output.
+
+#include "Subtitles.h"
+
+#include <cstdio>
+#include <cstring>
+
+double ParseVttTimestamp(const std::string& text) {
+    double seconds = 0;
+    double field = 0;
+    double scale = 0;   // Non-zero once past the decimal point
+    bool digits = false;
+    for (char c : text) {
+        if (c >= '0' && c <= '9') {
+            if (scale > 0) {
+                field += (c - '0') * scale;
+                scale /= 10;
+            } else {
+                field = field * 10 + (c - '0');
+            }
+            digits = true;
+        }
+        else if (c == ':') {
+            seconds = (seconds + field) * 60;
+            field = 0;
+        }
+        else if (c == '.' || c == ',') {
+            scale = 0.1;
+        }
+        else if (c == ' ' || c == '\t') {
+            if (digits) break;
+        }
+        else {
+            return -1;
+        }
+    }
+    return digits ? seconds + field : -1;
+}
+
+std::string CleanCueText(const std::string& line) {
+    std::string text;
+    text.reserve(line.size());
+    bool space = false;
+    for (size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
+        if (c == '<') {
+            size_t close = line.find('>', i);
+            if (close == std::string::npos) break;
+            i = close;
+            continue;
+        }
+        if (c == '&') {
+            static const struct { const char* entity; char value; } entities[] = {
+                { "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&#39;", '\'' }, { "&nbsp;", ' ' }
+            };
+            bool decoded = false;
+            for (const auto& e : entities) {
+                size_t length = strlen(e.entity);
+                if (line.compare(i, length, e.entity) == 0) {
+                    c = e.value;
+                    i += length - 1;
+                    decoded = true;
+                    break;
+                }
+            }
+            if (!decoded) c = '&';
+        }
+        if (c == ' ' || c == '\t') {
+            space = !text.empty();
+            continue;
+        }
+        if (space) {
+            text += ' ';
+            space = false;
+        }
+        text += c;
+    }
+    return text;
+}
+
+// YouTube's auto-generated tracks roll: each cue repeats the previous line above the one being
+// spoken, and short filler cues repeat it again, so a line is kept only the first time it appears
+// and later repeats just extend how long it stays on screen.
+void ParseWebVtt(const std::string& vtt, std::vector<SubtitleLine>& lines) {
+    size_t pos = 0;
+    auto nextLine = [&](std::string& line) {
+        size_t eol = vtt.find('\n', pos);
+        if (eol == std::string::npos) eol = vtt.size();
+        line.assign(vtt, pos, eol - pos);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        pos = eol + 1;
+    };
+
+    std::string line;
+    while (pos < vtt.size()) {
+        nextLine(line);
+        size_t arrow = line.find("-->");
+        if (arrow == std::string::npos) {
+            continue; // Header, cue identifier, NOTE or STYLE block
+        }
+        double start = ParseVttTimestamp(line.substr(0, arrow));
+        double end = ParseVttTimestamp(line.substr(arrow + 3));
+        if (start < 0 || end < start) {
+            continue;
+        }
+
+        while (pos < vtt.size()) {
+            nextLine(line);
+            if (line.empty()) {
+                break;
+            }
+            std::string text = CleanCueText(line);
+            if (text.empty()) {
+                continue;
+            }
+            // Compare with the last two lines kept, which is as far back as the rolling window reaches
+            size_t count = lines.size();
+            if (count >= 1 && lines[count - 1].text == text) {
+                if (end > lines[count - 1].end) lines[count - 1].end = end;
+                continue;
+            }
+            if (count >= 2 && lines[count - 2].text == text) {
+                if (end > lines[count - 2].end) lines[count - 2].end = end;
+                continue;
+            }
+            lines.push_back({ start, end, text });
+        }
+    }
+}
+
+std::string FormatSrtTimestamp(double seconds) {
+    long long ms = (long long)(seconds * 1000 + 0.5);
+    char text[32];
+    snprintf(text, sizeof(text), "%02lld:%02lld:%02lld,%03lld", ms / 3600000, (ms / 60000) % 60, (ms / 1000) % 60, ms % 1000);
+    return text;
+}
+
+std::string FormatSubtitles(const std::vector<SubtitleLine>& lines, bool srt) {
+    std::string output;
+    output.reserve(lines.size() * (srt ? 64 : 40));
+    int index = 1;
+    for (const auto& line : lines) {
+        if (srt) {
+            output += std::to_string(index++);
+            output += '\n';
+            output += FormatSrtTimestamp(line.start);
+            output += " --> ";
+            output += FormatSrtTimestamp(line.end);
+            output += '\n';
+            output += line.text;
+            output += "\n\n";
+        } else {
+            output += line.text;
+            output += '\n';
+        }
+    }
+    return output;
+}
@@ -0,0 +1,28 @@
+// Subtitles.h : Conversion of downloaded WebVTT subtitles to SRT or a plain transcript.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// One line of a subtitle track after cleanup, times in seconds
+struct SubtitleLine {
+    double start;
+    double end;
+    std::string text;
+};
+
+// Parse a WebVTT timestamp ("01:02:03.456" or "02:03.456"); -1 if invalid
+double ParseVttTimestamp(const std::string& text);
+
+// Strip cue markup (<c>, inline <00:00:01.000> timings) and entities, and collapse whitespace
+std::string CleanCueText(const std::string& line);
+
+// Parse WebVTT into distinct lines, collapsing the rolling repeats of auto-generated tracks
+void ParseWebVtt(const std::string& vtt, std::vector<SubtitleLine>& lines);
+
+// Format seconds as an SRT timestamp
+std::string FormatSrtTimestamp(double seconds);
+
+// Write cleaned subtitle lines as SRT, or as a plain transcript with one line per row
+std::string FormatSubtitles(const std::vector<SubtitleLine>& lines, bool srt);
@@ -0,0 +1,110 @@
+// Xxh64.cpp : XXH64 as specified by the xxHash reference, reading input as little-endian.
+
+#include "Xxh64.h"
+
+#include <cstring>
+
+namespace {
+
+const uint64_t kPrime1 = 11400714785074694791ULL;
+const uint64_t kPrime2 = 14029467366897019727ULL;
+const uint64_t kPrime3 = 1609587929392839161ULL;
+const uint64_t kPrime4 = 9650029242287828579ULL;
+const uint64_t kPrime5 = 2870177450012600261ULL;
+
+inline uint64_t Rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t Round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    return Rotl(acc, 31) * kPrime1;
+}
+
+// Compilers turn these into a single load on little-endian targets
+inline uint64_t Read64(const unsigned char* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+inline uint32_t Read32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+}  // namespace
+
+Xxh64State::Xxh64State()
+    : v{ kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1 }, total(0), buffered(0) {}
+
+void Xxh64Update(Xxh64State& state, const void* input, size_t length) {
+    const unsigned char* data = (const unsigned char*)input;
+    state.total += length;
+    if (state.buffered + length < 32) {
+        if (length > 0) {
+            memcpy(state.buffer + state.buffered, data, length);
+        }
+        state.buffered += length;
+        return;
+    }
+    if (state.buffered) {
+        size_t fill = 32 - state.buffered;
+        memcpy(state.buffer + state.buffered, data, fill);
+        for (int i = 0; i < 4; i++) state.v[i] = Round(state.v[i], Read64(state.buffer + 8 * i));
+        data += fill;
+        length -= fill;
+        state.buffered = 0;
+    }
+    uint64_t v0 = state.v[0], v1 = state.v[1], v2 = state.v[2], v3 = state.v[3];
+    for (; length >= 32; data += 32, length -= 32) {
+        v0 = Round(v0, Read64(data));
+        v1 = Round(v1, Read64(data + 8));
+        v2 = Round(v2, Read64(data + 16));
+        v3 = Round(v3, Read64(data + 24));
+    }
+    state.v[0] = v0; state.v[1] = v1; state.v[2] = v2; state.v[3] = v3;
+    if (length > 0) {
+        memcpy(state.buffer, data, length);
+    }
+    state.buffered = length;
+}
+
+uint64_t Xxh64Digest(const Xxh64State& state) {
+    uint64_t h;
+    if (state.total >= 32) {
+        h = Rotl(state.v[0], 1) + Rotl(state.v[1], 7) + Rotl(state.v[2], 12) + Rotl(state.v[3], 18);
+        for (int i = 0; i < 4; i++) {
+            h ^= Round(0, state.v[i]);
+            h = h * kPrime1 + kPrime4;
+        }
+    }
+    else {
+        h = kPrime5;
+    }
+    h += state.total;
+
+    const unsigned char* p = state.buffer;
+    size_t length = state.buffered;
+    for (; length >= 8; p += 8, length -= 8) {
+        h ^= Round(0, Read64(p));
+        h = Rotl(h, 27) * kPrime1 + kPrime4;
+    }
+    if (length >= 4) {
+        h ^= (uint64_t)Read32(p) * kPrime1;
+        h = Rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+        length -= 4;
+    }
+    for (; length > 0; p++, length--) {
+        h ^= *p * kPrime5;
+        h = Rotl(h, 11) * kPrime1;
+    }
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
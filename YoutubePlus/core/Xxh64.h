@@ -0,0 +1,24 @@
+// Xxh64.h : XXH64 (seed 0), fed in pieces, for hashing downloaded files.
+//
+// Implemented here rather than pulled in as a library; it is a few dozen lines and hashes at
+// memory speed, so reading the file is the only real cost.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct Xxh64State {
+    Xxh64State();
+
+    uint64_t v[4];
+    uint64_t total;             // Bytes fed so far
+    unsigned char buffer[32];   // The tail that doesn't fill a 32-byte stripe yet
+    size_t buffered;
+};
+
+// Feed bytes into an XXH64 state
+void Xxh64Update(Xxh64State& state, const void* data, size_t length);
+
+// Finish an XXH64 state; the state can still be updated afterwards
+uint64_t Xxh64Digest(const Xxh64State& state);
@@ -0,0 +1,207 @@
+// YouTubeUrl.cpp : The single-pass URL classifier, for wide and UTF-8 strings alike.
+
+#include "YouTubeUrl.h"
+
+#include <cstring>
+
+namespace {
+
+// Check a [begin, end) span against an 11 character video ID
+template <typename Char>
+inline bool IsVideoIdSpan(const Char* begin, const Char* end) {
+    if (end - begin != 11) {
+        return false;
+    }
+    for (const Char* p = begin; p != end; ++p) {
+        if (!IsYouTubeIdChar(*p)) return false;
+    }
+    return true;
+}
+
+// Check a [begin, end) span against a playlist ID (PL..., UU..., RD..., OLAK5uy_...)
+template <typename Char>
+inline bool IsPlaylistIdSpan(const Char* begin, const Char* end) {
+    if (end - begin < 2 || end - begin > 64) {
+        return false;
+    }
+    for (const Char* p = begin; p != end; ++p) {
+        if (!IsYouTubeIdChar(*p)) return false;
+    }
+    return true;
+}
+
+// Compare a span against a lowercase ASCII literal, ignoring case
+template <typename Char>
+inline bool SpanEqualsNoCase(const Char* begin, const Char* end, const char* literal) {
+    for (; begin != end; ++begin, ++literal) {
+        Char c = *begin;
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        if (*literal == 0 || c != (Char)*literal) return false;
+    }
+    return *literal == 0;
+}
+
+// Check whether a span starts with an ASCII literal, ignoring case
+template <typename Char>
+inline bool SpanStartsWithNoCase(const Char* begin, const Char* end, const char* literal) {
+    size_t length = strlen(literal);
+    return (size_t)(end - begin) >= length && SpanEqualsNoCase(begin, begin + length, literal);
+}
+
+// Check whether a span starts with an ASCII literal
+template <typename Char>
+inline bool SpanStartsWith(const Char* begin, const Char* end, const char* literal) {
+    for (; *literal; ++begin, ++literal) {
+        if (begin == end || *begin != (Char)*literal) return false;
+    }
+    return true;
+}
+
+template <typename Char>
+BasicYouTubeUrlInfo<Char> Classify(const std::basic_string<Char>& url) {
+    BasicYouTubeUrlInfo<Char> info;
+    const Char* p = url.c_str();
+    const Char* end = p + url.size();
+
+    // Scheme
+    for (const char* scheme : { "https://", "http://" }) {
+        if (SpanStartsWithNoCase(p, end, scheme)) {
+            p += strlen(scheme);
+            break;
+        }
+    }
+
+    // Host, without port or user info
+    const Char* host = p;
+    while (p != end && *p != '/' && *p != '?' && *p != '#') ++p;
+    const Char* hostEnd = p;
+    for (const Char* c = host; c != hostEnd; ++c) {
+        if (*c == '@') host = c + 1;
+    }
+    for (const Char* c = host; c != hostEnd; ++c) {
+        if (*c == ':') { hostEnd = c; break; }
+    }
+    for (const char* prefix : { "www.", "m.", "music." }) {
+        size_t length = strlen(prefix);
+        if ((size_t)(hostEnd - host) > length && SpanEqualsNoCase(host, host + length, prefix)) {
+            host += length;
+            break;
+        }
+    }
+    bool shortHost = SpanEqualsNoCase(host, hostEnd, "youtu.be");
+    if (!shortHost && !SpanEqualsNoCase(host, hostEnd, "youtube.com") &&
+        !SpanEqualsNoCase(host, hostEnd, "youtube-nocookie.com")) {
+        return info;
+    }
+    info.kind = UrlOtherPage;
+
+    // First two path segments
+    const Char* segments[2][2] = {};
+    int segmentCount = 0;
+    while (p != end && *p == '/') {
+        const Char* start = ++p;
+        while (p != end && *p != '/' && *p != '?' && *p != '#') ++p;
+        if (p != start && segmentCount < 2) {
+            segments[segmentCount][0] = start;
+            segments[segmentCount][1] = p;
+            ++segmentCount;
+        }
+    }
+
+    // Query parameters: v= and list=
+    const Char* v[2] = {};
+    const Char* list[2] = {};
+    if (p != end && *p == '?') {
+        ++p;
+        while (p != end && *p != '#') {
+            const Char* start = p;
+            while (p != end && *p != '&' && *p != '#') ++p;
+            if (p - start > 2 && start[0] == 'v' && start[1] == '=') {
+                v[0] = start + 2;
+                v[1] = p;
+            }
+            else if (p - start > 5 && SpanStartsWith(start, p, "list=")) {
+                list[0] = start + 5;
+                list[1] = p;
+            }
+            if (p != end && *p == '&') ++p;
+        }
+    }
+    if (list[0] && IsPlaylistIdSpan(list[0], list[1])) {
+        info.playlistId.assign(list[0], list[1]);
+    }
+
+    const Char* idBegin = nullptr;
+    const Char* idEnd = nullptr;
+    YouTubeUrlKind idKind = UrlVideo;
+    if (shortHost) {
+        if (segmentCount >= 1) {
+            idBegin = segments[0][0];
+            idEnd = segments[0][1];
+        }
+    }
+    else if (segmentCount >= 1) {
+        const Char* first = segments[0][0];
+        const Char* firstEnd = segments[0][1];
+        if (SpanEqualsNoCase(first, firstEnd, "watch")) {
+            idBegin = v[0];
+            idEnd = v[1];
+        }
+        else if (segmentCount == 2 && (SpanEqualsNoCase(first, firstEnd, "shorts") ||
+                                       SpanEqualsNoCase(first, firstEnd, "live") ||
+                                       SpanEqualsNoCase(first, firstEnd, "embed") ||
+                                       SpanEqualsNoCase(first, firstEnd, "v") ||
+                                       SpanEqualsNoCase(first, firstEnd, "e"))) {
+            idBegin = segments[1][0];
+            idEnd = segments[1][1];
+            if (SpanEqualsNoCase(idBegin, idEnd, "videoseries")) {
+                idBegin = nullptr;  // Playlist embed, exactly 11 characters long
+            }
+            if (*first == 's' || *first == 'S') idKind = UrlShort;
+            else if (*first == 'l' || *first == 'L') idKind = UrlLive;
+        }
+        else if (*first == '@' || SpanEqualsNoCase(first, firstEnd, "channel") ||
+                 SpanEqualsNoCase(first, firstEnd, "c") || SpanEqualsNoCase(first, firstEnd, "user")) {
+            if (*first == '@' || segmentCount == 2) info.kind = UrlChannel;
+        }
+    }
+
+    if (idBegin && IsVideoIdSpan(idBegin, idEnd)) {
+        info.kind = idKind;
+        info.videoId.assign(idBegin, idEnd);
+    }
+    else if (info.kind == UrlOtherPage && !info.playlistId.empty()) {
+        // /playlist?list=, /embed/videoseries?list= or a watch URL whose v= is missing
+        info.kind = UrlPlaylist;
+    }
+    return info;
+}
+
+template <typename Char>
+bool IsDownloadableUrl(const std::basic_string<Char>& url) {
+    const Char* begin = url.c_str();
+    const Char* end = begin + url.size();
+    if (!SpanStartsWith(begin, end, "http://") && !SpanStartsWith(begin, end, "https://")) {
+        return false;
+    }
+    YouTubeUrlKind kind = Classify(url).kind;
+    return IsVideoUrlKind(kind) || kind == UrlPlaylist;
+}
+
+}  // namespace
+
+YouTubeUrlInfo ClassifyYouTubeUrl(const std::wstring& url) {
+    return Classify(url);
+}
+
+Utf8YouTubeUrlInfo ClassifyYouTubeUrl(const std::string& url) {
+    return Classify(url);
+}
+
+bool IsYouTubeUrl(const std::wstring& url) {
+    return IsDownloadableUrl(url);
+}
+
+bool IsYouTubeUrl(const std::string& url) {
+    return IsDownloadableUrl(url);
+}
@@ -0,0 +1,48 @@
+// YouTubeUrl.h : Classifying YouTube URLs and extracting their video and playlist IDs.
+
+#pragma once
+
+#include <string>
+
+// What a YouTube URL points at
+enum YouTubeUrlKind {
+    UrlNotYouTube,
+    UrlOtherPage,   // On a YouTube host but nothing downloadable (home page, search, ...)
+    UrlVideo,
+    UrlShort,
+    UrlLive,
+    UrlPlaylist,
+    UrlChannel
+};
+
+// Result of ClassifyYouTubeUrl. IDs are validated and empty when absent.
+// A watch URL with both v= and list= is a UrlVideo carrying a playlist ID.
+template <typename Char>
+struct BasicYouTubeUrlInfo {
+    YouTubeUrlKind kind = UrlNotYouTube;
+    std::basic_string<Char> videoId;
+    std::basic_string<Char> playlistId;
+};
+typedef BasicYouTubeUrlInfo<wchar_t> YouTubeUrlInfo;
+typedef BasicYouTubeUrlInfo<char> Utf8YouTubeUrlInfo;
+
+// Classify a URL in a single pass without regexes or allocations beyond the returned IDs, so
+// pasted lists of thousands of links are cheap to sort through. Accepts youtube.com and its
+// www., m., music. subdomains, youtube-nocookie.com and youtu.be, with or without a scheme.
+YouTubeUrlInfo ClassifyYouTubeUrl(const std::wstring& url);
+Utf8YouTubeUrlInfo ClassifyYouTubeUrl(const std::string& url);
+
+// Characters allowed in video and playlist IDs (base64url)
+template <typename Char>
+inline bool IsYouTubeIdChar(Char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+}
+
+// Check whether a kind names a single video (watch, youtu.be, shorts, live, embed)
+inline bool IsVideoUrlKind(YouTubeUrlKind kind) {
+    return kind == UrlVideo || kind == UrlShort || kind == UrlLive;
+}
+
+// Check that a URL is an http(s) link to a YouTube video or playlist, something a download can start from
+bool IsYouTubeUrl(const std::wstring& url);
+bool IsYouTubeUrl(const std::string& url);
@@ -0,0 +1,172 @@
+// YoutubePlusHeadless.cpp : Console entry point for the headless download queue (see core/Headless.h).
+// The GUI app is a /SUBSYSTEM:WINDOWS program, which returns to the shell at once and gets no
+// Ctrl+C, so headless runs are a console program of their own. It builds on Windows and Linux.
+
+#include "core/Headless.h"
+#include "nlohmann/json.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <signal.h>
+#endif
+
+namespace {
+
+// Set by Ctrl+C; the queue then cancels what runs and reports before exiting
+std::atomic<bool> g_stop(false);
+
+// Helper function to write one JSON line to stdout, flushed so a reader sees it at once.
+// Once nobody reads the output any more, the downloads are cancelled.
+void WriteLine(const std::string& line) {
+    std::fwrite(line.data(), 1, line.size(), stdout);
+    std::fputc('\n', stdout);
+    if (std::fflush(stdout) != 0 || std::ferror(stdout)) {
+        g_stop = true;
+    }
+}
+
+// Helper function to read a whole file, or stdin for "-"
+bool ReadSource(const std::string& source, std::string& contents) {
+    if (source == "-") {
+        char buffer[4096];
+        size_t bytesRead;
+        while ((bytesRead = std::fread(buffer, 1, sizeof(buffer), stdin)) > 0) {
+            contents.append(buffer, bytesRead);
+        }
+        return true;
+    }
+#ifdef _WIN32
+    std::wstring path;
+    int size = MultiByteToWideChar(CP_UTF8, 0, source.data(), (int)source.size(), NULL, 0);
+    path.resize(size);
+    MultiByteToWideChar(CP_UTF8, 0, source.data(), (int)source.size(), &path[0], size);
+    std::ifstream file(path.c_str(), std::ios::binary);
+#else
+    std::ifstream file(source.c_str(), std::ios::binary);
+#endif
+    if (!file.good()) {
+        return false;
+    }
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+#ifdef _WIN32
+std::string ToUtf8(const std::wstring& text) {
+    int size = WideCharToMultiByte(CP_UTF8, 0, text.data(), (int)text.size(), NULL, 0, NULL, NULL);
+    std::string utf8(size, 0);
+    WideCharToMultiByte(CP_UTF8, 0, text.data(), (int)text.size(), &utf8[0], size, NULL, NULL);
+    return utf8;
+}
+
+// Ctrl+C, Ctrl+Break and closing the console all cancel the queue
+BOOL WINAPI StopHandler(DWORD ctrlType) {
+    UNREFERENCED_PARAMETER(ctrlType);
+    g_stop = true;
+    return TRUE;
+}
+
+// The app's settings file, %LOCALAPPDATA%\YoutubePlus\settings.json
+std::string GetSettingsPath() {
+    const wchar_t* localAppData = _wgetenv(L"LOCALAPPDATA");
+    return localAppData ? ToUtf8(localAppData) + "\\YoutubePlus\\settings.json" : "";
+}
+
+// The yt-dlp.exe installed next to the app, as the app runs it; otherwise whatever is on PATH
+std::string GetDefaultYtDlpPath() {
+    wchar_t exePath[MAX_PATH];
+    GetModuleFileNameW(NULL, exePath, MAX_PATH);
+    std::wstring path = exePath;
+    size_t pos = path.find_last_of(L"\\/");
+    if (pos != std::wstring::npos) {
+        path = path.substr(0, pos) + L"\\yt-dlp.exe";
+        if (GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES) {
+            return ToUtf8(path);
+        }
+    }
+    return "yt-dlp";
+}
+#else
+void StopHandler(int) {
+    g_stop = true;
+}
+
+// $XDG_CONFIG_HOME/YoutubePlus/settings.json, defaulting to ~/.config
+std::string GetSettingsPath() {
+    const char* config = std::getenv("XDG_CONFIG_HOME");
+    if (config && *config) {
+        return std::string(config) + "/YoutubePlus/settings.json";
+    }
+    const char* home = std::getenv("HOME");
+    return home ? std::string(home) + "/.config/YoutubePlus/settings.json" : "";
+}
+
+std::string GetDefaultYtDlpPath() {
+    return "yt-dlp";
+}
+#endif
+
+int RunHeadless(const std::vector<std::string>& arguments) {
+    HeadlessOptions options;
+    options.ytDlpPath = GetDefaultYtDlpPath();
+    std::string settings;
+    std::string settingsPath = GetSettingsPath();
+    if (!settingsPath.empty() && ReadSource(settingsPath, settings)) {
+        ApplyHeadlessSettings(settings, options);
+    }
+
+    std::string input;
+    std::vector<std::string> urls;
+    std::string error;
+    if (!ParseHeadlessArguments(arguments, options, input, urls, error)) {
+        WriteLine(nlohmann::json({ { "event", "error" }, { "error", error } }).dump());
+        return 2;
+    }
+    std::string contents;
+    if (!input.empty()) {
+        if (!ReadSource(input, contents)) {
+            WriteLine(nlohmann::json({ { "event", "error" }, { "error", "Cannot read " + input } }).dump());
+            return 2;
+        }
+        ParseUrlList(contents, urls);
+    }
+    return RunHeadlessQueue(urls, options, WriteLine, g_stop);
+}
+
+}  // namespace
+
+#ifdef _WIN32
+int wmain(int argc, wchar_t* argv[]) {
+    // JSON lines are UTF-8 bytes whatever the console code page; the URL list is read as bytes too
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+    SetConsoleCtrlHandler(StopHandler, TRUE);
+    std::vector<std::string> arguments;
+    for (int i = 1; i < argc; i++) {
+        arguments.push_back(ToUtf8(argv[i]));
+    }
+    return RunHeadless(arguments);
+}
+#else
+int main(int argc, char* argv[]) {
+    struct sigaction action = {};
+    action.sa_handler = StopHandler;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    // A reader that goes away shows up as a failed write, which cancels the downloads
+    signal(SIGPIPE, SIG_IGN);
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    return RunHeadless(arguments);
+}
+#endif
@@ -0,0 +1,21 @@
+// Benchmark.h : Timing and fixture helpers shared by the core benchmarks.
+
+#pragma once
+
+#include <chrono>
+#include "Fixture.h"
+
+// Best wall-clock time of several rounds, in seconds
+template <typename Body>
+double TimeBest(int rounds, Body body) {
+    double best = 0;
+    for (int round = 0; round < (rounds > 0 ? rounds : 1); round++) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (round == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,137 @@
+// PlaylistParseBenchmark.cpp : Times PlaylistEntrySax against building a DOM per line on a
+// 10k-line yt-dlp --flat-playlist --dump-json fixture, and checks both read the same fields.
+//
+// Usage: playlist_parse_benchmark [rounds]   (default 20; ctest runs 1 round as a smoke test)
+
+#include "core/PlaylistEntrySax.h"
+#include "Benchmark.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+const size_t kFixtureLines = 10000;
+
+struct Entry {
+    std::string id;
+    std::string title;
+    std::string channel;
+    double duration;
+};
+
+// Expand the one-line template into kFixtureLines entries with distinct IDs, titles and indices
+std::vector<std::string> BuildFixture(const std::string& templateLine) {
+    const std::string templateId = "dQw4w9WgXcQ";
+    std::vector<std::string> lines;
+    lines.reserve(kFixtureLines);
+    for (size_t i = 0; i < kFixtureLines; i++) {
+        char id[12];
+        std::snprintf(id, sizeof(id), "bench%06zu", i);
+        std::string line = templateLine;
+        for (size_t pos = line.find(templateId); pos != std::string::npos; pos = line.find(templateId, pos)) {
+            line.replace(pos, templateId.size(), id);
+        }
+        size_t index = line.find("\"playlist_index\": 1,");
+        if (index != std::string::npos) {
+            line.replace(index, 20, "\"playlist_index\": " + std::to_string(i + 1) + ",");
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+bool ParseSax(const std::string& line, Entry& entry) {
+    PlaylistEntrySax sax;
+    try {
+        nlohmann::json::sax_parse(line, &sax);
+    }
+    catch (...) {
+        return false;
+    }
+    if (!sax.hasId || !sax.hasTitle) {
+        return false;
+    }
+    entry.id = std::move(sax.id);
+    entry.title = std::move(sax.title);
+    entry.channel = std::move(sax.channel);
+    entry.duration = sax.duration;
+    return true;
+}
+
+// What ParsePlaylistLine did before the SAX handler: parse the whole line, then read the fields
+bool ParseDom(const std::string& line, Entry& entry) {
+    try {
+        auto json = nlohmann::json::parse(line);
+        if (!json.contains("id") || !json.contains("title")) {
+            return false;
+        }
+        entry.id = json["id"].get<std::string>();
+        entry.title = json["title"].get<std::string>();
+        auto channel = json.find("channel");
+        entry.channel = channel != json.end() && channel->is_string() ? channel->get<std::string>() : "";
+        auto duration = json.find("duration");
+        entry.duration = duration != json.end() && duration->is_number() ? duration->get<double>() : 0;
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+template <typename Parse>
+size_t ParseAll(const std::vector<std::string>& lines, std::vector<Entry>& entries, Parse parse) {
+    entries.clear();
+    Entry entry;
+    for (const auto& line : lines) {
+        if (parse(line, entry)) {
+            entries.push_back(entry);
+        }
+    }
+    return entries.size();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+    std::string templateLine;
+    if (!ReadFixture("playlist_entry.json", templateLine)) {
+        return 1;
+    }
+    while (!templateLine.empty() && (templateLine.back() == '\n' || templateLine.back() == '\r')) {
+        templateLine.pop_back();
+    }
+    std::vector<std::string> lines = BuildFixture(templateLine);
+    size_t bytes = 0;
+    for (const auto& line : lines) {
+        bytes += line.size();
+    }
+
+    std::vector<Entry> saxEntries;
+    std::vector<Entry> domEntries;
+    double saxSeconds = TimeBest(rounds, [&]() { ParseAll(lines, saxEntries, ParseSax); });
+    double domSeconds = TimeBest(rounds, [&]() { ParseAll(lines, domEntries, ParseDom); });
+
+    if (saxEntries.size() != kFixtureLines || domEntries.size() != kFixtureLines) {
+        std::fprintf(stderr, "parsed %zu (SAX) and %zu (DOM) of %zu lines\n", saxEntries.size(), domEntries.size(),
+                     kFixtureLines);
+        return 1;
+    }
+    for (size_t i = 0; i < kFixtureLines; i++) {
+        const Entry& a = saxEntries[i];
+        const Entry& b = domEntries[i];
+        if (a.id != b.id || a.title != b.title || a.channel != b.channel || a.duration != b.duration) {
+            std::fprintf(stderr, "line %zu: SAX and DOM disagree\n", i + 1);
+            return 1;
+        }
+    }
+
+    std::printf("%zu lines, %.1f MB\n", kFixtureLines, bytes / (1024.0 * 1024.0));
+    std::printf("SAX: %8.2f ms  %8.0f lines/s\n", saxSeconds * 1000, kFixtureLines / saxSeconds);
+    std::printf("DOM: %8.2f ms  %8.0f lines/s\n", domSeconds * 1000, kFixtureLines / domSeconds);
+    std::printf("SAX is %.1fx faster\n", domSeconds / saxSeconds);
+    return 0;
+}
@@ -0,0 +1,120 @@
+// SubtitleConvertBenchmark.cpp : Times the native WebVTT cleanup on an auto-generated track
+// several hours long, built by repeating a recorded 14-second stretch of rolling cues, and
+// checks that every spoken line comes out exactly once with its full on-screen time.
+//
+// Usage: subtitle_convert_benchmark [rounds]   (default 20; ctest runs 1 round as a smoke test)
+
+#include "core/Subtitles.h"
+#include "Benchmark.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int kRepeats = 2000;          // 2000 x 14 s is about 7.8 hours of speech
+const double kTemplateSeconds = 14;
+const size_t kTemplateLines = 5;
+
+std::string FormatVttTimestamp(double seconds) {
+    long long ms = (long long)(seconds * 1000 + 0.5);
+    char text[32];
+    std::snprintf(text, sizeof(text), "%02lld:%02lld:%02lld.%03lld", ms / 3600000, (ms / 60000) % 60,
+                  (ms / 1000) % 60, ms % 1000);
+    return text;
+}
+
+// Repeat the template's cues kRepeats times, shifting each copy's cue timings along
+std::string BuildFixture(const std::string& vtt, size_t& cues) {
+    size_t bodyStart = vtt.find("\n\n");
+    std::string header = vtt.substr(0, bodyStart + 2);
+    std::string body = vtt.substr(bodyStart + 2);
+    if (body.empty() || body.back() != '\n') {
+        body += '\n';
+    }
+
+    std::string output = header;
+    output.reserve(header.size() + body.size() * kRepeats);
+    cues = 0;
+    for (int repeat = 0; repeat < kRepeats; repeat++) {
+        double offset = repeat * kTemplateSeconds;
+        size_t pos = 0;
+        while (pos < body.size()) {
+            size_t eol = body.find('\n', pos);
+            std::string line = body.substr(pos, eol - pos);
+            pos = eol + 1;
+            size_t arrow = line.find(" --> ");
+            if (arrow != std::string::npos) {
+                size_t settings = line.find(' ', arrow + 5);
+                output += FormatVttTimestamp(ParseVttTimestamp(line.substr(0, arrow)) + offset);
+                output += " --> ";
+                output += FormatVttTimestamp(ParseVttTimestamp(line.substr(arrow + 5, settings - arrow - 5)) + offset);
+                output += line.substr(settings);
+                cues++;
+            } else {
+                output += line;
+            }
+            output += '\n';
+        }
+        output += '\n';
+    }
+    return output;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+    std::string templateVtt;
+    if (!ReadFixture("subtitles_auto.vtt", templateVtt)) {
+        return 1;
+    }
+    size_t cues = 0;
+    std::string vtt = BuildFixture(templateVtt, cues);
+
+    std::vector<SubtitleLine> lines;
+    std::string srt;
+    std::string text;
+    double parseSeconds = TimeBest(rounds, [&]() {
+        lines.clear();
+        ParseWebVtt(vtt, lines);
+    });
+    double srtSeconds = TimeBest(rounds, [&]() { srt = FormatSubtitles(lines, true); });
+    double textSeconds = TimeBest(rounds, [&]() { text = FormatSubtitles(lines, false); });
+
+    // Each spoken line appears in three cues but must be kept once, on screen from its
+    // first word until the next line takes over
+    if (lines.size() != kTemplateLines * kRepeats) {
+        std::fprintf(stderr, "kept %zu lines from %zu cues, expected %zu\n", lines.size(), cues,
+                     kTemplateLines * kRepeats);
+        return 1;
+    }
+    for (int repeat = 0; repeat < kRepeats; repeat++) {
+        const SubtitleLine& first = lines[repeat * kTemplateLines];
+        const SubtitleLine& last = lines[repeat * kTemplateLines + kTemplateLines - 1];
+        double offset = repeat * kTemplateSeconds;
+        if (first.text != "so today we're going to" || first.start != ParseVttTimestamp(FormatVttTimestamp(offset)) ||
+            first.end != ParseVttTimestamp(FormatVttTimestamp(offset + 5.63)) ||
+            last.end != ParseVttTimestamp(FormatVttTimestamp(offset + kTemplateSeconds))) {
+            std::fprintf(stderr, "repeat %d: lines or times do not match the template\n", repeat);
+            return 1;
+        }
+    }
+    const std::string firstCue = "1\n00:00:00,000 --> 00:00:05,630\nso today we're going to\n\n";
+    if (lines[1].text != "talk about how subtitles & captions" || srt.compare(0, firstCue.size(), firstCue) != 0 ||
+        text.compare(0, 24, "so today we're going to\n") != 0) {
+        std::fprintf(stderr, "unexpected output: %s\n", srt.substr(0, 80).c_str());
+        return 1;
+    }
+
+    double megabytes = vtt.size() / (1024.0 * 1024.0);
+    std::printf("%zu cues, %.1f MB of WebVTT -> %zu lines\n", cues, megabytes, lines.size());
+    std::printf("parse: %8.2f ms  %8.1f MB/s\n", parseSeconds * 1000, megabytes / parseSeconds);
+    std::printf("srt:   %8.2f ms  %8.1f MB out (%.0f%% of input)\n", srtSeconds * 1000, srt.size() / (1024.0 * 1024.0),
+                100.0 * srt.size() / vtt.size());
+    std::printf("text:  %8.2f ms  %8.1f MB out (%.0f%% of input)\n", textSeconds * 1000,
+                text.size() / (1024.0 * 1024.0), 100.0 * text.size() / vtt.size());
+    return 0;
+}
@@ -0,0 +1,123 @@
+// UrlClassifyBenchmark.cpp : Times ClassifyYouTubeUrl over a bulk list built from 16 recorded
+// URL shapes, for both UTF-8 and wide strings, and checks each shape's kind and IDs.
+//
+// Usage: url_classify_benchmark [rounds]   (default 20; ctest runs 1 round as a smoke test)
+
+#include "core/YouTubeUrl.h"
+#include "Benchmark.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const size_t kBulkUrls = 1 << 20;
+
+struct UrlCase {
+    std::string kind;
+    std::string videoId;
+    std::string playlistId;
+    std::string url;
+};
+
+const char* KindName(YouTubeUrlKind kind) {
+    switch (kind) {
+    case UrlOtherPage: return "other";
+    case UrlVideo: return "video";
+    case UrlShort: return "short";
+    case UrlLive: return "live";
+    case UrlPlaylist: return "playlist";
+    case UrlChannel: return "channel";
+    default: return "none";
+    }
+}
+
+// Each line is "kind video-id playlist-id url", with "-" for an absent ID
+bool ReadCases(const std::string& text, std::vector<UrlCase>& cases) {
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        UrlCase urlCase;
+        if (!(fields >> urlCase.kind >> urlCase.videoId >> urlCase.playlistId >> urlCase.url)) {
+            return false;
+        }
+        if (urlCase.videoId == "-") urlCase.videoId.clear();
+        if (urlCase.playlistId == "-") urlCase.playlistId.clear();
+        cases.push_back(urlCase);
+    }
+    return !cases.empty();
+}
+
+bool CheckCase(const UrlCase& urlCase) {
+    Utf8YouTubeUrlInfo info = ClassifyYouTubeUrl(urlCase.url);
+    YouTubeUrlInfo wide = ClassifyYouTubeUrl(std::wstring(urlCase.url.begin(), urlCase.url.end()));
+    bool downloadable = urlCase.url.compare(0, 4, "http") == 0 &&
+                        (urlCase.kind == "video" || urlCase.kind == "short" || urlCase.kind == "live" ||
+                         urlCase.kind == "playlist");
+    if (KindName(info.kind) != urlCase.kind || info.videoId != urlCase.videoId ||
+        info.playlistId != urlCase.playlistId || wide.kind != info.kind ||
+        wide.videoId != std::wstring(info.videoId.begin(), info.videoId.end()) ||
+        IsYouTubeUrl(urlCase.url) != downloadable) {
+        std::fprintf(stderr, "%s: got %s %s %s\n", urlCase.url.c_str(), KindName(info.kind), info.videoId.c_str(),
+                     info.playlistId.c_str());
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+    std::string text;
+    std::vector<UrlCase> cases;
+    if (!ReadFixture("youtube_urls.txt", text) || !ReadCases(text, cases)) {
+        return 1;
+    }
+    for (const auto& urlCase : cases) {
+        if (!CheckCase(urlCase)) {
+            return 1;
+        }
+    }
+
+    // The shapes interleaved, as a pasted list would have them
+    std::vector<std::string> urls;
+    std::vector<std::wstring> wideUrls;
+    urls.reserve(kBulkUrls);
+    wideUrls.reserve(kBulkUrls);
+    for (size_t i = 0; i < kBulkUrls; i++) {
+        urls.push_back(cases[i % cases.size()].url);
+        wideUrls.push_back(std::wstring(urls.back().begin(), urls.back().end()));
+    }
+
+    size_t videos = 0;
+    double seconds = TimeBest(rounds, [&]() {
+        videos = 0;
+        for (const auto& url : urls) {
+            videos += IsVideoUrlKind(ClassifyYouTubeUrl(url).kind) ? 1 : 0;
+        }
+    });
+    size_t wideVideos = 0;
+    double wideSeconds = TimeBest(rounds, [&]() {
+        wideVideos = 0;
+        for (const auto& url : wideUrls) {
+            wideVideos += IsVideoUrlKind(ClassifyYouTubeUrl(url).kind) ? 1 : 0;
+        }
+    });
+    if (videos != wideVideos || videos == 0) {
+        std::fprintf(stderr, "%zu videos from UTF-8, %zu from wide strings\n", videos, wideVideos);
+        return 1;
+    }
+
+    std::printf("%zu URLs, %zu videos\n", urls.size(), videos);
+    std::printf("utf-8: %8.2f ms  %6.1f M URLs/s\n", seconds * 1000, urls.size() / seconds / 1e6);
+    std::printf("wide:  %8.2f ms  %6.1f M URLs/s\n", wideSeconds * 1000, wideUrls.size() / wideSeconds / 1e6);
+    return 0;
+}
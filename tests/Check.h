@@ -0,0 +1,31 @@
+// Check.h : Minimal assertion helpers shared by the core tests.
+//
+// A failed CHECK prints the expression and location and marks the test as failed;
+// the test's main returns CheckResult() so ctest sees the failure.
+
+#pragma once
+
+#include <cstdio>
+
+inline int& CheckFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(expr)                                                                    \
+    do {                                                                               \
+        if (!(expr)) {                                                                 \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #expr); \
+            CheckFailures()++;                                                         \
+        }                                                                              \
+    } while (0)
+
+#define CHECK_EQ(a, b) CHECK((a) == (b))
+
+inline int CheckResult() {
+    if (CheckFailures()) {
+        std::fprintf(stderr, "%d check(s) failed\n", CheckFailures());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+// ChunkedListStressTest.cpp : Publishes chunked playlist snapshots from a fetch thread while
+// reader threads load and walk them, the way the playlist dialog does. Run under
+// ThreadSanitizer it reports any entry a reader can see while the writer still touches it.
+
+#include "core/ChunkedList.h"
+#include "Check.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Same shape as the dialog's PlaylistVideo
+struct Entry {
+    std::wstring id;
+    std::wstring title;
+    double duration;
+};
+
+struct Results {
+    unsigned int generation;
+    bool complete;
+    ChunkedList<Entry> videos;
+};
+typedef std::shared_ptr<const Results> Snapshot;
+
+const size_t kBatch = 200;
+const size_t kEntries = 50000;
+const int kReaders = 4;
+
+Snapshot g_snapshot;
+
+void Publish(unsigned int generation, const ChunkedListBuilder<Entry>& videos, bool complete) {
+    auto snapshot = std::make_shared<Results>();
+    snapshot->generation = generation;
+    snapshot->complete = complete;
+    snapshot->videos = videos.snapshot();
+    std::atomic_store(&g_snapshot, Snapshot(snapshot));
+}
+
+Entry MakeEntry(size_t i) {
+    Entry entry;
+    entry.id = std::to_wstring(i);
+    entry.title = L"Video " + std::to_wstring(i);
+    entry.duration = (double)i;
+    return entry;
+}
+
+void TestSingleThreaded() {
+    ChunkedListBuilder<Entry> builder(3);
+    CHECK(builder.snapshot().empty());
+    for (size_t i = 0; i < 10; i++) {
+        builder.push_back(MakeEntry(i));
+    }
+    ChunkedList<Entry> list = builder.snapshot();
+    CHECK_EQ(list.size(), 10u);
+    for (size_t i = 0; i < list.size(); i++) {
+        CHECK(list[i].id == std::to_wstring(i));
+        CHECK(builder[i].id == std::to_wstring(i));
+    }
+
+    // Later appends never show up in an earlier snapshot
+    builder.push_back(MakeEntry(10));
+    builder.push_back(MakeEntry(11));
+    CHECK_EQ(list.size(), 10u);
+    CHECK(list[9].id == L"9");
+    CHECK_EQ(builder.snapshot().size(), 12u);
+
+    ChunkedListBuilder<Entry> other(3);
+    std::swap(builder, other);
+    CHECK(builder.empty());
+    CHECK_EQ(other.size(), 12u);
+}
+
+void TestConcurrentPublish() {
+    std::atomic<bool> done(false);
+    std::atomic<size_t> snapshotsSeen(0);
+    std::atomic<int> badEntries(0);
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < kReaders; r++) {
+        readers.emplace_back([&]() {
+            size_t lastSize = 0;
+            Snapshot last;
+            while (true) {
+                bool finished = done.load();
+                Snapshot snapshot = std::atomic_load(&g_snapshot);
+                if (snapshot && snapshot != last) {
+                    const ChunkedList<Entry>& videos = snapshot->videos;
+                    if (videos.size() < lastSize) {
+                        badEntries++; // Snapshots only grow
+                    }
+                    // Walk the newly arrived entries and a sample of the old ones
+                    for (size_t i = lastSize; i < videos.size(); i++) {
+                        if (videos[i].duration != (double)i || videos[i].id != std::to_wstring(i)) {
+                            badEntries++;
+                        }
+                    }
+                    for (size_t i = 0; i < lastSize; i += 97) {
+                        if (videos[i].title.compare(0, 6, L"Video ") != 0) {
+                            badEntries++;
+                        }
+                    }
+                    lastSize = videos.size();
+                    last = snapshot;
+                    snapshotsSeen++;
+                }
+                if (finished && (!snapshot || snapshot->complete)) {
+                    break;
+                }
+            }
+        });
+    }
+
+    ChunkedListBuilder<Entry> videos(kBatch);
+    size_t publishedCount = 0;
+    for (size_t i = 0; i < kEntries; i++) {
+        videos.push_back(MakeEntry(i));
+        // Odd-sized pages publish partial tail chunks too, like InnerTube pages do
+        if (videos.size() >= publishedCount + (i % 2 ? kBatch : 137)) {
+            Publish(1, videos, false);
+            publishedCount = videos.size();
+        }
+    }
+    Publish(1, videos, true);
+    done = true;
+
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    Snapshot final = std::atomic_load(&g_snapshot);
+    CHECK(final && final->complete);
+    CHECK_EQ(final->videos.size(), kEntries);
+    CHECK_EQ(badEntries.load(), 0);
+    CHECK(snapshotsSeen.load() > 0);
+}
+
+}  // namespace
+
+int main() {
+    TestSingleThreaded();
+    TestConcurrentPublish();
+    return CheckResult();
+}
@@ -0,0 +1,69 @@
+// CookiesTest.cpp : Checks the Netscape cookie file written for yt-dlp, column by column.
+
+#include "core/Cookies.h"
+#include "Check.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+NetscapeCookie MakeCookie(const char* domain, const char* name, const char* value) {
+    NetscapeCookie cookie;
+    cookie.domain = domain;
+    cookie.path = "/";
+    cookie.name = name;
+    cookie.value = value;
+    cookie.expires = 1767225600;
+    cookie.secure = true;
+    cookie.httpOnly = false;
+    return cookie;
+}
+
+void TestColumns() {
+    std::vector<NetscapeCookie> cookies;
+    cookies.push_back(MakeCookie(".youtube.com", "PREF", "f6=40000000&hl=en"));
+
+    NetscapeCookie session = MakeCookie("www.youtube.com", "YSC", "abc123");
+    session.expires = 0;
+    session.path = "";
+    session.secure = false;
+    session.httpOnly = true;
+    cookies.push_back(session);
+
+    NetscapeCookie expired = MakeCookie(".youtube.com", "VISITOR_INFO1_LIVE", "");
+    expired.expires = -1;
+    cookies.push_back(expired);
+
+    CHECK(FormatNetscapeCookies(cookies) ==
+          "# Netscape HTTP Cookie File\n"
+          ".youtube.com\tTRUE\t/\tTRUE\t1767225600\tPREF\tf6=40000000&hl=en\n"
+          "#HttpOnly_www.youtube.com\tFALSE\t/\tFALSE\t0\tYSC\tabc123\n"
+          ".youtube.com\tTRUE\t/\tTRUE\t0\tVISITOR_INFO1_LIVE\t\n");
+}
+
+void TestRejectedCookies() {
+    std::vector<NetscapeCookie> cookies;
+    cookies.push_back(MakeCookie("", "NO_DOMAIN", "x"));
+    cookies.push_back(MakeCookie(".youtube.com", "", "no name"));
+    cookies.push_back(MakeCookie(".youtube.com", "TAB", "a\tb"));
+    cookies.push_back(MakeCookie(".youtube.com", "NEWLINE", "a\nb"));
+    cookies.push_back(MakeCookie(".youtube.com\r", "CR", "x"));
+    NetscapeCookie badPath = MakeCookie(".youtube.com", "PATH", "x");
+    badPath.path = "/\n.evil.example\tTRUE\t/";
+    cookies.push_back(badPath);
+    cookies.push_back(MakeCookie(".youtube.com", "SID", "kept"));
+
+    CHECK(FormatNetscapeCookies(cookies) ==
+          "# Netscape HTTP Cookie File\n"
+          ".youtube.com\tTRUE\t/\tTRUE\t1767225600\tSID\tkept\n");
+    CHECK(FormatNetscapeCookies(std::vector<NetscapeCookie>()) == "# Netscape HTTP Cookie File\n");
+}
+
+}  // namespace
+
+int main() {
+    TestColumns();
+    TestRejectedCookies();
+    return CheckResult();
+}
@@ -0,0 +1,20 @@
+// Fixture.h : Reads the recorded inputs under tests/fixtures.
+
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+// Read a file from tests/fixtures
+inline bool ReadFixture(const char* name, std::string& contents) {
+    std::string path = std::string(YTP_FIXTURE_DIR) + "/" + name;
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file) {
+        std::fprintf(stderr, "cannot open fixture %s\n", path.c_str());
+        return false;
+    }
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
@@ -0,0 +1,187 @@
+// HeadlessTest.cpp : Parses headless command lines, URL lists and settings, and runs the queue
+// against fixtures/fake_yt_dlp.sh to check the JSON lines it reports and how a stop cancels it.
+
+#include "core/Headless.h"
+#include "core/Process.h"
+#include "nlohmann/json.hpp"
+#include "Check.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* kVideo = "https://www.youtube.com/watch?v=dQw4w9WgXcQ";
+const char* kFailingVideo = "https://www.youtube.com/watch?v=aaaaaaaFAIL";
+const char* kSlowVideo = "https://youtu.be/aaaaaaaSLOW";
+
+HeadlessOptions FakeOptions() {
+    HeadlessOptions options;
+    options.ytDlpPath = std::string(YTP_FIXTURE_DIR) + "/fake_yt_dlp.sh";
+    return options;
+}
+
+void TestParseUrlList() {
+    std::vector<std::string> urls = { "https://youtu.be/dQw4w9WgXcQ" };
+    ParseUrlList("\xEF\xBB\xBF" "https://www.youtube.com/watch?v=dQw4w9WgXcQ\r\n"
+                 "\r\n"
+                 "   # a comment\n"
+                 "\thttps://www.youtube.com/playlist?list=PL590L5WQmH8fJ54F369BLDSqIwcs-TCfs  \n"
+                 "no newline at the end",
+                 urls);
+    CHECK(urls == std::vector<std::string>({ "https://youtu.be/dQw4w9WgXcQ",
+                                             "https://www.youtube.com/watch?v=dQw4w9WgXcQ",
+                                             "https://www.youtube.com/playlist?list=PL590L5WQmH8fJ54F369BLDSqIwcs-TCfs",
+                                             "no newline at the end" }));
+}
+
+void TestParseArguments() {
+    HeadlessOptions options;
+    std::string input;
+    std::vector<std::string> urls;
+    std::string error;
+    CHECK(ParseHeadlessArguments({}, options, input, urls, error));
+    CHECK(input == "-");
+    CHECK(urls.empty());
+
+    input.clear();
+    CHECK(ParseHeadlessArguments({ "--resolution", "720p", "--path", "/tmp/videos", "--subtitles", kVideo,
+                                   "--input", "list.txt", "--yt-dlp", "/opt/yt-dlp" },
+                                 options, input, urls, error));
+    CHECK(options.resolution == "720p");
+    CHECK(options.downloadPath == "/tmp/videos");
+    CHECK(options.downloadSubtitles);
+    CHECK(options.ytDlpPath == "/opt/yt-dlp");
+    CHECK(input == "list.txt");
+    CHECK(urls == std::vector<std::string>({ kVideo }));
+
+    HeadlessOptions rejected;
+    CHECK(!ParseHeadlessArguments({ "--quality", "720p" }, rejected, input, urls, error));
+    CHECK(error == "Unknown option --quality");
+    CHECK(!ParseHeadlessArguments({ "--path" }, rejected, input, urls, error));
+    CHECK(error == "--path needs a value");
+    CHECK(!ParseHeadlessArguments({ "--resolution", "Subtitles Only (srt)" }, rejected, input, urls, error));
+    CHECK(!ParseHeadlessArguments({ "--resolution", "p" }, rejected, input, urls, error));
+    CHECK(ParseHeadlessArguments({ "--resolution", "Audio Only (opus)" }, rejected, input, urls, error));
+}
+
+void TestApplySettings() {
+    HeadlessOptions options;
+    ApplyHeadlessSettings("{\"defaultDownloadPath\": \"D:\\\\Videos\", \"maxConcurrentDownloads\": 40, \"themeMode\": 1}",
+                          options);
+    CHECK(options.downloadPath == "D:\\Videos");
+    CHECK_EQ(options.maxConcurrentDownloads, 16);
+
+    ApplyHeadlessSettings("{\"maxConcurrentDownloads\": \"3\"}", options);
+    CHECK_EQ(options.maxConcurrentDownloads, 16);
+    ApplyHeadlessSettings("not json", options);
+    CHECK(options.downloadPath == "D:\\Videos");
+}
+
+void TestBuildCommand() {
+    HeadlessOptions options;
+    options.ytDlpPath = "C:\\Program Files\\YoutubePlus\\yt-dlp.exe";
+    options.resolution = "1080p";
+    options.downloadPath = "C:\\My Videos";
+    std::vector<std::string> arguments = SplitCommandLine(BuildHeadlessCommand(options, kVideo));
+    CHECK(arguments.front() == options.ytDlpPath);
+    CHECK(arguments.back() == kVideo);
+    CHECK(std::find(arguments.begin(), arguments.end(), "--no-playlist") != arguments.end());
+    CHECK(std::find(arguments.begin(), arguments.end(), "bv*[height<=1080]+ba/b") != arguments.end());
+    CHECK(std::find(arguments.begin(), arguments.end(), "--write-auto-sub") == arguments.end());
+    auto output = std::find(arguments.begin(), arguments.end(), "-o");
+    CHECK(output != arguments.end() && output + 1 != arguments.end() &&
+          output[1] == "C:\\My Videos/%(title)s.%(ext)s");
+
+    // A playlist URL lets yt-dlp go through the whole list
+    options.resolution = "Audio Only (mp3)";
+    options.downloadSubtitles = true;
+    arguments = SplitCommandLine(BuildHeadlessCommand(options, "https://www.youtube.com/playlist?list=PLabcdefghij"));
+    CHECK(std::find(arguments.begin(), arguments.end(), "--no-playlist") == arguments.end());
+    CHECK(std::find(arguments.begin(), arguments.end(), "mp3") != arguments.end());
+    CHECK(std::find(arguments.begin(), arguments.end(), "--write-auto-sub") != arguments.end());
+}
+
+// Run the queue and collect its output; the last status reported for each item is kept by ID
+struct QueueRun {
+    int exitCode = -1;
+    std::vector<nlohmann::json> lines;
+    std::map<int, nlohmann::json> last;
+};
+
+QueueRun RunQueue(const std::vector<std::string>& urls, const HeadlessOptions& options, std::atomic<bool>& stop,
+                  const std::function<void(const nlohmann::json&)>& onLine = nullptr) {
+    QueueRun run;
+    run.exitCode = RunHeadlessQueue(urls, options, [&](const std::string& line) {
+        nlohmann::json j = nlohmann::json::parse(line, nullptr, false);
+        CHECK(j.is_object());
+        run.lines.push_back(j);
+        if (j.value("event", "") == "status") {
+            run.last[j["id"].get<int>()] = j;
+        }
+        if (onLine) {
+            onLine(j);
+        }
+    }, stop);
+    return run;
+}
+
+void TestQueue() {
+    std::atomic<bool> stop(false);
+    QueueRun run = RunQueue({ kVideo, "https://example.com/watch?v=dQw4w9WgXcQ", kFailingVideo }, FakeOptions(), stop);
+    CHECK_EQ(run.exitCode, 1);
+    CHECK(!run.lines.empty() && run.lines.front()["event"] == "skipped");
+    CHECK(!run.lines.empty() && run.lines.back() == nlohmann::json({ { "event", "done" }, { "completed", 1 }, { "failed", 1 } }));
+
+    CHECK_EQ(run.last.size(), 2u);
+    nlohmann::json& done = run.last[1];
+    CHECK(done["status"] == "completed");
+    CHECK(done["title"] == "Title of dQw4w9WgXcQ");
+    CHECK(done["url"] == kVideo);
+    CHECK(done["progress"] == 100.0);
+    CHECK(done["resolution"] == "Best");
+    nlohmann::json& failed = run.last[2];
+    CHECK(failed["status"] == "failed");
+    CHECK(failed.value("error", "").find("Video unavailable") != std::string::npos);
+
+    // Every item is reported as queued before anything else happens to it
+    CHECK(run.lines.size() > 2 && run.lines[1]["status"] == "queued" && run.lines[2]["status"] == "queued");
+
+    std::atomic<bool> unused(false);
+    run = RunQueue({ kVideo, kVideo }, FakeOptions(), unused);
+    CHECK_EQ(run.exitCode, 0);
+}
+
+void TestStop() {
+    // The first download stops the queue once it is under way; the second never starts
+    HeadlessOptions options = FakeOptions();
+    options.maxConcurrentDownloads = 1;
+    std::atomic<bool> stop(false);
+    auto started = std::chrono::steady_clock::now();
+    QueueRun run = RunQueue({ kSlowVideo, kSlowVideo }, options, stop, [&](const nlohmann::json& j) {
+        if (j.value("title", "") == "Slow video") {
+            stop = true;
+        }
+    });
+    CHECK(std::chrono::steady_clock::now() - started < std::chrono::seconds(5));
+    CHECK_EQ(run.exitCode, 1);
+    CHECK(run.last[1]["status"] == "cancelled");
+    CHECK(run.last[1]["title"] == "Slow video");
+    CHECK(run.last[2]["status"] == "cancelled");
+    CHECK(run.lines.back() == nlohmann::json({ { "event", "done" }, { "completed", 0 }, { "failed", 2 } }));
+}
+
+}  // namespace
+
+int main() {
+    TestParseUrlList();
+    TestParseArguments();
+    TestApplySettings();
+    TestBuildCommand();
+    TestQueue();
+    TestStop();
+    return CheckResult();
+}
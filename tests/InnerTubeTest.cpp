@@ -0,0 +1,131 @@
+// InnerTubeTest.cpp : Pages through a playlist against a stand-in for the browse endpoint
+// that replays three recorded responses, and checks the requests the client sends.
+
+#include "core/InnerTube.h"
+#include "Check.h"
+#include "Fixture.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* kListId = "PLstandin0000000000000000000000001";
+const char* kToken1 = "4qmFsgJhEiRWTFBMc3RhbmRpbjAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMQ";
+const char* kToken2 = "4qmFsgJhEiRWTFBMc3RhbmRpbjAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMDAwMg";
+
+// Answers the first request by browseId and the rest by continuation token, like youtube.com
+class StandInServer {
+public:
+    StandInServer() {
+        ReadFixture("innertube_browse_page1.json", pages["VL" + std::string(kListId)]);
+        ReadFixture("innertube_browse_page2.json", pages[kToken1]);
+        ReadFixture("innertube_browse_page3.json", pages[kToken2]);
+    }
+
+    bool Post(const std::string& body, std::string& response) {
+        requests.push_back(nlohmann::json::parse(body));
+        if (requests.size() == failAt) {
+            return false;
+        }
+        const nlohmann::json& request = requests.back();
+        std::string key = request.contains("continuation") ? request["continuation"].get<std::string>()
+                                                           : request.value("browseId", "");
+        auto page = pages.find(key);
+        if (page == pages.end()) {
+            return false; // youtube.com answers 400
+        }
+        response = page->second;
+        return true;
+    }
+
+    InnerTubePost Transport() {
+        return [this](const std::string& body, std::string& response) { return Post(body, response); };
+    }
+
+    std::map<std::string, std::string> pages;
+    std::vector<nlohmann::json> requests;
+    size_t failAt = 0;  // 1-based request the transport fails, 0 for none
+};
+
+void TestFullPlaylist() {
+    StandInServer server;
+    std::vector<InnerTubePlaylistEntry> entries;
+    std::vector<size_t> pageSizes;
+    bool success = EnumerateInnerTubePlaylist(kListId, "2.20991231.00.00", server.Transport(), entries,
+        [&](const std::vector<InnerTubePlaylistEntry>& page) { pageSizes.push_back(page.size()); });
+    CHECK(success);
+
+    // The private video has no videoId and is left out
+    CHECK_EQ(entries.size(), 6u);
+    CHECK(pageSizes == std::vector<size_t>({ 3, 5, 6 }));
+    if (entries.size() == 6) {
+        CHECK(entries[0].videoId == "aaaaaaaaaa1" && entries[0].title == "First video");
+        CHECK(entries[0].channel == "Channel One" && entries[0].duration == 61);
+        CHECK(entries[1].duration == 3725);
+        CHECK(entries[2].title == "Caf\xC3\xA9 \xE2\x80\x93 live" && entries[2].duration == 0);
+        CHECK(entries[3].videoId == "aaaaaaaaaa4" && entries[3].channel == "Channel Two");
+        CHECK(entries[5].videoId == "aaaaaaaaaa6");
+    }
+
+    CHECK_EQ(server.requests.size(), 3u);
+    if (server.requests.size() == 3) {
+        const nlohmann::json& first = server.requests[0];
+        CHECK(first["context"]["client"]["clientName"] == "WEB");
+        CHECK(first["context"]["client"]["clientVersion"] == "2.20991231.00.00");
+        CHECK(first["browseId"] == "VL" + std::string(kListId));
+        CHECK(!first.contains("continuation"));
+        CHECK(server.requests[1]["continuation"] == kToken1 && !server.requests[1].contains("browseId"));
+        CHECK(server.requests[2]["continuation"] == kToken2);
+        CHECK(server.requests[2]["context"]["client"]["clientVersion"] == "2.20991231.00.00");
+    }
+}
+
+void TestDefaultClientVersion() {
+    StandInServer server;
+    std::vector<InnerTubePlaylistEntry> entries;
+    CHECK(EnumerateInnerTubePlaylist(kListId, "", server.Transport(), entries, nullptr));
+    CHECK(!server.requests.empty() &&
+          server.requests[0]["context"]["client"]["clientVersion"] == kInnerTubeClientVersion);
+}
+
+void TestFailures() {
+    // A transport error part way keeps the entries read so far
+    StandInServer server;
+    server.failAt = 3;
+    std::vector<InnerTubePlaylistEntry> entries;
+    CHECK(!EnumerateInnerTubePlaylist(kListId, "", server.Transport(), entries, nullptr));
+    CHECK_EQ(entries.size(), 5u);
+
+    // A page that repeats an earlier token would otherwise loop forever
+    StandInServer looping;
+    looping.pages[kToken2] = looping.pages[kToken1];
+    entries.clear();
+    CHECK(!EnumerateInnerTubePlaylist(kListId, "", looping.Transport(), entries, nullptr));
+    CHECK_EQ(looping.requests.size(), 3u);
+
+    // A first page with no entries is a layout we don't understand
+    StandInServer unknown;
+    unknown.pages["VL" + std::string(kListId)] = "{\"contents\": {\"alerts\": []}}";
+    entries.clear();
+    CHECK(!EnumerateInnerTubePlaylist(kListId, "", unknown.Transport(), entries, nullptr));
+    CHECK(entries.empty());
+
+    StandInServer garbled;
+    garbled.pages[kToken1] = "<html>";
+    entries.clear();
+    CHECK(!EnumerateInnerTubePlaylist(kListId, "", garbled.Transport(), entries, nullptr));
+    CHECK_EQ(entries.size(), 3u);
+
+    CHECK(!EnumerateInnerTubePlaylist("", "", server.Transport(), entries, nullptr));
+}
+
+}  // namespace
+
+int main() {
+    TestFullPlaylist();
+    TestDefaultClientVersion();
+    TestFailures();
+    return CheckResult();
+}
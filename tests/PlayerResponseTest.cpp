@@ -0,0 +1,100 @@
+// PlayerResponseTest.cpp : Parses recorded ytInitialPlayerResponse objects the way the host
+// does when the watch page posts them, and checks which pages may post at all.
+
+#include "core/PlayerResponse.h"
+#include "Check.h"
+#include "Fixture.h"
+
+#include <string>
+
+namespace {
+
+const VideoFormat* FindFormat(const PlayerResponseInfo& info, const char* formatId) {
+    for (const auto& format : info.formats) {
+        if (format.formatId == formatId) {
+            return &format;
+        }
+    }
+    return nullptr;
+}
+
+bool ParseFixture(const char* name, PlayerResponseInfo& info) {
+    std::string text;
+    if (!ReadFixture(name, text)) {
+        return false;
+    }
+    return ParsePlayerResponseJson(nlohmann::json::parse(text), info);
+}
+
+void TestWatchPage() {
+    PlayerResponseInfo info;
+    CHECK(ParseFixture("player_response_watch.json", info));
+    CHECK(info.videoId == "dQw4w9WgXcQ");
+    CHECK(info.title == "Rick Astley - Never Gonna Give You Up (Official Music Video) \xE2\x98\x85");
+    CHECK_EQ(info.duration, 213.0);
+    // The text/vtt entry is neither video nor audio
+    CHECK_EQ(info.formats.size(), 6u);
+
+    const VideoFormat* muxed = FindFormat(info, "18");
+    CHECK(muxed && muxed->hasVideo && muxed->hasAudio);
+    CHECK(muxed && muxed->ext == "mp4" && muxed->height == 360);
+    CHECK(muxed && muxed->filesize == 13385374.0);
+    CHECK(muxed && muxed->tbr == 502.67); // averageBitrate wins over bitrate
+
+    const VideoFormat* video = FindFormat(info, "248");
+    CHECK(video && video->hasVideo && !video->hasAudio);
+    CHECK(video && video->ext == "webm" && video->height == 1080);
+
+    // No contentLength or averageBitrate: size unknown, tbr from bitrate
+    const VideoFormat* ciphered = FindFormat(info, "135");
+    CHECK(ciphered && ciphered->filesize == 0 && ciphered->tbr == 1155.06);
+
+    const VideoFormat* m4a = FindFormat(info, "140");
+    CHECK(m4a && !m4a->hasVideo && m4a->hasAudio);
+    CHECK(m4a && m4a->ext == "m4a" && m4a->height == 0);
+
+    const VideoFormat* opus = FindFormat(info, "251");
+    CHECK(opus && opus->ext == "webm" && opus->hasAudio);
+}
+
+void TestUpcomingPremiere() {
+    PlayerResponseInfo info;
+    info.formats.resize(3); // Left over from an earlier parse
+    CHECK(ParseFixture("player_response_upcoming.json", info));
+    CHECK(info.videoId == "jfKfPfyJRdk");
+    CHECK_EQ(info.duration, 0.0);
+    CHECK(info.formats.empty());
+}
+
+void TestMalformed() {
+    PlayerResponseInfo info;
+    CHECK(!ParsePlayerResponseJson(nlohmann::json::parse("{}"), info));
+    CHECK(!ParsePlayerResponseJson(nlohmann::json::parse("[1, 2]"), info));
+    CHECK(!ParsePlayerResponseJson(nlohmann::json::parse("{\"videoDetails\": {\"title\": \"x\"}}"), info));
+    CHECK(!ParsePlayerResponseJson(nlohmann::json::parse("{\"videoDetails\": {\"videoId\": 7}}"), info));
+    // A format list of the wrong type is skipped, not fatal
+    CHECK(ParsePlayerResponseJson(
+        nlohmann::json::parse("{\"videoDetails\": {\"videoId\": \"a\"}, \"streamingData\": {\"formats\": 5}}"), info));
+    CHECK(info.formats.empty());
+}
+
+void TestMessageSource() {
+    CHECK(IsTrustedMessageSource(L"https://www.youtube.com/watch?v=dQw4w9WgXcQ"));
+    CHECK(IsTrustedMessageSource(L"https://m.youtube.com/watch?v=dQw4w9WgXcQ"));
+    CHECK(!IsTrustedMessageSource(L"https://www.youtube.com"));
+    CHECK(!IsTrustedMessageSource(L"http://www.youtube.com/watch?v=dQw4w9WgXcQ"));
+    CHECK(!IsTrustedMessageSource(L"https://www.youtube.com.example.com/watch"));
+    CHECK(!IsTrustedMessageSource(L"https://evil.example/https://www.youtube.com/"));
+    CHECK(!IsTrustedMessageSource(L"https://music.youtube.com/watch?v=dQw4w9WgXcQ"));
+    CHECK(!IsTrustedMessageSource(L""));
+}
+
+}  // namespace
+
+int main() {
+    TestWatchPage();
+    TestUpcomingPremiere();
+    TestMalformed();
+    TestMessageSource();
+    return CheckResult();
+}
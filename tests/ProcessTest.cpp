@@ -0,0 +1,121 @@
+// ProcessTest.cpp : Runs small shell commands through ChildProcess and checks their output,
+// exit codes and working directory, that a kill takes the whole tree, and that command lines
+// split the way CommandLineToArgvW splits them.
+
+#include "core/Process.h"
+#include "Check.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Read standard output (or error) until every writer has closed it
+std::string ReadAll(ChildProcess& process, bool errors = false) {
+    std::string text;
+    char buffer[256];
+    int bytesRead;
+    while ((bytesRead = errors ? process.ReadErrors(buffer, sizeof(buffer)) : process.ReadOutput(buffer, sizeof(buffer))) > 0) {
+        text.append(buffer, bytesRead);
+    }
+    return text;
+}
+
+void TestSplitCommandLine() {
+    std::vector<std::string> arguments = SplitCommandLine(
+        "\"C:\\Program Files\\yt-dlp.exe\" --progress -o \"C:\\Videos\\%(title)s.%(ext)s\"  a\\\\b \\\"x\\\" \"\"");
+    CHECK(arguments == std::vector<std::string>({ "C:\\Program Files\\yt-dlp.exe", "--progress", "-o",
+                                                  "C:\\Videos\\%(title)s.%(ext)s", "a\\\\b", "\"x\"", "" }));
+    CHECK(SplitCommandLine("yt-dlp \"say \"\"hi\"\"\" \"ends\\\\\"") ==
+          std::vector<std::string>({ "yt-dlp", "say \"hi\"", "ends\\" }));
+    CHECK(SplitCommandLine("   ").empty());
+
+    // Whatever QuoteCommandArgument produces comes back unchanged
+    std::vector<std::string> samples = { "plain", "two words", "", "quote\"inside", "trailing\\", "dir\\ with\\\\",
+                                         "\\\"already\\\" escaped", "tab\there" };
+    std::string commandLine = "program";
+    for (const auto& sample : samples) {
+        commandLine += " " + QuoteCommandArgument(sample);
+    }
+    std::vector<std::string> split = SplitCommandLine(commandLine);
+    CHECK_EQ(split.size(), samples.size() + 1);
+    for (size_t i = 0; i < samples.size() && i + 1 < split.size(); i++) {
+        CHECK(split[i + 1] == samples[i]);
+    }
+    CHECK(QuoteCommandArgument("plain") == "plain");
+}
+
+void TestOutputAndExitCode() {
+    ChildProcess process;
+    CHECK(process.Start("sh -c \"printf 'first\\nsecond\\n'; echo hidden >&2; exit 3\"", ProcessOptions()));
+    CHECK(ReadAll(process) == "first\nsecond\n");
+    CHECK(process.Wait());
+    CHECK_EQ(process.ExitCode(), 3);
+
+    ProcessOptions separate;
+    separate.errors = ErrorsSeparate;
+    ChildProcess split;
+    CHECK(split.Start("sh -c \"echo out; echo err >&2\"", separate));
+    CHECK(ReadAll(split) == "out\n");
+    CHECK(ReadAll(split, true) == "err\n");
+    CHECK(split.Wait() && split.ExitCode() == 0);
+
+    ProcessOptions merged;
+    merged.errors = ErrorsToOutput;
+    merged.workingDirectory = YTP_FIXTURE_DIR;
+    ChildProcess both;
+    CHECK(both.Start("sh -c \"ls youtube_urls.txt >&2; echo done\"", merged));
+    CHECK(ReadAll(both) == "youtube_urls.txt\ndone\n");
+    CHECK(both.Wait() && both.ExitCode() == 0);
+
+    ChildProcess missing;
+    CHECK(!missing.Start("no-such-program-for-youtubeplus --version", ProcessOptions()));
+    CHECK_EQ(missing.ExitCode(), -1);
+}
+
+void TestTimeoutsAndKill() {
+    // The background sleep inherits the output pipe, so it only closes once the whole tree is gone
+    ChildProcess process;
+    CHECK(process.Start("sh -c \"sleep 30 & echo started; wait\"", ProcessOptions()));
+    char buffer[64];
+    CHECK_EQ(process.ReadOutput(buffer, sizeof(buffer), 5000), 8);
+    CHECK_EQ(process.ReadOutput(buffer, sizeof(buffer), 50), kProcessReadTimeout);
+    CHECK(!process.Wait(50));
+    CHECK_EQ(process.ExitCode(), -1);
+
+    auto killed = std::chrono::steady_clock::now();
+    process.Kill();
+    CHECK_EQ(process.ReadOutput(buffer, sizeof(buffer), 5000), kProcessReadClosed);
+    CHECK(process.Wait(5000));
+    CHECK(process.ExitCode() != 0);
+    CHECK(std::chrono::steady_clock::now() - killed < std::chrono::seconds(5));
+
+    // Going out of scope kills a process that is still running
+    auto started = std::chrono::steady_clock::now();
+    {
+        ChildProcess abandoned;
+        CHECK(abandoned.Start("sleep 30", ProcessOptions()));
+    }
+    CHECK(std::chrono::steady_clock::now() - started < std::chrono::seconds(5));
+}
+
+void TestCpuSeconds() {
+    ChildProcess process;
+    ProcessOptions options;
+    options.captureOutput = false;
+    CHECK(process.Start("sh -c \"i=0; while [ $i -lt 300000 ]; do i=$((i+1)); done\"", options));
+    CHECK(process.Wait());
+    CHECK_EQ(process.ExitCode(), 0);
+    CHECK(process.CpuSeconds() > 0);
+}
+
+}  // namespace
+
+int main() {
+    TestSplitCommandLine();
+    TestOutputAndExitCode();
+    TestTimeoutsAndKill();
+    TestCpuSeconds();
+    return CheckResult();
+}
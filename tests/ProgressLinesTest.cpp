@@ -0,0 +1,82 @@
+// ProgressLinesTest.cpp : Feeds yt-dlp --newline output to LineAccumulator in chunks that
+// split lines and numbers at every possible point, and checks the fields read from each line.
+
+#include "core/ProgressLines.h"
+#include "Check.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* kOutput =
+    "[youtube] Extracting URL: https://www.youtube.com/watch?v=dQw4w9WgXcQ\n"
+    "[info] dQw4w9WgXcQ: Downloading 1 format(s): 137+140\r\n"
+    "[download] Destination: Rick Astley at home [dQw4w9WgXcQ].f137.mp4\n"
+    "[download]   0.0% of   76.26MiB at  Unknown B/s ETA Unknown\n"
+    "[download]  12.5% of   76.26MiB at    1.23MiB/s ETA 00:54\n"
+    "[download]  99.9% of ~  76.26MiB at  512.00KiB/s ETA 00:00 (frag 9/10)\r"
+    "[download] 100% of   76.26MiB in 00:00:31 at 2.45GiB/s\n"
+    "partial line with no end";
+
+std::vector<std::string> Split(size_t chunkSize, std::string& pending) {
+    std::vector<std::string> lines;
+    LineAccumulator accumulator;
+    std::string output = kOutput;
+    for (size_t pos = 0; pos < output.size(); pos += chunkSize) {
+        size_t size = output.size() - pos < chunkSize ? output.size() - pos : chunkSize;
+        accumulator.Append(output.data() + pos, size, [&](const std::string& line) { lines.push_back(line); });
+    }
+    pending = accumulator.Pending();
+    return lines;
+}
+
+void TestChunking() {
+    std::string pending;
+    std::vector<std::string> whole = Split(4096, pending);
+    CHECK_EQ(whole.size(), 7u);
+    CHECK(pending == "partial line with no end");
+    if (whole.size() == 7) {
+        CHECK(whole[1] == "[info] dQw4w9WgXcQ: Downloading 1 format(s): 137+140");
+        CHECK(whole[5].back() == ')');
+    }
+
+    // Every chunk size must yield the same lines, including one byte at a time
+    for (size_t chunkSize = 1; chunkSize <= 64; chunkSize++) {
+        std::string chunkPending;
+        CHECK(Split(chunkSize, chunkPending) == whole);
+        CHECK(chunkPending == pending);
+    }
+}
+
+void TestFields() {
+    std::string pending;
+    std::vector<std::string> lines = Split(7, pending);
+    CHECK_EQ(lines.size(), 7u);
+    if (lines.size() != 7) {
+        return;
+    }
+    CHECK_EQ(ParseProgressPercent(lines[0]), -1.0);
+    CHECK_EQ(ParseProgressPercent(lines[2]), -1.0);
+    CHECK_EQ(ParseProgressSpeed(lines[2]), 0.0);   // " at " in a file name is not a speed
+    CHECK_EQ(ParseProgressPercent(lines[3]), 0.0);
+    CHECK_EQ(ParseProgressSpeed(lines[3]), 0.0);
+    CHECK_EQ(ParseProgressPercent(lines[4]), 12.5);
+    CHECK_EQ(ParseProgressSpeed(lines[4]), 1.23 * 1024 * 1024);
+    CHECK_EQ(ParseProgressPercent(lines[5]), 99.9);
+    CHECK_EQ(ParseProgressSpeed(lines[5]), 512.0 * 1024);
+    CHECK_EQ(ParseProgressPercent(lines[6]), 100.0);
+    CHECK_EQ(ParseProgressSpeed(lines[6]), 2.45 * 1024 * 1024 * 1024);
+
+    // What a read ending inside "1.23MiB/s" looks like; the reason only complete lines are parsed
+    CHECK_EQ(ParseProgressSpeed("[download]  12.5% of   76.26MiB at    1"), 1.0);
+    CHECK_EQ(ParseProgressPercent("[download]99.0%"), -1.0);
+}
+
+}  // namespace
+
+int main() {
+    TestChunking();
+    TestFields();
+    return CheckResult();
+}
@@ -0,0 +1,404 @@
+// SegmentedTransferTest.cpp : Runs segmented transfers against a local HTTP server that
+// honours Range requests, cuts some responses short and refuses some connections, and
+// checks that the file comes out byte for byte. Run under ThreadSanitizer it also covers
+// the scheduler's locking.
+
+#include "core/SegmentedTransfer.h"
+#include "Check.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Deterministic content, so any misplaced byte shows
+char ContentByte(long long offset) {
+    return (char)((offset * 2654435761u) >> 13);
+}
+
+// Serves a file of the given size over HTTP/1.1 keep-alive connections
+class RangeServer {
+public:
+    explicit RangeServer(long long size) : size(size) {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        socklen_t length = sizeof(address);
+        if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 16) != 0 ||
+            getsockname(listener, (sockaddr*)&address, &length) != 0) {
+            std::perror("range server");
+            std::exit(1);
+        }
+        port = ntohs(address.sin_port);
+        acceptor = std::thread([this]() { AcceptLoop(); });
+    }
+
+    ~RangeServer() {
+        stopping = true;
+        shutdown(listener, SHUT_RDWR);
+        close(listener);
+        acceptor.join();
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& connection : connections) {
+            connection.join();
+        }
+    }
+
+    int Port() const { return port; }
+
+    std::atomic<int> cutEvery{ 0 };        // Cut every Nth response short; 0 for never
+    std::atomic<int> refuseFirst{ 0 };     // Close the first N connections without answering
+    std::atomic<int> requests{ 0 };
+    std::atomic<long long> bytesServed{ 0 };
+
+    std::mutex rangesMutex;
+    std::vector<std::pair<long long, long long>> ranges; // Every range requested
+
+private:
+    void AcceptLoop() {
+        while (!stopping) {
+            int client = accept(listener, nullptr, nullptr);
+            if (client < 0) {
+                break;
+            }
+            if (refuseFirst.fetch_sub(1) > 0) {
+                close(client);
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            connections.emplace_back([this, client]() { Serve(client); });
+        }
+    }
+
+    void Serve(int client) {
+        std::string pending;
+        char buffer[4096];
+        while (true) {
+            size_t headerEnd;
+            while ((headerEnd = pending.find("\r\n\r\n")) == std::string::npos) {
+                ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+                if (received <= 0) {
+                    close(client);
+                    return;
+                }
+                pending.append(buffer, received);
+            }
+            std::string request = pending.substr(0, headerEnd);
+            pending.erase(0, headerEnd + 4);
+
+            long long start = 0;
+            long long last = 0;
+            size_t range = request.find("Range: bytes=");
+            if (range == std::string::npos ||
+                std::sscanf(request.c_str() + range, "Range: bytes=%lld-%lld", &start, &last) != 2 ||
+                start > last || last >= size) {
+                const char* response = "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Length: 0\r\n\r\n";
+                send(client, response, strlen(response), MSG_NOSIGNAL);
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(rangesMutex);
+                ranges.push_back(std::make_pair(start, last + 1));
+            }
+            int number = ++requests;
+            char header[256];
+            std::snprintf(header, sizeof(header),
+                          "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes %lld-%lld/%lld\r\n"
+                          "Content-Length: %lld\r\n\r\n",
+                          start, last, size, last - start + 1);
+            send(client, header, strlen(header), MSG_NOSIGNAL);
+
+            // A cut response sends half the body and drops the connection, as a throttling CDN does
+            long long end = last + 1;
+            bool cut = cutEvery > 0 && number % cutEvery == 0;
+            if (cut) {
+                end = start + (end - start) / 2;
+            }
+            std::vector<char> body(64 * 1024);
+            for (long long offset = start; offset < end;) {
+                size_t chunk = (size_t)std::min<long long>((long long)body.size(), end - offset);
+                for (size_t i = 0; i < chunk; i++) {
+                    body[i] = ContentByte(offset + i);
+                }
+                ssize_t sent = send(client, body.data(), chunk, MSG_NOSIGNAL);
+                if (sent <= 0) {
+                    close(client);
+                    return;
+                }
+                offset += sent;
+                bytesServed += sent;
+            }
+            if (cut) {
+                close(client);
+                return;
+            }
+        }
+    }
+
+    long long size;
+    int listener;
+    int port;
+    std::atomic<bool> stopping{ false };
+    std::thread acceptor;
+    std::mutex mutex;
+    std::vector<std::thread> connections;
+};
+
+int OpenSocket(int port) {
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((unsigned short)port);
+    if (connect(client, (sockaddr*)&address, sizeof(address)) != 0) {
+        close(client);
+        return -1;
+    }
+    return client;
+}
+
+// The client side of one keep-alive connection. Like a WinHTTP connection handle, it opens a
+// new socket when the server dropped the last one.
+class SocketRangeConnection : public RangeConnection {
+public:
+    SocketRangeConnection(int port, int socket) : port(port), socket(socket) {}
+    ~SocketRangeConnection() override {
+        if (socket >= 0) {
+            close(socket);
+        }
+    }
+
+    bool Request(long long start, long long end) override {
+        if (remaining > 0 || broken) {
+            // The previous body wasn't read to the end, so the socket can't carry another request
+            close(socket);
+            socket = OpenSocket(port);
+            remaining = 0;
+            broken = socket < 0;
+            if (broken) {
+                return false;
+            }
+        }
+        char request[128];
+        std::snprintf(request, sizeof(request), "GET /media HTTP/1.1\r\nHost: 127.0.0.1\r\nRange: bytes=%lld-%lld\r\n\r\n",
+                      start, end - 1);
+        if (send(socket, request, strlen(request), MSG_NOSIGNAL) <= 0) {
+            broken = true;
+            return false;
+        }
+        std::string header;
+        char c;
+        while (header.size() < 4 || header.compare(header.size() - 4, 4, "\r\n\r\n") != 0) {
+            if (recv(socket, &c, 1, 0) != 1) {
+                broken = true;
+                return false;
+            }
+            header += c;
+        }
+        size_t length = header.find("Content-Length: ");
+        if (header.compare(0, 12, "HTTP/1.1 206") != 0 || length == std::string::npos) {
+            return false;
+        }
+        remaining = std::atoll(header.c_str() + length + 16);
+        return true;
+    }
+
+    size_t Read(char* buffer, size_t size) override {
+        if (remaining <= 0) {
+            return 0;
+        }
+        ssize_t received = recv(socket, buffer, (size_t)std::min<long long>((long long)size, remaining), 0);
+        if (received <= 0) {
+            broken = true;
+            remaining = 0;
+            return 0;
+        }
+        remaining -= received;
+        return (size_t)received;
+    }
+
+private:
+    int port;
+    int socket;
+    long long remaining = 0;
+    bool broken = false;
+};
+
+std::unique_ptr<RangeConnection> Connect(int port) {
+    int client = OpenSocket(port);
+    if (client < 0) {
+        return nullptr;
+    }
+    return std::unique_ptr<RangeConnection>(new SocketRangeConnection(port, client));
+}
+
+// The preallocated file, in memory
+struct MemoryFile {
+    explicit MemoryFile(long long size) : data((size_t)size, '\0') {}
+
+    SegmentIo Io(int port) {
+        SegmentIo io;
+        io.connect = [port]() { return Connect(port); };
+        io.write = [this](long long offset, const char* bytes, size_t size) {
+            std::memcpy(&data[(size_t)offset], bytes, size);
+            return true;
+        };
+        io.checkIntervalMs = 100;
+        return io;
+    }
+
+    bool Matches(long long from, long long to) const {
+        for (long long offset = from; offset < to; offset++) {
+            if (data[(size_t)offset] != ContentByte(offset)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<char> data;
+};
+
+const long long kFileSize = 12 * 1024 * 1024 + 12345;   // Not a multiple of any segment size
+
+void TestFullTransfer() {
+    RangeServer server(kFileSize);
+    server.cutEvery = 4;
+    MemoryFile file(kFileSize);
+    SegmentScheduler scheduler(kFileSize);
+    SegmentIo io = file.Io(server.Port());
+    std::atomic<int> intervals(0);
+    io.onInterval = [&](double) { intervals++; };
+
+    CHECK(RunSegmentedTransfer(scheduler, io));
+    CHECK(scheduler.Complete());
+    CHECK_EQ(scheduler.BytesDone(), kFileSize);
+    CHECK(file.Matches(0, kFileSize));
+    ByteRanges completed = scheduler.Completed();
+    CHECK(completed.size() == 1 && completed[0] == std::make_pair(0LL, kFileSize));
+    CHECK(server.requests.load() > 4);  // Some responses were cut and fetched again
+}
+
+void TestResume() {
+    RangeServer server(kFileSize);
+    MemoryFile file(kFileSize);
+    // An earlier attempt wrote the start, a middle stretch and the end
+    ByteRanges done = { { 0, 1000000 }, { 5000000, 6000000 }, { kFileSize - 1, kFileSize } };
+    for (const auto& range : done) {
+        for (long long offset = range.first; offset < range.second; offset++) {
+            file.data[(size_t)offset] = ContentByte(offset);
+        }
+    }
+    SegmentScheduler scheduler(kFileSize);
+    scheduler.Resume(done);
+    CHECK_EQ(scheduler.BytesDone(), 2000001LL);
+
+    CHECK(RunSegmentedTransfer(scheduler, file.Io(server.Port())));
+    CHECK(file.Matches(0, kFileSize));
+    CHECK_EQ(server.bytesServed.load(), kFileSize - 2000001);
+    std::lock_guard<std::mutex> lock(server.rangesMutex);
+    for (const auto& range : server.ranges) {
+        bool overlaps = false;
+        for (const auto& kept : done) {
+            overlaps = overlaps || (range.first < kept.second && kept.first < range.second);
+        }
+        CHECK(!overlaps);
+    }
+}
+
+void TestDroppedConnections() {
+    // A connection the server drops before answering is opened again
+    RangeServer server(kFileSize);
+    server.refuseFirst = 1;
+    MemoryFile file(kFileSize);
+    SegmentScheduler scheduler(kFileSize);
+    CHECK(RunSegmentedTransfer(scheduler, file.Io(server.Port())));
+    CHECK(file.Matches(0, kFileSize));
+
+    // A server that can't be reached at all fails the transfer instead of hanging it
+    SegmentScheduler unreachable(kFileSize);
+    SegmentIo io = file.Io(server.Port());
+    io.connect = []() { return std::unique_ptr<RangeConnection>(); };
+    CHECK(!RunSegmentedTransfer(unreachable, io));
+    CHECK(unreachable.Failed());
+    CHECK_EQ(unreachable.BytesDone(), 0LL);
+}
+
+void TestStop() {
+    RangeServer server(kFileSize);
+    MemoryFile file(kFileSize);
+    SegmentScheduler scheduler(kFileSize);
+    SegmentIo io = file.Io(server.Port());
+    io.stopped = [&]() { return scheduler.BytesDone() > 0; };
+    CHECK(!RunSegmentedTransfer(scheduler, io));
+    CHECK(scheduler.Stopped() && !scheduler.Failed());
+    CHECK(scheduler.BytesDone() < kFileSize);
+    // What was recorded is on disk, so a resumed attempt may rely on it
+    for (const auto& range : scheduler.Completed()) {
+        CHECK(file.Matches(range.first, range.second));
+    }
+}
+
+void TestConnectionController() {
+    ConnectionController controller;
+    CHECK_EQ(controller.Connections(), kInitialSegmentConnections);
+    CHECK_EQ(controller.Update(1000, true), 3);     // First measurement
+    CHECK_EQ(controller.Update(1500, true), 4);     // The third connection helped
+    CHECK_EQ(controller.Update(1600, true), 4);     // The fourth didn't help enough
+    CHECK_EQ(controller.Update(1200, true), 3);     // The aggregate rate fell: drop one
+    CHECK_EQ(controller.Update(2000, true), 3);     // ...and don't grow back past that
+    CHECK_EQ(controller.Update(1000, true), 2);
+    CHECK_EQ(controller.Update(500, true), 1);
+    CHECK_EQ(controller.Update(100, true), 1);      // Never below one
+    CHECK_EQ(controller.Update(5000, false), 1);
+
+    ConnectionController finishing;
+    CHECK_EQ(finishing.Update(1000, false), kInitialSegmentConnections); // Nothing left to add one for
+    for (int i = 0; i < 20; i++) {
+        finishing.Update(1000.0 * (i + 2) * (i + 2), true);
+    }
+    CHECK_EQ(finishing.Connections(), kMaxSegmentConnections);
+}
+
+void TestScheduler() {
+    SegmentScheduler scheduler(kMinSegmentSize * 3);
+    SegmentRange range;
+    CHECK(scheduler.Next(range));
+    CHECK(range.start == 0 && range.end == kMinSegmentSize);
+    // A range that keeps failing part way fails the transfer after kMaxSegmentAttempts
+    for (int attempt = 1; attempt < kMaxSegmentAttempts; attempt++) {
+        scheduler.Finish(range, range.start + 10, 1);
+        CHECK(!scheduler.Failed());
+        CHECK(scheduler.Next(range));
+        CHECK_EQ(range.attempts, attempt);
+    }
+    scheduler.Finish(range, range.start, 1);
+    CHECK(scheduler.Failed());
+}
+
+}  // namespace
+
+int main() {
+    TestScheduler();
+    TestConnectionController();
+    TestFullTransfer();
+    TestResume();
+    TestDroppedConnections();
+    TestStop();
+    return CheckResult();
+}
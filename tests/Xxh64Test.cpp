@@ -0,0 +1,58 @@
+// Xxh64Test.cpp : Checks XXH64 against known answers around the 32-byte stripe size, and that
+// feeding the same bytes in pieces of any size gives the same digest.
+
+#include "core/Xxh64.h"
+#include "Check.h"
+
+#include <string>
+
+namespace {
+
+uint64_t Hash(const std::string& text) {
+    Xxh64State state;
+    Xxh64Update(state, text.data(), text.size());
+    return Xxh64Digest(state);
+}
+
+// Bytes that aren't all text, so every value of the tail loops is exercised
+std::string Sequence(size_t length) {
+    std::string bytes;
+    for (size_t i = 0; i < length; i++) {
+        bytes += (char)((i * 7 + 3) & 0xFF);
+    }
+    return bytes;
+}
+
+void TestKnownAnswers() {
+    CHECK_EQ(Hash(""), 0xEF46DB3751D8E999ULL);
+    CHECK_EQ(Hash("a"), 0xD24EC4F1A98C6E5BULL);
+    CHECK_EQ(Hash("abc"), 0x44BC2CF5AD770999ULL);
+    CHECK_EQ(Hash(Sequence(12)), 0xD52E407833AF5133ULL);
+    CHECK_EQ(Hash(Sequence(31)), 0xA2AA5F33CC4A6119ULL);
+    CHECK_EQ(Hash(Sequence(32)), 0x23C3C17EF790FD97ULL);
+    // 39 bytes: one stripe, then an 8-byte, a 4-byte and single-byte tail
+    CHECK_EQ(Hash("Nobody inspects the spammish repetition"), 0xFBCEA83C8A378BF1ULL);
+    CHECK_EQ(Hash(Sequence(100)), 0xA61F8D4C170FE531ULL);
+}
+
+void TestPieces() {
+    std::string bytes = Sequence(100);
+    uint64_t whole = Hash(bytes);
+    for (size_t pieceSize = 1; pieceSize <= bytes.size(); pieceSize++) {
+        Xxh64State state;
+        for (size_t pos = 0; pos < bytes.size(); pos += pieceSize) {
+            size_t size = bytes.size() - pos < pieceSize ? bytes.size() - pos : pieceSize;
+            Xxh64Update(state, bytes.data() + pos, size);
+        }
+        CHECK_EQ(Xxh64Digest(state), whole);
+        CHECK_EQ(state.total, (uint64_t)bytes.size());
+    }
+}
+
+}  // namespace
+
+int main() {
+    TestKnownAnswers();
+    TestPieces();
+    return CheckResult();
+}
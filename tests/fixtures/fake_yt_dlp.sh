@@ -0,0 +1,19 @@
+#!/bin/sh
+# Stands in for yt-dlp in HeadlessTest: prints what yt-dlp would for the URL (its last argument).
+# Video IDs ending in FAIL fail, and ones ending in SLOW wait until they are killed.
+for url; do :; done
+case "$url" in
+*FAIL)
+    echo "ERROR: [youtube] ${url##*=}: Video unavailable" >&2
+    exit 1
+    ;;
+*SLOW)
+    echo "ytp-title Slow video"
+    sleep 30
+    ;;
+esac
+echo "[youtube] Extracting URL: $url"
+echo "ytp-title Title of ${url##*=}"
+printf '[download]   0.0%% of   10.00MiB at  Unknown B/s ETA Unknown\n'
+printf '[download]  50.0%% of   10.00MiB at    2.00MiB/s ETA 00:02\r'
+printf '[download] 100%% of   10.00MiB in 00:00:04 at 2.50MiB/s\n'